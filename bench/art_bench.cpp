@@ -0,0 +1,117 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/map.h>
+#include <datastore/clients/radix_map.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr auto count = 1 << 16;
+
+/** Bytes currently allocated through the global operator new */
+std::atomic<std::size_t> allocated{0};
+
+/** Header recording the size of each allocation, preserving alignment */
+constexpr auto header = alignof(std::max_align_t);
+
+/** Returns keys with the long shared prefixes of tenant/entity/ paths */
+std::vector<std::string> make_keys() {
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  char key[64];
+  for (auto i = 0; i < count; ++i) {
+    std::snprintf(key, sizeof(key), "tenant/%04d/entity/%08d/name", i % 16,
+                  i * 7919 % count);
+    keys.emplace_back(key);
+  }
+  return keys;
+}
+
+template <typename Client>
+void fill(Client& datastore, const std::vector<std::string>& keys) {
+  for (const auto& key : keys) {
+    datastore.insert(std::pair(std::string_view(key), "value"));
+  }
+}
+
+/** Measures the memory held per element after inserting every key */
+template <typename Client>
+void memory(benchmark::State& state) {
+  auto keys = make_keys();
+  for (auto _ : state) {
+    auto before = allocated.load();
+    {
+      Client datastore;
+      fill(datastore, keys);
+      state.counters["bytes_per_key"] =
+          static_cast<double>(allocated.load() - before) / count;
+    }
+  }
+}
+BENCHMARK_TEMPLATE(memory, datastore::clients::map_client)->Iterations(1);
+BENCHMARK_TEMPLATE(memory, datastore::clients::radix_map_client)
+    ->Iterations(1);
+
+/** Measures random lookups of existing keys */
+template <typename Client>
+void lookup(benchmark::State& state) {
+  auto keys = make_keys();
+  Client datastore;
+  fill(datastore, keys);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+  auto i = 0u;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(datastore.find(keys[i++ % count]));
+  }
+}
+BENCHMARK_TEMPLATE(lookup, datastore::clients::map_client);
+BENCHMARK_TEMPLATE(lookup, datastore::clients::radix_map_client);
+
+/** Measures scans of the 1/16th of the keys sharing a tenant prefix */
+template <typename Client>
+void prefix_scan(benchmark::State& state) {
+  auto keys = make_keys();
+  Client datastore;
+  fill(datastore, keys);
+  for (auto _ : state) {
+    auto [first, last] = datastore.prefix("tenant/0007/");
+    for (; first != last; ++first) {
+      benchmark::DoNotOptimize(*first);
+    }
+  }
+}
+BENCHMARK_TEMPLATE(prefix_scan, datastore::clients::map_client);
+BENCHMARK_TEMPLATE(prefix_scan, datastore::clients::radix_map_client);
+
+}  // namespace
+
+// Allocations are counted with a replaced global operator new, so that the
+// memory of both backends is measured in the same way
+void* operator new(std::size_t size) {
+  auto memory = static_cast<char*>(std::malloc(size + header));
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<std::size_t*>(memory) = size;
+  allocated.fetch_add(size, std::memory_order_relaxed);
+  return memory + header;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer != nullptr) {
+    auto memory = static_cast<char*>(pointer) - header;
+    allocated.fetch_sub(*reinterpret_cast<std::size_t*>(memory),
+                        std::memory_order_relaxed);
+    std::free(memory);
+  }
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  operator delete(pointer);
+}
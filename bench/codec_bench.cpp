@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+#include <datastore/bijective/binary.h>
+#include <datastore/clients/map.h>
+#include <datastore/compression.h>
+#include <datastore/map.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int count = 1 << 12;
+
+template <typename Map>
+void find(benchmark::State& state, Map& map) {
+  for (auto i = 0; i < count; ++i) {
+    map.insert(std::pair{i, static_cast<double>(i)});
+  }
+  auto i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(i)->second);
+    i = (i + 1) % count;
+  }
+}
+
+/** Type-erased codecs, chosen at runtime */
+void find_runtime(benchmark::State& state) {
+  auto datastore = datastore::clients::make_map();
+  datastore::map<int, double> map{*datastore,
+                                  datastore::bijective::binary<int>{},
+                                  datastore::bijective::binary<double>{}};
+  find(state, map);
+}
+BENCHMARK(find_runtime);
+
+/** Statically dispatched codecs, inlined into the map */
+void find_static(benchmark::State& state) {
+  auto datastore = datastore::clients::make_map();
+  datastore::map<int, double, datastore::bijective::binary<int>,
+                 datastore::bijective::binary<double>>
+      map{*datastore};
+  find(state, map);
+}
+BENCHMARK(find_static);
+
+/** JSON-like values, sharing most of their strings with each other */
+std::vector<std::string> records() {
+  std::vector<std::string> result;
+  for (auto i = 0; i < count; ++i) {
+    result.push_back(R"({"id":)" + std::to_string(i) + R"(,"email":"user)" +
+                     std::to_string(i) +
+                     R"(@example.com","roles":["reader","writer"],)"
+                     R"("preferences":{"theme":"dark","language":"en"}})");
+  }
+  return result;
+}
+
+/** Compressor with a dictionary trained on the records if trained */
+datastore::compressor compressor(const std::vector<std::string>& values,
+                                 bool trained) {
+  auto result = datastore::compressor();
+  if (trained) {
+    result.add_dictionary(
+        1, datastore::train_dictionary(
+               std::vector<std::string_view>(values.begin(), values.end()),
+               16 << 10));
+  }
+  return result;
+}
+
+void compress(benchmark::State& state) {
+  auto values = records();
+  auto codec = compressor(values, state.range(0) != 0);
+  std::size_t i = 0;
+  std::size_t raw = 0;
+  std::size_t stored = 0;
+  for (auto _ : state) {
+    auto value = codec.f(values[i]);
+    benchmark::DoNotOptimize(value.data());
+    raw += values[i].size();
+    stored += value.size();
+    i = (i + 1) % values.size();
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(raw));
+  state.counters["ratio"] = static_cast<double>(raw) / stored;
+}
+BENCHMARK(compress)->Arg(0)->Arg(1);
+
+void decompress(benchmark::State& state) {
+  auto values = records();
+  auto codec = compressor(values, state.range(0) != 0);
+  std::vector<std::string> stored;
+  for (const auto& value : values) {
+    stored.emplace_back(codec.f(value));
+  }
+  std::size_t i = 0;
+  std::size_t raw = 0;
+  for (auto _ : state) {
+    auto value = codec.g(stored[i]);
+    benchmark::DoNotOptimize(value.data());
+    raw += value.size();
+    i = (i + 1) % stored.size();
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(raw));
+}
+BENCHMARK(decompress)->Arg(0)->Arg(1);
+
+}  // namespace
@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <datastore/compare.h>
+#include <filesystem>
+#include <random>
+
+namespace {
+
+std::vector<std::string> hashes(std::size_t count) {
+  auto engine = std::mt19937_64{42};
+  auto result = std::vector<std::string>(count, std::string(32, '\0'));
+  for (auto& hash : result) {
+    for (std::size_t i = 0; i < hash.size(); i += sizeof(std::uint64_t)) {
+      auto word = engine();
+      std::memcpy(hash.data() + i, &word, sizeof(word));
+    }
+  }
+  return result;
+}
+
+datastore::key_compare comparator(std::int64_t index) {
+  return index == 0 ? nullptr : datastore::compare::fixed<32>;
+}
+
+void compare_bytes(benchmark::State& state) {
+  auto keys = hashes(1024);
+  auto others = keys;
+  for (auto& key : others) {
+    // Differ in the last byte only, so that every byte is compared
+    key.back() = static_cast<char>(key.back() ^ 1);
+  }
+  auto compare = state.range(0) == 0 ? datastore::compare::lexicographic
+                                     : datastore::compare::fixed<32>;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(compare(keys[i], others[i]));
+    i = (i + 1) % keys.size();
+  }
+}
+BENCHMARK(compare_bytes)->Arg(0)->Arg(1);
+
+/** Measures point lookups, dominated by comparisons during tree descent */
+void find_map(benchmark::State& state) {
+  auto keys = hashes(static_cast<std::size_t>(state.range(1)));
+  auto datastore = datastore::clients::make_map(comparator(state.range(0)));
+  for (auto& key : keys) {
+    datastore->insert(std::pair(key, "value"));
+  }
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(datastore->find(keys[i++ % keys.size()]));
+  }
+}
+BENCHMARK(find_map)->ArgsProduct({{0, 1}, {1 << 10, 1 << 16}});
+
+void find_lmdb(benchmark::State& state) {
+  auto path = std::filesystem::temp_directory_path() / "datastore_bench";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  auto keys = hashes(static_cast<std::size_t>(state.range(1)));
+  {
+    auto datastore = datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path, 0, 0644,
+                                               comparator(state.range(0))));
+    for (auto& key : keys) {
+      datastore->insert(std::pair(key, "value"));
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(datastore->find(keys[i++ % keys.size()]));
+    }
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(find_lmdb)->ArgsProduct({{0, 1}, {1 << 10, 1 << 14}});
+
+}  // namespace
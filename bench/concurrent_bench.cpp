@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/concurrent_map.h>
+#include <datastore/clients/map.h>
+#include <mutex>
+#include <random>
+
+namespace {
+
+constexpr auto keys = 1 << 16;
+
+/** Serialises a client with a global mutex, as sharing a map requires */
+class locked {
+ public:
+  explicit locked(std::unique_ptr<datastore::client> client)
+      : client_(std::move(client)) {}
+
+  bool find(const std::string& key) {
+    std::lock_guard lock(mutex_);
+    return client_->find(key) != client_->end();
+  }
+
+  void insert(const std::string& key) {
+    std::lock_guard lock(mutex_);
+    client_->erase(key);
+    client_->insert(std::pair(std::string_view(key), "value"));
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unique_ptr<datastore::client> client_;
+};
+
+/** Shares the concurrent client between threads without a lock */
+class shared {
+ public:
+  explicit shared(std::unique_ptr<datastore::client> client)
+      : client_(std::move(client)) {}
+
+  bool find(const std::string& key) {
+    return client_->find(key) != client_->end();
+  }
+
+  void insert(const std::string& key) {
+    client_->erase(key);
+    client_->insert(std::pair(std::string_view(key), "value"));
+  }
+
+ private:
+  std::unique_ptr<datastore::client> client_;
+};
+
+template <typename Wrapper>
+Wrapper& instance(std::unique_ptr<datastore::client> (*make)()) {
+  static auto result = [make] {
+    auto client = make();
+    for (auto i = 0; i < keys; ++i) {
+      auto key = std::to_string(i);
+      client->insert(std::pair(std::string_view(key), "value"));
+    }
+    return Wrapper(std::move(client));
+  }();
+  return result;
+}
+
+std::unique_ptr<datastore::client> make_map() {
+  return datastore::clients::make_map();
+}
+
+std::unique_ptr<datastore::client> make_concurrent_map() {
+  return datastore::clients::make_concurrent_map();
+}
+
+/** Measures a read-mostly mix with 5% writes, per thread */
+template <typename Wrapper>
+void read_mostly(benchmark::State& state,
+                 std::unique_ptr<datastore::client> (*make)()) {
+  auto& datastore = instance<Wrapper>(make);
+  auto random = std::mt19937(static_cast<unsigned>(state.thread_index()));
+  for (auto _ : state) {
+    auto key = std::to_string(random() % keys);
+    if (random() % 100 < 5) {
+      datastore.insert(key);
+    } else {
+      benchmark::DoNotOptimize(datastore.find(key));
+    }
+  }
+}
+
+void read_mostly_locked_map(benchmark::State& state) {
+  read_mostly<locked>(state, make_map);
+}
+BENCHMARK(read_mostly_locked_map)->ThreadRange(1, 8)->UseRealTime();
+
+void read_mostly_concurrent_map(benchmark::State& state) {
+  read_mostly<shared>(state, make_concurrent_map);
+}
+BENCHMARK(read_mostly_concurrent_map)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,31 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/lmdb.h>
+#include <filesystem>
+
+namespace {
+
+/** Measures lookups of absent keys, with and without a membership filter */
+void find_missing(benchmark::State& state) {
+  auto path = std::filesystem::temp_directory_path() / "datastore_bench";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  {
+    auto configuration = datastore::clients::lmdb_configuration(path);
+    configuration.set_filter_bits_per_key(
+        static_cast<unsigned int>(state.range(0)));
+    auto datastore = datastore::clients::make_lmdb(configuration);
+    for (auto i = 0; i < 1 << 14; ++i) {
+      auto key = std::to_string(i);
+      datastore->insert(std::pair(std::string_view(key), "value"));
+    }
+    auto i = 0;
+    for (auto _ : state) {
+      auto key = "missing" + std::to_string(i++);
+      benchmark::DoNotOptimize(datastore->find(key));
+    }
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(find_missing)->Arg(0)->Arg(10);
+
+}  // namespace
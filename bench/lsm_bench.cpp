@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/lsm.h>
+#include <filesystem>
+#include <random>
+
+namespace {
+
+constexpr auto keys = 1 << 14;
+
+std::filesystem::path directory() {
+  auto path = std::filesystem::temp_directory_path() / "datastore_bench";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+std::unique_ptr<datastore::client> make(int backend,
+                                        const std::filesystem::path& path) {
+  if (backend == 0) {
+    return datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path));
+  }
+  return datastore::clients::make_lsm(
+      datastore::clients::lsm_configuration(path));
+}
+
+/** Measures random writes, by backend: 0 for lmdb and 1 for lsm
+ *
+ * The second argument is the percentage of lookups mixed in. */
+void random_writes(benchmark::State& state) {
+  auto path = directory();
+  {
+    auto datastore = make(static_cast<int>(state.range(0)), path);
+    auto random = std::mt19937(42);
+    for (auto _ : state) {
+      auto key = std::to_string(random() % keys);
+      if (static_cast<long>(random() % 100) < state.range(1)) {
+        benchmark::DoNotOptimize(datastore->find(key));
+      } else {
+        datastore->erase(key);
+        datastore->insert(std::pair(std::string_view(key), "value"));
+      }
+    }
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(random_writes)
+    ->ArgNames({"backend", "reads"})
+    ->ArgsProduct({{0, 1}, {0, 50}});
+
+}  // namespace
@@ -0,0 +1,111 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/detail/lmdb.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <filesystem>
+
+namespace {
+
+constexpr int count = 1 << 14;
+
+template <typename Client>
+void fill(Client& client) {
+  for (auto i = 0; i < count; ++i) {
+    auto key = std::to_string(1000000 + i);
+    client.insert(std::pair(std::string_view(key), std::string_view(key)));
+  }
+}
+
+/** Reports the time per element of a full scan */
+template <typename Client>
+void scan(benchmark::State& state, const Client& client) {
+  for (auto _ : state) {
+    std::size_t bytes = 0;
+    for (auto it = client.begin(); it != client.end(); ++it) {
+      bytes += it->second.size();
+    }
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+/** Reports the time per element of a full scan in blocks */
+template <typename Client>
+void scan_chunks(benchmark::State& state, const Client& client) {
+  for (auto _ : state) {
+    std::size_t bytes = 0;
+    client.for_each_chunk([&](const auto& chunk) {
+      for (const auto& value : chunk) {
+        bytes += value.second.size();
+      }
+    });
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+std::filesystem::path directory() {
+  auto path = std::filesystem::temp_directory_path() / "datastore_bench";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+void scan_map_virtual(benchmark::State& state) {
+  auto client = datastore::clients::make_map();
+  fill(*client);
+  scan(state, *client);
+}
+BENCHMARK(scan_map_virtual);
+
+void scan_map_chunks(benchmark::State& state) {
+  auto client = datastore::clients::make_map();
+  fill(*client);
+  scan_chunks(state, *client);
+}
+BENCHMARK(scan_map_chunks);
+
+void scan_map_static(benchmark::State& state) {
+  auto client = datastore::clients::map_client();
+  fill(client);
+  scan(state, client);
+}
+BENCHMARK(scan_map_static);
+
+void scan_lmdb_virtual(benchmark::State& state) {
+  auto path = directory();
+  {
+    auto client = datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path));
+    fill(*client);
+    scan(state, *client);
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(scan_lmdb_virtual);
+
+void scan_lmdb_chunks(benchmark::State& state) {
+  auto path = directory();
+  {
+    auto client = datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path));
+    fill(*client);
+    scan_chunks(state, *client);
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(scan_lmdb_chunks);
+
+void scan_lmdb_static(benchmark::State& state) {
+  auto path = directory();
+  {
+    auto client = datastore::clients::lmdb_client(
+        datastore::clients::lmdb_configuration(path));
+    fill(client);
+    scan(state, client);
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(scan_lmdb_static);
+
+}  // namespace
@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <datastore/clients/table.h>
+#include <filesystem>
+
+namespace {
+
+constexpr auto count = 1 << 14;
+
+std::filesystem::path directory() {
+  auto path = std::filesystem::temp_directory_path() / "datastore_bench";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+void fill(datastore::client& datastore) {
+  for (auto i = 0; i < count; ++i) {
+    auto key = "user" + std::to_string(i);
+    datastore.insert(std::pair(std::string_view(key), "value"));
+  }
+}
+
+void find(benchmark::State& state, datastore::client& datastore) {
+  auto i = 0;
+  for (auto _ : state) {
+    auto key = "user" + std::to_string(i++ % count);
+    benchmark::DoNotOptimize(datastore.find(key));
+  }
+}
+
+/** Measures random lookups in a table, by restart interval */
+void table_find(benchmark::State& state) {
+  auto path = directory();
+  auto configuration = datastore::clients::table_configuration(path / "table");
+  configuration.set_restart_interval(
+      static_cast<unsigned int>(state.range(0)));
+  {
+    auto source = datastore::clients::make_map();
+    fill(*source);
+    datastore::clients::write_table(*source, configuration);
+    auto datastore = datastore::clients::make_table(configuration);
+    find(state, *datastore);
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(table_find)->Arg(1)->Arg(16);
+
+/** Measures random lookups of the same data in lmdb, for comparison */
+void table_find_lmdb(benchmark::State& state) {
+  auto path = directory();
+  {
+    auto datastore =
+        datastore::clients::make_lmdb(datastore::clients::lmdb_configuration(path));
+    fill(*datastore);
+    find(state, *datastore);
+  }
+  std::filesystem::remove_all(path);
+}
+BENCHMARK(table_find_lmdb);
+
+}  // namespace
@@ -1,4 +1,7 @@
 @PACKAGE_INIT@
 
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+
 include("${CMAKE_CURRENT_LIST_DIR}/datastoreTargets.cmake")
-check_required_components("@PROJECT_NAME@")
\ No newline at end of file
+check_required_components("@PROJECT_NAME@")
@@ -0,0 +1,727 @@
+#pragma once
+#include <boost/iterator/iterator_facade.hpp>
+#include <datastore/client.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace datastore {
+
+namespace detail {
+
+/** Detects whether a backend applies batches itself */
+template <typename Backend, typename = void>
+struct has_write : std::false_type {};
+
+template <typename Backend>
+struct has_write<Backend, std::void_t<decltype(std::declval<Backend&>().write(
+                              std::declval<const batch&>()))>>
+    : std::true_type {};
+
+/** Detects whether the keys of a backend's cursors only last until they
+ * move, as with prefix compressed keys decoded into a buffer */
+template <typename Backend, typename = void>
+struct has_transient_keys : std::false_type {};
+
+template <typename Backend>
+struct has_transient_keys<
+    Backend, std::enable_if_t<Backend::cursor::transient_keys>>
+    : std::true_type {};
+
+/** Detects whether the values of a backend's cursors only last until they
+ * move, as with values decompressed into a buffer */
+template <typename Backend, typename = void>
+struct has_transient_values : std::false_type {};
+
+template <typename Backend>
+struct has_transient_values<
+    Backend, std::enable_if_t<Backend::cursor::transient_values>>
+    : std::true_type {};
+
+/** Detects whether a backend estimates the size of key ranges itself */
+template <typename Backend, typename = void>
+struct has_estimate : std::false_type {};
+
+template <typename Backend>
+struct has_estimate<
+    Backend, std::void_t<decltype(std::declval<const Backend&>().estimate(
+                 std::declval<client::key_type>(),
+                 std::declval<client::key_type>()))>> : std::true_type {};
+
+/** Detects whether a backend reads and writes a key in one transaction */
+template <typename Backend, typename = void>
+struct has_update : std::false_type {};
+
+template <typename Backend>
+struct has_update<Backend,
+                  std::void_t<decltype(std::declval<Backend&>().update(
+                      std::declval<client::key_type>(),
+                      std::declval<const client::update_function&>()))>>
+    : std::true_type {};
+
+/** Detects whether a backend resolves the merges of a batch in the
+ * transaction which writes it */
+template <typename Backend, typename = void>
+struct has_merge : std::false_type {};
+
+template <typename Backend>
+struct has_merge<Backend, std::enable_if_t<Backend::applies_merges>>
+    : std::true_type {};
+
+/** Detects whether a backend stores blobs itself */
+template <typename Backend, typename = void>
+struct has_blobs : std::false_type {};
+
+template <typename Backend>
+struct has_blobs<Backend,
+                 std::void_t<decltype(std::declval<const Backend&>()
+                                          .open_blob_reader(
+                                              std::declval<client::key_type>(),
+                                              std::uint64_t{0}))>>
+    : std::true_type {};
+
+}  // namespace detail
+
+/** Statically dispatched client driver for a known key value backend
+ *
+ * Offers the same interface as client, without virtual calls or heap
+ * allocated cursors, so that code which knows its backend at compile time
+ * can have every operation inlined. The polymorphic client is an adapter
+ * over a basic_client.
+ *
+ * A Backend provides
+ *   - a copyable cursor type with key(), value(), increment(), decrement()
+ *     and operator==
+ *   - first(), last(), lookup(key) and lower_bound(key) returning cursors,
+ *     where last() is the past-the-end position, which decrements to the
+ *     last element, and to which the first element decrements
+ *   - insert_or_assign(cursor, value) and erase(cursor) returning cursors
+ *   - size(), capacity() and clear()
+ *   - optionally write(batch), to apply a batch in one transaction
+ *   - optionally a static constexpr bool applies_merges, if write resolves
+ *     the merges of a batch itself
+ *   - optionally update(key, function), to read and write a key in one
+ *     transaction
+ *   - optionally estimate(from, to), to size a range of keys without
+ *     walking it
+ *   - optionally open_blob_writer(key, append, chunk_size) and
+ *     open_blob_reader(key, offset), to stream blobs within transactions
+ *   - optionally a static constexpr bool cursor::transient_keys, if keys do
+ *     not outlive the position of the cursor they were read from
+ *   - optionally a static constexpr bool cursor::transient_values, likewise
+ *
+ * @tparam Backend the key value store implementation
+ */
+template <typename Backend>
+class basic_client {
+ public:
+  class iterator;
+  using backend_type = Backend;
+  using cursor = typename Backend::cursor;
+  using const_iterator = const iterator;
+  using reverse_iterator = datastore::reverse_iterator<iterator>;
+  using chunk = client::chunk;
+  using difference_type = client::difference_type;
+  using key_type = client::key_type;
+  using mapped_type = client::mapped_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+  using element_type = client::element_type;
+
+  /** Creates a client, forwarding the arguments to the backend */
+  template <typename... Args>
+  explicit basic_client(Args&&... args);
+
+  // Element access
+
+  /** Access specified element with bounds checking
+   *
+   * Returns a copy of the element with key equivalent to key, as views
+   * into a cursor would not outlive the call. If no such element exists,
+   * an exception of type std::out_of_range is thrown. */
+  element_type at(key_type key) const;
+
+  // Iterators
+
+  /** Returns an iterator to the beginning */
+  [[nodiscard]] iterator begin() const;
+  /** Returns an iterator to the beginning */
+  [[nodiscard]] iterator cbegin() const;
+
+  /** Returns an iterator to the end */
+  [[nodiscard]] iterator end() const;
+  /** Returns an iterator to the end */
+  [[nodiscard]] iterator cend() const;
+
+  /** Returns a reverse iterator to the last element */
+  [[nodiscard]] reverse_iterator rbegin() const;
+  /** Returns a reverse iterator to the last element */
+  [[nodiscard]] reverse_iterator crbegin() const;
+
+  /** Returns a reverse iterator to the reverse end */
+  [[nodiscard]] reverse_iterator rend() const;
+  /** Returns a reverse iterator to the reverse end */
+  [[nodiscard]] reverse_iterator crend() const;
+
+  // Capacity
+
+  /** Checks whether the db is empty */
+  [[nodiscard]] bool empty() const;
+
+  /** Returns the number of elements in the db */
+  [[nodiscard]] size_type size() const;
+
+  /** Returns the maximum possible number of elements in the db */
+  [[nodiscard]] size_type max_size() const;
+
+  // Modifiers
+
+  /** Removes all elements from the db */
+  void clear();
+
+  /** Inserts an element at the given position */
+  iterator insert(iterator pos, const value_type& value);
+
+  /** Inserts a value */
+  std::pair<iterator, bool> insert(const value_type& value);
+
+  /** Writes value at pos, the position of its key or of the element after */
+  iterator insert_or_assign(iterator pos, const value_type& value);
+
+  /** Erases the value matching the given key */
+  size_type erase(key_type key);
+
+  /** Erases the element at pos */
+  iterator erase(iterator pos);
+
+  /** Applies a batch of writes, in a single transaction where supported */
+  void write(const batch& operations);
+
+  /** Replaces the value at key with the result of function, as
+   * client::update */
+  std::optional<std::string> update(key_type key,
+                                    const client::update_function& function);
+
+  /** Replaces the value at key with desired if it is expected, as
+   * client::compare_and_swap */
+  bool compare_and_swap(key_type key, std::optional<mapped_type> expected,
+                        std::optional<mapped_type> desired);
+
+  // Lookup
+
+  /** Finds an element matching the given key */
+  [[nodiscard]] iterator find(key_type key) const;
+
+  /** Returns an iterator to the first element not ordered before key */
+  [[nodiscard]] iterator lower_bound(key_type key) const;
+
+  /** Returns the range of elements whose keys start with prefix
+   *
+   * Requires the default lexicographic order, under which such keys are
+   * contiguous. */
+  [[nodiscard]] std::pair<iterator, iterator> prefix(key_type prefix) const;
+
+  /** Returns the elements whose keys start with prefix, last first */
+  [[nodiscard]] std::pair<reverse_iterator, reverse_iterator> reverse_prefix(
+      key_type prefix) const;
+
+  // Estimation
+
+  /** Returns the approximate number and size of the elements whose keys are
+   * in [from, to), as client::estimate */
+  [[nodiscard]] range_estimate estimate(key_type from,
+                                        key_type to = key_type()) const;
+
+  // Blobs
+
+  /** Opens a writer which streams a large value into key, as
+   * client::open_blob_writer */
+  [[nodiscard]] std::unique_ptr<blob_writer> open_blob_writer(
+      key_type key, bool append = false,
+      size_type chunk_size = default_blob_chunk);
+
+  /** Opens a reader of the blob at key, as client::open_blob_reader */
+  [[nodiscard]] std::unique_ptr<blob_reader> open_blob_reader(
+      key_type key, std::uint64_t offset = 0) const;
+
+  /** Erases the blob at key and its chunks, as client::erase_blob */
+  size_type erase_blob(key_type key);
+
+  // Block reads
+
+  /** Reads up to max_items elements from position into values, as
+   * client::next_batch */
+  size_type next_batch(iterator& position, chunk& values,
+                       size_type max_items) const;
+
+  /** Reads up to max_items elements from a backend cursor into values */
+  size_type next_batch(cursor& position, chunk& values,
+                       size_type max_items) const;
+
+  /** Calls function with consecutive blocks of up to max_items elements */
+  template <typename Function>
+  void for_each_chunk(Function&& function, size_type max_items = 1024) const;
+
+  /** Returns the backend */
+  Backend& backend() noexcept;
+
+  /** Returns the backend */
+  const Backend& backend() const noexcept;
+
+ private:
+  /** Applies a batch without merges */
+  void apply(const batch& operations);
+
+  /** Locks update_mutex_ for a write, unless the backend updates in write
+   * transactions of its own and merges need not be read here */
+  std::unique_lock<std::mutex> lock_writes(bool merges = false);
+
+  Backend backend_;
+  std::mutex update_mutex_; /** Serialises writes with the updates and
+                               merges the backend does not apply itself */
+};
+
+/** Iterates through the values of a basic_client with direct cursor calls */
+template <typename Backend>
+class basic_client<Backend>::iterator
+    : public boost::iterator_facade<iterator, const value_type,
+                                    boost::bidirectional_traversal_tag,
+                                    value_type> {
+ public:
+  /** Create a sentinel iterator */
+  iterator() = default;
+
+  /** Construct from a cursor */
+  explicit iterator(cursor position);
+
+  /** Returns the underlying cursor */
+  [[nodiscard]] const cursor& position() const noexcept;
+
+ private:
+  friend class boost::iterator_core_access;
+  friend class basic_client;
+
+  void increment();
+  void decrement();
+  [[nodiscard]] value_type dereference() const;
+  [[nodiscard]] bool equal(const iterator& rhs) const;
+
+  cursor cursor_;
+};
+
+template <typename Backend>
+template <typename... Args>
+basic_client<Backend>::basic_client(Args&&... args)
+    : backend_(std::forward<Args>(args)...) {}
+
+template <typename Backend>
+typename basic_client<Backend>::element_type basic_client<Backend>::at(
+    key_type key) const {
+  auto it = find(key);
+  if (it == end()) {
+    throw std::out_of_range{"key not found"};
+  }
+  auto [key_view, value] = *it;
+  return element_type(key_view, value);
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::begin() const {
+  return iterator(backend_.first());
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::cbegin()
+    const {
+  return begin();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::end() const {
+  return iterator(backend_.last());
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::cend() const {
+  return end();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::reverse_iterator
+basic_client<Backend>::rbegin() const {
+  auto last = backend_.last();
+  last.decrement();
+  return reverse_iterator(iterator(std::move(last)));
+}
+
+template <typename Backend>
+typename basic_client<Backend>::reverse_iterator
+basic_client<Backend>::crbegin() const {
+  return rbegin();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::reverse_iterator basic_client<Backend>::rend()
+    const {
+  return reverse_iterator(end());
+}
+
+template <typename Backend>
+typename basic_client<Backend>::reverse_iterator
+basic_client<Backend>::crend() const {
+  return rend();
+}
+
+template <typename Backend>
+bool basic_client<Backend>::empty() const {
+  return backend_.first() == backend_.last();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::size_type basic_client<Backend>::size() const {
+  return backend_.size();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::size_type basic_client<Backend>::max_size()
+    const {
+  return backend_.capacity();
+}
+
+template <typename Backend>
+void basic_client<Backend>::clear() {
+  auto lock = lock_writes();
+  backend_.clear();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::insert(
+    iterator pos, const value_type& value) {
+  auto lock = lock_writes();
+  auto it = find(value.first);
+  if (it == end()) {
+    it = iterator(backend_.insert_or_assign(std::move(pos.cursor_), value));
+  }
+  return it;
+}
+
+template <typename Backend>
+std::pair<typename basic_client<Backend>::iterator, bool>
+basic_client<Backend>::insert(const value_type& value) {
+  auto lock = lock_writes();
+  auto it = find(value.first);
+  if (it != end()) {
+    return std::pair(std::move(it), false);
+  }
+  return std::pair(
+      iterator(backend_.insert_or_assign(std::move(it.cursor_), value)), true);
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator
+basic_client<Backend>::insert_or_assign(iterator pos,
+                                        const value_type& value) {
+  auto lock = lock_writes();
+  return iterator(backend_.insert_or_assign(std::move(pos.cursor_), value));
+}
+
+template <typename Backend>
+typename basic_client<Backend>::size_type basic_client<Backend>::erase(
+    key_type key) {
+  auto lock = lock_writes();
+  auto pos = backend_.lookup(key);
+  if (pos == backend_.last()) {
+    return 0;
+  }
+  backend_.erase(std::move(pos));
+  return 1;
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::erase(
+    iterator pos) {
+  auto lock = lock_writes();
+  return iterator(backend_.erase(std::move(pos.cursor_)));
+}
+
+template <typename Backend>
+void basic_client<Backend>::write(const batch& operations) {
+  if constexpr (!detail::has_merge<Backend>::value) {
+    if (operations.merges()) {
+      auto lock = lock_writes(true);
+      apply(operations.resolve_merges([this](std::string_view key) {
+        auto pos = backend_.lookup(key);
+        return pos == backend_.last()
+                   ? std::nullopt
+                   : std::optional(std::string(pos.value()));
+      }));
+      return;
+    }
+  }
+  auto lock = lock_writes();
+  apply(operations);
+}
+
+template <typename Backend>
+std::optional<std::string> basic_client<Backend>::update(
+    key_type key, const client::update_function& function) {
+  if constexpr (detail::has_update<Backend>::value) {
+    return backend_.update(key, function);
+  } else {
+    std::lock_guard lock(update_mutex_);
+    auto pos = backend_.lookup(key);
+    auto current = std::optional<std::string>();
+    if (!(pos == backend_.last())) {
+      current.emplace(pos.value());
+    }
+    auto result = function(current);
+    if (result != current) {
+      apply(result ? batch().put(key, *result) : batch().erase(key));
+    }
+    return result;
+  }
+}
+
+template <typename Backend>
+bool basic_client<Backend>::compare_and_swap(
+    key_type key, std::optional<mapped_type> expected,
+    std::optional<mapped_type> desired) {
+  auto swapped = false;
+  update(key, [&](std::optional<mapped_type> current)
+                  -> std::optional<std::string> {
+    swapped = current == expected;
+    auto& result = swapped ? desired : current;
+    return result ? std::optional(std::string(*result)) : std::nullopt;
+  });
+  return swapped;
+}
+
+template <typename Backend>
+std::unique_lock<std::mutex> basic_client<Backend>::lock_writes(bool merges) {
+  if constexpr (detail::has_update<Backend>::value) {
+    if (!merges) {
+      return {};
+    }
+  }
+  return std::unique_lock(update_mutex_);
+}
+
+template <typename Backend>
+void basic_client<Backend>::apply(const batch& operations) {
+  if constexpr (detail::has_write<Backend>::value) {
+    backend_.write(operations);
+  } else {
+    for (const auto& operation : operations) {
+      auto pos = backend_.lookup(operation.key);
+      if (operation.type == batch::kind::put) {
+        backend_.insert_or_assign(std::move(pos),
+                                  value_type(operation.key, operation.value));
+      } else if (pos != backend_.last()) {
+        backend_.erase(std::move(pos));
+      }
+    }
+  }
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::find(
+    key_type key) const {
+  return iterator(backend_.lookup(key));
+}
+
+template <typename Backend>
+typename basic_client<Backend>::iterator basic_client<Backend>::lower_bound(
+    key_type key) const {
+  return iterator(backend_.lower_bound(key));
+}
+
+template <typename Backend>
+std::pair<typename basic_client<Backend>::iterator,
+          typename basic_client<Backend>::iterator>
+basic_client<Backend>::prefix(key_type prefix) const {
+  auto bound = detail::prefix_end(prefix);
+  return std::pair(lower_bound(prefix), bound ? lower_bound(*bound) : end());
+}
+
+template <typename Backend>
+std::pair<typename basic_client<Backend>::reverse_iterator,
+          typename basic_client<Backend>::reverse_iterator>
+basic_client<Backend>::reverse_prefix(key_type prefix) const {
+  auto bound = detail::prefix_end(prefix);
+  auto last = bound ? lower_bound(*bound) : end();
+  auto first = lower_bound(prefix);
+  if (first == last) {
+    return std::pair(reverse_iterator(last), reverse_iterator(last));
+  }
+  return std::pair(reverse_iterator(--last), reverse_iterator(--first));
+}
+
+template <typename Backend>
+range_estimate basic_client<Backend>::estimate(key_type from,
+                                               key_type to) const {
+  if constexpr (detail::has_estimate<Backend>::value) {
+    return backend_.estimate(from, to);
+  } else {
+    auto result = range_estimate();
+    auto last = backend_.last();
+    auto bound = to.empty() ? last : backend_.lower_bound(to);
+    for (auto position =
+             from.empty() ? backend_.first() : backend_.lower_bound(from);
+         !(position == bound) && !(position == last); position.increment()) {
+      ++result.count;
+      result.bytes += position.key().size() + position.value().size();
+    }
+    return result;
+  }
+}
+
+template <typename Backend>
+std::unique_ptr<blob_writer> basic_client<Backend>::open_blob_writer(
+    key_type key, bool append, size_type chunk_size) {
+  if constexpr (detail::has_blobs<Backend>::value) {
+    return backend_.open_blob_writer(key, append, chunk_size);
+  } else {
+    auto store = detail::blob_store();
+    store.read = [this](std::string_view key) -> std::optional<std::string> {
+      auto pos = backend_.lookup(key);
+      if (pos == backend_.last()) {
+        return std::nullopt;
+      }
+      return std::string(pos.value());
+    };
+    store.write = [this](const batch& writes) { write(writes); };
+    return std::make_unique<blob_writer>(std::move(store), key, append,
+                                         chunk_size);
+  }
+}
+
+template <typename Backend>
+std::unique_ptr<blob_reader> basic_client<Backend>::open_blob_reader(
+    key_type key, std::uint64_t offset) const {
+  if constexpr (detail::has_blobs<Backend>::value) {
+    return backend_.open_blob_reader(key, offset);
+  } else {
+    auto pos = backend_.lookup(key);
+    if (pos == backend_.last()) {
+      throw std::out_of_range("key not found");
+    }
+    auto read = [this](std::string_view key, std::size_t offset, char* data,
+                       std::size_t size) -> std::size_t {
+      auto chunk = backend_.lookup(key);
+      if (chunk == backend_.last() || offset >= chunk.value().size()) {
+        return 0;
+      }
+      auto value = chunk.value();
+      auto count = std::min(size, value.size() - offset);
+      std::memcpy(data, value.data() + offset, count);
+      return count;
+    };
+    return std::make_unique<blob_reader>(key, pos.value(), offset,
+                                         std::move(read));
+  }
+}
+
+template <typename Backend>
+typename basic_client<Backend>::size_type basic_client<Backend>::erase_blob(
+    key_type key) {
+  auto erasures = batch();
+  {
+    auto pos = backend_.lookup(key);
+    if (pos == backend_.last()) {
+      return 0;
+    }
+    auto manifest = detail::blob_manifest::decode(pos.value());
+    if (!manifest) {
+      return 0;
+    }
+    erasures.erase(key);
+    detail::erase_blob_chunks(erasures, key, *manifest);
+  }
+  write(erasures);
+  return 1;
+}
+
+template <typename Backend>
+typename basic_client<Backend>::size_type basic_client<Backend>::next_batch(
+    iterator& position, chunk& values, size_type max_items) const {
+  return next_batch(position.cursor_, values, max_items);
+}
+
+template <typename Backend>
+typename basic_client<Backend>::size_type basic_client<Backend>::next_batch(
+    cursor& position, chunk& values, size_type max_items) const {
+  values.clear();
+  auto end = backend_.last();
+  for (; values.size() < max_items && !(position == end);
+       position.increment()) {
+    if constexpr (detail::has_transient_values<Backend>::value) {
+      values.push_back_copy(value_type(position.key(), position.value()),
+                            true);
+    } else if constexpr (detail::has_transient_keys<Backend>::value) {
+      values.push_back_copy(value_type(position.key(), position.value()));
+    } else {
+      values.push_back(value_type(position.key(), position.value()));
+    }
+  }
+  return values.size();
+}
+
+template <typename Backend>
+template <typename Function>
+void basic_client<Backend>::for_each_chunk(Function&& function,
+                                           size_type max_items) const {
+  auto position = backend_.first();
+  chunk values;
+  while (next_batch(position, values, max_items) != 0) {
+    function(static_cast<const chunk&>(values));
+  }
+}
+
+template <typename Backend>
+Backend& basic_client<Backend>::backend() noexcept {
+  return backend_;
+}
+
+template <typename Backend>
+const Backend& basic_client<Backend>::backend() const noexcept {
+  return backend_;
+}
+
+template <typename Backend>
+basic_client<Backend>::iterator::iterator(cursor position)
+    : cursor_(std::move(position)) {}
+
+template <typename Backend>
+const typename basic_client<Backend>::cursor&
+basic_client<Backend>::iterator::position() const noexcept {
+  return cursor_;
+}
+
+template <typename Backend>
+void basic_client<Backend>::iterator::increment() {
+  cursor_.increment();
+}
+
+template <typename Backend>
+void basic_client<Backend>::iterator::decrement() {
+  cursor_.decrement();
+}
+
+template <typename Backend>
+typename basic_client<Backend>::value_type
+basic_client<Backend>::iterator::dereference() const {
+  return value_type(cursor_.key(), cursor_.value());
+}
+
+template <typename Backend>
+bool basic_client<Backend>::iterator::equal(const iterator& rhs) const {
+  return cursor_ == rhs.cursor_;
+}
+
+}  // namespace datastore
@@ -0,0 +1,76 @@
+#include "batch.h"
+#include <unordered_map>
+
+namespace datastore {
+
+batch& batch::put(std::string_view key, std::string_view value) {
+  operations_.push_back({kind::put, std::string(key), std::string(value)});
+  return *this;
+}
+
+batch& batch::erase(std::string_view key) {
+  operations_.push_back({kind::erase, std::string(key), {}});
+  return *this;
+}
+
+batch& batch::merge(std::string_view key, std::string_view operand,
+                    const merge_operator& merge) {
+  operations_.push_back(
+      {kind::merge, std::string(key), std::string(operand), &merge});
+  return *this;
+}
+
+bool batch::merges() const {
+  for (const auto& operation : operations_) {
+    if (operation.type == kind::merge) {
+      return true;
+    }
+  }
+  return false;
+}
+
+batch batch::resolve_merges(const reader& read) const {
+  // Values of the keys merged into, as of the writes so far
+  std::unordered_map<std::string_view, std::optional<std::string>> values;
+  std::unordered_map<std::string_view, size_type> last_merge;
+  for (size_type i = 0; i < operations_.size(); ++i) {
+    if (operations_[i].type == kind::merge) {
+      last_merge[operations_[i].key] = i;
+    }
+  }
+  batch result;
+  for (size_type i = 0; i < operations_.size(); ++i) {
+    const auto& operation = operations_[i];
+    auto merged = last_merge.find(operation.key);
+    if (operation.type != kind::merge) {
+      if (merged != last_merge.end() && merged->second > i) {
+        values[operation.key] = operation.type == kind::put
+                                    ? std::optional(operation.value)
+                                    : std::nullopt;
+      }
+      result.operations_.push_back(operation);
+      continue;
+    }
+    auto value = values.find(operation.key);
+    if (value == values.end()) {
+      value = values.emplace(operation.key, read(operation.key)).first;
+    }
+    value->second = operation.merge->apply(value->second, operation.value);
+    if (merged->second == i) {
+      result.put(operation.key, *value->second);
+    }
+  }
+  return result;
+}
+
+batch::const_iterator batch::begin() const { return operations_.begin(); }
+
+batch::const_iterator batch::end() const { return operations_.end(); }
+
+batch::size_type batch::size() const { return operations_.size(); }
+
+bool batch::empty() const { return operations_.empty(); }
+
+void batch::clear() { operations_.clear(); }
+
+}  // namespace datastore
@@ -0,0 +1,63 @@
+#pragma once
+#include <datastore/merge.h>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace datastore {
+
+/** A sequence of writes to be applied together
+ *
+ * Backends which support it, such as LMDB, apply a batch within a single
+ * transaction, so that it is atomic and pays for one commit. Others apply
+ * the writes one at a time, in order. */
+class batch {
+ public:
+  enum class kind { put, erase, merge };
+
+  /** A single write, which owns its key and value */
+  struct operation {
+    kind type;
+    std::string key;
+    std::string value; /** Empty for an erasure, the operand of a merge */
+    const merge_operator* merge = nullptr;
+  };
+
+  /** Returns the value of a key before the batch, or nullopt if absent */
+  using reader = std::function<std::optional<std::string>(std::string_view)>;
+
+  using const_iterator = std::vector<operation>::const_iterator;
+  using size_type = std::vector<operation>::size_type;
+
+  /** Inserts value at key, replacing any existing value */
+  batch& put(std::string_view key, std::string_view value);
+
+  /** Erases key, if present */
+  batch& erase(std::string_view key);
+
+  /** Replaces the value at key with the result of merging operand into it */
+  batch& merge(std::string_view key, std::string_view operand,
+               const merge_operator& merge);
+
+  /** Returns whether any write is a merge */
+  [[nodiscard]] bool merges() const;
+
+  /** Returns the batch with the merges replaced by puts of their results
+   *
+   * Each key merged into is read once, and written once after its last
+   * merge, which leaves it as the batch would. */
+  [[nodiscard]] batch resolve_merges(const reader& read) const;
+
+  [[nodiscard]] const_iterator begin() const;
+  [[nodiscard]] const_iterator end() const;
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] bool empty() const;
+  void clear();
+
+ private:
+  std::vector<operation> operations_;
+};
+
+}  // namespace datastore
@@ -0,0 +1 @@
+#include <datastore/bijective/binary.h>
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace datastore::bijective {
+
+/** Encodes trivially copyable values as their object representation
+ *
+ * The encoded view refers to the input, which must outlive it. Encoding is
+ * native byte order, so integer keys do not sort numerically unless the
+ * datastore uses a matching comparator such as compare::tuple.
+ */
+template <typename T>
+class binary {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "binary codecs require trivially copyable types");
+
+ public:
+  /** Encodes the input */
+  std::string_view f(const T& x) const noexcept;
+
+  /** Decodes the input */
+  T g(std::string_view y) const noexcept;
+};
+
+template <typename T>
+std::string_view binary<T>::f(const T& x) const noexcept {
+  return std::string_view(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <typename T>
+T binary<T>::g(std::string_view y) const noexcept {
+  T result{};
+  std::memcpy(&result, y.data(), std::min(y.size(), sizeof(T)));
+  return result;
+}
+
+}  // namespace datastore::bijective
@@ -0,0 +1 @@
+#include <datastore/bijective/codec.h>
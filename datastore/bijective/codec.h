@@ -0,0 +1,30 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+
+namespace datastore::bijective {
+
+/** Checks whether Codec is a bijective function from X to Y
+ *
+ * A codec provides f, mapping an X to a Y, and its inverse g, mapping a Y
+ * back to an X. Codecs which are not type-erased are called directly, so that
+ * they can be inlined into the container operations which use them.
+ */
+template <typename Codec, typename X, typename Y, typename = void>
+struct is_codec : std::false_type {};
+
+template <typename Codec, typename X, typename Y>
+struct is_codec<
+    Codec, X, Y,
+    std::enable_if_t<
+        std::is_convertible_v<decltype(std::declval<const Codec&>().f(
+                                  std::declval<const X&>())),
+                              Y> &&
+        std::is_convertible_v<decltype(std::declval<const Codec&>().g(
+                                  std::declval<const Y&>())),
+                              X>>> : std::true_type {};
+
+template <typename Codec, typename X, typename Y>
+inline constexpr bool is_codec_v = is_codec<Codec, X, Y>::value;
+
+}  // namespace datastore::bijective
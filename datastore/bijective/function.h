@@ -1,9 +1,15 @@
 #pragma once
+#include <datastore/bijective/codec.h>
 #include <functional>
 
 namespace datastore::bijective {
 
-/** A bijective function f and its inverse g */
+/** A bijective function f and its inverse g
+ *
+ * The functions are type-erased, so that codecs may be chosen at runtime.
+ * Use basic_function, or any other codec type, where the codec is known at
+ * compile time.
+ */
 template <typename X, typename Y>
 class function {
  public:
@@ -16,20 +22,53 @@ class function {
   /** Returns the g function */
   constexpr const g_type& g() const;
 
-  /** Encodes the input */
+  /** Decodes the input */
   constexpr X g(const Y& y) const;
 
-  /** Decodes the input */
+  /** Encodes the input */
   constexpr Y f(const X& x) const;
 
   /** Creates a codec from an f and g */
   constexpr function(f_type f, g_type g) noexcept;
 
+  /** Erases the type of a statically dispatched codec */
+  template <typename Codec,
+            typename = std::enable_if_t<
+                is_codec_v<Codec, X, Y> &&
+                !std::is_base_of_v<function, std::decay_t<Codec>>>>
+  function(Codec codec);
+
  private:
   const f_type f_;
   const g_type g_;
 };
 
+/** A statically dispatched bijective function f and its inverse g
+ *
+ * @tparam F callable mapping an X to a Y
+ * @tparam G callable mapping a Y to an X
+ */
+template <typename X, typename Y, typename F, typename G>
+class basic_function {
+ public:
+  /** Creates a codec from an f and g */
+  constexpr basic_function(F f, G g) noexcept;
+
+  /** Decodes the input */
+  constexpr X g(const Y& y) const;
+
+  /** Encodes the input */
+  constexpr Y f(const X& x) const;
+
+ private:
+  F f_;
+  G g_;
+};
+
+/** Creates a statically dispatched codec from an f and g */
+template <typename X, typename Y, typename F, typename G>
+constexpr basic_function<X, Y, F, G> make_function(F f, G g) noexcept;
+
 template <typename X, typename Y>
 constexpr const typename function<X, Y>::f_type& function<X, Y>::f() const {
   return f_;
@@ -55,4 +94,29 @@ constexpr function<X, Y>::function(function::f_type f,
                                    function::g_type g) noexcept
     : f_(std::move(f)), g_(std::move(g)) {}
 
+template <typename X, typename Y>
+template <typename Codec, typename>
+function<X, Y>::function(Codec codec)
+    : f_([codec](const X& x) -> Y { return codec.f(x); }),
+      g_([codec](const Y& y) -> X { return codec.g(y); }) {}
+
+template <typename X, typename Y, typename F, typename G>
+constexpr basic_function<X, Y, F, G>::basic_function(F f, G g) noexcept
+    : f_(std::move(f)), g_(std::move(g)) {}
+
+template <typename X, typename Y, typename F, typename G>
+constexpr X basic_function<X, Y, F, G>::g(const Y& y) const {
+  return g_(y);
+}
+
+template <typename X, typename Y, typename F, typename G>
+constexpr Y basic_function<X, Y, F, G>::f(const X& x) const {
+  return f_(x);
+}
+
+template <typename X, typename Y, typename F, typename G>
+constexpr basic_function<X, Y, F, G> make_function(F f, G g) noexcept {
+  return basic_function<X, Y, F, G>(std::move(f), std::move(g));
+}
+
 }  // namespace datastore::bijective
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <datastore/bijective/codec.h>
+
+namespace datastore::bijective {
+
+/** Converts between two types which represent the same value, such as
+ * std::string and std::string_view
+ *
+ * Decoded values may refer to the memory of the encoded value.
+ */
+template <typename X, typename Y = X>
+class identity {
+ public:
+  /** Encodes the input */
+  constexpr Y f(const X& x) const;
+
+  /** Decodes the input */
+  constexpr X g(const Y& y) const;
+};
+
+template <typename X, typename Y>
+constexpr Y identity<X, Y>::f(const X& x) const {
+  return Y(x);
+}
+
+template <typename X, typename Y>
+constexpr X identity<X, Y>::g(const Y& y) const {
+  return X(y);
+}
+
+}  // namespace datastore::bijective
@@ -11,21 +11,47 @@ namespace datastore::bijective {
  * @tparam Key
  * @tparam T
  * @tparam AssociativeContainer
+ * @tparam KeyCodec codec between Key and the container key_type
+ * @tparam MappedCodec codec between T and the container mapped_type
  *
+ * Codecs other than the type-erased bijective::function are called directly,
+ * so that they can be inlined into every lookup, insertion and dereference.
  */
-template <typename Key, typename T, typename AssociativeContainer>
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec =
+              function<Key, typename AssociativeContainer::key_type>,
+          typename MappedCodec =
+              function<T, typename AssociativeContainer::mapped_type>>
 class map {
+  static_assert(
+      is_codec_v<KeyCodec, Key, typename AssociativeContainer::key_type>,
+      "KeyCodec must be a codec between Key and the container key_type");
+  static_assert(
+      is_codec_v<MappedCodec, T, typename AssociativeContainer::mapped_type>,
+      "MappedCodec must be a codec between T and the container mapped_type");
+
  public:
   using value_type = std::pair<const Key, T>;
 
-  using key_transform_type =
-      function<Key, typename AssociativeContainer::key_type>;
-  using mapped_transform_type =
-      function<T, typename AssociativeContainer::mapped_type>;
+  using key_transform_type = KeyCodec;
+  using mapped_transform_type = MappedCodec;
   using value_transform_type =
-      function<std::pair<Key, T>,
-               std::pair<typename AssociativeContainer::key_type,
-                         typename AssociativeContainer::mapped_type>>;
+      basic_pair<std::pair<Key, T>,
+                 std::pair<typename AssociativeContainer::key_type,
+                           typename AssociativeContainer::mapped_type>,
+                 KeyCodec, MappedCodec>;
+
+  /** Decodes the values of the underlying container */
+  class decoder {
+   public:
+    explicit decoder(const value_transform_type& value_transform);
+
+    value_type operator()(
+        const typename AssociativeContainer::value_type& value) const;
+
+   private:
+    value_transform_type value_transform_;
+  };
 
   using key_type = Key;
   using mapped_type = T;
@@ -36,16 +62,16 @@ class map {
   using pointer = value_type*;
   using const_pointer = const value_type*;
   using iterator =
-      boost::transform_iterator<typename value_transform_type::g_type,
+      boost::transform_iterator<decoder,
                                 typename AssociativeContainer::iterator,
                                 value_type, value_type>;
   using const_iterator = typename std::add_const<iterator>::type;
-  using reverse_iterator = std::reverse_iterator<iterator>;
-  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
-
-  map(AssociativeContainer& container, key_transform_type key_transform,
-      mapped_transform_type mapped_transform,
-      value_transform_type value_transform) noexcept;
+  using reverse_iterator =
+      boost::transform_iterator<decoder,
+                                typename AssociativeContainer::reverse_iterator,
+                                value_type, value_type>;
+  using const_reverse_iterator =
+      typename std::add_const<reverse_iterator>::type;
 
   map(AssociativeContainer& container, key_transform_type key_transform,
       mapped_transform_type mapped_transform) noexcept;
@@ -62,6 +88,16 @@ class map {
   /** Returns an iterator to the end */
   [[nodiscard]] const_iterator cend() const;
 
+  /** Returns a reverse iterator to the last element */
+  [[nodiscard]] reverse_iterator rbegin() const;
+  /** Returns a reverse iterator to the last element */
+  [[nodiscard]] const_reverse_iterator crbegin() const;
+
+  /** Returns a reverse iterator to the reverse end */
+  [[nodiscard]] reverse_iterator rend() const;
+  /** Returns a reverse iterator to the reverse end */
+  [[nodiscard]] const_reverse_iterator crend() const;
+
   // Capacity
 
   /** Checks whether the datastore is empty */
@@ -97,118 +133,164 @@ class map {
 
  private:
   AssociativeContainer* container_;
-  key_transform_type key_transform_;
-  mapped_transform_type mapped_transform_;
   value_transform_type value_transform_;
 };
 
-template <typename Key, typename T, typename AssociativeContainer>
-map<Key, T, AssociativeContainer>::map(
-    AssociativeContainer& container,
-    map<Key, T, AssociativeContainer>::key_transform_type key_transform,
-    map<Key, T, AssociativeContainer>::mapped_transform_type mapped_transform,
-    map<Key, T, AssociativeContainer>::value_transform_type
-        value_transform) noexcept
-    : container_(&container),
-      key_transform_(std::move(key_transform)),
-      mapped_transform_(std::move(mapped_transform)),
-      value_transform_(std::move(value_transform)) {}
-
-template <typename Key, typename T, typename AssociativeContainer>
-map<Key, T, AssociativeContainer>::map(
-    AssociativeContainer& container,
-    map<Key, T, AssociativeContainer>::key_transform_type key_transform,
-    map<Key, T, AssociativeContainer>::mapped_transform_type
-        mapped_transform) noexcept
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::decoder::decoder(
+    const value_transform_type& value_transform)
+    : value_transform_(value_transform) {}
+
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::value_type
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::decoder::operator()(
+    const typename AssociativeContainer::value_type& value) const {
+  return value_transform_.g(value);
+}
+
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::map(
+    AssociativeContainer& container, key_transform_type key_transform,
+    mapped_transform_type mapped_transform) noexcept
     : container_(&container),
-      key_transform_(key_transform),
-      mapped_transform_(mapped_transform),
-      value_transform_(
-          pair<std::pair<Key, T>,
-               std::pair<typename AssociativeContainer::key_type,
-                         typename AssociativeContainer::mapped_type>>{
-              key_transform, mapped_transform}) {}
+      value_transform_(std::move(key_transform), std::move(mapped_transform)) {
+}
+
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::begin() const {
+  return iterator(container_->begin(), decoder(value_transform_));
+}
+
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec,
+             MappedCodec>::const_iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::cbegin() const {
+  return iterator(container_->cbegin(), decoder(value_transform_));
+}
+
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::end() const {
+  return iterator(container_->end(), decoder(value_transform_));
+}
+
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec,
+             MappedCodec>::const_iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::cend() const {
+  return iterator(container_->cend(), decoder(value_transform_));
+}
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::iterator
-map<Key, T, AssociativeContainer>::begin() const {
-  return iterator(container_->begin(), value_transform_.g());
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec,
+             MappedCodec>::reverse_iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::rbegin() const {
+  return reverse_iterator(container_->rbegin(), decoder(value_transform_));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::const_iterator
-map<Key, T, AssociativeContainer>::cbegin() const {
-  return iterator(container_->cbegin(), value_transform_.g());
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec,
+             MappedCodec>::const_reverse_iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::crbegin() const {
+  return reverse_iterator(container_->crbegin(), decoder(value_transform_));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::iterator
-map<Key, T, AssociativeContainer>::end() const {
-  return iterator(container_->end(), value_transform_.g());
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec,
+             MappedCodec>::reverse_iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::rend() const {
+  return reverse_iterator(container_->rend(), decoder(value_transform_));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::const_iterator
-map<Key, T, AssociativeContainer>::cend() const {
-  return iterator(container_->cend(), value_transform_.g());
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec,
+             MappedCodec>::const_reverse_iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::crend() const {
+  return reverse_iterator(container_->crend(), decoder(value_transform_));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-bool map<Key, T, AssociativeContainer>::empty() const {
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+bool map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::empty() const {
   return container_->empty();
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::size_type
-map<Key, T, AssociativeContainer>::size() const {
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::size_type
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::size() const {
   return container_->size();
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::size_type
-map<Key, T, AssociativeContainer>::max_size() const {
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::size_type
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::max_size() const {
   return container_->max_size();
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-void map<Key, T, AssociativeContainer>::clear() {
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+void map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::clear() {
   container_->clear();
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::iterator
-map<Key, T, AssociativeContainer>::insert(map::iterator pos,
-                                          const map::value_type& value) {
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::insert(
+    map::iterator pos, const map::value_type& value) {
   return iterator(container_->insert(pos.base(), value_transform_.f(value)),
-                  value_transform_.g());
+                  decoder(value_transform_));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-std::pair<typename map<Key, T, AssociativeContainer>::iterator, bool>
-map<Key, T, AssociativeContainer>::insert(const value_type& value) {
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+std::pair<typename map<Key, T, AssociativeContainer, KeyCodec,
+                       MappedCodec>::iterator,
+          bool>
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::insert(
+    const value_type& value) {
   auto transformed_value = value_transform_.f(value);
   auto insert_result = container_->insert(transformed_value);
-  return std::pair(iterator(insert_result.first, value_transform_.g()),
+  return std::pair(iterator(insert_result.first, decoder(value_transform_)),
                    insert_result.second);
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::size_type
-map<Key, T, AssociativeContainer>::erase(const key_type& key) {
-  return container_->erase(key_transform_.f(key));
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::size_type
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::erase(
+    const key_type& key) {
+  return container_->erase(value_transform_.first().f(key));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::iterator
-map<Key, T, AssociativeContainer>::erase(iterator pos) {
-  return iterator(container_->erase(pos.base()), value_transform_.g());
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::erase(iterator pos) {
+  return iterator(container_->erase(pos.base()), decoder(value_transform_));
 }
 
-template <typename Key, typename T, typename AssociativeContainer>
-typename map<Key, T, AssociativeContainer>::iterator
-map<Key, T, AssociativeContainer>::find(const key_type& key) const {
-  return iterator(container_->find(key_transform_.f(key)),
-                  value_transform_.g());
+template <typename Key, typename T, typename AssociativeContainer,
+          typename KeyCodec, typename MappedCodec>
+typename map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::iterator
+map<Key, T, AssociativeContainer, KeyCodec, MappedCodec>::find(
+    const key_type& key) const {
+  return iterator(container_->find(value_transform_.first().f(key)),
+                  decoder(value_transform_));
 }
 
 }  // namespace datastore::bijective
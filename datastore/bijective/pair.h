@@ -16,6 +16,44 @@ class pair : public function<X, Y> {
        function<typename X::second_type, typename Y::second_type> second);
 };
 
+/** Applies a pair of statically dispatched codecs to a tuple
+ *
+ * @tparam X A pair of values in domain of X
+ * @tparam Y A pair of values in the domain of Y
+ * @tparam First codec between the first members of X and Y
+ * @tparam Second codec between the second members of X and Y
+ */
+template <typename X, typename Y, typename First, typename Second>
+class basic_pair {
+  static_assert(
+      is_codec_v<First, typename X::first_type, typename Y::first_type>,
+      "First must be a codec between the first members of X and Y");
+  static_assert(
+      is_codec_v<Second, typename X::second_type, typename Y::second_type>,
+      "Second must be a codec between the second members of X and Y");
+
+ public:
+  constexpr basic_pair(First first, Second second) noexcept;
+
+  /** Encodes the input */
+  template <typename U>
+  constexpr Y f(const U& x) const;
+
+  /** Decodes the input */
+  template <typename U>
+  constexpr X g(const U& y) const;
+
+  /** Returns the codec of the first members */
+  constexpr const First& first() const noexcept;
+
+  /** Returns the codec of the second members */
+  constexpr const Second& second() const noexcept;
+
+ private:
+  First first_;
+  Second second_;
+};
+
 template <typename X, typename Y>
 pair<X, Y>::pair(
     function<typename X::first_type, typename Y::first_type> first,
@@ -28,4 +66,32 @@ pair<X, Y>::pair(
             return X{first.g(y.first), second.g(y.second)};
           }) {}
 
+template <typename X, typename Y, typename First, typename Second>
+constexpr basic_pair<X, Y, First, Second>::basic_pair(First first,
+                                                      Second second) noexcept
+    : first_(std::move(first)), second_(std::move(second)) {}
+
+template <typename X, typename Y, typename First, typename Second>
+template <typename U>
+constexpr Y basic_pair<X, Y, First, Second>::f(const U& x) const {
+  return Y{first_.f(x.first), second_.f(x.second)};
+}
+
+template <typename X, typename Y, typename First, typename Second>
+template <typename U>
+constexpr X basic_pair<X, Y, First, Second>::g(const U& y) const {
+  return X{first_.g(y.first), second_.g(y.second)};
+}
+
+template <typename X, typename Y, typename First, typename Second>
+constexpr const First& basic_pair<X, Y, First, Second>::first() const noexcept {
+  return first_;
+}
+
+template <typename X, typename Y, typename First, typename Second>
+constexpr const Second& basic_pair<X, Y, First, Second>::second()
+    const noexcept {
+  return second_;
+}
+
 }  // namespace datastore::bijective
@@ -6,30 +6,38 @@
 
 namespace datastore::bijective {
 
+/** Encodes values with operator<< and decodes them with operator>>
+ *
+ * The codec is statically dispatched and converts to a
+ * bijective::function<T, std::string_view> where a runtime codec is needed.
+ */
 template <typename T>
-class stream : public bijective::function<T, std::string_view> {
+class stream {
  public:
-  using base_type = bijective::function<T, std::string_view>;
-  stream();
+  /** Encodes the input */
+  std::string_view f(const T& input) const;
+
+  /** Decodes the input */
+  T g(std::string_view input) const;
 };
 
 template <typename T>
-stream<T>::stream()
-    : base_type(
-          [](const T& input) {
-            static std::string buffer;
-            std::ostringstream os;
-            os << input;
-            buffer = os.str();
-            return std::string_view(buffer);
-          },
-          [](std::string_view input) {
-            static std::string buffer;
-            buffer = input;
-            T output;
-            std::istringstream is{buffer};
-            is >> output;
-            return output;
-          }) {}
+std::string_view stream<T>::f(const T& input) const {
+  static std::string buffer;
+  std::ostringstream os;
+  os << input;
+  buffer = os.str();
+  return std::string_view(buffer);
+}
+
+template <typename T>
+T stream<T>::g(std::string_view input) const {
+  static std::string buffer;
+  buffer = input;
+  T output;
+  std::istringstream is{buffer};
+  is >> output;
+  return output;
+}
 
 }  // namespace datastore::bijective
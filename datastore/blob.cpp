@@ -0,0 +1,227 @@
+#include "blob.h"
+#include <datastore/clients/detail/coding.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace datastore {
+
+namespace detail {
+
+namespace {
+
+/** Starts every manifest, so that other values are not mistaken for one */
+constexpr std::string_view manifest_magic =
+    "\xff"
+    "blob";
+
+/** Appends a big endian 64-bit integer, so that chunks order by index */
+void put_big_endian(std::string& destination, std::uint64_t value) {
+  for (auto shift = 56; shift >= 0; shift -= 8) {
+    destination.push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+}  // namespace
+
+std::uint64_t blob_manifest::chunks() const {
+  return (size + chunk_size - 1) / chunk_size;
+}
+
+std::string blob_manifest::encode() const {
+  auto result = std::string(manifest_magic);
+  clients::detail::put_fixed64(result, size);
+  clients::detail::put_fixed64(result, chunk_size);
+  clients::detail::put_fixed64(result, generation);
+  return result;
+}
+
+std::optional<blob_manifest> blob_manifest::decode(std::string_view value) {
+  if (value.size() != manifest_magic.size() + 24 ||
+      value.substr(0, manifest_magic.size()) != manifest_magic) {
+    return std::nullopt;
+  }
+  auto fields = value.data() + manifest_magic.size();
+  auto result = blob_manifest();
+  result.size = clients::detail::get_fixed64(fields);
+  result.chunk_size = clients::detail::get_fixed64(fields + 8);
+  result.generation = clients::detail::get_fixed64(fields + 16);
+  if (result.chunk_size == 0) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+std::string blob_chunk_key(std::string_view key, std::uint64_t generation,
+                           std::uint64_t index) {
+  auto result = std::string(blob_prefix);
+  clients::detail::put_length_prefixed(result, key);
+  put_big_endian(result, generation);
+  put_big_endian(result, index);
+  return result;
+}
+
+void erase_blob_chunks(batch& writes, std::string_view key,
+                       const blob_manifest& manifest) {
+  for (std::uint64_t i = 0; i < manifest.chunks(); ++i) {
+    writes.erase(blob_chunk_key(key, manifest.generation, i));
+  }
+}
+
+}  // namespace detail
+
+blob_writer::blob_writer(detail::blob_store store, std::string_view key,
+                         bool append, std::size_t chunk_size)
+    : store_(std::move(store)), key_(key) {
+  if (chunk_size == 0) {
+    throw std::invalid_argument("blob chunks may not be empty");
+  }
+  auto existing = store_.read(key_);
+  auto manifest = existing ? detail::blob_manifest::decode(*existing)
+                           : std::nullopt;
+  if (!append) {
+    manifest_.chunk_size = chunk_size;
+    if (manifest) {
+      manifest_.generation = manifest->generation + 1;
+      replaced_ = manifest;
+    }
+    return;
+  }
+  if (!existing) {
+    throw std::out_of_range("key not found");
+  }
+  if (!manifest) {
+    throw std::invalid_argument("value is not a blob");
+  }
+  manifest_ = *manifest;
+  first_new_chunk_ = manifest_.chunks();
+  auto tail = manifest_.size % manifest_.chunk_size;
+  if (tail != 0) {
+    auto chunk = store_.read(
+        detail::blob_chunk_key(key_, manifest_.generation, current_chunk()));
+    if (!chunk || chunk->size() < tail) {
+      throw std::runtime_error("blob chunk is missing");
+    }
+    buffer_.assign(*chunk, 0, tail);
+  }
+}
+
+blob_writer::~blob_writer() {
+  if (committed_) {
+    return;
+  }
+  try {
+    if (store_.abort) {
+      store_.abort();
+      return;
+    }
+    auto erasures = batch();
+    for (auto i = first_new_chunk_; i < current_chunk(); ++i) {
+      erasures.erase(detail::blob_chunk_key(key_, manifest_.generation, i));
+    }
+    if (!erasures.empty()) {
+      store_.write(erasures);
+    }
+  } catch (...) {
+    // Leftover chunks are unreachable, which only wastes space
+  }
+}
+
+void blob_writer::write(std::string_view data) {
+  if (committed_) {
+    throw std::logic_error("blob already committed");
+  }
+  while (!data.empty()) {
+    auto count = std::min<std::size_t>(
+        data.size(), manifest_.chunk_size - buffer_.size());
+    buffer_.append(data.substr(0, count));
+    data.remove_prefix(count);
+    manifest_.size += count;
+    if (buffer_.size() == manifest_.chunk_size) {
+      auto index = current_chunk();
+      store_.write(batch().put(
+          detail::blob_chunk_key(key_, manifest_.generation, index),
+          buffer_));
+      buffer_.clear();
+    }
+  }
+}
+
+std::uint64_t blob_writer::size() const { return manifest_.size; }
+
+void blob_writer::commit() {
+  if (committed_) {
+    throw std::logic_error("blob already committed");
+  }
+  auto writes = batch();
+  if (!buffer_.empty()) {
+    writes.put(
+        detail::blob_chunk_key(key_, manifest_.generation, current_chunk()),
+        buffer_);
+  }
+  writes.put(key_, manifest_.encode());
+  if (replaced_) {
+    detail::erase_blob_chunks(writes, key_, *replaced_);
+  }
+  store_.write(writes);
+  if (store_.commit) {
+    store_.commit();
+  }
+  committed_ = true;
+}
+
+std::uint64_t blob_writer::current_chunk() const {
+  return (manifest_.size - buffer_.size()) / manifest_.chunk_size;
+}
+
+blob_reader::blob_reader(std::string_view key, std::string_view manifest,
+                         std::uint64_t offset, detail::blob_chunk_reader read)
+    : key_(key), read_(std::move(read)) {
+  auto decoded = detail::blob_manifest::decode(manifest);
+  if (!decoded) {
+    throw std::invalid_argument("value is not a blob");
+  }
+  manifest_ = *decoded;
+  seek(offset);
+}
+
+std::uint64_t blob_reader::size() const { return manifest_.size; }
+
+std::uint64_t blob_reader::tell() const { return position_; }
+
+void blob_reader::seek(std::uint64_t offset) {
+  if (offset > manifest_.size) {
+    throw std::out_of_range("offset is beyond the end of the blob");
+  }
+  position_ = offset;
+}
+
+std::size_t blob_reader::read(char* data, std::size_t size) {
+  auto result = std::size_t{0};
+  while (result < size && position_ < manifest_.size) {
+    auto index = position_ / manifest_.chunk_size;
+    auto offset = static_cast<std::size_t>(position_ % manifest_.chunk_size);
+    auto count = static_cast<std::size_t>(
+        std::min<std::uint64_t>({size - result, manifest_.chunk_size - offset,
+                                 manifest_.size - position_}));
+    auto copied =
+        read_(detail::blob_chunk_key(key_, manifest_.generation, index),
+              offset, data + result, count);
+    if (copied < count) {
+      throw std::runtime_error("blob chunk is missing");
+    }
+    result += count;
+    position_ += count;
+  }
+  return result;
+}
+
+std::string blob_reader::read(std::size_t size) {
+  auto result = std::string(static_cast<std::size_t>(std::min<std::uint64_t>(
+                                size, manifest_.size - position_)),
+                            '\0');
+  read(result.data(), result.size());
+  return result;
+}
+
+}  // namespace datastore
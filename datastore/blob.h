@@ -0,0 +1,158 @@
+#pragma once
+#include <datastore/batch.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace datastore {
+
+/** Bytes per chunk of a blob, unless chosen otherwise */
+constexpr std::size_t default_blob_chunk = 64 * 1024;
+
+namespace detail {
+
+/** Prefix of the keys of the chunks of every blob */
+constexpr std::string_view blob_prefix =
+    "\xff"
+    "datastore.blob";
+
+/** Describes a blob, as stored at its key */
+struct blob_manifest {
+  std::uint64_t size = 0;
+  std::uint64_t chunk_size = 0;
+  std::uint64_t generation = 0; /** Distinguishes replaced chunks */
+
+  /** Returns the number of chunks */
+  [[nodiscard]] std::uint64_t chunks() const;
+
+  [[nodiscard]] std::string encode() const;
+
+  /** Returns nothing if value is not a manifest */
+  [[nodiscard]] static std::optional<blob_manifest> decode(
+      std::string_view value);
+};
+
+/** Returns the key of a chunk of the blob at key */
+[[nodiscard]] std::string blob_chunk_key(std::string_view key,
+                                         std::uint64_t generation,
+                                         std::uint64_t index);
+
+/** Appends the erasure of every chunk of a blob to writes */
+void erase_blob_chunks(batch& writes, std::string_view key,
+                       const blob_manifest& manifest);
+
+/** How a blob_writer reads and writes its datastore */
+struct blob_store {
+  /** Returns the value at a key, or nothing if it is absent */
+  std::function<std::optional<std::string>(std::string_view key)> read;
+
+  /** Applies writes, which later reads see */
+  std::function<void(const batch& writes)> write;
+
+  /** Commits the writes, if they are held in a transaction */
+  std::function<void()> commit;
+
+  /** Discards the writes, if they are held in a transaction; without it,
+   * the writer erases the chunks it wrote instead */
+  std::function<void()> abort;
+};
+
+/** Copies up to size bytes of the value at key, from offset, into data,
+ * returning how many, which is zero if the key is absent */
+using blob_chunk_reader = std::function<std::size_t(
+    std::string_view key, std::size_t offset, char* data, std::size_t size)>;
+
+}  // namespace detail
+
+/** Streams a large value into a datastore, a chunk at a time
+ *
+ * The value at the key of a blob is its manifest, which records its size,
+ * and the bytes are stored in chunks of fixed size under derived keys with
+ * a reserved prefix. Memory use is bounded by one chunk. A blob written
+ * anew gets fresh chunk keys, and the chunks it replaces are only erased
+ * with the new manifest, so that the old blob stays readable until the
+ * writer commits and intact if it never does. Appending rewrites only the
+ * last chunk. A blob should only have one writer at a time.
+ */
+class blob_writer {
+ public:
+  /** Opens the blob at key, replacing any value unless append, in which
+   * case the blob must exist
+   *
+   * Throws std::invalid_argument if chunk_size is zero or if appending to
+   * a value which is not a blob, and std::out_of_range if appending to an
+   * absent key. */
+  blob_writer(detail::blob_store store, std::string_view key, bool append,
+              std::size_t chunk_size);
+
+  /** Discards what was written, unless committed */
+  ~blob_writer();
+
+  blob_writer(const blob_writer&) = delete;
+  blob_writer& operator=(const blob_writer&) = delete;
+
+  /** Appends data to the blob */
+  void write(std::string_view data);
+
+  /** Returns the size of the blob, including what was written so far */
+  [[nodiscard]] std::uint64_t size() const;
+
+  /** Writes the last chunk and the manifest, making the blob readable as
+   * written, after which writes throw std::logic_error */
+  void commit();
+
+ private:
+  /** Returns the index of the chunk in buffer_ */
+  [[nodiscard]] std::uint64_t current_chunk() const;
+
+  detail::blob_store store_;
+  std::string key_;
+  detail::blob_manifest manifest_;
+  std::optional<detail::blob_manifest> replaced_;
+  std::uint64_t first_new_chunk_ = 0; /** Chunks before are not new */
+  std::string buffer_;                /** The last chunk, not yet full */
+  bool committed_ = false;
+};
+
+/** Reads a range of a blob, a chunk at a time, without reading the rest */
+class blob_reader {
+ public:
+  /** Reads the blob at key from offset, given its manifest
+   *
+   * Throws std::invalid_argument if manifest is not a blob manifest. */
+  blob_reader(std::string_view key, std::string_view manifest,
+              std::uint64_t offset, detail::blob_chunk_reader read);
+
+  blob_reader(const blob_reader&) = delete;
+  blob_reader& operator=(const blob_reader&) = delete;
+
+  /** Returns the size of the blob */
+  [[nodiscard]] std::uint64_t size() const;
+
+  /** Returns the offset of the next read */
+  [[nodiscard]] std::uint64_t tell() const;
+
+  /** Moves to offset, which may not be beyond the end */
+  void seek(std::uint64_t offset);
+
+  /** Copies up to size bytes from the offset into data, moving past them,
+   * and returns how many, which is less than size only at the end
+   *
+   * Throws std::runtime_error if a chunk is missing, as when the blob was
+   * replaced since the reader opened it, on datastores without snapshots. */
+  std::size_t read(char* data, std::size_t size);
+
+  /** Returns up to size bytes from the offset, moving past them */
+  [[nodiscard]] std::string read(std::size_t size);
+
+ private:
+  std::string key_;
+  detail::blob_manifest manifest_;
+  std::uint64_t position_ = 0;
+  detail::blob_chunk_reader read_;
+};
+
+}  // namespace datastore
@@ -0,0 +1,46 @@
+#include "changes.h"
+#include <stdexcept>
+#include <string>
+
+namespace datastore {
+
+follower::follower(client& replica, std::uint64_t sequence)
+    : replica_(replica), sequence_(sequence), held_(sequence) {}
+
+void follower::apply(const std::vector<change>& changes) {
+  for (const auto& change : changes) {
+    if (change.sequence <= held_) {
+      continue;
+    }
+    if (change.sequence != held_ + 1) {
+      throw std::out_of_range("change " + std::to_string(held_ + 1) +
+                              " is missing from the log");
+    }
+    if (change.cleared) {
+      cleared_ = true;
+      writes_.clear();
+    }
+    for (const auto& operation : change.writes) {
+      if (operation.type == batch::kind::put) {
+        writes_.put(operation.key, operation.value);
+      } else {
+        writes_.erase(operation.key);
+      }
+    }
+    held_ = change.sequence;
+    if (change.continued) {
+      continue;
+    }
+    if (cleared_) {
+      replica_.clear();
+    }
+    replica_.write(writes_);
+    writes_.clear();
+    cleared_ = false;
+    sequence_ = held_;
+  }
+}
+
+std::uint64_t follower::sequence() const { return sequence_; }
+
+}  // namespace datastore
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <datastore/batch.h>
+#include <datastore/client.h>
+#include <vector>
+
+namespace datastore {
+
+/** The writes of one committed transaction, or a part of them, as recorded
+ * in a change log
+ *
+ * A transaction writing in several batches, as a blob writer does, is
+ * recorded as one change per batch, each but the last marked continued. */
+struct change {
+  std::uint64_t sequence; /** One more than that of the previous change */
+  bool cleared = false;   /** Whether every element was erased first */
+  bool continued = false; /** Whether the next change is of the same one */
+  batch writes;
+};
+
+/** Replays a change log into a replica, one write per transaction
+ *
+ * Replication then costs time in proportion to the changes rather than to
+ * the size of the datastore. The follower only remembers the sequence it
+ * reached in memory; a replica which outlives it should store the sequence
+ * alongside its data.
+ */
+class follower {
+ public:
+  /** Follows into replica, which already holds the changes up to sequence */
+  explicit follower(client& replica, std::uint64_t sequence = 0);
+
+  /** Applies the changes following sequence(), in order
+   *
+   * Changes up to sequence() are skipped, so overlapping reads of the log
+   * are harmless. The changes of a transaction are held back until its last
+   * one arrives, then written together. Throws std::out_of_range if a change
+   * is missing, as when the log was truncated beyond sequence(), after which
+   * the replica must be copied anew. */
+  void apply(const std::vector<change>& changes);
+
+  /** Returns the sequence of the last change applied, ending a transaction */
+  [[nodiscard]] std::uint64_t sequence() const;
+
+ private:
+  client& replica_;
+  std::uint64_t sequence_;
+  std::uint64_t held_;  /** Of the last change held back or applied */
+  bool cleared_ = false; /** Whether a change held back cleared */
+  batch writes_;         /** Of the changes held back */
+};
+
+}  // namespace datastore
@@ -1,4 +1,6 @@
 #include <datastore/client.h>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 namespace datastore {
@@ -18,6 +20,19 @@ client::const_iterator client::end() const {
 
 client::const_iterator client::cend() const { return end(); }
 
+client::const_reverse_iterator client::rbegin() const {
+  auto last = iterator(const_cast<client*>(this)->last());
+  return reverse_iterator(--last);
+}
+
+client::const_reverse_iterator client::crbegin() const { return rbegin(); }
+
+client::const_reverse_iterator client::rend() const {
+  return reverse_iterator(end());
+}
+
+client::const_reverse_iterator client::crend() const { return rend(); }
+
 client::iterator::const_reference client::iterator::dereference() const {
   if (!value_) {
     if (cursor_ != nullptr) {
@@ -91,12 +106,75 @@ client::iterator client::find(client::key_type key) const {
   return iterator(lookup(key));
 }
 
-const client::value_type& client::at(const client::key_type& key) {
+client::iterator client::lower_bound(client::key_type key) const {
+  return iterator(seek(key));
+}
+
+std::pair<client::iterator, client::iterator> client::prefix(
+    client::key_type prefix) const {
+  auto bound = detail::prefix_end(prefix);
+  return std::pair(lower_bound(prefix), bound ? lower_bound(*bound) : end());
+}
+
+std::pair<client::reverse_iterator, client::reverse_iterator>
+client::reverse_prefix(client::key_type prefix) const {
+  auto bound = detail::prefix_end(prefix);
+  auto last = bound ? lower_bound(*bound) : end();
+  auto first = lower_bound(prefix);
+  if (first == last) {
+    return std::pair(reverse_iterator(last), reverse_iterator(last));
+  }
+  return std::pair(reverse_iterator(--last), reverse_iterator(--first));
+}
+
+range_estimate client::estimate(key_type from, key_type to) const {
+  auto result = range_estimate();
+  auto last = end();
+  auto bound = to.empty() ? last : lower_bound(to);
+  for (auto it = from.empty() ? begin() : lower_bound(from);
+       it != bound && it != last; ++it) {
+    ++result.count;
+    result.bytes += it->first.size() + it->second.size();
+  }
+  return result;
+}
+
+client::size_type client::next_batch(iterator& position, chunk& values,
+                                     size_type max_items) const {
+  values.clear();
+  position.value_.reset();
+  if (position.cursor_ == nullptr) {
+    return 0;
+  }
+  return read(*position.cursor_, values, max_items);
+}
+
+void client::for_each_chunk(const std::function<void(const chunk&)>& function,
+                            size_type max_items) const {
+  auto position = iterator(first());
+  chunk values;
+  while (next_batch(position, values, max_items) != 0) {
+    function(values);
+  }
+}
+
+client::size_type client::read(cursor& position, chunk& values,
+                               size_type max_items) const {
+  auto end = last();
+  for (; values.size() < max_items && !position.equal(*end);
+       position.increment()) {
+    // Keys and values of an unknown cursor may not outlive its position
+    values.push_back_copy(value_type(position.key(), position.value()), true);
+  }
+  return values.size();
+}
+
+client::element_type client::at(const client::key_type& key) {
   auto it = find(key);
   if (it == end()) {
     throw std::out_of_range{"key not found"};
   } else {
-    return *it;
+    return element_type(it->first, it->second);
   }
 }
 
@@ -109,6 +187,104 @@ std::pair<client::iterator, bool> client::insert(
   return result;
 }
 
+void client::write(const batch& operations) {
+  if (operations.merges()) {
+    write(operations.resolve_merges([this](std::string_view key) {
+      auto it = find(key);
+      return it == end() ? std::nullopt
+                         : std::optional(std::string(it->second));
+    }));
+    return;
+  }
+  for (const auto& operation : operations) {
+    auto pos = lookup(operation.key);
+    if (operation.type == batch::kind::put) {
+      insert_or_assign(std::move(pos), {operation.key, operation.value});
+    } else if (!pos->equal(*last())) {
+      erase(std::move(pos));
+    }
+  }
+}
+
+std::optional<std::string> client::update(key_type key,
+                                          const update_function& function) {
+  auto it = find(key);
+  auto current = std::optional<std::string>();
+  if (it != end()) {
+    current.emplace(it->second);
+  }
+  auto result = function(current);
+  if (result != current) {
+    write(result ? batch().put(key, *result) : batch().erase(key));
+  }
+  return result;
+}
+
+bool client::compare_and_swap(key_type key,
+                              std::optional<mapped_type> expected,
+                              std::optional<mapped_type> desired) {
+  auto swapped = false;
+  update(key, [&](std::optional<mapped_type> current)
+                  -> std::optional<std::string> {
+    swapped = current == expected;
+    auto& result = swapped ? desired : current;
+    return result ? std::optional(std::string(*result)) : std::nullopt;
+  });
+  return swapped;
+}
+
+std::unique_ptr<blob_writer> client::open_blob_writer(key_type key,
+                                                      bool append,
+                                                      size_type chunk_size) {
+  auto store = detail::blob_store();
+  store.read = [this](std::string_view key) -> std::optional<std::string> {
+    auto it = find(key);
+    if (it == end()) {
+      return std::nullopt;
+    }
+    return std::string(it->second);
+  };
+  store.write = [this](const batch& writes) { write(writes); };
+  return std::make_unique<blob_writer>(std::move(store), key, append,
+                                       chunk_size);
+}
+
+std::unique_ptr<blob_reader> client::open_blob_reader(
+    key_type key, std::uint64_t offset) const {
+  auto it = find(key);
+  if (it == end()) {
+    throw std::out_of_range("key not found");
+  }
+  auto read = [this](std::string_view key, std::size_t offset, char* data,
+                     std::size_t size) -> std::size_t {
+    auto chunk = find(key);
+    if (chunk == end() || offset >= chunk->second.size()) {
+      return 0;
+    }
+    auto count = std::min(size, chunk->second.size() - offset);
+    std::memcpy(data, chunk->second.data() + offset, count);
+    return count;
+  };
+  return std::make_unique<blob_reader>(key, it->second, offset,
+                                       std::move(read));
+}
+
+client::size_type client::erase_blob(key_type key) {
+  auto it = find(key);
+  if (it == end()) {
+    return 0;
+  }
+  auto manifest = detail::blob_manifest::decode(it->second);
+  if (!manifest) {
+    return 0;
+  }
+  auto erasures = batch().erase(key);
+  detail::erase_blob_chunks(erasures, key, *manifest);
+  it = end();
+  write(erasures);
+  return 1;
+}
+
 void client::clear() {
   for (auto&& i : *this) {
     erase(i.first);
@@ -121,4 +297,69 @@ client::size_type client::size() const {
 }
 
 bool client::empty() const { return begin() == end(); }
+
+client::chunk::const_iterator client::chunk::begin() const {
+  return values_.begin();
+}
+
+client::chunk::const_iterator client::chunk::end() const {
+  return values_.end();
+}
+
+bool client::chunk::empty() const { return values_.empty(); }
+
+client::size_type client::chunk::size() const { return values_.size(); }
+
+const client::value_type& client::chunk::operator[](size_type index) const {
+  return values_[index];
+}
+
+void client::chunk::clear() {
+  values_.clear();
+  copies_.clear();
+  copied_.clear();
+}
+
+void client::chunk::push_back(const value_type& value) {
+  values_.push_back(value);
+}
+
+void client::chunk::push_back_copy(const value_type& value, bool mapped) {
+  auto data = copies_.data();
+  auto key = copies_.size();
+  copies_.append(value.first);
+  auto copied = std::string::npos;
+  if (mapped) {
+    copied = copies_.size();
+    copies_.append(value.second);
+  }
+  auto view = std::string_view(copies_);
+  if (copies_.data() != data) {
+    // The copies moved, so their views are rebased
+    for (const auto& element : copied_) {
+      auto& [first, second] = values_[element.index];
+      first = view.substr(element.key, first.size());
+      if (element.mapped != std::string::npos) {
+        second = view.substr(element.mapped, second.size());
+      }
+    }
+  }
+  copied_.push_back({values_.size(), key, copied});
+  values_.emplace_back(
+      view.substr(key, value.first.size()),
+      mapped ? view.substr(copied, value.second.size()) : value.second);
+}
+
+std::optional<std::string> detail::prefix_end(std::string_view prefix) {
+  auto result = std::string(prefix);
+  while (!result.empty() && static_cast<unsigned char>(result.back()) == 0xff) {
+    result.pop_back();
+  }
+  if (result.empty()) {
+    return std::nullopt;
+  }
+  ++result.back();
+  return result;
+}
+
 }  // namespace datastore
@@ -1,19 +1,37 @@
 #pragma once
 #include <boost/iterator/iterator_facade.hpp>
+#include <datastore/batch.h>
+#include <datastore/blob.h>
+#include <datastore/reverse_iterator.h>
+#include <functional>
+#include <iosfwd>
 #include <memory>
 #include <numeric>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 namespace datastore {
 
+/** Approximate number and size of the elements in a range of keys */
+struct range_estimate {
+  std::size_t count = 0; /** Elements */
+  std::size_t bytes = 0; /** Bytes of their keys and values */
+  std::size_t error = 0; /** Bound on how far count may be from the actual
+                            count, zero if it is exact */
+};
+
 /** Client driver for a key value database */
 class client {
  public:
+  class chunk;
   class cursor;
   class iterator;
   using const_iterator = const iterator;
+  using reverse_iterator = datastore::reverse_iterator<iterator>;
+  using const_reverse_iterator = const reverse_iterator;
   using difference_type = std::ptrdiff_t;
   using key_type = std::string_view;
   using mapped_type = std::string_view;
@@ -22,6 +40,13 @@ class client {
   using const_reference =
       std::add_lvalue_reference<std::add_const<value_type>::type>::type;
   using size_type = std::size_t;
+  /** An element copied out of the datastore, which outlives any cursor */
+  using element_type = std::pair<std::string, std::string>;
+
+  /** Returns the value to leave at a key, or nullopt to erase it, given its
+   * current value, or nullopt if it is absent */
+  using update_function = std::function<std::optional<std::string>(
+      std::optional<mapped_type> current)>;
 
   virtual ~client() = default;
 
@@ -29,10 +54,10 @@ class client {
 
   /** Access specified element with bounds checking
    *
-   * Returns a reference to the mapped value of the element with key equivalent
-   * to key. If no such element exists, an exception of type std::out_of_range
-   * is thrown. */
-  const_reference at(const key_type& key);
+   * Returns a copy of the element with key equivalent to key, as views
+   * into a cursor would not outlive the call. If no such element exists,
+   * an exception of type std::out_of_range is thrown. */
+  element_type at(const key_type& key);
 
   // Iterators
 
@@ -46,6 +71,16 @@ class client {
   /** Returns an iterator to the end */
   [[nodiscard]] const_iterator cend() const;
 
+  /** Returns a reverse iterator to the last element */
+  [[nodiscard]] const_reverse_iterator rbegin() const;
+  /** Returns a reverse iterator to the last element */
+  [[nodiscard]] const_reverse_iterator crbegin() const;
+
+  /** Returns a reverse iterator to the reverse end */
+  [[nodiscard]] const_reverse_iterator rend() const;
+  /** Returns a reverse iterator to the reverse end */
+  [[nodiscard]] const_reverse_iterator crend() const;
+
   // Capacity
 
   /** Checks whether the db is empty */
@@ -68,25 +103,199 @@ class client {
   /** Inserts a value */
   std::pair<iterator, bool> insert(const value_type& value);
 
-  /** Erases the value matching the given key */
+  /** Erases the value matching the given key
+   *
+   * The chunks of a blob at key are left behind; erase_blob erases them. */
   size_type erase(key_type key);
 
   /** Erases the element at pos */
   iterator erase(iterator pos);
 
+  /** Applies a batch of writes, in a single transaction where supported */
+  virtual void write(const batch& operations);
+
+  /** Replaces the value at key with the result of function, returning it
+   *
+   * The value is read and written in one write transaction where supported,
+   * so that no other write comes between them; elsewhere other writes wait
+   * for it. function may be called with a view only valid during the call,
+   * and must not write to this client. */
+  virtual std::optional<std::string> update(key_type key,
+                                            const update_function& function);
+
+  /** Replaces the value at key with desired if it is expected, nullopt
+   * standing for an absent key, returning whether it did */
+  bool compare_and_swap(key_type key, std::optional<mapped_type> expected,
+                        std::optional<mapped_type> desired);
+
   // Lookup
 
   /** Finds an element matching the given key */
   [[nodiscard]] iterator find(key_type key) const;
 
+  /** Returns an iterator to the first element not ordered before key */
+  [[nodiscard]] iterator lower_bound(key_type key) const;
+
+  /** Returns the range of elements whose keys start with prefix
+   *
+   * Requires the default lexicographic order, under which such keys are
+   * contiguous. */
+  [[nodiscard]] std::pair<iterator, iterator> prefix(key_type prefix) const;
+
+  /** Returns the elements whose keys start with prefix, last first
+   *
+   * The range starts with a seek past the prefix and a single step back, so
+   * that the newest n keys under a prefix cost one seek and n steps. */
+  [[nodiscard]] std::pair<reverse_iterator, reverse_iterator> reverse_prefix(
+      key_type prefix) const;
+
+  // Estimation
+
+  /** Returns the approximate number and size of the elements whose keys are
+   * in [from, to), an empty to standing for the end
+   *
+   * Backends which can estimate in O(log n), reporting a bound on the error
+   * of the count, as documented by each. The others count exactly, walking
+   * the range. to must not order before from. */
+  [[nodiscard]] virtual range_estimate estimate(
+      key_type from, key_type to = key_type()) const;
+
+  // Blobs
+  //
+  // The chunks of a blob are elements like any other, with keys starting
+  // "\xff" "datastore.blob": iteration visits them, size() counts them, and
+  // dump, load and the change log copy them, which keeps blobs readable in a
+  // copy. Erase a blob with erase_blob, as erase leaves its chunks behind.
+
+  /** Opens a writer which streams a large value into key, in chunks of
+   * chunk_size bytes stored under derived keys, as blob_writer
+   *
+   * The blob replaces the value at key, unless append, which continues an
+   * existing blob with its own chunk size. Where writes are transactional,
+   * as with LMDB, the whole blob is written in one transaction, which the
+   * writer holds until it commits: other threads' writes wait for it, and
+   * writes on its own thread throw std::logic_error. The writer must not
+   * outlive the datastore. */
+  [[nodiscard]] virtual std::unique_ptr<blob_writer> open_blob_writer(
+      key_type key, bool append = false,
+      size_type chunk_size = default_blob_chunk);
+
+  /** Opens a reader of the blob at key, from offset, which only reads the
+   * chunks it is asked for
+   *
+   * Throws std::out_of_range if key is absent, and std::invalid_argument if
+   * its value is not a blob. The reader must not outlive the datastore. */
+  [[nodiscard]] virtual std::unique_ptr<blob_reader> open_blob_reader(
+      key_type key, std::uint64_t offset = 0) const;
+
+  /** Erases the blob at key and its chunks, in one write
+   *
+   * Returns the number of blobs erased, which is zero if key is absent or
+   * its value is not a blob. */
+  size_type erase_blob(key_type key);
+
+  // Block reads
+
+  /** Reads up to max_items elements from position into values
+   *
+   * The elements are read in a loop native to the backend, so that a scan
+   * pays for the virtual calls once per block rather than once per element.
+   * values is cleared first, and position is left after the last element
+   * read. Returns the number of elements read, which is only zero at the
+   * end. */
+  size_type next_batch(iterator& position, chunk& values,
+                       size_type max_items) const;
+
+  /** Calls function with consecutive blocks of up to max_items elements,
+   * from the first element to the last */
+  void for_each_chunk(const std::function<void(const chunk&)>& function,
+                      size_type max_items = 1024) const;
+
+  // Export and import
+
+  /** Writes every element in a compact binary format
+   *
+   * Elements are written in checksummed, length-prefixed blocks of about
+   * 1 MiB. They are read in a single iteration, so the dump is a consistent
+   * snapshot wherever iterators are, as with LMDB and map. Returns the
+   * number of elements written. */
+  size_type dump(std::ostream& os) const;
+
+  /** Writes every element to a file descriptor, like dump(std::ostream&) */
+  size_type dump(int fd) const;
+
+  /** Inserts or assigns every element of a dump
+   *
+   * A second thread reads and verifies blocks while this one writes them,
+   * each block in a single batch. Throws std::runtime_error if the dump is
+   * corrupt or truncated, in which case the blocks before the damage remain
+   * written. Returns the number of elements read. */
+  size_type load(std::istream& is);
+
+  /** Loads a dump from a file descriptor, like load(std::istream&) */
+  size_type load(int fd);
+
  protected:
   virtual std::unique_ptr<cursor> insert_or_assign(std::unique_ptr<cursor> pos,
                                                    const value_type& value) = 0;
   virtual std::unique_ptr<cursor> erase(std::unique_ptr<cursor> pos) = 0;
   [[nodiscard]] virtual std::unique_ptr<cursor> lookup(key_type key) const = 0;
+  [[nodiscard]] virtual std::unique_ptr<cursor> seek(key_type key) const = 0;
   [[nodiscard]] virtual std::unique_ptr<cursor> first() const = 0;
   [[nodiscard]] virtual std::unique_ptr<cursor> last() const = 0;
   [[nodiscard]] virtual size_type capacity() const = 0;
+
+  /** Reads the elements for next_batch, one virtual call at a time unless
+   * overridden */
+  virtual size_type read(cursor& position, chunk& values,
+                         size_type max_items) const;
+};
+
+namespace detail {
+
+/** Returns the least key ordered after every key which starts with prefix,
+ * in lexicographic order, or nothing if no key is */
+[[nodiscard]] std::optional<std::string> prefix_end(std::string_view prefix);
+
+}  // namespace detail
+
+/** Elements read by a single call to next_batch
+ *
+ * Keys and values are views into the datastore, which stay valid until the
+ * chunk is refilled or cleared, as long as the iterator they were read from
+ * remains. Keys which a backend cursor only holds until it moves are copied
+ * into the chunk. */
+class client::chunk {
+ public:
+  using const_iterator = std::vector<value_type>::const_iterator;
+
+  [[nodiscard]] const_iterator begin() const;
+  [[nodiscard]] const_iterator end() const;
+  [[nodiscard]] bool empty() const;
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] const value_type& operator[](size_type index) const;
+
+  /** Removes every element, keeping the memory allocated */
+  void clear();
+
+  /** Appends an element whose views outlive the cursor they came from */
+  void push_back(const value_type& value);
+
+  /** Appends an element, copying its key into the chunk, and its mapped
+   * value too if mapped */
+  void push_back_copy(const value_type& value, bool mapped = false);
+
+ private:
+  /** Index of a copied element, with the offsets of its copies */
+  struct copy {
+    size_type index;
+    size_type key;
+    size_type mapped; /** std::string::npos if not copied */
+  };
+
+  std::vector<value_type> values_;
+  std::string copies_; /** Copied keys and values, back to back */
+  std::vector<copy> copied_;
 };
 
 /** Interface to iterate through values of a database */
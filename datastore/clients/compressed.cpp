@@ -0,0 +1,81 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/compressed.h>
+#include <stdexcept>
+
+namespace datastore::clients {
+
+compression compressed_configuration::algorithm() const { return algorithm_; }
+
+int compressed_configuration::level() const { return level_; }
+
+std::size_t compressed_configuration::min_size() const { return min_size_; }
+
+std::size_t compressed_configuration::dictionary_size() const {
+  return dictionary_size_;
+}
+
+std::size_t compressed_configuration::training_size() const {
+  return training_size_;
+}
+
+compressed_configuration& compressed_configuration::set_algorithm(
+    compression algorithm) {
+  algorithm_ = algorithm;
+  return *this;
+}
+
+compressed_configuration& compressed_configuration::set_level(int level) {
+  level_ = level;
+  return *this;
+}
+
+compressed_configuration& compressed_configuration::set_min_size(
+    std::size_t size) {
+  min_size_ = size;
+  return *this;
+}
+
+compressed_configuration& compressed_configuration::set_dictionary_size(
+    std::size_t size) {
+  dictionary_size_ = size;
+  return *this;
+}
+
+compressed_configuration& compressed_configuration::set_training_size(
+    std::size_t size) {
+  training_size_ = size;
+  return *this;
+}
+
+double compression_statistics::ratio() const {
+  return stored_bytes == 0 ? 1.0
+                           : static_cast<double>(raw_bytes) /
+                                 static_cast<double>(stored_bytes);
+}
+
+std::unique_ptr<client> make_compressed(
+    std::unique_ptr<client> store,
+    const compressed_configuration& configuration) {
+  return std::make_unique<detail::adapter<detail::compressed>>(
+      std::move(store), configuration);
+}
+
+std::uint32_t train_dictionary(client& datastore) {
+  auto compressed =
+      dynamic_cast<detail::adapter<detail::compressed>*>(&datastore);
+  if (compressed == nullptr) {
+    throw std::invalid_argument("datastore does not compress its values");
+  }
+  return compressed->get().backend().train();
+}
+
+compression_statistics statistics(const client& datastore) {
+  auto compressed =
+      dynamic_cast<const detail::adapter<detail::compressed>*>(&datastore);
+  if (compressed == nullptr) {
+    throw std::invalid_argument("datastore does not compress its values");
+  }
+  return compressed->get().backend().statistics();
+}
+
+}  // namespace datastore::clients
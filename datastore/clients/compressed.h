@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <datastore/compression.h>
+#include <memory>
+
+namespace datastore::clients {
+
+class compressed_configuration {
+ public:
+  [[nodiscard]] compression algorithm() const;
+
+  /** Returns the zstd compression level */
+  [[nodiscard]] int level() const;
+
+  /** Returns the size below which values are stored as they are */
+  [[nodiscard]] std::size_t min_size() const;
+
+  /** Returns the size of the dictionaries trained */
+  [[nodiscard]] std::size_t dictionary_size() const;
+
+  /** Returns how many bytes of values are sampled to train a dictionary */
+  [[nodiscard]] std::size_t training_size() const;
+
+  compressed_configuration& set_algorithm(compression algorithm);
+  compressed_configuration& set_level(int level);
+  compressed_configuration& set_min_size(std::size_t size);
+  compressed_configuration& set_dictionary_size(std::size_t size);
+  compressed_configuration& set_training_size(std::size_t size);
+
+ private:
+  compression algorithm_ = compression::lz;
+  int level_ = 3;
+  std::size_t min_size_ = 32;
+  std::size_t dictionary_size_ = 16 << 10;
+  std::size_t training_size_ = 1 << 20;
+};
+
+/** Bytes of values written since a compressed datastore was created */
+struct compression_statistics {
+  std::uint64_t values = 0;
+  std::uint64_t raw_bytes = 0;
+  std::uint64_t stored_bytes = 0;
+
+  /** Returns raw bytes per stored byte, or one before any write */
+  [[nodiscard]] double ratio() const;
+};
+
+namespace detail {
+class compressed;
+}
+
+/** Statically dispatched datastore of compressed values
+ *
+ * Include datastore/clients/detail/compressed.h to instantiate it. */
+using compressed_client = basic_client<detail::compressed>;
+
+/** Creates a datastore which compresses values into another
+ *
+ * Values are compressed on write and decompressed as they are read, through
+ * buffers of each thread and of each cursor. Dictionaries trained by
+ * train_dictionary are stored under a reserved key of the store, which the
+ * returned datastore hides, and which may not be written through it. The
+ * store must only hold elements written through such a datastore, as each
+ * value carries a header. Throws std::invalid_argument if the algorithm is
+ * not available. */
+std::unique_ptr<client> make_compressed(
+    std::unique_ptr<client> store,
+    const compressed_configuration& configuration =
+        compressed_configuration());
+
+/** Trains a dictionary on a sample of the values of a datastore created by
+ * make_compressed, stores it, and compresses later writes with it
+ *
+ * Values already written keep their dictionary, so they are not rewritten.
+ * Returns the id of the new dictionary, or zero if there was nothing to
+ * train on. Throws std::invalid_argument if the datastore was not created
+ * by make_compressed. */
+std::uint32_t train_dictionary(client& datastore);
+
+/** Returns how well the values written to a datastore created by
+ * make_compressed compressed
+ *
+ * Throws std::invalid_argument if the datastore was not created by
+ * make_compressed. */
+compression_statistics statistics(const client& datastore);
+
+}  // namespace datastore::clients
@@ -0,0 +1,10 @@
+#include "concurrent_map.h"
+#include <datastore/clients/detail/adapter.h>
+
+namespace datastore::clients {
+
+std::unique_ptr<client> make_concurrent_map(key_compare compare) {
+  return std::make_unique<detail::adapter<detail::skiplist>>(compare);
+}
+
+}  // namespace datastore::clients
@@ -0,0 +1,25 @@
+#pragma once
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <datastore/clients/detail/skiplist.h>
+#include <datastore/compare.h>
+#include <memory>
+
+namespace datastore::clients {
+
+/** Statically dispatched concurrent in-memory datastore */
+using concurrent_map_client = basic_client<detail::skiplist>;
+
+/** Creates an in-memory datastore which threads may share without locking
+ *
+ * Reads never block and scale with the number of threads, while writes are
+ * serialised. Iterators remain valid while other threads modify the
+ * datastore. As with any client, a find followed by an insert is not atomic,
+ * so concurrent inserts of one key may both succeed, with the last one
+ * winning.
+ *
+ * estimate samples the upper levels of the skiplist, in O(log n), with an
+ * error bound which holds about 95% of the time. */
+std::unique_ptr<client> make_concurrent_map(key_compare compare = nullptr);
+
+}  // namespace datastore::clients
@@ -0,0 +1,254 @@
+#pragma once
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <typeinfo>
+
+namespace datastore::clients::detail {
+
+/** Exposes a statically dispatched basic_client as a polymorphic client
+ *
+ * The only cost over the basic_client is one virtual call per cursor
+ * operation and the heap allocation of each cursor.
+ */
+template <typename Backend>
+class adapter final : public client {
+ public:
+  /** Creates a client, forwarding the arguments to the backend */
+  template <typename... Args>
+  explicit adapter(Args&&... args);
+
+  [[nodiscard]] size_type size() const override;
+  [[nodiscard]] bool empty() const override;
+  void clear() override;
+  void write(const batch& operations) override;
+  std::optional<std::string> update(key_type key,
+                                    const update_function& function) override;
+  [[nodiscard]] range_estimate estimate(key_type from,
+                                        key_type to) const override;
+  [[nodiscard]] std::unique_ptr<blob_writer> open_blob_writer(
+      key_type key, bool append, size_type chunk_size) override;
+  [[nodiscard]] std::unique_ptr<blob_reader> open_blob_reader(
+      key_type key, std::uint64_t offset) const override;
+
+  /** Returns the statically dispatched client */
+  basic_client<Backend>& get() noexcept;
+
+  /** Returns the statically dispatched client */
+  const basic_client<Backend>& get() const noexcept;
+
+  /** Returns an iterator at a position of the backend */
+  [[nodiscard]] iterator make_iterator(
+      typename Backend::cursor position) const;
+
+ protected:
+  std::unique_ptr<client::cursor> insert_or_assign(
+      std::unique_ptr<client::cursor> pos, const value_type& value) override;
+  std::unique_ptr<client::cursor> erase(
+      std::unique_ptr<client::cursor> pos) override;
+  [[nodiscard]] std::unique_ptr<client::cursor> lookup(
+      key_type key) const override;
+  [[nodiscard]] std::unique_ptr<client::cursor> seek(
+      key_type key) const override;
+  [[nodiscard]] std::unique_ptr<client::cursor> first() const override;
+  [[nodiscard]] std::unique_ptr<client::cursor> last() const override;
+  [[nodiscard]] size_type capacity() const override;
+
+  /** Reads with the backend cursor, without virtual calls */
+  size_type read(client::cursor& position, chunk& values,
+                 size_type max_items) const override;
+
+ private:
+  using backend_cursor = typename Backend::cursor;
+
+  class cursor final : public client::cursor {
+   public:
+    explicit cursor(backend_cursor position);
+    [[nodiscard]] std::unique_ptr<client::cursor> clone() const override;
+    [[nodiscard]] std::string_view key() const override;
+    [[nodiscard]] std::string_view value() const override;
+    [[nodiscard]] bool equal(const client::cursor& rhs) const override;
+    void increment() override;
+    void decrement() override;
+
+    friend class adapter;
+
+   private:
+    backend_cursor cursor_;
+  };
+
+  /** Takes the backend cursor from a cursor created by this adapter */
+  backend_cursor take(std::unique_ptr<client::cursor> pos) const;
+
+  std::unique_ptr<client::cursor> wrap(backend_cursor position) const;
+
+  basic_client<Backend> client_;
+};
+
+template <typename Backend>
+template <typename... Args>
+adapter<Backend>::adapter(Args&&... args)
+    : client_(std::forward<Args>(args)...) {}
+
+template <typename Backend>
+client::size_type adapter<Backend>::size() const {
+  return client_.size();
+}
+
+template <typename Backend>
+bool adapter<Backend>::empty() const {
+  return client_.empty();
+}
+
+template <typename Backend>
+void adapter<Backend>::clear() {
+  client_.clear();
+}
+
+template <typename Backend>
+void adapter<Backend>::write(const batch& operations) {
+  client_.write(operations);
+}
+
+template <typename Backend>
+std::optional<std::string> adapter<Backend>::update(
+    key_type key, const update_function& function) {
+  return client_.update(key, function);
+}
+
+template <typename Backend>
+range_estimate adapter<Backend>::estimate(key_type from, key_type to) const {
+  return client_.estimate(from, to);
+}
+
+template <typename Backend>
+std::unique_ptr<blob_writer> adapter<Backend>::open_blob_writer(
+    key_type key, bool append, size_type chunk_size) {
+  return client_.open_blob_writer(key, append, chunk_size);
+}
+
+template <typename Backend>
+std::unique_ptr<blob_reader> adapter<Backend>::open_blob_reader(
+    key_type key, std::uint64_t offset) const {
+  return client_.open_blob_reader(key, offset);
+}
+
+template <typename Backend>
+basic_client<Backend>& adapter<Backend>::get() noexcept {
+  return client_;
+}
+
+template <typename Backend>
+const basic_client<Backend>& adapter<Backend>::get() const noexcept {
+  return client_;
+}
+
+template <typename Backend>
+client::iterator adapter<Backend>::make_iterator(
+    typename Backend::cursor position) const {
+  return iterator(wrap(std::move(position)));
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::insert_or_assign(
+    std::unique_ptr<client::cursor> pos, const value_type& value) {
+  auto it = client_.insert_or_assign(
+      typename basic_client<Backend>::iterator(take(std::move(pos))), value);
+  return wrap(it.position());
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::erase(
+    std::unique_ptr<client::cursor> pos) {
+  auto it = client_.erase(
+      typename basic_client<Backend>::iterator(take(std::move(pos))));
+  return wrap(it.position());
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::lookup(key_type key) const {
+  return wrap(client_.backend().lookup(key));
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::seek(key_type key) const {
+  return wrap(client_.backend().lower_bound(key));
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::first() const {
+  return wrap(client_.backend().first());
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::last() const {
+  return wrap(client_.backend().last());
+}
+
+template <typename Backend>
+client::size_type adapter<Backend>::capacity() const {
+  return client_.max_size();
+}
+
+template <typename Backend>
+client::size_type adapter<Backend>::read(client::cursor& position,
+                                         chunk& values,
+                                         size_type max_items) const {
+  if (typeid(position) != typeid(cursor)) {
+    return client::read(position, values, max_items);
+  }
+  return client_.next_batch(static_cast<cursor&>(position).cursor_, values,
+                            max_items);
+}
+
+template <typename Backend>
+typename adapter<Backend>::backend_cursor adapter<Backend>::take(
+    std::unique_ptr<client::cursor> pos) const {
+  if (pos != nullptr && typeid(*pos) == typeid(cursor)) {
+    return std::move(static_cast<cursor&>(*pos).cursor_);
+  }
+  return client_.backend().last();
+}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::wrap(
+    backend_cursor position) const {
+  return std::make_unique<cursor>(std::move(position));
+}
+
+template <typename Backend>
+adapter<Backend>::cursor::cursor(backend_cursor position)
+    : cursor_(std::move(position)) {}
+
+template <typename Backend>
+std::unique_ptr<client::cursor> adapter<Backend>::cursor::clone() const {
+  return std::make_unique<cursor>(cursor_);
+}
+
+template <typename Backend>
+std::string_view adapter<Backend>::cursor::key() const {
+  return cursor_.key();
+}
+
+template <typename Backend>
+std::string_view adapter<Backend>::cursor::value() const {
+  return cursor_.value();
+}
+
+template <typename Backend>
+bool adapter<Backend>::cursor::equal(const client::cursor& rhs) const {
+  // Comparing type_info is cheaper than a dynamic_cast
+  return typeid(rhs) == typeid(cursor) &&
+         cursor_ == static_cast<const cursor&>(rhs).cursor_;
+}
+
+template <typename Backend>
+void adapter<Backend>::cursor::increment() {
+  cursor_.increment();
+}
+
+template <typename Backend>
+void adapter<Backend>::cursor::decrement() {
+  cursor_.decrement();
+}
+
+}  // namespace datastore::clients::detail
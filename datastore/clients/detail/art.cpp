@@ -0,0 +1,1082 @@
+#include "art.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DATASTORE_ART_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace datastore::clients::detail {
+
+/** A key and its value, allocated in one block */
+struct art::leaf {
+  static leaf* make(std::string_view key, std::string_view value) {
+    if (key.size() > std::numeric_limits<std::uint32_t>::max() ||
+        value.size() > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error("element too large for the radix tree");
+    }
+    auto memory = ::operator new(sizeof(leaf) + key.size() + value.size());
+    auto result = new (memory) leaf{static_cast<std::uint32_t>(key.size()),
+                                    static_cast<std::uint32_t>(value.size())};
+    std::memcpy(result->data(), key.data(), key.size());
+    std::memcpy(result->data() + key.size(), value.data(), value.size());
+    return result;
+  }
+
+  static void destroy(leaf* item) {
+    item->~leaf();
+    ::operator delete(item);
+  }
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+  const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+  std::string_view key() const { return {data(), key_size}; }
+  std::string_view value() const { return {data() + key_size, value_size}; }
+
+  std::uint32_t key_size;
+  std::uint32_t value_size; /** May shrink below the allocated size */
+};
+
+/** Header of an inner node, and the operations on the tree
+ *
+ * Children are inner nodes or leaves, which are told apart by tagging the
+ * low bit of leaf pointers. A key which ends at a node is held in its
+ * terminal leaf, which orders before every child. Prefixes longer than the
+ * stored bytes are checked against a leaf below the node.
+ */
+struct art::node {
+  enum class kind : std::uint8_t { node4, node16, node48, node256 };
+  static constexpr std::uint32_t max_prefix = 8;
+
+  struct node4;
+  struct node16;
+  struct node48;
+  struct node256;
+
+  explicit node(kind type) : type(type) {}
+
+  static bool is_leaf(const node* item) {
+    return (reinterpret_cast<std::uintptr_t>(item) & 1) != 0;
+  }
+
+  static node* tag(const leaf* item) {
+    return reinterpret_cast<node*>(reinterpret_cast<std::uintptr_t>(item) | 1);
+  }
+
+  static leaf* as_leaf(const node* item) {
+    return reinterpret_cast<leaf*>(reinterpret_cast<std::uintptr_t>(item) &
+                                   ~std::uintptr_t{1});
+  }
+
+  static void destroy(node* item);
+  static node** find_child(node* item, unsigned char byte);
+  static node* child_after(const node* item, unsigned char byte);
+  static node* child_before(const node* item, unsigned char byte);
+  static node* first_child(const node* item);
+  static node* last_child(const node* item);
+
+  /** Returns the least byte of a child after byte, or -1 if there is none */
+  static int byte_after(const node* item, int byte);
+
+  /** Returns the greatest byte of a child before byte, or -1 if there is
+   * none */
+  static int byte_before(const node* item, int byte);
+  static void add_child(node*& ref, unsigned char byte, node* child);
+  static void remove_child(node*& ref, unsigned char byte);
+
+  /** Returns the leaf with the least key below item */
+  static const leaf* minimum(const node* item);
+
+  /** Returns the leaf with the greatest key below item */
+  static const leaf* maximum(const node* item);
+
+  /** Returns the whole prefix of item, which starts at depth */
+  static std::string_view prefix_of(const node* item, std::size_t depth);
+  void set_prefix(std::string_view bytes);
+
+  static const leaf* find(const node* item, std::string_view key);
+
+  /** Returns the first leaf whose key is not less than key, or greater than
+   * key if strict */
+  static const leaf* lower_bound(const node* item, std::string_view key,
+                                 std::size_t depth, bool strict);
+
+  /** Inserts or assigns, returning the leaf and whether it is new */
+  static std::pair<const leaf*, bool> insert(node*& ref, std::string_view key,
+                                             std::string_view value,
+                                             std::size_t depth);
+
+  /** Replaces the value of the leaf at ref */
+  template <typename Leaf>
+  static const leaf* assign(Leaf*& ref, std::string_view value);
+
+  static bool erase(node*& ref, std::string_view key, std::size_t depth);
+
+  /** Replaces a node with too few children by a smaller one */
+  static void shrink(node*& ref);
+
+  /** Copies the header of a node which is being resized */
+  static void copy_header(node* to, const node* from);
+
+  kind type;
+  std::uint16_t count = 0; /** Children, excluding the terminal leaf */
+  std::uint32_t prefix_length = 0;
+  unsigned char prefix[max_prefix] = {};
+  leaf* terminal = nullptr;
+};
+
+struct art::node::node4 : art::node {
+  node4() : node(kind::node4) {}
+  unsigned char keys[4] = {};
+  node* children[4] = {};
+};
+
+struct art::node::node16 : art::node {
+  node16() : node(kind::node16) {}
+  unsigned char keys[16] = {};
+  node* children[16] = {};
+};
+
+struct art::node::node48 : art::node {
+  node48() : node(kind::node48) {}
+  unsigned char index[256] = {}; /** Slot plus one, or zero if absent */
+  node* children[48] = {};
+};
+
+struct art::node::node256 : art::node {
+  node256() : node(kind::node256) {}
+  node* children[256] = {};
+};
+
+namespace {
+
+/** Returns the index of the lowest set bit of a non-zero mask */
+unsigned int lowest(unsigned int mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+/** Returns the slot of byte among count sorted keys, or count if absent */
+unsigned int find16(const unsigned char* keys, unsigned int count,
+                    unsigned char byte) {
+#ifdef DATASTORE_ART_SSE2
+  auto matches = _mm_cmpeq_epi8(
+      _mm_set1_epi8(static_cast<char>(byte)),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)));
+  auto mask = static_cast<unsigned int>(_mm_movemask_epi8(matches)) &
+              ((1u << count) - 1);
+  return mask != 0 ? lowest(mask) : count;
+#else
+  auto end = keys + count;
+  auto it = std::lower_bound(keys, end, byte);
+  return it != end && *it == byte ? static_cast<unsigned int>(it - keys)
+                                  : count;
+#endif
+}
+
+/** Returns the first slot whose key is greater than byte, or count */
+unsigned int upper16(const unsigned char* keys, unsigned int count,
+                     unsigned char byte) {
+#ifdef DATASTORE_ART_SSE2
+  // SSE2 only compares signed bytes, so flip the sign bits first
+  auto flip = _mm_set1_epi8(static_cast<char>(0x80));
+  auto greater = _mm_cmpgt_epi8(
+      _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)),
+                    flip),
+      _mm_xor_si128(_mm_set1_epi8(static_cast<char>(byte)), flip));
+  auto mask = static_cast<unsigned int>(_mm_movemask_epi8(greater)) &
+              ((1u << count) - 1);
+  return mask != 0 ? lowest(mask) : count;
+#else
+  return static_cast<unsigned int>(std::upper_bound(keys, keys + count, byte) -
+                                   keys);
+#endif
+}
+
+unsigned int upper4(const unsigned char* keys, unsigned int count,
+                    unsigned char byte) {
+  auto i = 0u;
+  while (i < count && keys[i] <= byte) {
+    ++i;
+  }
+  return i;
+}
+
+/** Returns the greatest of count sorted keys less than byte, or -1 */
+int lower_key(const unsigned char* keys, unsigned int count, int byte) {
+  for (auto i = count; i > 0; --i) {
+    if (keys[i - 1] < byte) {
+      return keys[i - 1];
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+void art::node::destroy(node* item) {
+  if (item == nullptr) {
+    return;
+  }
+  if (is_leaf(item)) {
+    leaf::destroy(as_leaf(item));
+    return;
+  }
+  if (item->terminal != nullptr) {
+    leaf::destroy(item->terminal);
+  }
+  switch (item->type) {
+    case kind::node4: {
+      auto self = static_cast<node4*>(item);
+      std::for_each(self->children, self->children + self->count, destroy);
+      delete self;
+      break;
+    }
+    case kind::node16: {
+      auto self = static_cast<node16*>(item);
+      std::for_each(self->children, self->children + self->count, destroy);
+      delete self;
+      break;
+    }
+    case kind::node48: {
+      auto self = static_cast<node48*>(item);
+      std::for_each(std::begin(self->children), std::end(self->children),
+                    destroy);
+      delete self;
+      break;
+    }
+    case kind::node256: {
+      auto self = static_cast<node256*>(item);
+      std::for_each(std::begin(self->children), std::end(self->children),
+                    destroy);
+      delete self;
+      break;
+    }
+  }
+}
+
+art::node** art::node::find_child(node* item, unsigned char byte) {
+  switch (item->type) {
+    case kind::node4: {
+      auto self = static_cast<node4*>(item);
+      for (auto i = 0u; i < self->count; ++i) {
+        if (self->keys[i] == byte) {
+          return &self->children[i];
+        }
+      }
+      return nullptr;
+    }
+    case kind::node16: {
+      auto self = static_cast<node16*>(item);
+      auto i = find16(self->keys, self->count, byte);
+      return i < self->count ? &self->children[i] : nullptr;
+    }
+    case kind::node48: {
+      auto self = static_cast<node48*>(item);
+      auto slot = self->index[byte];
+      return slot != 0 ? &self->children[slot - 1] : nullptr;
+    }
+    case kind::node256: {
+      auto self = static_cast<node256*>(item);
+      return self->children[byte] != nullptr ? &self->children[byte] : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+art::node* art::node::child_after(const node* item, unsigned char byte) {
+  switch (item->type) {
+    case kind::node4: {
+      auto self = static_cast<const node4*>(item);
+      auto i = upper4(self->keys, self->count, byte);
+      return i < self->count ? self->children[i] : nullptr;
+    }
+    case kind::node16: {
+      auto self = static_cast<const node16*>(item);
+      auto i = upper16(self->keys, self->count, byte);
+      return i < self->count ? self->children[i] : nullptr;
+    }
+    case kind::node48: {
+      auto self = static_cast<const node48*>(item);
+      for (auto i = byte + 1; i < 256; ++i) {
+        if (self->index[i] != 0) {
+          return self->children[self->index[i] - 1];
+        }
+      }
+      return nullptr;
+    }
+    case kind::node256: {
+      auto self = static_cast<const node256*>(item);
+      for (auto i = byte + 1; i < 256; ++i) {
+        if (self->children[i] != nullptr) {
+          return self->children[i];
+        }
+      }
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+art::node* art::node::child_before(const node* item, unsigned char byte) {
+  switch (item->type) {
+    case kind::node4: {
+      auto self = static_cast<const node4*>(item);
+      for (auto i = self->count; i > 0; --i) {
+        if (self->keys[i - 1] < byte) {
+          return self->children[i - 1];
+        }
+      }
+      return nullptr;
+    }
+    case kind::node16: {
+      auto self = static_cast<const node16*>(item);
+      // The slot of the first key not less than byte follows the answer
+      auto i = byte == 0 ? 0u : upper16(self->keys, self->count, byte - 1);
+      return i > 0 ? self->children[i - 1] : nullptr;
+    }
+    case kind::node48: {
+      auto self = static_cast<const node48*>(item);
+      for (auto i = int{byte} - 1; i >= 0; --i) {
+        if (self->index[i] != 0) {
+          return self->children[self->index[i] - 1];
+        }
+      }
+      return nullptr;
+    }
+    case kind::node256: {
+      auto self = static_cast<const node256*>(item);
+      for (auto i = int{byte} - 1; i >= 0; --i) {
+        if (self->children[i] != nullptr) {
+          return self->children[i];
+        }
+      }
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+art::node* art::node::first_child(const node* item) {
+  switch (item->type) {
+    case kind::node4:
+      return item->count != 0 ? static_cast<const node4*>(item)->children[0]
+                              : nullptr;
+    case kind::node16:
+      return item->count != 0 ? static_cast<const node16*>(item)->children[0]
+                              : nullptr;
+    default:
+      return find_child(const_cast<node*>(item), 0) != nullptr
+                 ? *find_child(const_cast<node*>(item), 0)
+                 : child_after(item, 0);
+  }
+}
+
+art::node* art::node::last_child(const node* item) {
+  switch (item->type) {
+    case kind::node4:
+      return item->count != 0
+                 ? static_cast<const node4*>(item)->children[item->count - 1]
+                 : nullptr;
+    case kind::node16:
+      return item->count != 0
+                 ? static_cast<const node16*>(item)->children[item->count - 1]
+                 : nullptr;
+    default:
+      return find_child(const_cast<node*>(item), 255) != nullptr
+                 ? *find_child(const_cast<node*>(item), 255)
+                 : child_before(item, 255);
+  }
+}
+
+int art::node::byte_after(const node* item, int byte) {
+  switch (item->type) {
+    case kind::node4: {
+      auto self = static_cast<const node4*>(item);
+      auto i = byte < 0 ? 0u
+                        : upper4(self->keys, self->count,
+                                 static_cast<unsigned char>(byte));
+      return i < self->count ? self->keys[i] : -1;
+    }
+    case kind::node16: {
+      auto self = static_cast<const node16*>(item);
+      auto i = byte < 0 ? 0u
+                        : upper16(self->keys, self->count,
+                                  static_cast<unsigned char>(byte));
+      return i < self->count ? self->keys[i] : -1;
+    }
+    case kind::node48: {
+      auto self = static_cast<const node48*>(item);
+      for (auto i = byte + 1; i < 256; ++i) {
+        if (self->index[i] != 0) {
+          return i;
+        }
+      }
+      return -1;
+    }
+    case kind::node256: {
+      auto self = static_cast<const node256*>(item);
+      for (auto i = byte + 1; i < 256; ++i) {
+        if (self->children[i] != nullptr) {
+          return i;
+        }
+      }
+      return -1;
+    }
+  }
+  return -1;
+}
+
+int art::node::byte_before(const node* item, int byte) {
+  switch (item->type) {
+    case kind::node4: {
+      auto self = static_cast<const node4*>(item);
+      return lower_key(self->keys, self->count, byte);
+    }
+    case kind::node16: {
+      auto self = static_cast<const node16*>(item);
+      return lower_key(self->keys, self->count, byte);
+    }
+    case kind::node48: {
+      auto self = static_cast<const node48*>(item);
+      for (auto i = byte - 1; i >= 0; --i) {
+        if (self->index[i] != 0) {
+          return i;
+        }
+      }
+      return -1;
+    }
+    case kind::node256: {
+      auto self = static_cast<const node256*>(item);
+      for (auto i = byte - 1; i >= 0; --i) {
+        if (self->children[i] != nullptr) {
+          return i;
+        }
+      }
+      return -1;
+    }
+  }
+  return -1;
+}
+
+void art::node::add_child(node*& ref, unsigned char byte, node* child) {
+  switch (ref->type) {
+    case kind::node4: {
+      auto self = static_cast<node4*>(ref);
+      if (self->count < 4) {
+        auto i = upper4(self->keys, self->count, byte);
+        std::copy_backward(self->keys + i, self->keys + self->count,
+                           self->keys + self->count + 1);
+        std::copy_backward(self->children + i, self->children + self->count,
+                           self->children + self->count + 1);
+        self->keys[i] = byte;
+        self->children[i] = child;
+        ++self->count;
+        return;
+      }
+      auto grown = new node16;
+      copy_header(grown, self);
+      std::copy(self->keys, self->keys + 4, grown->keys);
+      std::copy(self->children, self->children + 4, grown->children);
+      delete self;
+      ref = grown;
+      break;
+    }
+    case kind::node16: {
+      auto self = static_cast<node16*>(ref);
+      if (self->count < 16) {
+        auto i = upper16(self->keys, self->count, byte);
+        std::copy_backward(self->keys + i, self->keys + self->count,
+                           self->keys + self->count + 1);
+        std::copy_backward(self->children + i, self->children + self->count,
+                           self->children + self->count + 1);
+        self->keys[i] = byte;
+        self->children[i] = child;
+        ++self->count;
+        return;
+      }
+      auto grown = new node48;
+      copy_header(grown, self);
+      for (auto i = 0u; i < 16; ++i) {
+        grown->index[self->keys[i]] = static_cast<unsigned char>(i + 1);
+        grown->children[i] = self->children[i];
+      }
+      delete self;
+      ref = grown;
+      break;
+    }
+    case kind::node48: {
+      auto self = static_cast<node48*>(ref);
+      if (self->count < 48) {
+        auto slot = std::find(std::begin(self->children),
+                              std::end(self->children), nullptr);
+        *slot = child;
+        self->index[byte] =
+            static_cast<unsigned char>(slot - self->children + 1);
+        ++self->count;
+        return;
+      }
+      auto grown = new node256;
+      copy_header(grown, self);
+      for (auto i = 0u; i < 256; ++i) {
+        if (self->index[i] != 0) {
+          grown->children[i] = self->children[self->index[i] - 1];
+        }
+      }
+      delete self;
+      ref = grown;
+      break;
+    }
+    case kind::node256: {
+      auto self = static_cast<node256*>(ref);
+      self->children[byte] = child;
+      ++self->count;
+      return;
+    }
+  }
+  add_child(ref, byte, child);
+}
+
+void art::node::remove_child(node*& ref, unsigned char byte) {
+  switch (ref->type) {
+    case kind::node4: {
+      auto self = static_cast<node4*>(ref);
+      auto i = static_cast<unsigned int>(
+          std::find(self->keys, self->keys + self->count, byte) - self->keys);
+      std::copy(self->keys + i + 1, self->keys + self->count, self->keys + i);
+      std::copy(self->children + i + 1, self->children + self->count,
+                self->children + i);
+      --self->count;
+      break;
+    }
+    case kind::node16: {
+      auto self = static_cast<node16*>(ref);
+      auto i = find16(self->keys, self->count, byte);
+      std::copy(self->keys + i + 1, self->keys + self->count, self->keys + i);
+      std::copy(self->children + i + 1, self->children + self->count,
+                self->children + i);
+      --self->count;
+      break;
+    }
+    case kind::node48: {
+      auto self = static_cast<node48*>(ref);
+      self->children[self->index[byte] - 1] = nullptr;
+      self->index[byte] = 0;
+      --self->count;
+      break;
+    }
+    case kind::node256: {
+      auto self = static_cast<node256*>(ref);
+      self->children[byte] = nullptr;
+      --self->count;
+      break;
+    }
+  }
+  shrink(ref);
+}
+
+void art::node::shrink(node*& ref) {
+  switch (ref->type) {
+    case kind::node4: {
+      auto self = static_cast<node4*>(ref);
+      if (self->count == 0) {
+        ref = self->terminal != nullptr ? tag(self->terminal) : nullptr;
+        delete self;
+      } else if (self->count == 1 && self->terminal == nullptr) {
+        // Merge the node into its only child, joining their prefixes
+        auto child = self->children[0];
+        if (!is_leaf(child)) {
+          unsigned char bytes[max_prefix];
+          auto length = std::min(self->prefix_length, max_prefix);
+          std::copy(self->prefix, self->prefix + length, bytes);
+          if (length < max_prefix) {
+            bytes[length++] = self->keys[0];
+          }
+          auto rest = std::min(child->prefix_length, max_prefix - length);
+          std::copy(child->prefix, child->prefix + rest, bytes + length);
+          std::copy(bytes, bytes + length + rest, child->prefix);
+          child->prefix_length += self->prefix_length + 1;
+        }
+        ref = child;
+        delete self;
+      }
+      break;
+    }
+    case kind::node16: {
+      auto self = static_cast<node16*>(ref);
+      if (self->count <= 3) {
+        auto shrunk = new node4;
+        copy_header(shrunk, self);
+        std::copy(self->keys, self->keys + self->count, shrunk->keys);
+        std::copy(self->children, self->children + self->count,
+                  shrunk->children);
+        delete self;
+        ref = shrunk;
+      }
+      break;
+    }
+    case kind::node48: {
+      auto self = static_cast<node48*>(ref);
+      if (self->count <= 12) {
+        auto shrunk = new node16;
+        copy_header(shrunk, self);
+        auto n = 0u;
+        for (auto i = 0u; i < 256; ++i) {
+          if (self->index[i] != 0) {
+            shrunk->keys[n] = static_cast<unsigned char>(i);
+            shrunk->children[n++] = self->children[self->index[i] - 1];
+          }
+        }
+        delete self;
+        ref = shrunk;
+      }
+      break;
+    }
+    case kind::node256: {
+      auto self = static_cast<node256*>(ref);
+      if (self->count <= 36) {
+        auto shrunk = new node48;
+        copy_header(shrunk, self);
+        auto n = 0u;
+        for (auto i = 0u; i < 256; ++i) {
+          if (self->children[i] != nullptr) {
+            shrunk->children[n] = self->children[i];
+            shrunk->index[i] = static_cast<unsigned char>(++n);
+          }
+        }
+        delete self;
+        ref = shrunk;
+      }
+      break;
+    }
+  }
+}
+
+void art::node::copy_header(node* to, const node* from) {
+  to->count = from->count;
+  to->prefix_length = from->prefix_length;
+  std::copy(std::begin(from->prefix), std::end(from->prefix), to->prefix);
+  to->terminal = from->terminal;
+}
+
+const art::leaf* art::node::minimum(const node* item) {
+  while (item != nullptr && !is_leaf(item)) {
+    if (item->terminal != nullptr) {
+      return item->terminal;
+    }
+    item = first_child(item);
+  }
+  return item != nullptr ? as_leaf(item) : nullptr;
+}
+
+const art::leaf* art::node::maximum(const node* item) {
+  while (item != nullptr && !is_leaf(item)) {
+    if (item->count == 0) {
+      return item->terminal;
+    }
+    item = last_child(item);
+  }
+  return item != nullptr ? as_leaf(item) : nullptr;
+}
+
+std::string_view art::node::prefix_of(const node* item, std::size_t depth) {
+  if (item->prefix_length <= max_prefix) {
+    return {reinterpret_cast<const char*>(item->prefix), item->prefix_length};
+  }
+  return minimum(item)->key().substr(depth, item->prefix_length);
+}
+
+void art::node::set_prefix(std::string_view bytes) {
+  prefix_length = static_cast<std::uint32_t>(bytes.size());
+  std::memcpy(prefix, bytes.data(), std::min<std::size_t>(bytes.size(),
+                                                          max_prefix));
+}
+
+const art::leaf* art::node::find(const node* item, std::string_view key) {
+  std::size_t depth = 0;
+  while (item != nullptr) {
+    if (is_leaf(item)) {
+      auto result = as_leaf(item);
+      return result->key() == key ? result : nullptr;
+    }
+    // Only the stored bytes of a long prefix are checked on the way down;
+    // the comparison with the leaf catches any mismatch in the rest
+    auto stored = std::min(item->prefix_length, max_prefix);
+    if (key.size() < depth + item->prefix_length ||
+        std::memcmp(item->prefix, key.data() + depth, stored) != 0) {
+      return nullptr;
+    }
+    depth += item->prefix_length;
+    if (depth == key.size()) {
+      auto result = item->terminal;
+      return result != nullptr && result->key() == key ? result : nullptr;
+    }
+    auto child = find_child(const_cast<node*>(item),
+                            static_cast<unsigned char>(key[depth]));
+    item = child != nullptr ? *child : nullptr;
+    ++depth;
+  }
+  return nullptr;
+}
+
+const art::leaf* art::node::lower_bound(const node* item, std::string_view key,
+                                        std::size_t depth, bool strict) {
+  if (item == nullptr) {
+    return nullptr;
+  }
+  if (is_leaf(item)) {
+    auto result = as_leaf(item);
+    auto order = result->key().compare(key);
+    return order > 0 || (order == 0 && !strict) ? result : nullptr;
+  }
+  auto prefix = prefix_of(item, depth);
+  for (std::size_t i = 0; i < prefix.size(); ++i) {
+    if (depth + i == key.size()) {
+      // Every key below extends key
+      return minimum(item);
+    }
+    auto lhs = static_cast<unsigned char>(prefix[i]);
+    auto rhs = static_cast<unsigned char>(key[depth + i]);
+    if (lhs != rhs) {
+      return lhs > rhs ? minimum(item) : nullptr;
+    }
+  }
+  depth += prefix.size();
+  if (depth == key.size()) {
+    if (item->terminal != nullptr && !strict) {
+      return item->terminal;
+    }
+    return minimum(first_child(item));
+  }
+  auto byte = static_cast<unsigned char>(key[depth]);
+  if (auto child = find_child(const_cast<node*>(item), byte)) {
+    if (auto result = lower_bound(*child, key, depth + 1, strict)) {
+      return result;
+    }
+  }
+  return minimum(child_after(item, byte));
+}
+
+template <typename Leaf>
+const art::leaf* art::node::assign(Leaf*& ref, std::string_view value) {
+  auto item = [&] {
+    if constexpr (std::is_same_v<Leaf, leaf>) {
+      return ref;
+    } else {
+      return as_leaf(ref);
+    }
+  }();
+  if (value.size() <= item->value_size) {
+    // Reuse the allocation, so that cursors at the element stay valid
+    std::memcpy(item->data() + item->key_size, value.data(), value.size());
+    item->value_size = static_cast<std::uint32_t>(value.size());
+    return item;
+  }
+  auto replacement = leaf::make(item->key(), value);
+  leaf::destroy(item);
+  if constexpr (std::is_same_v<Leaf, leaf>) {
+    ref = replacement;
+  } else {
+    ref = tag(replacement);
+  }
+  return replacement;
+}
+
+std::pair<const art::leaf*, bool> art::node::insert(node*& ref,
+                                                    std::string_view key,
+                                                    std::string_view value,
+                                                    std::size_t depth) {
+  if (ref == nullptr) {
+    auto result = leaf::make(key, value);
+    ref = tag(result);
+    return {result, true};
+  }
+  if (is_leaf(ref)) {
+    auto existing = as_leaf(ref);
+    if (existing->key() == key) {
+      return {assign(ref, value), false};
+    }
+    // Split the leaf at the first byte where the keys differ
+    auto other = existing->key();
+    auto common = static_cast<std::size_t>(
+        std::mismatch(other.begin() + depth,
+                      other.begin() + std::min(other.size(), key.size()),
+                      key.begin() + depth)
+            .first -
+        other.begin());
+    auto result = leaf::make(key, value);
+    auto split = new node4;
+    split->set_prefix(key.substr(depth, common - depth));
+    node* branch = split;
+    for (auto item : {existing, result}) {
+      if (item->key_size == common) {
+        branch->terminal = item;
+      } else {
+        add_child(branch, static_cast<unsigned char>(item->key()[common]),
+                  tag(item));
+      }
+    }
+    ref = branch;
+    return {result, true};
+  }
+  auto prefix = prefix_of(ref, depth);
+  auto common = static_cast<std::size_t>(
+      std::mismatch(prefix.begin(),
+                    prefix.begin() +
+                        std::min(prefix.size(), key.size() - depth),
+                    key.begin() + depth)
+          .first -
+      prefix.begin());
+  if (common < prefix.size()) {
+    // Split the prefix, hanging this node below a new parent
+    auto result = leaf::make(key, value);
+    auto split = new node4;
+    split->set_prefix(prefix.substr(0, common));
+    auto branch = static_cast<unsigned char>(prefix[common]);
+    auto rest = std::string(prefix.substr(common + 1));
+    ref->set_prefix(rest);
+    node* parent = split;
+    add_child(parent, branch, ref);
+    if (depth + common == key.size()) {
+      parent->terminal = result;
+    } else {
+      add_child(parent, static_cast<unsigned char>(key[depth + common]),
+                tag(result));
+    }
+    ref = parent;
+    return {result, true};
+  }
+  depth += prefix.size();
+  if (depth == key.size()) {
+    if (ref->terminal != nullptr) {
+      return {assign(ref->terminal, value), false};
+    }
+    ref->terminal = leaf::make(key, value);
+    return {ref->terminal, true};
+  }
+  auto byte = static_cast<unsigned char>(key[depth]);
+  if (auto child = find_child(ref, byte)) {
+    return insert(*child, key, value, depth + 1);
+  }
+  auto result = leaf::make(key, value);
+  add_child(ref, byte, tag(result));
+  return {result, true};
+}
+
+bool art::node::erase(node*& ref, std::string_view key, std::size_t depth) {
+  if (ref == nullptr) {
+    return false;
+  }
+  if (is_leaf(ref)) {
+    if (as_leaf(ref)->key() != key) {
+      return false;
+    }
+    leaf::destroy(as_leaf(ref));
+    ref = nullptr;
+    return true;
+  }
+  auto stored = std::min(ref->prefix_length, max_prefix);
+  if (key.size() < depth + ref->prefix_length ||
+      std::memcmp(ref->prefix, key.data() + depth, stored) != 0) {
+    return false;
+  }
+  depth += ref->prefix_length;
+  if (depth == key.size()) {
+    if (ref->terminal == nullptr || ref->terminal->key() != key) {
+      return false;
+    }
+    leaf::destroy(ref->terminal);
+    ref->terminal = nullptr;
+    shrink(ref);
+    return true;
+  }
+  auto byte = static_cast<unsigned char>(key[depth]);
+  auto child = find_child(ref, byte);
+  if (child == nullptr || !erase(*child, key, depth + 1)) {
+    return false;
+  }
+  if (*child == nullptr) {
+    remove_child(ref, byte);
+  }
+  return true;
+}
+
+art::~art() { node::destroy(root_); }
+
+art::cursor art::first() const { return cursor(this, node::minimum(root_)); }
+
+art::cursor art::last() const { return cursor(this, nullptr); }
+
+art::cursor art::lookup(key_type key) const {
+  return cursor(this, node::find(root_, key));
+}
+
+art::cursor art::lower_bound(key_type key) const {
+  return cursor(this, node::lower_bound(root_, key, 0, false));
+}
+
+art::cursor art::insert_or_assign(art::cursor, const value_type& value) {
+  auto [item, inserted] = node::insert(root_, value.first, value.second, 0);
+  if (inserted) {
+    ++size_;
+    ++version_;
+  }
+  return cursor(this, item);
+}
+
+art::cursor art::erase(art::cursor pos) {
+  auto key = std::string(pos.key());
+  if (node::erase(root_, key, 0)) {
+    --size_;
+    ++version_;
+  }
+  return cursor(this, node::lower_bound(root_, key, 0, false));
+}
+
+client::size_type art::size() const { return size_; }
+
+client::size_type art::capacity() const {
+  return std::numeric_limits<size_type>::max();
+}
+
+void art::clear() {
+  node::destroy(root_);
+  root_ = nullptr;
+  size_ = 0;
+  ++version_;
+}
+
+art::cursor::cursor(const art* tree, const leaf* position)
+    : tree_(tree), leaf_(position) {}
+
+std::string_view art::cursor::key() const { return leaf_->key(); }
+
+std::string_view art::cursor::value() const { return leaf_->value(); }
+
+void art::cursor::increment() {
+  if (!located_ || version_ != tree_->version_) {
+    locate();
+  }
+  // Move to the next child of the deepest node which has one
+  while (!path_.empty()) {
+    auto& top = path_.back();
+    auto byte = node::byte_after(top.item, top.byte);
+    if (byte >= 0) {
+      top.byte = byte;
+      leftmost(*node::find_child(const_cast<node*>(top.item),
+                                 static_cast<unsigned char>(byte)));
+      return;
+    }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void art::cursor::decrement() {
+  if (leaf_ == nullptr) {
+    path_.clear();
+    located_ = true;
+    version_ = tree_->version_;
+    rightmost(tree_->root_);
+    return;
+  }
+  if (!located_ || version_ != tree_->version_) {
+    locate();
+  }
+  // Move to the previous child, or else the terminal leaf, of the deepest
+  // node which has one
+  while (!path_.empty()) {
+    auto& top = path_.back();
+    if (top.byte >= 0) {
+      auto byte = node::byte_before(top.item, top.byte);
+      if (byte >= 0) {
+        top.byte = byte;
+        rightmost(*node::find_child(const_cast<node*>(top.item),
+                                    static_cast<unsigned char>(byte)));
+        return;
+      }
+      if (top.item->terminal != nullptr) {
+        top.byte = -1;
+        leaf_ = top.item->terminal;
+        return;
+      }
+    }
+    path_.pop_back();
+  }
+  leaf_ = nullptr;
+}
+
+void art::cursor::locate() {
+  path_.clear();
+  located_ = true;
+  version_ = tree_->version_;
+  auto key = leaf_->key();
+  std::size_t depth = 0;
+  for (auto item = tree_->root_; !node::is_leaf(item);) {
+    // The leaf is in the tree, so its key matches every prefix on the way
+    depth += item->prefix_length;
+    if (depth == key.size()) {
+      path_.push_back({item, -1});
+      return;
+    }
+    auto byte = static_cast<unsigned char>(key[depth++]);
+    path_.push_back({item, byte});
+    item = *node::find_child(item, byte);
+  }
+}
+
+void art::cursor::leftmost(const node* item) {
+  while (!node::is_leaf(item)) {
+    if (item->terminal != nullptr) {
+      path_.push_back({item, -1});
+      leaf_ = item->terminal;
+      return;
+    }
+    auto byte = node::byte_after(item, -1);
+    path_.push_back({item, byte});
+    item = *node::find_child(const_cast<node*>(item),
+                             static_cast<unsigned char>(byte));
+  }
+  leaf_ = node::as_leaf(item);
+}
+
+void art::cursor::rightmost(const node* item) {
+  if (item == nullptr) {
+    leaf_ = nullptr;
+    return;
+  }
+  while (!node::is_leaf(item)) {
+    auto byte = node::byte_before(item, 256);
+    if (byte < 0) {
+      path_.push_back({item, -1});
+      leaf_ = item->terminal;
+      return;
+    }
+    path_.push_back({item, byte});
+    item = *node::find_child(const_cast<node*>(item),
+                             static_cast<unsigned char>(byte));
+  }
+  leaf_ = node::as_leaf(item);
+}
+
+bool art::cursor::operator==(const cursor& rhs) const {
+  return leaf_ == rhs.leaf_;
+}
+
+bool art::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <datastore/client.h>
+#include <string>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** In-memory backend over an adaptive radix tree
+ *
+ * Inner nodes branch on one key byte and grow from 4 to 16, 48 and 256
+ * children as they fill, so sparse levels stay small and dense levels
+ * index their children directly. Each node stores the bytes its keys have
+ * in common, so shared prefixes such as tenant/entity/ are stored once and
+ * never compared again below that node. A key and its value live together
+ * in a single leaf allocation.
+ *
+ * Keys are ordered lexicographically by byte, which is the only order a
+ * radix tree can offer. Like map, a tree may be used by one thread at a
+ * time, and cursors are invalidated by erasing or assigning their element.
+ * Cursors keep the path to their leaf, which other writes make them find
+ * again from the root.
+ */
+class art {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  art() = default;
+
+  /** Frees every node and leaf */
+  ~art();
+
+  art(const art&) = delete;
+  art& operator=(const art&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+ private:
+  struct leaf;
+  struct node;
+
+  node* root_ = nullptr; /** Inner node, tagged leaf or nullptr if empty */
+  size_type size_ = 0;
+  std::uint64_t version_ = 0; /** Changed by inserting and erasing keys */
+};
+
+class art::cursor {
+ public:
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+
+  /** Moves to the following element, in amortised constant time */
+  void increment();
+
+  /** Moves to the preceding element, in amortised constant time */
+  void decrement();
+
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class art;
+
+ private:
+  /** An inner node on the path and the byte of the child taken, or -1 for
+   * its terminal leaf */
+  struct frame {
+    const node* item;
+    int byte;
+  };
+
+  cursor(const art* tree, const leaf* position);
+
+  /** Finds the path to the current leaf from the root */
+  void locate();
+
+  /** Descends to the least leaf below item */
+  void leftmost(const node* item);
+
+  /** Descends to the greatest leaf below item */
+  void rightmost(const node* item);
+
+  const art* tree_ = nullptr;
+  const leaf* leaf_ = nullptr; /** Current leaf, nullptr at the end */
+  std::vector<frame> path_;    /** Inner nodes from the root to the leaf */
+  std::uint64_t version_ = 0;  /** Of the tree when the path was found */
+  bool located_ = false;       /** Whether the path has been found */
+};
+
+}  // namespace datastore::clients::detail
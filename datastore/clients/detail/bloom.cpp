@@ -0,0 +1,130 @@
+#include "bloom.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr std::uint64_t magic = 0x314d4f4f4c425344;  // "DSBLOOM1"
+
+std::uint64_t mix(std::uint64_t h) noexcept {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+std::uint64_t hash(std::string_view key) noexcept {
+  auto h = 0x9e3779b97f4a7c15ULL ^ key.size();
+  auto data = key.data();
+  auto n = key.size();
+  for (; n >= sizeof(std::uint64_t); n -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    h = mix(h ^ word);
+    data += sizeof(word);
+  }
+  std::uint64_t tail = 0;
+  std::memcpy(&tail, data, n);
+  return mix(h ^ tail);
+}
+
+}  // namespace
+
+namespace datastore::clients::detail {
+
+bloom::bloom(std::size_t capacity, unsigned int bits_per_key)
+    : capacity_(capacity),
+      bits_per_key_(bits_per_key),
+      probes_(std::clamp(
+          static_cast<unsigned int>(std::lround(bits_per_key * 0.69)), 1u,
+          16u)),
+      blocks_(std::max<std::size_t>(
+          1, (capacity * bits_per_key + 511) / 512)),
+      words_(blocks_ * block_words) {}
+
+std::size_t bloom::block(std::uint64_t hash) const noexcept {
+  // Maps the upper half of the hash onto [0, blocks_) without a division
+  return static_cast<std::size_t>(((hash >> 32) * blocks_) >> 32) *
+         block_words;
+}
+
+void bloom::insert(std::string_view key) noexcept {
+  auto h = hash(key);
+  auto base = block(h);
+  auto h1 = static_cast<std::uint32_t>(h);
+  auto h2 = (h1 >> 17) | (h1 << 15) | 1u;
+  for (unsigned int i = 0; i < probes_; ++i, h1 += h2) {
+    auto bit = h1 & 511u;
+    words_[base + bit / 64].fetch_or(std::uint64_t{1} << (bit % 64),
+                                     std::memory_order_release);
+  }
+}
+
+bool bloom::may_contain(std::string_view key) const noexcept {
+  auto h = hash(key);
+  auto base = block(h);
+  auto h1 = static_cast<std::uint32_t>(h);
+  auto h2 = (h1 >> 17) | (h1 << 15) | 1u;
+  for (unsigned int i = 0; i < probes_; ++i, h1 += h2) {
+    auto bit = h1 & 511u;
+    auto word = words_[base + bit / 64].load(std::memory_order_acquire);
+    if ((word & (std::uint64_t{1} << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::size_t bloom::capacity() const noexcept { return capacity_; }
+
+unsigned int bloom::bits_per_key() const noexcept { return bits_per_key_; }
+
+void bloom::save(const std::filesystem::path& path, std::uint64_t tag) const {
+  auto temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream os(temporary, std::ios::binary | std::ios::trunc);
+    std::uint64_t header[] = {magic, tag, capacity_, bits_per_key_,
+                              words_.size()};
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (auto& word : words_) {
+      auto value = word.load(std::memory_order_relaxed);
+      os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    if (!os) {
+      throw std::filesystem::filesystem_error(
+          "unable to save filter", temporary,
+          std::make_error_code(std::errc::io_error));
+    }
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+std::unique_ptr<bloom> bloom::load(const std::filesystem::path& path,
+                                   std::uint64_t tag,
+                                   unsigned int bits_per_key) {
+  std::ifstream is(path, std::ios::binary);
+  std::uint64_t header[5];
+  if (!is.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+      header[0] != magic || header[1] != tag || header[3] != bits_per_key) {
+    return nullptr;
+  }
+  auto result = std::make_unique<bloom>(header[2], bits_per_key);
+  if (result->words_.size() != header[4]) {
+    return nullptr;
+  }
+  for (auto& word : result->words_) {
+    std::uint64_t value;
+    if (!is.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+      return nullptr;
+    }
+    word.store(value, std::memory_order_relaxed);
+  }
+  return result;
+}
+
+}  // namespace datastore::clients::detail
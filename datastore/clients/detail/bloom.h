@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** Blocked Bloom filter answering whether a key may be present
+ *
+ * All bits of a key fall within one 512-bit block, so that a query touches
+ * a single cache line. Keys cannot be removed, so owners rebuild the filter
+ * once enough keys have been erased. Inserts and queries may run
+ * concurrently.
+ */
+class bloom {
+ public:
+  /** Creates an empty filter sized for capacity keys */
+  bloom(std::size_t capacity, unsigned int bits_per_key);
+
+  /** Adds a key */
+  void insert(std::string_view key) noexcept;
+
+  /** Returns false if the key is definitely absent */
+  [[nodiscard]] bool may_contain(std::string_view key) const noexcept;
+
+  /** Returns the number of keys the filter was sized for */
+  [[nodiscard]] std::size_t capacity() const noexcept;
+
+  /** Returns the number of bits allotted to each key */
+  [[nodiscard]] unsigned int bits_per_key() const noexcept;
+
+  /** Writes the filter to a file, tagged with the state it describes */
+  void save(const std::filesystem::path& path, std::uint64_t tag) const;
+
+  /** Reads a filter from a file
+   *
+   * Returns nullptr if the file is missing, malformed, or was saved with a
+   * different tag or bits_per_key. */
+  static std::unique_ptr<bloom> load(const std::filesystem::path& path,
+                                     std::uint64_t tag,
+                                     unsigned int bits_per_key);
+
+ private:
+  static constexpr std::size_t block_words = 8;
+
+  [[nodiscard]] std::size_t block(std::uint64_t hash) const noexcept;
+
+  std::size_t capacity_;
+  unsigned int bits_per_key_;
+  unsigned int probes_;
+  std::size_t blocks_;
+  std::vector<std::atomic<std::uint64_t>> words_;
+};
+
+}  // namespace datastore::clients::detail
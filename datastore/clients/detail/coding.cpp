@@ -0,0 +1,101 @@
+#include "coding.h"
+#include <array>
+
+namespace datastore::clients::detail {
+
+namespace {
+
+constexpr std::array<std::uint32_t, 256> crc32_table() {
+  auto result = std::array<std::uint32_t, 256>{};
+  for (std::uint32_t i = 0; i < 256; ++i) {
+    auto crc = i;
+    for (auto bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0u);
+    }
+    result[i] = crc;
+  }
+  return result;
+}
+
+constexpr auto crc32_lookup = crc32_table();
+
+}  // namespace
+
+void put_fixed32(std::string& destination, std::uint32_t value) {
+  for (auto i = 0; i < 4; ++i) {
+    destination.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_fixed64(std::string& destination, std::uint64_t value) {
+  for (auto i = 0; i < 8; ++i) {
+    destination.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_varint(std::string& destination, std::uint64_t value) {
+  while (value >= 0x80) {
+    destination.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  destination.push_back(static_cast<char>(value));
+}
+
+void put_length_prefixed(std::string& destination, std::string_view data) {
+  put_varint(destination, data.size());
+  destination.append(data);
+}
+
+std::uint32_t get_fixed32(const char* source) {
+  auto bytes = reinterpret_cast<const unsigned char*>(source);
+  std::uint32_t result = 0;
+  for (auto i = 0; i < 4; ++i) {
+    result |= std::uint32_t{bytes[i]} << (8 * i);
+  }
+  return result;
+}
+
+std::uint64_t get_fixed64(const char* source) {
+  auto bytes = reinterpret_cast<const unsigned char*>(source);
+  std::uint64_t result = 0;
+  for (auto i = 0; i < 8; ++i) {
+    result |= std::uint64_t{bytes[i]} << (8 * i);
+  }
+  return result;
+}
+
+const char* get_varint(const char* source, const char* limit,
+                       std::uint64_t& value) {
+  value = 0;
+  for (unsigned int shift = 0; shift < 64 && source < limit; shift += 7) {
+    auto byte = static_cast<unsigned char>(*source++);
+    value |= std::uint64_t{byte & 0x7fu} << shift;
+    if ((byte & 0x80) == 0) {
+      return source;
+    }
+  }
+  return nullptr;
+}
+
+bool get_length_prefixed(std::string_view& input, std::string_view& data) {
+  std::uint64_t length;
+  auto limit = input.data() + input.size();
+  auto p = get_varint(input.data(), limit, length);
+  if (p == nullptr || static_cast<std::uint64_t>(limit - p) < length) {
+    return false;
+  }
+  data = std::string_view(p, length);
+  input.remove_prefix(static_cast<std::size_t>(p - input.data()) + length);
+  return true;
+}
+
+std::uint32_t crc32(std::string_view data, std::uint32_t crc) {
+  crc = ~crc;
+  for (auto c : data) {
+    crc = crc32_lookup[(crc ^ static_cast<unsigned char>(c)) & 0xff] ^
+          (crc >> 8);
+  }
+  return ~crc;
+}
+
+}  // namespace datastore::clients::detail
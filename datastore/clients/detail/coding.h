@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace datastore::clients::detail {
+
+/** Appends a little endian 32-bit integer */
+void put_fixed32(std::string& destination, std::uint32_t value);
+
+/** Appends a little endian 64-bit integer */
+void put_fixed64(std::string& destination, std::uint64_t value);
+
+/** Appends a variable length integer, 7 bits per byte */
+void put_varint(std::string& destination, std::uint64_t value);
+
+/** Appends a varint length followed by the data */
+void put_length_prefixed(std::string& destination, std::string_view data);
+
+/** Reads a little endian 32-bit integer */
+std::uint32_t get_fixed32(const char* source);
+
+/** Reads a little endian 64-bit integer */
+std::uint64_t get_fixed64(const char* source);
+
+/** Reads a variable length integer from [source, limit)
+ *
+ * Returns the position after the integer, or nullptr if it is truncated or
+ * malformed. */
+const char* get_varint(const char* source, const char* limit,
+                       std::uint64_t& value);
+
+/** Reads a varint length followed by the data from the front of input
+ *
+ * Returns false if input is truncated. */
+bool get_length_prefixed(std::string_view& input, std::string_view& data);
+
+/** Computes the CRC-32 of data, continuing from a previous checksum */
+std::uint32_t crc32(std::string_view data, std::uint32_t crc = 0);
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,213 @@
+#include "compressed.h"
+#include <datastore/clients/detail/coding.h>
+#include <stdexcept>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+namespace {
+
+std::unique_ptr<client> require(std::unique_ptr<client> store) {
+  if (store == nullptr) {
+    throw std::invalid_argument("compressed values require a store");
+  }
+  return store;
+}
+
+}  // namespace
+
+compressed::compressed(std::unique_ptr<client> store,
+                       const compressed_configuration& configuration)
+    : store_(require(std::move(store))),
+      store_end_(store_->end()),
+      configuration_(configuration) {
+  auto codec = std::make_shared<compressor>(configuration.algorithm(),
+                                            configuration.level(),
+                                            configuration.min_size());
+  auto found = store_->find(reserved_key);
+  if (found != store_end_) {
+    dictionaries_ = found->second;
+    auto input = std::string_view(dictionaries_);
+    while (!input.empty()) {
+      std::uint64_t id = 0;
+      auto data = std::string_view();
+      auto end = input.data() + input.size();
+      auto next = get_varint(input.data(), end, id);
+      if (next == nullptr) {
+        throw std::runtime_error("stored dictionaries are corrupt");
+      }
+      input.remove_prefix(next - input.data());
+      if (!get_length_prefixed(input, data)) {
+        throw std::runtime_error("stored dictionaries are corrupt");
+      }
+      // The last dictionary is the newest
+      codec->add_dictionary(static_cast<std::uint32_t>(id), data);
+    }
+  }
+  codec_ = std::move(codec);
+}
+
+compressed::cursor compressed::first() const {
+  return cursor(this, store_->begin());
+}
+
+compressed::cursor compressed::last() const {
+  return cursor(this, store_->end());
+}
+
+compressed::cursor compressed::lookup(key_type key) const {
+  if (key == reserved_key) {
+    return last();
+  }
+  return cursor(this, store_->find(key));
+}
+
+compressed::cursor compressed::lower_bound(key_type key) const {
+  return cursor(this, store_->lower_bound(key));
+}
+
+compressed::cursor compressed::insert_or_assign(compressed::cursor,
+                                                const value_type& value) {
+  check(value.first);
+  store_->write(batch().put(value.first, encode(value.second)));
+  return cursor(this, store_->find(value.first));
+}
+
+compressed::cursor compressed::erase(compressed::cursor pos) {
+  auto key = std::string(pos.key());
+  store_->write(batch().erase(key));
+  return lower_bound(key);
+}
+
+void compressed::write(const batch& operations) {
+  batch stored;
+  for (const auto& operation : operations) {
+    check(operation.key);
+    if (operation.type == batch::kind::put) {
+      stored.put(operation.key, encode(operation.value));
+    } else {
+      stored.erase(operation.key);
+    }
+  }
+  store_->write(stored);
+}
+
+client::size_type compressed::size() const {
+  auto size = store_->size();
+  return codec()->current_dictionary() == 0 ? size : size - 1;
+}
+
+client::size_type compressed::capacity() const { return store_->max_size(); }
+
+void compressed::clear() {
+  std::lock_guard lock(mutex_);
+  store_->clear();
+  if (!dictionaries_.empty()) {
+    store_->write(batch().put(reserved_key, dictionaries_));
+  }
+}
+
+std::uint32_t compressed::train() {
+  std::lock_guard lock(mutex_);
+  auto current = codec();
+  std::vector<std::string> values;
+  std::size_t total = 0;
+  for (auto it = first(), end = last();
+       it != end && total < configuration_.training_size(); it.increment()) {
+    values.emplace_back(it.value());
+    total += values.back().size();
+  }
+  auto samples = std::vector<std::string_view>(values.begin(), values.end());
+  auto dictionary = train_dictionary(
+      samples, configuration_.dictionary_size(), configuration_.algorithm());
+  if (dictionary.empty()) {
+    return 0;
+  }
+  auto id = current->current_dictionary() + 1;
+  auto stored = dictionaries_;
+  put_varint(stored, id);
+  put_length_prefixed(stored, dictionary);
+  store_->write(batch().put(reserved_key, stored));
+  dictionaries_ = std::move(stored);
+  auto next = std::make_shared<compressor>(*current);
+  next->add_dictionary(id, dictionary);
+  std::atomic_store(&codec_, std::shared_ptr<const compressor>(next));
+  return id;
+}
+
+compression_statistics compressed::statistics() const {
+  auto result = compression_statistics();
+  result.values = values_;
+  result.raw_bytes = raw_bytes_;
+  result.stored_bytes = stored_bytes_;
+  return result;
+}
+
+std::shared_ptr<const compressor> compressed::codec() const {
+  return std::atomic_load(&codec_);
+}
+
+std::string_view compressed::encode(std::string_view value) {
+  auto result = codec()->f(value);
+  values_.fetch_add(1, std::memory_order_relaxed);
+  raw_bytes_.fetch_add(value.size(), std::memory_order_relaxed);
+  stored_bytes_.fetch_add(result.size(), std::memory_order_relaxed);
+  return result;
+}
+
+void compressed::check(key_type key) {
+  if (key == reserved_key) {
+    throw std::invalid_argument("key is reserved for dictionaries");
+  }
+}
+
+compressed::cursor::cursor(const compressed* owner, client::iterator position)
+    : owner_(owner), position_(std::move(position)) {
+  if (!end() && reserved()) {
+    ++position_;
+  }
+}
+
+std::string_view compressed::cursor::key() const { return position_->first; }
+
+std::string_view compressed::cursor::value() const {
+  if (!decompressed_) {
+    owner_->codec()->decompress(position_->second, value_);
+    decompressed_ = true;
+  }
+  return value_;
+}
+
+void compressed::cursor::increment() {
+  ++position_;
+  if (!end() && reserved()) {
+    ++position_;
+  }
+  decompressed_ = false;
+}
+
+void compressed::cursor::decrement() {
+  --position_;
+  if (!end() && reserved()) {
+    --position_;
+  }
+  decompressed_ = false;
+}
+
+bool compressed::cursor::operator==(const cursor& rhs) const {
+  return position_ == rhs.position_;
+}
+
+bool compressed::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+bool compressed::cursor::end() const {
+  return position_ == owner_->store_end_;
+}
+
+bool compressed::cursor::reserved() const {
+  return position_->first == reserved_key;
+}
+
+}  // namespace datastore::clients::detail
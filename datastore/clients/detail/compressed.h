@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <datastore/client.h>
+#include <datastore/clients/compressed.h>
+#include <datastore/compression.h>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace datastore::clients::detail {
+
+/** Compresses the values of another datastore
+ *
+ * Dictionaries are stored back to back under a reserved key, so that they
+ * are found with a lookup whatever the order of the store. Cursors skip the
+ * reserved key wherever it orders.
+ */
+class compressed {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Key holding the dictionaries, which may not be written */
+  static constexpr std::string_view reserved_key = "\xff" "datastore.dict";
+
+  /** Loads the dictionaries of store */
+  compressed(std::unique_ptr<client> store,
+             const compressed_configuration& configuration);
+
+  compressed(const compressed&) = delete;
+  compressed& operator=(const compressed&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+
+  /** Writes the batch to the store in one write */
+  void write(const batch& operations);
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+
+  /** Erases every element, keeping the dictionaries */
+  void clear();
+
+  /** Trains, stores and compresses with a new dictionary, returning its id */
+  std::uint32_t train();
+
+  [[nodiscard]] compression_statistics statistics() const;
+
+ private:
+  /** Returns the compressor in use, which training replaces */
+  [[nodiscard]] std::shared_ptr<const compressor> codec() const;
+
+  /** Compresses value into a buffer of the calling thread, counting it in
+   * the statistics */
+  [[nodiscard]] std::string_view encode(std::string_view value);
+
+  /** Throws std::invalid_argument for the reserved key */
+  static void check(key_type key);
+
+  std::unique_ptr<client> store_;
+  client::iterator store_end_; /** Compared against, never moved */
+  compressed_configuration configuration_;
+  std::shared_ptr<const compressor> codec_; /** Accessed with atomic_load */
+  std::string dictionaries_; /** Id and contents of each, as stored */
+  std::mutex mutex_;         /** Serialises training and clearing */
+  std::atomic<std::uint64_t> values_{0};
+  std::atomic<std::uint64_t> raw_bytes_{0};
+  std::atomic<std::uint64_t> stored_bytes_{0};
+};
+
+/** Position of an element, whose value is decompressed once read */
+class compressed::cursor {
+ public:
+  /** Keys come from an iterator of any client */
+  static constexpr bool transient_keys = true;
+
+  /** Values are decompressed into the cursor */
+  static constexpr bool transient_values = true;
+
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class compressed;
+
+ private:
+  cursor(const compressed* owner, client::iterator position);
+
+  [[nodiscard]] bool end() const;
+  [[nodiscard]] bool reserved() const;
+
+  const compressed* owner_ = nullptr;
+  client::iterator position_;
+  mutable std::string value_;
+  mutable bool decompressed_ = false;
+};
+
+}  // namespace datastore::clients::detail
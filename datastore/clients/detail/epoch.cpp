@@ -0,0 +1,93 @@
+#include "epoch.h"
+#include <functional>
+#include <thread>
+
+namespace datastore::clients::detail {
+
+epoch::~epoch() {
+  for (auto& objects : limbo_) {
+    for (auto& item : objects) {
+      item.deleter(item.object);
+    }
+  }
+}
+
+epoch::guard epoch::pin() const {
+  auto index = stripe();
+  while (true) {
+    auto pinned = epoch_.load();
+    enter(pinned, index);
+    // The epoch may have advanced past pinned before the guard was counted
+    if (epoch_.load() == pinned) {
+      return guard(this, pinned, index);
+    }
+    exit(pinned, index);
+  }
+}
+
+void epoch::retire(void* object, void (*deleter)(void*)) {
+  limbo_[epoch_.load() % 3].push_back(retired{object, deleter});
+}
+
+void epoch::reclaim() {
+  auto current = epoch_.load();
+  auto previous = (current + 2) % 3;
+  for (auto& item : active_[previous]) {
+    if (item.value.load() != 0) {
+      return;
+    }
+  }
+  // Guards are now in the current epoch or later, so objects retired in the
+  // previous epoch are unreachable, and their list is reused by the next
+  epoch_.store(current + 1);
+  auto objects = std::move(limbo_[previous]);
+  limbo_[previous].clear();
+  for (auto& item : objects) {
+    item.deleter(item.object);
+  }
+}
+
+std::size_t epoch::stripe() {
+  thread_local auto index =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) % stripes;
+  return index;
+}
+
+void epoch::enter(std::uint64_t pinned, std::size_t index) const {
+  active_[pinned % 3][index].value.fetch_add(1);
+}
+
+void epoch::exit(std::uint64_t pinned, std::size_t index) const {
+  active_[pinned % 3][index].value.fetch_sub(1);
+}
+
+epoch::guard::guard(const epoch* domain, std::uint64_t pinned,
+                    std::size_t stripe)
+    : domain_(domain), pinned_(pinned), stripe_(stripe) {}
+
+epoch::guard::guard(const guard& rhs)
+    : domain_(rhs.domain_), pinned_(rhs.pinned_), stripe_(rhs.stripe_) {
+  if (domain_ != nullptr) {
+    domain_->enter(pinned_, stripe_);
+  }
+}
+
+epoch::guard::guard(guard&& rhs) noexcept
+    : domain_(rhs.domain_), pinned_(rhs.pinned_), stripe_(rhs.stripe_) {
+  rhs.domain_ = nullptr;
+}
+
+epoch::guard& epoch::guard::operator=(guard rhs) noexcept {
+  std::swap(domain_, rhs.domain_);
+  std::swap(pinned_, rhs.pinned_);
+  std::swap(stripe_, rhs.stripe_);
+  return *this;
+}
+
+epoch::guard::~guard() {
+  if (domain_ != nullptr) {
+    domain_->exit(pinned_, stripe_);
+  }
+}
+
+}  // namespace datastore::clients::detail
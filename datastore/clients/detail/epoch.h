@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** Epoch-based reclamation of memory shared with lock-free readers
+ *
+ * Readers pin the current epoch for as long as they may dereference shared
+ * objects. Writers retire objects they have unlinked, and an object is only
+ * deleted once every guard which was pinned when it was retired is gone.
+ * The epoch advances when no guard remains in the epoch before it, so
+ * guards only ever occupy the current and the previous epoch.
+ *
+ * Guards count into per-thread stripes, so that readers on different cores
+ * do not contend on a shared cache line. Calls to retire and reclaim must be
+ * serialised by the caller.
+ */
+class epoch {
+ public:
+  class guard;
+
+  epoch() = default;
+
+  /** Deletes every retired object; no guard may outlive the epoch */
+  ~epoch();
+
+  epoch(const epoch&) = delete;
+  epoch& operator=(const epoch&) = delete;
+
+  /** Pins the current epoch */
+  [[nodiscard]] guard pin() const;
+
+  /** Defers deleter(object) until no guard could still reach object */
+  void retire(void* object, void (*deleter)(void*));
+
+  /** Advances the epoch if possible, deleting objects no guard can reach */
+  void reclaim();
+
+ private:
+  static constexpr std::size_t stripes = 32;
+
+  struct alignas(64) counter {
+    std::atomic<std::size_t> value{0};
+  };
+
+  struct retired {
+    void* object;
+    void (*deleter)(void*);
+  };
+
+  [[nodiscard]] static std::size_t stripe();
+  void enter(std::uint64_t epoch, std::size_t stripe) const;
+  void exit(std::uint64_t epoch, std::size_t stripe) const;
+
+  mutable std::atomic<std::uint64_t> epoch_{0};
+  mutable std::array<std::array<counter, stripes>, 3> active_;
+  std::array<std::vector<retired>, 3> limbo_;
+};
+
+/** Keeps the objects reachable when it was created from being deleted
+ *
+ * A copy pins the same epoch, in the same stripe, as the original, so that
+ * a stripe never reads as empty while it holds a guard. */
+class epoch::guard {
+ public:
+  /** Creates a guard which pins nothing */
+  guard() = default;
+
+  guard(const guard& rhs);
+  guard(guard&& rhs) noexcept;
+  guard& operator=(guard rhs) noexcept;
+  ~guard();
+
+  friend class epoch;
+
+ private:
+  guard(const epoch* domain, std::uint64_t pinned, std::size_t stripe);
+
+  const epoch* domain_ = nullptr;
+  std::uint64_t pinned_ = 0;
+  std::size_t stripe_ = 0;
+};
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,281 @@
+#include "expiring.h"
+#include <datastore/clients/detail/coding.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace datastore::clients::detail {
+
+namespace {
+
+constexpr std::size_t header = sizeof(std::uint64_t);
+
+std::unique_ptr<client> require(std::unique_ptr<client> store) {
+  if (store == nullptr) {
+    throw std::invalid_argument("expiring elements require a store");
+  }
+  return store;
+}
+
+}  // namespace
+
+expiring::expiring(std::unique_ptr<client> store,
+                   const expiring_configuration& configuration)
+    : store_(require(std::move(store))),
+      store_end_(store_->end()),
+      default_ttl_(configuration.default_ttl()),
+      batch_size_(std::max<std::size_t>(1, configuration.batch_size())),
+      max_pause_(configuration.max_pause()),
+      interval_(configuration.interval()),
+      clock_(configuration.now()) {
+  for (const auto& [key, value] : *store_) {
+    auto time = expiry(value);
+    if (time != never) {
+      index_.emplace(time, key);
+    }
+  }
+  worker_ = std::thread([this] { work(); });
+}
+
+expiring::~expiring() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  worker_.join();
+}
+
+expiring::cursor expiring::first() const {
+  return cursor(this, store_->begin(), now());
+}
+
+expiring::cursor expiring::last() const {
+  return cursor(this, store_->end(), now());
+}
+
+expiring::cursor expiring::lookup(key_type key) const {
+  auto time = now();
+  auto it = store_->find(key);
+  if (it == store_end_ || expired(it->second, time)) {
+    return last();
+  }
+  return cursor(this, std::move(it), time);
+}
+
+expiring::cursor expiring::lower_bound(key_type key) const {
+  return cursor(this, store_->lower_bound(key), now());
+}
+
+expiring::cursor expiring::insert_or_assign(expiring::cursor,
+                                            const value_type& value) {
+  auto time = now();
+  auto expiry = deadline(default_ttl_);
+  {
+    std::lock_guard lock(mutex_);
+    check();
+    store_->write(batch().put(value.first, encode(expiry, value.second)));
+    if (expiry != never) {
+      index_.emplace(expiry, value.first);
+    }
+  }
+  return cursor(this, store_->find(value.first), time);
+}
+
+expiring::cursor expiring::erase(expiring::cursor pos) {
+  auto key = std::string(pos.key());
+  {
+    std::lock_guard lock(mutex_);
+    check();
+    store_->write(batch().erase(key));
+  }
+  return lower_bound(key);
+}
+
+void expiring::write(const batch& operations) {
+  auto expiry = deadline(default_ttl_);
+  batch stored;
+  for (const auto& operation : operations) {
+    if (operation.type == batch::kind::put) {
+      stored.put(operation.key, encode(expiry, operation.value));
+    } else {
+      stored.erase(operation.key);
+    }
+  }
+  std::lock_guard lock(mutex_);
+  check();
+  store_->write(stored);
+  if (expiry != never) {
+    for (const auto& operation : operations) {
+      if (operation.type == batch::kind::put) {
+        index_.emplace(expiry, operation.key);
+      }
+    }
+  }
+}
+
+client::size_type expiring::size() const { return store_->size(); }
+
+client::size_type expiring::capacity() const { return store_->max_size(); }
+
+void expiring::clear() {
+  std::lock_guard lock(mutex_);
+  check();
+  store_->clear();
+  index_.clear();
+}
+
+void expiring::expire(key_type key, std::chrono::milliseconds ttl) {
+  auto expiry = deadline(ttl);
+  std::lock_guard lock(mutex_);
+  check();
+  auto it = store_->find(key);
+  if (it == store_end_ || expired(it->second, now())) {
+    throw std::out_of_range("key not found");
+  }
+  store_->write(batch().put(key, encode(expiry, it->second.substr(header))));
+  if (expiry != never) {
+    index_.emplace(expiry, key);
+  }
+}
+
+client::size_type expiring::sweep() {
+  auto time = now();
+  auto result = size_type{0};
+  auto more = true;
+  while (more) {
+    // Writers may go between two batches
+    std::lock_guard lock(mutex_);
+    check();
+    result += sweep(time, more);
+  }
+  return result;
+}
+
+expiring::instant expiring::now() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             clock_().time_since_epoch())
+      .count();
+}
+
+expiring::instant expiring::deadline(std::chrono::milliseconds ttl) const {
+  return ttl.count() > 0 ? now() + ttl.count() : never;
+}
+
+std::string expiring::encode(instant expiry, std::string_view value) {
+  auto result = std::string();
+  result.reserve(header + value.size());
+  put_fixed64(result, expiry);
+  result.append(value);
+  return result;
+}
+
+expiring::instant expiring::expiry(std::string_view stored) {
+  if (stored.size() < header) {
+    throw std::runtime_error("stored value has no expiry time");
+  }
+  return get_fixed64(stored.data());
+}
+
+bool expiring::expired(std::string_view stored, instant time) {
+  auto expiry = expiring::expiry(stored);
+  return expiry != never && expiry <= time;
+}
+
+client::size_type expiring::sweep(instant time, bool& more) {
+  auto start = std::chrono::steady_clock::now();
+  batch erasures;
+  auto due = index_.begin();
+  for (auto count = std::size_t{0};
+       due != index_.end() && due->first <= time && count < batch_size_;
+       ++count) {
+    // Skip stale entries, of keys since erased or given another time
+    auto it = store_->find(due->second);
+    if (it != store_end_ && expiry(it->second) == due->first) {
+      erasures.erase(due->second);
+    }
+    ++due;
+    if (std::chrono::steady_clock::now() - start >= max_pause_) {
+      break;
+    }
+  }
+  if (!erasures.empty()) {
+    store_->write(erasures);
+  }
+  index_.erase(index_.begin(), due);
+  more = due != index_.end() && due->first <= time;
+  return erasures.size();
+}
+
+void expiring::work() {
+  std::unique_lock lock(mutex_);
+  while (!stop_) {
+    changed_.wait_for(lock, interval_, [this] { return stop_; });
+    if (stop_) {
+      break;
+    }
+    try {
+      auto time = now();
+      auto more = true;
+      while (more && !stop_) {
+        sweep(time, more);
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+      }
+    } catch (...) {
+      // Reported by the next write, as expired elements can no longer be
+      // erased
+      error_ = std::current_exception();
+      return;
+    }
+  }
+}
+
+void expiring::check() const {
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+expiring::cursor::cursor(const expiring* owner, client::iterator position,
+                         instant time)
+    : owner_(owner), position_(std::move(position)), time_(time) {
+  skip();
+}
+
+std::string_view expiring::cursor::key() const { return position_->first; }
+
+std::string_view expiring::cursor::value() const {
+  return position_->second.substr(header);
+}
+
+void expiring::cursor::increment() {
+  ++position_;
+  skip();
+}
+
+void expiring::cursor::decrement() {
+  do {
+    --position_;
+  } while (!end() && expired(position_->second, time_));
+}
+
+bool expiring::cursor::operator==(const cursor& rhs) const {
+  return position_ == rhs.position_;
+}
+
+bool expiring::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+bool expiring::cursor::end() const {
+  return position_ == owner_->store_end_;
+}
+
+void expiring::cursor::skip() {
+  while (!end() && expired(position_->second, time_)) {
+    ++position_;
+  }
+}
+
+}  // namespace datastore::clients::detail
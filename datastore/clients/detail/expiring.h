@@ -0,0 +1,142 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <datastore/client.h>
+#include <datastore/clients/expiring.h>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace datastore::clients::detail {
+
+/** Expiry times in front of another datastore
+ *
+ * Values are stored behind the time they expire at, in milliseconds since
+ * the epoch or zero for never. An in-memory index orders the keys which
+ * expire by time, so the sweeper only visits due keys. The index is rebuilt
+ * from the store on construction. It is not updated when a key is
+ * overwritten or erased, so it may hold stale entries, which the sweeper
+ * checks against the stored time and drops when they come due.
+ */
+class expiring {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Indexes the expiring elements of store and starts sweeping */
+  expiring(std::unique_ptr<client> store,
+           const expiring_configuration& configuration);
+
+  /** Stops sweeping */
+  ~expiring();
+
+  expiring(const expiring&) = delete;
+  expiring& operator=(const expiring&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first live element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  /** Inserts value with the default time to live */
+  cursor insert_or_assign(cursor pos, const value_type& value);
+
+  cursor erase(cursor pos);
+
+  /** Writes the batch to the store in one write, with the default time to
+   * live */
+  void write(const batch& operations);
+
+  /** Returns the number of elements, including expired ones not yet swept */
+  [[nodiscard]] size_type size() const;
+
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+  /** Sets the time to live of a live element, zero for none */
+  void expire(key_type key, std::chrono::milliseconds ttl);
+
+  /** Erases the elements due now, in batches, returning how many */
+  size_type sweep();
+
+ private:
+  using instant = std::uint64_t; /** Milliseconds since the epoch */
+  static constexpr instant never = 0;
+
+  [[nodiscard]] instant now() const;
+  [[nodiscard]] instant deadline(std::chrono::milliseconds ttl) const;
+
+  /** Prefixes value with its expiry time */
+  [[nodiscard]] static std::string encode(instant expiry,
+                                          std::string_view value);
+
+  /** Returns the expiry time of a stored value */
+  [[nodiscard]] static instant expiry(std::string_view stored);
+
+  [[nodiscard]] static bool expired(std::string_view stored, instant time);
+
+  /** Erases one batch of due elements, returning how many */
+  size_type sweep(instant time, bool& more);
+
+  void work();
+  void check() const;
+
+  std::unique_ptr<client> store_;
+  client::iterator store_end_; /** Compared against, never moved */
+  std::chrono::milliseconds default_ttl_;
+  std::size_t batch_size_;
+  std::chrono::milliseconds max_pause_;
+  std::chrono::milliseconds interval_;
+  expiring_configuration::clock clock_;
+
+  std::mutex mutex_; /** Serialises writes and guards the index */
+  std::set<std::pair<instant, std::string>> index_;
+  std::condition_variable changed_;
+  bool stop_ = false;
+  std::exception_ptr error_; /** Failure of the sweeper */
+  std::thread worker_;
+};
+
+/** Position of a live element, as of the time the cursor was created */
+class expiring::cursor {
+ public:
+  /** Keys come from an iterator of any client */
+  static constexpr bool transient_keys = true;
+
+  /** So do values */
+  static constexpr bool transient_values = true;
+
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class expiring;
+
+ private:
+  cursor(const expiring* owner, client::iterator position, instant time);
+
+  [[nodiscard]] bool end() const;
+
+  /** Moves forwards past expired elements */
+  void skip();
+
+  const expiring* owner_ = nullptr;
+  client::iterator position_;
+  instant time_ = never;
+};
+
+}  // namespace datastore::clients::detail
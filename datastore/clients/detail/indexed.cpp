@@ -0,0 +1,340 @@
+#include "indexed.h"
+#include <datastore/clients/detail/coding.h>
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace datastore::clients::detail {
+
+namespace {
+
+/** Records read and entries written per write while building an index */
+constexpr std::size_t build_batch = 1024;
+
+std::unique_ptr<client> require(std::unique_ptr<client> store) {
+  if (store == nullptr) {
+    throw std::invalid_argument("indexes require a store");
+  }
+  return store;
+}
+
+bool starts_with(std::string_view key, std::string_view prefix) {
+  return key.substr(0, prefix.size()) == prefix;
+}
+
+}  // namespace
+
+indexed::indexed(std::unique_ptr<client> store)
+    : store_(require(std::move(store))), store_end_(store_->end()) {
+  auto count = size_type{0};
+  for (auto it = store_->lower_bound(reserved_prefix);
+       it != store_end_ && reserved(it->first); ++it) {
+    if (marker(it->first)) {
+      unadded_.emplace_back(it->first);
+    }
+    ++count;
+  }
+  reserved_ = count;
+}
+
+indexed::cursor indexed::first() const {
+  return cursor(this, store_->begin());
+}
+
+indexed::cursor indexed::last() const { return cursor(this, store_->end()); }
+
+indexed::cursor indexed::lookup(key_type key) const {
+  if (reserved(key)) {
+    return last();
+  }
+  return cursor(this, store_->find(key));
+}
+
+indexed::cursor indexed::lower_bound(key_type key) const {
+  return cursor(this, store_->lower_bound(key));
+}
+
+indexed::cursor indexed::insert_or_assign(indexed::cursor,
+                                          const value_type& value) {
+  write(batch().put(value.first, value.second));
+  return cursor(this, store_->find(value.first));
+}
+
+indexed::cursor indexed::erase(indexed::cursor pos) {
+  auto key = std::string(pos.key());
+  write(batch().erase(key));
+  return lower_bound(key);
+}
+
+void indexed::write(const batch& operations) {
+  for (const auto& operation : operations) {
+    check(operation.key);
+  }
+  std::lock_guard lock(mutex_);
+  if (indexes_.empty() && unadded_.empty()) {
+    store_->write(operations);
+    return;
+  }
+  batch stored;
+  for (const auto& mark : unadded_) {
+    stored.erase(mark);
+  }
+  auto added = size_type{0};
+  auto erased = size_type{0};
+  // Values as of the operations before, for keys written more than once
+  std::unordered_map<std::string, std::optional<std::string>> written;
+  for (const auto& operation : operations) {
+    std::optional<std::string> previous;
+    if (auto found = written.find(operation.key); found != written.end()) {
+      previous = found->second;
+    } else if (auto it = store_->find(operation.key); it != store_end_) {
+      previous = std::string(it->second);
+    }
+    std::optional<std::string> next;
+    if (operation.type == batch::kind::put) {
+      next = operation.value;
+    }
+    for (const auto& index : indexes_) {
+      auto before = previous ? index.extract(operation.key, *previous)
+                             : std::nullopt;
+      auto after =
+          next ? index.extract(operation.key, *next) : std::nullopt;
+      if (before == after) {
+        continue;
+      }
+      if (before) {
+        stored.erase(entry(index.prefix, *before, operation.key));
+        ++erased;
+      }
+      if (after) {
+        stored.put(entry(index.prefix, *after, operation.key), {});
+        ++added;
+      }
+    }
+    if (next) {
+      stored.put(operation.key, *next);
+    } else {
+      stored.erase(operation.key);
+    }
+    written[operation.key] = std::move(next);
+  }
+  store_->write(stored);
+  reserved_ += added;
+  reserved_ -= erased + unadded_.size();
+  unadded_.clear();
+}
+
+client::size_type indexed::size() const {
+  return store_->size() - reserved_;
+}
+
+client::size_type indexed::capacity() const { return store_->max_size(); }
+
+void indexed::clear() {
+  std::lock_guard lock(mutex_);
+  store_->clear();
+  unadded_.clear();
+  batch built;
+  for (const auto& index : indexes_) {
+    built.put(index.prefix, {});
+  }
+  store_->write(built);
+  reserved_ = indexes_.size();
+}
+
+void indexed::add_index(std::string_view name, index_extractor extract,
+                        bool rebuild) {
+  auto prefix = indexed::prefix(name);
+  std::lock_guard lock(mutex_);
+  for (const auto& index : indexes_) {
+    if (index.prefix == prefix) {
+      throw std::invalid_argument("index already added");
+    }
+  }
+  unadded_.erase(std::remove(unadded_.begin(), unadded_.end(), prefix),
+                 unadded_.end());
+  if (rebuild || store_->find(prefix) == store_end_) {
+    // Entries of an interrupted or outdated build go first
+    reserved_ -= erase_prefix(prefix);
+    // Records are read a batch at a time, as some stores do not allow
+    // writes while they are iterated
+    auto resume = std::string();
+    auto more = true;
+    while (more) {
+      batch entries;
+      auto records = std::size_t{0};
+      auto it = first();
+      if (!resume.empty()) {
+        it = lower_bound(resume);
+      }
+      for (auto end = last(); it != end && records < build_batch;
+           it.increment(), ++records) {
+        if (auto key = extract(it.key(), it.value())) {
+          entries.put(entry(prefix, *key, it.key()), {});
+        }
+        resume.assign(it.key());
+        resume.push_back('\0');
+      }
+      more = records == build_batch;
+      store_->write(entries);
+      reserved_ += entries.size();
+    }
+    // Marked last, so that an interrupted build is started again
+    store_->write(batch().put(prefix, {}));
+    ++reserved_;
+  }
+  indexes_.push_back({std::move(prefix), std::move(extract)});
+}
+
+void indexed::scan(std::string_view name, std::string_view from,
+                   std::string_view to,
+                   const std::function<void(const client::chunk&)>& function,
+                   size_type max_items, bool join) const {
+  auto prefix = indexed::prefix(name);
+  auto end = to.empty() ? datastore::detail::prefix_end(prefix).value_or("")
+                        : entry(prefix, to, {});
+  client::chunk values;
+  auto index_key = std::string();
+  auto primary_key = std::string_view();
+  for (auto it = store_->lower_bound(entry(prefix, from, {}));
+       it != store_end_ && starts_with(it->first, prefix) &&
+       (end.empty() || it->first < end);
+       ++it) {
+    parse(it->first.substr(prefix.size()), index_key, primary_key);
+    if (!join) {
+      values.push_back_copy(value_type(index_key, primary_key), true);
+    } else if (auto record = store_->find(primary_key);
+               record != store_end_) {
+      values.push_back_copy(*record, true);
+    }
+    if (values.size() >= max_items) {
+      function(values);
+      values.clear();
+    }
+  }
+  if (!values.empty()) {
+    function(values);
+  }
+}
+
+std::string indexed::prefix(std::string_view name) {
+  auto result = std::string(reserved_prefix);
+  put_length_prefixed(result, name);
+  return result;
+}
+
+std::string indexed::entry(std::string_view prefix, std::string_view index_key,
+                           std::string_view primary_key) {
+  auto result = std::string(prefix);
+  result.reserve(prefix.size() + index_key.size() + primary_key.size() + 2);
+  for (auto c : index_key) {
+    result.push_back(c);
+    if (c == '\0') {
+      result.push_back('\xff');
+    }
+  }
+  result.append(2, '\0');
+  result.append(primary_key);
+  return result;
+}
+
+void indexed::parse(std::string_view entry, std::string& index_key,
+                    std::string_view& primary_key) {
+  index_key.clear();
+  for (std::size_t i = 0; i < entry.size(); ++i) {
+    if (entry[i] != '\0') {
+      index_key.push_back(entry[i]);
+    } else if (i + 1 < entry.size() && entry[i + 1] == '\xff') {
+      index_key.push_back('\0');
+      ++i;
+    } else if (i + 1 < entry.size() && entry[i + 1] == '\0') {
+      primary_key = entry.substr(i + 2);
+      return;
+    } else {
+      break;
+    }
+  }
+  throw std::runtime_error("index entry is corrupt");
+}
+
+void indexed::check(key_type key) {
+  if (reserved(key)) {
+    throw std::invalid_argument("key is reserved for indexes");
+  }
+}
+
+bool indexed::reserved(key_type key) {
+  return starts_with(key, reserved_prefix);
+}
+
+bool indexed::marker(key_type key) {
+  auto name = std::string_view();
+  key.remove_prefix(reserved_prefix.size());
+  return get_length_prefixed(key, name) && key.empty();
+}
+
+client::size_type indexed::erase_prefix(std::string_view prefix) {
+  auto result = size_type{0};
+  auto more = true;
+  while (more) {
+    batch erasures;
+    for (auto it = store_->lower_bound(prefix);
+         it != store_end_ && starts_with(it->first, prefix) &&
+         erasures.size() < build_batch;
+         ++it) {
+      erasures.erase(it->first);
+    }
+    more = erasures.size() == build_batch;
+    store_->write(erasures);
+    result += erasures.size();
+  }
+  return result;
+}
+
+indexed::cursor::cursor(const indexed* owner, client::iterator position)
+    : owner_(owner), position_(std::move(position)) {
+  skip();
+}
+
+std::string_view indexed::cursor::key() const { return position_->first; }
+
+std::string_view indexed::cursor::value() const {
+  return position_->second;
+}
+
+void indexed::cursor::increment() {
+  ++position_;
+  skip();
+}
+
+void indexed::cursor::decrement() {
+  --position_;
+  if (!end() && reserved(position_->first)) {
+    position_ = owner_->store_->lower_bound(reserved_prefix);
+    --position_;
+  }
+}
+
+bool indexed::cursor::operator==(const cursor& rhs) const {
+  return position_ == rhs.position_;
+}
+
+bool indexed::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+bool indexed::cursor::end() const {
+  return position_ == owner_->store_end_;
+}
+
+void indexed::cursor::skip() {
+  if (!end() && reserved(position_->first)) {
+    // Every reserved key shares the prefix, so they are all together
+    if (auto next = datastore::detail::prefix_end(reserved_prefix)) {
+      position_ = owner_->store_->lower_bound(*next);
+    }
+  }
+}
+
+}  // namespace datastore::clients::detail
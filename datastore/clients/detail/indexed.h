@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <datastore/client.h>
+#include <datastore/clients/indexed.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** Secondary indexes kept in the store of the records they index
+ *
+ * The entries of an index are keys under a reserved prefix and the length
+ * prefixed name of the index: the index key, escaped so that it orders as
+ * it would alone and ends with two zero bytes, then the primary key. The
+ * prefix alone marks the index as built. Writes are serialised, as they
+ * read the values they replace to erase their entries. The first write
+ * erases the marks of the indexes built before but not added, which would
+ * miss it, so that adding them builds them again.
+ */
+class indexed {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Prefix of every key of every index, which records may not use */
+  static constexpr std::string_view reserved_prefix =
+      "\xff"
+      "datastore.index";
+
+  /** Counts the entries of the indexes of store, and finds those built */
+  explicit indexed(std::unique_ptr<client> store);
+
+  indexed(const indexed&) = delete;
+  indexed& operator=(const indexed&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+
+  /** Writes the batch and the changes to the indexes in one write */
+  void write(const batch& operations);
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+
+  /** Erases every record, leaving the indexes empty */
+  void clear();
+
+  /** Registers an index, building it unless it was built before */
+  void add_index(std::string_view name, index_extractor extract,
+                 bool rebuild);
+
+  /** Calls function with chunks of the entries of an index in
+   * [from, to), as index and primary keys, or as records if join */
+  void scan(std::string_view name, std::string_view from, std::string_view to,
+            const std::function<void(const client::chunk&)>& function,
+            size_type max_items, bool join) const;
+
+ private:
+  struct index {
+    std::string prefix;
+    index_extractor extract;
+  };
+
+  /** Returns the prefix of the entries of the named index */
+  [[nodiscard]] static std::string prefix(std::string_view name);
+
+  /** Returns the key of the entry of a record in an index */
+  [[nodiscard]] static std::string entry(std::string_view prefix,
+                                         std::string_view index_key,
+                                         std::string_view primary_key);
+
+  /** Splits the part of an entry after its prefix into its index key, which
+   * is unescaped, and its primary key */
+  static void parse(std::string_view entry, std::string& index_key,
+                    std::string_view& primary_key);
+
+  /** Throws std::invalid_argument for reserved keys */
+  static void check(key_type key);
+
+  [[nodiscard]] static bool reserved(key_type key);
+
+  /** Returns whether a reserved key marks an index as built */
+  [[nodiscard]] static bool marker(key_type key);
+
+  /** Erases every key starting with prefix, returning how many */
+  size_type erase_prefix(std::string_view prefix);
+
+  std::unique_ptr<client> store_;
+  client::iterator store_end_; /** Compared against, never moved */
+  std::vector<index> indexes_;
+  std::vector<std::string> unadded_; /** Marks of indexes not added */
+  std::atomic<size_type> reserved_{0}; /** Keys under the reserved prefix */
+  std::mutex mutex_; /** Serialises writes, and guards indexes_ */
+};
+
+/** Position of a record, skipping the entries of the indexes */
+class indexed::cursor {
+ public:
+  /** Keys come from an iterator of any client */
+  static constexpr bool transient_keys = true;
+
+  /** Values come from an iterator of any client */
+  static constexpr bool transient_values = true;
+
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class indexed;
+
+ private:
+  cursor(const indexed* owner, client::iterator position);
+
+  [[nodiscard]] bool end() const;
+
+  /** Moves forwards past the reserved keys */
+  void skip();
+
+  const indexed* owner_ = nullptr;
+  client::iterator position_;
+};
+
+}  // namespace datastore::clients::detail
@@ -1,8 +1,29 @@
 #include "lmdb.h"
+#include <datastore/clients/detail/coding.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 #include <utility>
 
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace {
 void call(int status) {
   std::string message = mdb_strerror(status);
@@ -67,51 +88,356 @@ void call(int status) {
       throw std::runtime_error(message);
   }
 }
+
+/** LMDB comparators are bare function pointers with no user data, so each
+ * installed key_compare is bound to its own slot trampoline. */
+constexpr std::size_t max_comparators = 16;
+std::array<datastore::key_compare, max_comparators> comparators{};
+std::mutex comparators_mutex;
+
+template <std::size_t I>
+int compare_slot(const MDB_val* lhs, const MDB_val* rhs) {
+  return comparators[I](
+      std::string_view(static_cast<const char*>(lhs->mv_data), lhs->mv_size),
+      std::string_view(static_cast<const char*>(rhs->mv_data), rhs->mv_size));
+}
+
+template <std::size_t... I>
+constexpr std::array<MDB_cmp_func*, sizeof...(I)> make_slots(
+    std::index_sequence<I...>) {
+  return {&compare_slot<I>...};
+}
+
+constexpr auto slots = make_slots(std::make_index_sequence<max_comparators>{});
+
+MDB_cmp_func* install(datastore::key_compare compare) {
+  std::lock_guard<std::mutex> lock(comparators_mutex);
+  for (std::size_t i = 0; i < max_comparators; ++i) {
+    if (comparators[i] == nullptr) {
+      comparators[i] = compare;
+    }
+    if (comparators[i] == compare) {
+      return slots[i];
+    }
+  }
+  throw std::length_error("too many distinct key comparators");
+}
+
+/** Seeks made to take a sample, and elements walked from a key to count
+ * the elements up to the next */
+constexpr std::size_t sample_seeks = 1024;
+constexpr std::size_t sample_probe = 32;
+
+/** Bounds the seeks made to read the branch pages of a tree */
+constexpr std::size_t max_probes = 1 << 20;
+
+constexpr auto data_file = "data.mdb";
+constexpr auto filter_file = "datastore.filter";
+
+/** Named databases of an environment with a change log, which keeps the
+ * elements out of the main database where LMDB lists the named ones */
+constexpr auto data_database = "datastore.data";
+constexpr auto changes_database = "datastore.changes";
+
+std::size_t page_size() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/** Asks for the pages holding data to be read in, unless they are within
+ * [advised_begin, advised_end), the pages asked for last */
+void advise(std::string_view data, std::size_t page_size,
+            std::uintptr_t& advised_begin, std::uintptr_t& advised_end) {
+  auto begin = reinterpret_cast<std::uintptr_t>(data.data());
+  auto end = begin + data.size();
+  begin &= ~(page_size - 1);
+  if (data.empty() || (begin >= advised_begin && end <= advised_end)) {
+    return;
+  }
+  end = (end + page_size - 1) & ~(page_size - 1);
+#ifdef _WIN32
+  // Touching a byte of each page faults it in on this thread instead
+  for (auto page = begin; page < end; page += page_size) {
+    static_cast<void>(*reinterpret_cast<const volatile char*>(
+        std::max(page, reinterpret_cast<std::uintptr_t>(data.data()))));
+  }
+#else
+  ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+#endif
+  advised_begin = begin;
+  advised_end = end;
+}
+
+/** Returns a key ordered halfway between lo and hi, byte-wise, of at most
+ * max_size bytes */
+std::string midpoint(std::string_view lo, std::string_view hi,
+                     std::size_t max_size) {
+  auto size = std::min(std::max(lo.size(), hi.size()) + 1, max_size);
+  auto digit = [](std::string_view key, std::size_t i) -> unsigned int {
+    return i < key.size() ? static_cast<unsigned char>(key[i]) : 0;
+  };
+  // Adds the keys as fractions in base 256, then halves the sum
+  auto sum = std::vector<unsigned int>(size);
+  auto carry = 0u;
+  for (auto i = size; i-- > 0;) {
+    sum[i] = digit(lo, i) + digit(hi, i) + carry;
+    carry = sum[i] >> 8;
+    sum[i] &= 0xff;
+  }
+  auto result = std::string(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    auto value = (carry << 8) | sum[i];
+    result[i] = static_cast<char>(value >> 1);
+    carry = value & 1;
+  }
+  return result;
+}
+
+/** Calls function on threads threads, this one among them, rethrowing the
+ * first exception once they all return */
+void run(unsigned int threads, const std::function<void()>& function) {
+  std::exception_ptr failure;
+  std::mutex mutex;
+  auto guarded = [&] {
+    try {
+      function();
+    } catch (...) {
+      std::lock_guard lock(mutex);
+      if (!failure) {
+        failure = std::current_exception();
+      }
+    }
+  };
+  auto workers = std::vector<std::thread>();
+  for (auto i = 1u; i < threads; ++i) {
+    workers.emplace_back(guarded);
+  }
+  guarded();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+/** Writes all of data to fd, returning 0 or the error number */
+int write_all(int fd, const char* data, std::size_t size) {
+  while (size != 0) {
+#ifdef _WIN32
+    auto written = ::_write(fd, data, static_cast<unsigned int>(size));
+#else
+    auto written = ::write(fd, data, size);
+#endif
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    }
+    data += written;
+    size -= written;
+  }
+  return 0;
+}
+
+bool sync(std::FILE* file) {
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return ::fsync(fileno(file)) == 0;
+#endif
+}
+
+/** Encodes a sequence so that byte order is numeric order */
+std::string encode_sequence(std::uint64_t sequence) {
+  auto result = std::string(sizeof(sequence), '\0');
+  for (auto i = result.rbegin(); i != result.rend(); ++i, sequence >>= 8) {
+    *i = static_cast<char>(sequence & 0xff);
+  }
+  return result;
+}
+
+std::uint64_t decode_sequence(std::string_view key) {
+  auto result = std::uint64_t{0};
+  for (auto byte : key) {
+    result = result << 8 | static_cast<unsigned char>(byte);
+  }
+  return result;
+}
+
+constexpr char cleared_flag = 1;
+constexpr char continued_flag = 2;
+
+/** Encodes a change as flags, a count, then each kind, key and value */
+std::string encode_change(bool cleared, const datastore::batch& writes) {
+  using namespace datastore::clients::detail;
+  auto result = std::string(1, cleared ? cleared_flag : '\0');
+  put_varint(result, writes.size());
+  for (const auto& operation : writes) {
+    auto put = operation.type == datastore::batch::kind::put;
+    result.push_back(put ? 'p' : 'e');
+    put_length_prefixed(result, operation.key);
+    if (put) {
+      put_length_prefixed(result, operation.value);
+    }
+  }
+  return result;
+}
+
+datastore::change decode_change(std::string_view key, std::string_view value) {
+  using namespace datastore::clients::detail;
+  auto result = datastore::change{decode_sequence(key), false, false, {}};
+  auto count = std::uint64_t{0};
+  const char* position = nullptr;
+  if (!value.empty()) {
+    result.cleared = (value.front() & cleared_flag) != 0;
+    result.continued = (value.front() & continued_flag) != 0;
+    position = get_varint(value.data() + 1, value.data() + value.size(), count);
+  }
+  if (position == nullptr) {
+    throw std::runtime_error("corrupt change log");
+  }
+  value.remove_prefix(position - value.data());
+  for (; count != 0; --count) {
+    std::string_view written, mapped;
+    if (value.empty()) {
+      throw std::runtime_error("corrupt change log");
+    }
+    auto put = value.front() == 'p';
+    value.remove_prefix(1);
+    if (!get_length_prefixed(value, written) ||
+        (put && !get_length_prefixed(value, mapped))) {
+      throw std::runtime_error("corrupt change log");
+    }
+    if (put) {
+      result.writes.put(written, mapped);
+    } else {
+      result.writes.erase(written);
+    }
+  }
+  return result;
+}
 }  // namespace
 
 namespace datastore::clients::detail {
 
 /** lmdb **********************************************************/
 
-lmdb::lmdb(const lmdb_configuration& config) : env_(config.path()), db_(env_) {
+lmdb::lmdb(const lmdb_configuration& config)
+    : env_(config.path()),
+      db_(env_, config.change_log() ? data_database : std::string_view(),
+          config.compare(), config.change_log()),
+      change_log_(config.change_log()),
+      changes_(change_log_ ? database(env_, changes_database, nullptr, true)
+                           : database()),
+      filter_path_(config.path() / filter_file),
+      data_path_(config.path() / data_file),
+      filter_bits_per_key_(config.filter_bits_per_key()),
+      stale_reader_policy_(config.stale_reader_policy()),
+      max_reader_age_(config.max_reader_age()),
+      stale_reader_callback_(config.stale_reader_callback()),
+      reader_check_interval_(config.reader_check_interval()) {
   // TODO check if the file exists, if not pass MDB_CREATE as a flag
+  if (filter_bits_per_key_ != 0) {
+    auto txnid = last_txnid();
+    std::shared_ptr<bloom> filter =
+        bloom::load(filter_path_, txnid, filter_bits_per_key_);
+    auto txn = std::make_shared<transaction>(env_);
+    MDB_stat stat;
+    {
+      transaction::guard use(txn.get());
+      call(mdb_stat(*txn, db_, &stat));
+    }
+    if (!filter) {
+      filter = build_filter(txn, stat.ms_entries);
+      txnid = txn->id();
+    }
+    // A saved filter holds at least the keys there are
+    filter_keys_ = stat.ms_entries;
+    seen_txnid_ = txnid;
+    publish_filter(std::move(filter), txnid);
+  }
+  if (!stale_reader_callback_) {
+    auto invalidate = stale_reader_policy_ == reader_policy::invalidate;
+    stale_reader_callback_ = [invalidate](const reader_info& reader) {
+      std::cerr << "datastore: lmdb read transaction of snapshot "
+                << reader.snapshot << " open for "
+                << std::chrono::duration<double>(reader.age).count() << "s"
+                << (reader.origin.empty() ? "" : " by " + reader.origin)
+                << (invalidate ? ", invalidated" : "") << std::endl;
+    };
+  }
+  if (reader_check_interval_.count() > 0) {
+    checker_ = std::thread([this] { check_periodically(); });
+  }
 }
 
-std::unique_ptr<client::cursor> lmdb::first() const {
-  auto txn = std::make_shared<transaction>(env_);
-  auto result = std::make_unique<cursor>(db_, txn);
+lmdb::~lmdb() {
+  if (checker_.joinable()) {
+    {
+      std::lock_guard lock(checker_mutex_);
+      stop_ = true;
+    }
+    checker_changed_.notify_all();
+    checker_.join();
+  }
+  closing_ = true;
+  if (rebuilder_.joinable()) {
+    rebuilder_.join();
+  }
+  auto state = std::atomic_load(&filter_);
+  if (state) {
+    try {
+      auto txnid = last_txnid();
+      if (txnid == state->txnid) {
+        state->filter->save(filter_path_, txnid);
+      } else {
+        // Stale filters are rebuilt on the next open
+        std::filesystem::remove(filter_path_);
+      }
+    } catch (std::exception&) {
+    }
+  }
+}
+
+lmdb::cursor lmdb::first() const {
+  auto result = cursor(db_);
   try {
-    result->first();
-    return result;
+    result.first();
   } catch (std::out_of_range&) {
-    return last();
+    result.seek_end();
   }
+  return result;
 }
 
-std::unique_ptr<client::cursor> lmdb::last() const {
-  return std::make_unique<lmdb::cursor>();
-}
+lmdb::cursor lmdb::last() const { return cursor::end(db_); }
 
-std::unique_ptr<client::cursor> lmdb::insert_or_assign(
-    std::unique_ptr<client::cursor> pos, const client::value_type& value) {
-  {
-    auto cursor = lmdb::cursor{db_, std::make_shared<transaction>(env_, false)};
+lmdb::cursor lmdb::insert_or_assign(lmdb::cursor, const value_type& value) {
+  transact([&](const std::shared_ptr<transaction>& txn) {
+    auto cursor = lmdb::cursor{db_, txn};
     cursor.put(value);
-    cursor.transaction()->commit();
-  }
-  auto cursor = dynamic_cast<lmdb::cursor*>(pos.get());
-  if (!cursor || *cursor == lmdb::cursor::default_instance()) {
-    pos = std::make_unique<lmdb::cursor>(db_);
-    cursor = dynamic_cast<lmdb::cursor*>(pos.get());
-  }
-  cursor->seek(value.first);
-  return pos;
+    remember(value.first);
+    if (change_log_) {
+      record(txn, false, batch().put(value.first, value.second));
+    }
+  });
+  ++writes_;
+  return lookup(value.first);
 }
 
-std::unique_ptr<client::cursor> lmdb::lookup(client::key_type key) const {
+lmdb::cursor lmdb::lookup(key_type key) const {
+  if (absent(key)) {
+    return last();
+  }
   try {
-    auto result = std::make_unique<cursor>(db_);
-    result->seek(key);
+    auto result = cursor(db_);
+    result.seek(key);
     return result;
   } catch (std::out_of_range&) {
     return last();
@@ -120,23 +446,433 @@ std::unique_ptr<client::cursor> lmdb::lookup(client::key_type key) const {
   }
 }
 
-std::unique_ptr<client::cursor> lmdb::erase(
-    std::unique_ptr<client::cursor> pos) {
-  auto key = pos->key();
+lmdb::cursor lmdb::lower_bound(key_type key) const {
+  auto result = cursor(db_);
   try {
-    pos->increment();
+    result.seek_range(key);
   } catch (std::out_of_range&) {
-    pos = last();
+    // Stepping back from here stays within the snapshot
+    result.seek_end();
   }
-  {
-    lmdb::cursor cur{db_, std::make_shared<transaction>(env_, false)};
+  return result;
+}
+
+lmdb::cursor lmdb::erase(lmdb::cursor pos) {
+  // The key refers to the snapshot of pos, which is released at the end
+  auto key = std::string(pos.key());
+  pos.increment();
+  transact([&](const std::shared_ptr<transaction>& txn) {
+    lmdb::cursor cur{db_, txn};
     cur.seek(key);
     cur.erase();
-    cur.transaction()->commit();
-  }
+    ++filter_erased_;
+    if (change_log_) {
+      record(txn, false, batch().erase(key));
+    }
+  });
+  ++writes_;
   return pos;
 }
 
+lmdb::cursor lmdb::read_ahead(key_type from, std::size_t window) const {
+  // LMDB rejects empty keys, even to seek
+  auto result = from.empty() ? first() : lower_bound(from);
+  if (result != last()) {
+    result.read_ahead(
+        std::make_shared<prefetcher>(db_, std::string(result.key()), window));
+  }
+  return result;
+}
+
+void lmdb::write(const batch& operations) {
+  auto written = size_type{0};
+  transact([&](const std::shared_ptr<transaction>& txn) {
+    auto cursor = lmdb::cursor{db_, txn};
+    // Merges read the values they combine with in this transaction
+    auto resolved = batch();
+    if (operations.merges()) {
+      resolved = operations.resolve_merges(
+          [&](std::string_view key) -> std::optional<std::string> {
+            auto reader = lmdb::cursor{db_, txn};
+            try {
+              reader.seek(key);
+              return std::string(reader.value());
+            } catch (std::out_of_range&) {
+              return std::nullopt;
+            }
+          });
+    }
+    written = apply(txn, operations.merges() ? resolved : operations);
+  });
+  writes_ += written;
+}
+
+lmdb::size_type lmdb::apply(const std::shared_ptr<transaction>& txn,
+                            const batch& writes) {
+  auto cursor = lmdb::cursor{db_, txn};
+  auto append = appendable(txn, writes);
+  for (const auto& operation : writes) {
+    if (operation.type == batch::kind::put) {
+      cursor.put({operation.key, operation.value}, append);
+      remember(operation.key);
+      continue;
+    }
+    try {
+      cursor.seek(operation.key);
+      cursor.erase();
+      ++filter_erased_;
+    } catch (std::out_of_range&) {
+    }
+  }
+  record(txn, false, writes);
+  return writes.size();
+}
+
+std::unique_ptr<blob_writer> lmdb::open_blob_writer(key_type key,
+                                                    bool append,
+                                                    size_type chunk_size) {
+  // Releases the thread however the transaction ends, unless it was
+  // committed or aborted, after which another writer may hold it
+  auto scope = std::shared_ptr<write_scope>(
+      new write_scope(begin_write()), [this](write_scope* scope) {
+        if (scope->txn) {
+          blob_thread_ = std::thread::id();
+        }
+        delete scope;
+      });
+  blob_thread_ = std::this_thread::get_id();
+  auto store = datastore::detail::blob_store();
+  store.read = [this, scope](std::string_view key)
+      -> std::optional<std::string> {
+    auto cursor = lmdb::cursor{db_, scope->txn};
+    try {
+      cursor.seek(key);
+      return std::string(cursor.value());
+    } catch (std::out_of_range&) {
+      return std::nullopt;
+    }
+  };
+  store.write = [this, scope](const batch& writes) {
+    writes_ += apply(scope->txn, writes);
+  };
+  store.commit = [this, scope] {
+    commit(*scope);
+    scope->txn.reset();
+    blob_thread_ = std::thread::id();
+  };
+  store.abort = [this, scope] {
+    scope->txn->abort();
+    scope->txn.reset();
+    scope->lock = {};
+    blob_thread_ = std::thread::id();
+  };
+  return std::make_unique<blob_writer>(std::move(store), key, append,
+                                       chunk_size);
+}
+
+std::unique_ptr<blob_reader> lmdb::open_blob_reader(
+    key_type key, std::uint64_t offset) const {
+  // Every chunk is read from the snapshot the manifest was read from
+  auto position =
+      std::make_shared<cursor>(db_, std::make_shared<transaction>(env_));
+  try {
+    position->seek(key);
+  } catch (std::invalid_argument&) {
+    throw std::out_of_range("key not found");
+  }
+  auto read = [position](std::string_view key, std::size_t offset,
+                         char* data, std::size_t size) -> std::size_t {
+    try {
+      position->seek(key);
+    } catch (std::out_of_range&) {
+      return 0;
+    }
+    // Copied from the map, so only the pages of the range are touched
+    auto value = position->value();
+    if (offset >= value.size()) {
+      return 0;
+    }
+    auto count = std::min(size, value.size() - offset);
+    std::memcpy(data, value.data() + offset, count);
+    return count;
+  };
+  return std::make_unique<blob_reader>(key, position->value(), offset,
+                                       std::move(read));
+}
+
+std::optional<std::string> lmdb::update(
+    key_type key, const client::update_function& function) {
+  auto result = std::optional<std::string>();
+  auto written = false;
+  transact([&](const std::shared_ptr<transaction>& txn) {
+    auto cursor = lmdb::cursor{db_, txn};
+    auto current = std::optional<mapped_type>();
+    try {
+      cursor.seek(key);
+      current = cursor.value();
+    } catch (std::out_of_range&) {
+    }
+    result = function(current);
+    if (result == current) {
+      return false;
+    }
+    if (result) {
+      cursor.put({key, *result});
+      remember(key);
+    } else {
+      cursor.erase();
+      ++filter_erased_;
+    }
+    if (change_log_) {
+      record(txn, false,
+             result ? batch().put(key, *result) : batch().erase(key));
+    }
+    written = true;
+    return true;
+  });
+  if (written) {
+    ++writes_;
+  }
+  return result;
+}
+
+warm_up_report lmdb::warm_up(const warm_up_policy& policy) const {
+  auto start = std::chrono::steady_clock::now();
+  auto result = warm_up_report();
+  result.before = resident();
+  {
+    transaction txn(env_);
+    transaction::guard use(&txn);
+    MDB_stat stat;
+    call(mdb_stat(txn, db_, &stat));
+    result.branch_pages = stat.ms_branch_pages;
+  }
+  if (policy.branches()) {
+    // Seeks spread evenly over the keys pass through every page of the
+    // lowest branch level once there are as many; twice as many allow for
+    // keys spread unevenly over the key space
+    result.probes = probe_branches(
+        policy.threads(),
+        std::min(max_probes, 2 * std::max<size_type>(1, result.branch_pages)));
+  }
+  read_ranges(policy, result);
+  result.after = resident();
+  result.elapsed = std::chrono::steady_clock::now() - start;
+  return result;
+}
+
+residency lmdb::resident() const {
+  auto result = residency();
+  std::error_code error;
+  auto size = std::filesystem::file_size(data_path_, error);
+  if (error || size == 0) {
+    return result;
+  }
+  result.size = static_cast<std::size_t>(size);
+#ifndef _WIN32
+  auto fd = ::open(data_path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return result;
+  }
+  // Mappings of a file share its page cache, so this one sees LMDB's
+  auto map = ::mmap(nullptr, result.size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return result;
+  }
+  auto page = page_size();
+#ifdef __APPLE__
+  auto pages = std::vector<char>((result.size + page - 1) / page);
+#else
+  auto pages = std::vector<unsigned char>((result.size + page - 1) / page);
+#endif
+  if (::mincore(map, result.size, pages.data()) == 0) {
+    for (auto flags : pages) {
+      if ((flags & 1) != 0) {
+        result.resident += page;
+      }
+    }
+    result.resident = std::min(result.resident, result.size);
+  }
+  ::munmap(map, result.size);
+#endif
+  return result;
+}
+
+lmdb::size_type lmdb::probe_branches(unsigned int threads,
+                                     size_type limit) const {
+  auto txn = std::make_shared<transaction>(env_);
+  auto position = cursor(db_, txn);
+  try {
+    position.first();
+  } catch (std::out_of_range&) {
+    return 0;
+  }
+  // Bounds of the gaps, with the first key not ordered before each
+  auto bounds = std::vector<std::pair<std::string, std::string>>();
+  bounds.emplace_back(position.key(), position.key());
+  position.last();
+  bounds.emplace_back(position.key(), position.key());
+  auto probes = size_type{2};
+  auto max_key = static_cast<std::size_t>(mdb_env_get_maxkeysize(env_));
+  while (probes < limit) {
+    // Gaps are halved while keys are known to lie within them
+    auto points = std::vector<std::string>();
+    auto gaps = std::vector<std::size_t>();
+    for (std::size_t i = 0;
+         i + 1 < bounds.size() && probes + points.size() < limit; ++i) {
+      const auto& [lo, next] = bounds[i];
+      const auto& hi = bounds[i + 1].first;
+      if (compare(txn, next, hi) >= 0) {
+        continue;
+      }
+      auto point = midpoint(lo, hi, max_key);
+      if (compare(txn, lo, point) < 0 && compare(txn, point, hi) < 0) {
+        points.push_back(std::move(point));
+        gaps.push_back(i);
+      }
+    }
+    if (points.empty()) {
+      break;
+    }
+    auto found = std::vector<std::string>(points.size());
+    std::atomic<std::size_t> taken{0};
+    run(threads, [&] {
+      auto origin = reader_origin("warm up");
+      // Each thread reads from a transaction of its own
+      auto probe = cursor(db_);
+      for (std::size_t i; (i = taken++) < points.size();) {
+        try {
+          probe.seek_range(points[i]);
+          found[i] = probe.key();
+        } catch (std::out_of_range&) {
+          // The keys after were erased since; the gap is halved again
+          found[i] = points[i];
+        }
+      }
+    });
+    auto merged = std::vector<std::pair<std::string, std::string>>();
+    merged.reserve(bounds.size() + points.size());
+    for (std::size_t i = 0, j = 0; i < bounds.size(); ++i) {
+      merged.push_back(std::move(bounds[i]));
+      if (j < gaps.size() && gaps[j] == i) {
+        merged.emplace_back(std::move(points[j]), std::move(found[j]));
+        ++j;
+      }
+    }
+    bounds = std::move(merged);
+    probes += points.size();
+  }
+  return probes;
+}
+
+void lmdb::read_ranges(const warm_up_policy& policy,
+                       warm_up_report& report) const {
+  const auto& ranges = policy.ranges();
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<std::size_t> taken{0};
+  std::atomic<std::size_t> read{0};
+  std::atomic<std::size_t> elements{0};
+  std::atomic<std::size_t> bytes{0};
+  std::atomic<bool> exhausted{false};
+  run(policy.threads(), [&] {
+    auto origin = reader_origin("warm up");
+    auto page = page_size();
+    auto advised_begin = std::uintptr_t{0};
+    auto advised_end = std::uintptr_t{0};
+    for (std::size_t i; !exhausted && (i = taken++) < ranges.size();) {
+      const auto& [from, to] = ranges[i];
+      ++read;
+      auto end = last();
+      auto bound = to.empty() ? end : lower_bound(to);
+      for (auto position = from.empty() ? first() : lower_bound(from);
+           !(position == bound) && !(position == end); position.increment()) {
+        auto size = position.key().size() + position.value().size();
+        auto total = bytes.load();
+        do {
+          if (policy.max_bytes() != 0 && total + size > policy.max_bytes()) {
+            exhausted = true;
+            return;
+          }
+        } while (!bytes.compare_exchange_weak(total, total + size));
+        ::advise(position.key(), page, advised_begin, advised_end);
+        ::advise(position.value(), page, advised_begin, advised_end);
+        ++elements;
+        if (policy.bytes_per_second() != 0) {
+          std::this_thread::sleep_until(
+              start + std::chrono::duration_cast<
+                          std::chrono::steady_clock::duration>(
+                          std::chrono::duration<double>(
+                              static_cast<double>(total + size) /
+                              policy.bytes_per_second())));
+        }
+      }
+    }
+  });
+  report.ranges = read;
+  report.elements = elements;
+  report.bytes = bytes;
+}
+
+range_estimate lmdb::estimate(key_type from, key_type to) const {
+  auto txn = std::make_shared<transaction>(env_);
+  // Small ranges are counted exactly
+  auto result = range_estimate();
+  auto position = lmdb::cursor(db_, txn);
+  try {
+    if (from.empty()) {
+      position.first();
+    } else {
+      position.seek_range(from);
+    }
+  } catch (std::out_of_range&) {
+    return result;
+  }
+  for (; result.count <= sample_probe; position.increment()) {
+    if (position == last() ||
+        (!to.empty() && compare(txn, position.key(), to) >= 0)) {
+      return result;
+    }
+    ++result.count;
+    result.bytes += position.key().size() + position.value().size();
+  }
+  MDB_stat stat;
+  {
+    transaction::guard use(txn.get());
+    call(mdb_stat(*txn, db_, &stat));
+  }
+  auto stale = [&](const std::shared_ptr<const sample>& current) {
+    return !current || drift(*current, stat.ms_entries) > current->count / 8;
+  };
+  auto current = std::atomic_load(&sample_);
+  if (stale(current)) {
+    std::lock_guard lock(sample_mutex_);
+    current = std::atomic_load(&sample_);
+    if (stale(current)) {
+      current = take_sample(txn);
+      std::atomic_store(&sample_, current);
+    }
+  }
+  auto begin = from.empty() ? 0 : locate(txn, *current, from);
+  auto end = to.empty() ? current->bounds.size() : locate(txn, *current, to);
+  auto first =
+      begin == 0 ? range_estimate() : rank(txn, *current, from, begin);
+  auto last = to.empty() ? range_estimate{current->count,
+                                          current->bytes.back()}
+              : end == 0 ? range_estimate()
+                         : rank(txn, *current, to, end);
+  if (last.count < first.count) {
+    return {};
+  }
+  // The estimated gaps from that of from to that of to, or else the others,
+  // as the elements in all of them are known
+  const auto& spread = current->spread;
+  auto inside = spread[end] - spread[begin == 0 ? 0 : begin - 1];
+  return {last.count - first.count, last.bytes - first.bytes,
+          std::min(inside, spread.back() - inside) +
+              drift(*current, stat.ms_entries)};
+}
+
 client::size_type lmdb::capacity() const {
   MDB_envinfo envinfo;
   call(mdb_env_info(env_, &envinfo));
@@ -144,19 +880,699 @@ client::size_type lmdb::capacity() const {
 }
 
 client::size_type lmdb::size() const {
+  transaction txn(env_);
+  transaction::guard use(&txn);
   MDB_stat stat;
-  call(mdb_env_stat(env_, &stat));
+  call(mdb_stat(txn, db_, &stat));
   return stat.ms_entries;
 }
 
+void lmdb::clear() {
+  auto scope = begin_write();
+  call(mdb_drop(*scope.txn, db_, 0));
+  record(scope.txn, true, batch());
+  scope.cleared = true;
+  commit(scope);
+  std::atomic_store(&sample_, std::shared_ptr<const sample>());
+}
+
+std::vector<change> lmdb::changes(std::uint64_t from,
+                                  std::size_t limit) const {
+  if (!change_log_) {
+    throw std::invalid_argument("the change log is disabled");
+  }
+  auto result = std::vector<change>();
+  auto log = cursor(changes_);
+  try {
+    auto key = encode_sequence(from);
+    for (log.seek_range(key); log != last() && result.size() < limit;
+         log.increment()) {
+      result.push_back(decode_change(log.key(), log.value()));
+    }
+  } catch (std::out_of_range&) {
+  }
+  return result;
+}
+
+void lmdb::truncate_changes(std::uint64_t before) {
+  if (!change_log_) {
+    throw std::invalid_argument("the change log is disabled");
+  }
+  transact([&](const std::shared_ptr<transaction>& txn) {
+    auto log = cursor(changes_, txn);
+    try {
+      log.last();
+      before = std::min(before, decode_sequence(log.key()));
+      for (log.first(); decode_sequence(log.key()) < before;) {
+        auto key = std::string(log.key());
+        log.erase();
+        log.seek_range(key);
+      }
+    } catch (std::out_of_range&) {
+    }
+  });
+}
+
+backup_progress lmdb::backup(int fd,
+                             const backup_configuration& configuration) const {
+  auto flags = configuration.compact() ? MDB_CP_COMPACT : 0u;
+  auto progress = backup_progress();
+  {
+    MDB_envinfo envinfo;
+    MDB_stat stat;
+    call(mdb_env_info(env_, &envinfo));
+    call(mdb_env_stat(env_, &stat));
+    progress.estimate =
+        static_cast<std::uint64_t>(envinfo.me_last_pgno + 1) * stat.ms_psize;
+  }
+  auto start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+  // Without pipes, progress is only reported at the end
+  auto offset = ::_lseeki64(fd, 0, SEEK_CUR);
+  call(mdb_env_copyfd2(
+      env_, reinterpret_cast<mdb_filehandle_t>(::_get_osfhandle(fd)), flags));
+  progress.bytes = ::_lseeki64(fd, 0, SEEK_CUR) - offset;
+  progress.elapsed = std::chrono::steady_clock::now() - start;
+  if (configuration.progress()) {
+    configuration.progress()(progress);
+  }
+#else
+  int pipe[2];
+  if (::pipe(pipe) != 0) {
+    throw std::system_error(errno, std::generic_category(), "pipe");
+  }
+  auto status = MDB_SUCCESS;
+  auto copier = std::thread([&] {
+    status = mdb_env_copyfd2(env_, pipe[1], flags);
+    ::close(pipe[1]);
+  });
+  // The pipe is drained to the end whatever happens, so that the copier is
+  // never left blocked on it
+  auto error = 0;
+  std::exception_ptr failure;
+  auto buffer = std::vector<char>(1 << 20);
+  for (;;) {
+    auto size = ::read(pipe[0], buffer.data(), buffer.size());
+    if (size == 0) {
+      break;
+    }
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error = error == 0 ? errno : error;
+      break;
+    }
+    if (error != 0 || failure) {
+      continue;
+    }
+    error = write_all(fd, buffer.data(), size);
+    if (error != 0) {
+      continue;
+    }
+    progress.bytes += size;
+    progress.elapsed = std::chrono::steady_clock::now() - start;
+    if (configuration.progress()) {
+      try {
+        configuration.progress()(progress);
+      } catch (...) {
+        failure = std::current_exception();
+      }
+    }
+  }
+  ::close(pipe[0]);
+  copier.join();
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+  if (error != 0) {
+    throw std::system_error(error, std::generic_category(), "backup");
+  }
+  call(status);
+  progress.elapsed = std::chrono::steady_clock::now() - start;
+#endif
+  return progress;
+}
+
+backup_progress lmdb::backup(const std::filesystem::path& directory,
+                             const backup_configuration& configuration) const {
+  std::filesystem::create_directories(directory);
+  auto path = directory / data_file;
+  auto temporary = path;
+  temporary += ".tmp";
+  auto file = std::fopen(temporary.string().c_str(), "wb");
+  if (file == nullptr) {
+    throw std::filesystem::filesystem_error(
+        "unable to create backup", temporary,
+        std::error_code(errno, std::generic_category()));
+  }
+  backup_progress result;
+  try {
+#ifdef _WIN32
+    result = backup(_fileno(file), configuration);
+#else
+    result = backup(fileno(file), configuration);
+#endif
+    if (!sync(file)) {
+      throw std::filesystem::filesystem_error(
+          "unable to sync backup", temporary,
+          std::error_code(errno, std::generic_category()));
+    }
+  } catch (...) {
+    std::fclose(file);
+    std::filesystem::remove(temporary);
+    throw;
+  }
+  std::fclose(file);
+  std::filesystem::rename(temporary, path);
+  return result;
+}
+
+void lmdb::restore(const std::filesystem::path& backup,
+                   const std::filesystem::path& directory) {
+  std::filesystem::rename(backup / data_file, directory / data_file);
+  // The filter describes the data replaced
+  std::error_code error;
+  std::filesystem::remove(directory / filter_file, error);
+}
+
+bool lmdb::appendable(const std::shared_ptr<transaction>& txn,
+                      const batch& operations) const {
+  auto compare = [&](std::string_view lhs, std::string_view rhs) {
+    buffer left(lhs), right(rhs);
+    return mdb_cmp(*txn, db_, left, right);
+  };
+  const std::string* previous = nullptr;
+  for (const auto& operation : operations) {
+    if (operation.type != batch::kind::put ||
+        (previous && compare(*previous, operation.key) >= 0)) {
+      return false;
+    }
+    previous = &operation.key;
+  }
+  if (previous == nullptr) {
+    return false;
+  }
+  auto tail = lmdb::cursor{db_, txn};
+  try {
+    tail.last();
+  } catch (std::out_of_range&) {
+    return true;
+  }
+  return compare(tail.key(), operations.begin()->key) < 0;
+}
+
+void lmdb::record(const std::shared_ptr<transaction>& txn, bool cleared,
+                  const batch& writes) {
+  if (!change_log_) {
+    return;
+  }
+  auto log = cursor(changes_, txn);
+  auto sequence = std::uint64_t{1};
+  try {
+    log.last();
+    sequence = decode_sequence(log.key()) + 1;
+    // A transaction recording again continues its last change, unless that
+    // was rolled back with it and the id reused
+    if (txn->id() == recorded_.first && sequence - 1 == recorded_.second) {
+      auto last = std::string(log.value());
+      last.front() |= continued_flag;
+      log.put({encode_sequence(sequence - 1), last});
+    }
+  } catch (std::out_of_range&) {
+  }
+  auto key = encode_sequence(sequence);
+  log.put({key, encode_change(cleared, writes)});
+  recorded_ = {txn->id(), sequence};
+}
+
+lmdb::write_scope lmdb::begin_write() {
+  if (blob_thread_ == std::this_thread::get_id()) {
+    throw std::logic_error("a blob writer holds the write transaction");
+  }
+  auto result = write_scope();
+  result.lock = std::unique_lock<std::mutex>(write_mutex_, std::defer_lock);
+  if (filter_bits_per_key_ != 0) {
+    // Writers are serialized by LMDB anyway; this keeps the filter in step
+    result.lock.lock();
+  }
+  result.txn = std::make_shared<transaction>(env_, false);
+  result.id = result.txn->id();
+  if (filter_) {
+    if (result.id != seen_txnid_ + 1) {
+      foreign_txnid_ = result.id - 1;
+    }
+    // The filter misses writes since it was last brought up to date
+    result.stale = result.id != filter_->txnid + 1;
+  }
+  return result;
+}
+
+void lmdb::commit(write_scope& scope) {
+  scope.txn->commit();
+  if (filter_) {
+    seen_txnid_ = scope.id;
+    auto capacity = filter_->filter->capacity();
+    if (scope.cleared) {
+      filter_keys_ = filter_erased_ = 0;
+      publish_filter(std::make_shared<bloom>(1024, filter_bits_per_key_),
+                     scope.id);
+    } else if (scope.stale) {
+      // Bypassed until rebuilt, rather than scanned on every such write
+      publish_filter(filter_->filter, 0);
+      start_rebuild();
+    } else {
+      publish_filter(filter_->filter, scope.id);
+      if (filter_keys_ > capacity || filter_erased_ > capacity / 4) {
+        start_rebuild();
+      }
+    }
+  }
+  scope.lock = {};
+}
+
+template <typename Function>
+void lmdb::transact(Function&& function) {
+  auto scope = begin_write();
+  const auto& txn = scope.txn;
+  if constexpr (std::is_same_v<std::invoke_result_t<Function&,
+                                                    decltype(txn)&>,
+                               bool>) {
+    if (!function(txn)) {
+      // Nothing was written, so the filter is as up to date as it was
+      txn->abort();
+      return;
+    }
+  } else {
+    function(txn);
+  }
+  commit(scope);
+}
+
+bool lmdb::absent(key_type key) const {
+  if (filter_bits_per_key_ == 0) {
+    return false;
+  }
+  auto state = std::atomic_load(&filter_);
+  // Bypass the filter if another process wrote since it was built
+  return state && last_txnid() == state->txnid &&
+         !state->filter->may_contain(key);
+}
+
+std::size_t lmdb::last_txnid() const {
+  MDB_envinfo envinfo;
+  call(mdb_env_info(env_, &envinfo));
+  return envinfo.me_last_txnid;
+}
+
+void lmdb::remember(key_type key) {
+  if (filter_) {
+    filter_->filter->insert(key);
+    ++filter_keys_;
+    if (rebuilding_) {
+      pending_.emplace_back(key);
+    }
+  }
+}
+
+std::shared_ptr<bloom> lmdb::build_filter(
+    const std::shared_ptr<transaction>& txn, std::size_t entries) const {
+  // Leave room to double before the next rebuild
+  auto filter = std::make_shared<bloom>(
+      std::max<std::size_t>(1024, 2 * entries), filter_bits_per_key_);
+  auto cursor = lmdb::cursor(db_, txn);
+  try {
+    for (cursor.first(); cursor != last(); cursor.increment()) {
+      if (closing_) {
+        return nullptr;
+      }
+      filter->insert(cursor.key());
+    }
+  } catch (std::out_of_range&) {
+  }
+  return filter;
+}
+
+void lmdb::start_rebuild() {
+  if (rebuilding_) {
+    return;
+  }
+  // The last rebuild has published its filter, so is about to return
+  if (rebuilder_.joinable()) {
+    rebuilder_.join();
+  }
+  rebuilding_ = true;
+  pending_.clear();
+  rebuilder_ = std::thread([this] { rebuild_filter(); });
+}
+
+void lmdb::rebuild_filter() {
+  auto filter = std::shared_ptr<bloom>();
+  auto txn = std::shared_ptr<transaction>();
+  auto entries = std::size_t{0};
+  try {
+    auto origin = reader_origin("filter rebuild");
+    txn = std::make_shared<transaction>(env_);
+    MDB_stat stat;
+    {
+      transaction::guard use(txn.get());
+      call(mdb_stat(*txn, db_, &stat));
+    }
+    entries = stat.ms_entries;
+    filter = build_filter(txn, entries);
+  } catch (std::exception&) {
+    // The filter stays as it was, until the next write asks again
+  }
+  std::lock_guard lock(write_mutex_);
+  rebuilding_ = false;
+  if (!filter) {
+    pending_.clear();
+    return;
+  }
+  for (const auto& key : pending_) {
+    filter->insert(key);
+  }
+  filter_keys_ = entries + pending_.size();
+  filter_erased_ = 0;
+  pending_.clear();
+  // Writes since the snapshot were made here, unless another process wrote
+  auto snapshot = txn->id();
+  publish_filter(std::move(filter), foreign_txnid_ > snapshot
+                                        ? 0
+                                        : std::max(snapshot, seen_txnid_));
+}
+
+void lmdb::publish_filter(std::shared_ptr<bloom> filter, std::size_t txnid) {
+  std::atomic_store(&filter_, std::make_shared<const filter_state>(
+                                  filter_state{std::move(filter), txnid}));
+}
+
+std::shared_ptr<const lmdb::sample> lmdb::take_sample(
+    const std::shared_ptr<transaction>& txn) const {
+  auto result = std::make_shared<sample>();
+  result->writes = writes_;
+  MDB_stat stat;
+  {
+    transaction::guard use(txn.get());
+    call(mdb_stat(*txn, db_, &stat));
+  }
+  result->count = stat.ms_entries;
+  // Gaps from each key found up to the next, within a part of the key space
+  // halved depth times, the last holding only the last key
+  struct gap {
+    std::string key;
+    std::string begin, end; /** Of the part of the key space */
+    int depth = 0;
+    bool counted = false; /** Whether count holds all of its elements */
+    bool halved = true;   /** Whether the part can be halved again */
+    size_type count = 0;  /** Elements walked */
+    size_type bytes = 0;
+  };
+  auto gaps = std::vector<gap>();
+  auto position = lmdb::cursor(db_, txn);
+  try {
+    position.first();
+    auto first = std::string(position.key());
+    position.last();
+    auto last = std::string(position.key());
+    if (first != last) {
+      gaps.push_back({first, first, last});
+    }
+    gaps.push_back({last, last, last, 0, true, false, 1,
+                    last.size() + position.value().size()});
+  } catch (std::out_of_range&) {
+  }
+  // Counts the elements of a gap up to the key of the next, or up to
+  // sample_probe of them
+  auto walk = [&](gap& item, const std::string& next) {
+    item.count = item.bytes = 0;
+    for (position.seek_range(item.key);
+         position != last() && compare(txn, position.key(), next) < 0;
+         position.increment()) {
+      if (item.count == sample_probe) {
+        item.counted = false;
+        return;
+      }
+      ++item.count;
+      item.bytes += position.key().size() + position.value().size();
+    }
+    item.counted = true;
+  };
+  if (gaps.size() > 1) {
+    walk(gaps.front(), gaps.back().key);
+  }
+  auto max_key = static_cast<std::size_t>(mdb_env_get_maxkeysize(env_));
+  for (auto seeks = size_type{0}; seeks < sample_seeks;) {
+    // Parts are halved while there are more elements in them than walked
+    auto halved = std::vector<gap>();
+    halved.reserve(2 * gaps.size());
+    auto before = seeks;
+    for (std::size_t i = 0; i < gaps.size(); ++i) {
+      auto item = std::move(gaps[i]);
+      if (item.counted || !item.halved || seeks == sample_seeks) {
+        halved.push_back(std::move(item));
+        continue;
+      }
+      auto point = midpoint(item.begin, item.end, max_key);
+      if (compare(txn, item.begin, point) >= 0 ||
+          compare(txn, point, item.end) >= 0) {
+        item.halved = false;
+        halved.push_back(std::move(item));
+        continue;
+      }
+      ++seeks;
+      ++item.depth;
+      position.seek_range(point);
+      auto found = std::string(position.key());
+      if (compare(txn, found, item.key) == 0) {
+        item.begin = std::move(point);
+      } else if (compare(txn, found, item.end) >= 0) {
+        item.end = std::move(point);
+      } else {
+        const auto& next = gaps[i + 1].key;
+        auto upper = gap{found, point, item.end, item.depth};
+        item.end = std::move(point);
+        walk(item, found);
+        walk(upper, next);
+        halved.push_back(std::move(item));
+        item = std::move(upper);
+      }
+      halved.push_back(std::move(item));
+    }
+    gaps = std::move(halved);
+    if (seeks == before) {
+      break;
+    }
+  }
+  // The elements not counted are shared among the other gaps, as if evenly
+  // spread over their parts of the key space
+  auto counted = size_type{0};
+  auto weight = 0.0;
+  auto estimated = gaps.end();
+  for (auto it = gaps.begin(); it != gaps.end(); ++it) {
+    if (it->counted) {
+      counted += it->count;
+    } else {
+      weight += std::ldexp(1.0, -it->depth);
+      estimated = it;
+    }
+  }
+  auto remaining = result->count > counted ? result->count - counted : 0;
+  auto shared = size_type{0};
+  result->counts.push_back(0);
+  result->bytes.push_back(0);
+  result->spread.push_back(0);
+  for (auto it = gaps.begin(); it != gaps.end(); ++it) {
+    auto count = it->count;
+    auto bytes = it->bytes;
+    if (!it->counted) {
+      auto share =
+          it == estimated
+              ? remaining - std::min(remaining, shared)
+              : static_cast<size_type>(remaining *
+                                       std::ldexp(1.0, -it->depth) / weight);
+      shared += share;
+      count = std::max(count, share);
+      bytes = it->bytes * count / std::max<size_type>(1, it->count);
+    }
+    result->bounds.push_back(std::move(it->key));
+    result->counts.push_back(result->counts.back() + count);
+    result->bytes.push_back(result->bytes.back() + bytes);
+    result->spread.push_back(result->spread.back() +
+                             (it->counted ? 0 : count));
+  }
+  return result;
+}
+
+client::size_type lmdb::drift(const sample& sample, size_type count) const {
+  // Writes by other processes only show in the number of elements
+  auto written = writes_ - sample.writes;
+  auto difference =
+      count > sample.count ? count - sample.count : sample.count - count;
+  return std::max(written, difference);
+}
+
+int lmdb::compare(const std::shared_ptr<transaction>& txn, key_type lhs,
+                  key_type rhs) const {
+  buffer left(lhs), right(rhs);
+  return mdb_cmp(*txn, db_, left, right);
+}
+
+std::size_t lmdb::locate(const std::shared_ptr<transaction>& txn,
+                         const sample& sample, key_type key) const {
+  return static_cast<std::size_t>(
+      std::upper_bound(sample.bounds.begin(), sample.bounds.end(), key,
+                       [&](key_type lhs, const std::string& rhs) {
+                         return compare(txn, lhs, rhs) < 0;
+                       }) -
+      sample.bounds.begin());
+}
+
+range_estimate lmdb::rank(const std::shared_ptr<transaction>& txn,
+                          const sample& sample, key_type key,
+                          std::size_t after) const {
+  auto begin = sample.counts[after - 1];
+  auto end = sample.counts[after];
+  if (compare(txn, key, sample.bounds[after - 1]) == 0) {
+    return {begin, sample.bytes[after - 1]};
+  }
+  // Elements from key up to the next bound, if there are few enough
+  auto steps = size_type{0};
+  auto walked = size_type{0};
+  auto position = lmdb::cursor(db_, txn);
+  try {
+    position.seek_range(key);
+  } catch (std::out_of_range&) {
+    position.seek_end();
+  }
+  for (; position != last() &&
+         (after == sample.bounds.size() ||
+          compare(txn, position.key(), sample.bounds[after]) < 0);
+       position.increment()) {
+    if (steps == sample_probe) {
+      // Halfway through the gap, which was estimated
+      return {begin + (end - begin) / 2,
+              sample.bytes[after - 1] +
+                  (sample.bytes[after] - sample.bytes[after - 1]) / 2};
+    }
+    ++steps;
+    walked += position.key().size() + position.value().size();
+  }
+  // The snapshot may have more elements than the sample
+  return {end - std::min(steps, end - begin),
+          sample.bytes[after] -
+              std::min(walked, sample.bytes[after] - sample.bytes[after - 1])};
+}
+
+reader_statistics lmdb::readers() const {
+  auto result = reader_statistics();
+  auto open = env_.readers();
+  result.open = open.size();
+  if (!open.empty()) {
+    result.oldest = open.front().age;
+  }
+  MDB_envinfo envinfo;
+  call(mdb_env_info(env_, &envinfo));
+  result.slots_used = envinfo.me_numreaders;
+  result.slots = envinfo.me_maxreaders;
+  result.reaped = reaped_;
+  result.warned = warned_;
+  result.invalidated = invalidated_;
+  return result;
+}
+
+std::vector<reader_info> lmdb::open_readers() const { return env_.readers(); }
+
+std::size_t lmdb::check_readers() const {
+  auto dead = 0;
+  call(mdb_reader_check(env_, &dead));
+  reaped_ += dead;
+  if (stale_reader_policy_ != reader_policy::none) {
+    auto invalidate = stale_reader_policy_ == reader_policy::invalidate;
+    for (const auto& reader : env_.expire(max_reader_age_, invalidate)) {
+      ++(invalidate ? invalidated_ : warned_);
+      stale_reader_callback_(reader);
+    }
+  }
+  return dead;
+}
+
+void lmdb::check_periodically() {
+  std::unique_lock lock(checker_mutex_);
+  while (!stop_) {
+    checker_changed_.wait_for(lock, reader_check_interval_,
+                              [this] { return stop_; });
+    if (stop_) {
+      break;
+    }
+    try {
+      check_readers();
+    } catch (...) {
+      // Checks only prevent growth, so a failed one waits for the next
+    }
+  }
+}
+
+/** lmdb::prefetcher **********************************************/
+
+lmdb::prefetcher::prefetcher(database db, std::string from,
+                             std::size_t window)
+    : window_(window), page_size_(page_size()) {
+  worker_ = std::thread([this, db, from = std::move(from)] { work(db, from); });
+}
+
+lmdb::prefetcher::~prefetcher() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  worker_.join();
+}
+
+void lmdb::prefetcher::consumed(std::size_t bytes) {
+  if (consumed_.fetch_add(bytes) + bytes >= wake_) {
+    changed_.notify_one();
+  }
+}
+
+void lmdb::prefetcher::work(database db, const std::string& from) {
+  auto origin = reader_origin("read ahead");
+  try {
+    auto position = cursor(db);
+    position.seek_range(from);
+    for (; position != cursor() && !stop_; position.increment()) {
+      advise(position.key());
+      advise(position.value());
+      ahead_ += position.key().size() + position.value().size();
+      if (ahead_ < consumed_ + window_) {
+        continue;
+      }
+      // Resume once half of the window has been consumed. A notification
+      // may slip in before the wait, so waits are also bounded in time.
+      wake_ = ahead_ - window_ / 2;
+      std::unique_lock lock(mutex_);
+      while (!stop_ && consumed_ < wake_) {
+        changed_.wait_for(lock, std::chrono::milliseconds(10));
+      }
+    }
+  } catch (std::exception&) {
+    // The scan carries on regardless, only without read ahead
+  }
+}
+
+void lmdb::prefetcher::advise(std::string_view data) {
+  ::advise(data, page_size_, advised_begin_, advised_end_);
+}
+
 /** lmdb::environment *********************************************/
 
 lmdb::environment::environment(const std::filesystem::path& directory)
     : env_(nullptr) {
   // TODO ensure that each environment directory is only opened once
   call(mdb_env_create(&env_));
-  // Allow only a single database
-  call(mdb_env_set_maxdbs(env_, 1));
+  // Leave room for the change log and other named databases
+  call(mdb_env_set_maxdbs(env_, 16));
   // TODO validate that the path is a directory
   auto path = std::string(directory.native().begin(), directory.native().end());
   unsigned int flags = MDB_NOTLS;
@@ -172,6 +1588,63 @@ bool lmdb::environment::operator==(const lmdb::environment& rhs) {
   return env_ == rhs.env_;
 }
 
+void lmdb::environment::track(transaction& txn) const {
+  std::lock_guard lock(readers_mutex_);
+  txn.older_ = newest_;
+  txn.newer_ = nullptr;
+  (newest_ ? newest_->newer_ : oldest_) = &txn;
+  newest_ = &txn;
+  txn.tracked_ = true;
+}
+
+void lmdb::environment::untrack(transaction& txn) const {
+  std::lock_guard lock(readers_mutex_);
+  if (txn.tracked_) {
+    unlink(txn);
+  }
+}
+
+void lmdb::environment::unlink(transaction& txn) const {
+  (txn.older_ ? txn.older_->newer_ : oldest_) = txn.newer_;
+  (txn.newer_ ? txn.newer_->older_ : newest_) = txn.older_;
+  txn.older_ = txn.newer_ = nullptr;
+  txn.tracked_ = false;
+}
+
+std::vector<reader_info> lmdb::environment::readers() const {
+  auto result = std::vector<reader_info>();
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard lock(readers_mutex_);
+  for (auto txn = oldest_; txn != nullptr; txn = txn->newer_) {
+    result.push_back(
+        {txn->snapshot_, now - txn->start_, txn->thread_, txn->origin_});
+  }
+  return result;
+}
+
+std::vector<reader_info> lmdb::environment::expire(
+    std::chrono::milliseconds max_age, bool invalidate) const {
+  auto result = std::vector<reader_info>();
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard lock(readers_mutex_);
+  // Transactions are tracked in the order they began, so the walk stops at
+  // the first young enough
+  for (auto txn = oldest_; txn != nullptr && now - txn->start_ > max_age;) {
+    auto newer = txn->newer_;
+    if (!txn->reported_ && (!invalidate || txn->invalidate())) {
+      txn->reported_ = true;
+      result.push_back(
+          {txn->snapshot_, now - txn->start_, txn->thread_, txn->origin_});
+      if (invalidate) {
+        // It no longer holds a snapshot
+        unlink(*txn);
+      }
+    }
+    txn = newer;
+  }
+  return result;
+}
+
 /** lmdb::transaction *********************************************/
 
 lmdb::transaction::transaction(const lmdb::environment& env, bool readonly)
@@ -180,9 +1653,21 @@ lmdb::transaction::transaction(const lmdb::environment& env, bool readonly)
   unsigned int flags = readonly ? MDB_RDONLY : 0;
   call(
       mdb_txn_begin(const_cast<lmdb::environment&>(env), parent, flags, &txn_));
+  if (readonly) {
+    env_ = &env;
+    snapshot_ = mdb_txn_id(txn_);
+    start_ = std::chrono::steady_clock::now();
+    thread_ = std::this_thread::get_id();
+    origin_ = reader_origin::current();
+    env.track(*this);
+  }
 }
 
 lmdb::transaction::~transaction() {
+  // Untracked first, so that it cannot be invalidated while aborted
+  if (env_ != nullptr) {
+    env_->untrack(*this);
+  }
   if (txn_ != nullptr) {
     abort();
   }
@@ -204,26 +1689,65 @@ void lmdb::transaction::commit() {
 
 lmdb::transaction::operator MDB_txn*() { return txn_; }
 
+std::size_t lmdb::transaction::id() { return mdb_txn_id(txn_); }
+
+bool lmdb::transaction::invalidate() {
+  auto idle = 0;
+  // Far enough below zero that guards failing meanwhile cannot reach it
+  if (!users_.compare_exchange_strong(idle,
+                                      std::numeric_limits<int>::min() / 2)) {
+    return false;
+  }
+  // Aborting a reset transaction is allowed, so the destructor is unchanged
+  mdb_txn_reset(txn_);
+  return true;
+}
+
+lmdb::transaction::guard::guard(transaction* txn)
+    : txn_(txn != nullptr && txn->readonly_ ? txn : nullptr) {
+  if (txn_ != nullptr && txn_->users_.fetch_add(1) < 0) {
+    txn_->users_.fetch_sub(1);
+    txn_ = nullptr;
+    throw std::system_error(std::make_error_code(std::errc::timed_out),
+                            "read transaction invalidated for its age");
+  }
+}
+
+lmdb::transaction::guard::~guard() {
+  if (txn_ != nullptr) {
+    txn_->users_.fetch_sub(1);
+  }
+}
+
 bool lmdb::transaction::readonly() const { return readonly_; }
 
 /** lmdb::database ************************************************/
 
 lmdb::database::database() : env_(nullptr), dbi_(0) {}
 
-lmdb::database::database(const lmdb::environment& env, std::string_view name)
+lmdb::database::database(const lmdb::environment& env, std::string_view name,
+                         key_compare compare, bool create)
     : env_(&env), dbi_(0) {
-  unsigned int flags = 0;
-  transaction txn(env);
-  auto path = name.empty() ? nullptr : name.data();
+  // Only a write transaction may create a database
+  unsigned int flags = create ? MDB_CREATE : 0;
+  transaction txn(env, !create);
+  auto name_string = std::string(name);
+  auto path = name.empty() ? nullptr : name_string.c_str();
   call(mdb_dbi_open(txn, path, flags, &dbi_));
+  if (compare) {
+    // Must be installed before any data access, by every process
+    call(mdb_set_compare(txn, dbi_, install(compare)));
+  }
   txn.commit();
 }
 
 const lmdb::environment& lmdb::database::environment() const { return *env_; }
 
+bool lmdb::database::opened() const { return env_ != nullptr; }
+
 lmdb::database::operator MDB_dbi() const { return dbi_; }
 
-bool lmdb::database::operator==(const lmdb::database& rhs) {
+bool lmdb::database::operator==(const lmdb::database& rhs) const {
   return dbi_ == rhs.dbi_;
 }
 
@@ -246,6 +1770,7 @@ lmdb::buffer::operator std::string_view() const {
 lmdb::cursor::cursor(lmdb::database db, std::shared_ptr<lmdb::transaction> txn)
     : database_(db), transaction_(std::move(txn)), cursor_(nullptr) {
   if (transaction_) {
+    auto guard = use();
     call(mdb_cursor_open(*transaction_, db, &cursor_));
   }
 }
@@ -253,19 +1778,49 @@ lmdb::cursor::cursor(lmdb::database db, std::shared_ptr<lmdb::transaction> txn)
 lmdb::cursor::cursor(lmdb::database db)
     : cursor(db, std::make_shared<lmdb::transaction>(db.environment())) {}
 
-lmdb::cursor::cursor(lmdb::cursor&& rhs) noexcept
+lmdb::cursor lmdb::cursor::end(lmdb::database db) {
+  auto result = cursor();
+  result.database_ = db;
+  return result;
+}
+
+lmdb::cursor::cursor(const lmdb::cursor& rhs)
     : database_(rhs.database_),
+      transaction_(rhs.transaction_),
+      prefetcher_(rhs.prefetcher_) {
+  if (rhs.cursor_ != nullptr) {
+    auto guard = use();
+    call(mdb_cursor_open(*transaction_, database_, &cursor_));
+    seek(rhs.key());
+  }
+}
+
+lmdb::cursor& lmdb::cursor::operator=(const lmdb::cursor& rhs) {
+  if (this != &rhs) {
+    *this = lmdb::cursor(rhs);
+  }
+  return *this;
+}
+
+lmdb::cursor::cursor(lmdb::cursor&& rhs) noexcept
+    : key_(rhs.key_),
+      value_(rhs.value_),
+      database_(rhs.database_),
       transaction_(std::move(rhs.transaction_)),
-      cursor_(rhs.cursor_) {
+      cursor_(rhs.cursor_),
+      prefetcher_(std::move(rhs.prefetcher_)) {
   rhs.database_ = lmdb::database();
   rhs.cursor_ = nullptr;
 }
 
 lmdb::cursor& lmdb::cursor::operator=(lmdb::cursor&& rhs) noexcept {
   close();
+  key_ = rhs.key_;
+  value_ = rhs.value_;
   database_ = rhs.database_;
   transaction_ = std::move(rhs.transaction_);
   cursor_ = rhs.cursor_;
+  prefetcher_ = std::move(rhs.prefetcher_);
 
   rhs.database_ = lmdb::database();
   rhs.transaction_ = nullptr;
@@ -274,8 +1829,17 @@ lmdb::cursor& lmdb::cursor::operator=(lmdb::cursor&& rhs) noexcept {
 }
 
 void lmdb::cursor::seek(const key_type& key) {
+  auto guard = use();
   key_ = key;
-  call(mdb_cursor_get(cursor_, key_, value_, MDB_SET));
+  // MDB_SET_KEY returns the stored key, so that key() does not refer to the
+  // caller's memory
+  call(mdb_cursor_get(cursor_, key_, value_, MDB_SET_KEY));
+}
+
+void lmdb::cursor::seek_range(const key_type& key) {
+  auto guard = use();
+  key_ = key;
+  call(mdb_cursor_get(cursor_, key_, value_, MDB_SET_RANGE));
 }
 
 void lmdb::cursor::set(const mapped_type& value) {
@@ -284,8 +1848,8 @@ void lmdb::cursor::set(const mapped_type& value) {
   call(mdb_cursor_put(cursor_, key_, value_, flags));
 }
 
-void lmdb::cursor::put(const value_type& value) {
-  unsigned int flags = 0;
+void lmdb::cursor::put(const value_type& value, bool append) {
+  unsigned int flags = append ? MDB_APPEND : 0;
   key_ = value.first;
   value_ = value.second;
   call(mdb_cursor_put(cursor_, key_, value_, flags));
@@ -295,38 +1859,45 @@ std::string_view lmdb::cursor::key() const { return key_; }
 
 std::string_view lmdb::cursor::value() const { return value_; }
 
-bool lmdb::cursor::equal(const client::cursor& rhs) const {
-  try {
-    const auto& cursor = dynamic_cast<const lmdb::cursor&>(rhs);
-    return database_ == cursor.database_ &&
-           transaction_ == cursor.transaction_ && cursor_ == cursor.cursor_;
-  } catch (std::bad_cast&) {
-    return false;
-  }
-}
-
 void lmdb::cursor::increment() {
+  auto guard = use();
   try {
     call(mdb_cursor_get(cursor_, key_, value_, MDB_NEXT));
   } catch (std::out_of_range&) {
-    *this = cursor();
+    seek_end();
+    return;
+  }
+  if (prefetcher_) {
+    prefetcher_->consumed(key().size() + value().size());
   }
 }
 
 void lmdb::cursor::decrement() {
+  if (cursor_ == nullptr) {
+    if (!database_.opened()) {
+      return;
+    }
+    if (!transaction_) {
+      transaction_ = std::make_shared<lmdb::transaction>(
+          database_.environment());
+    }
+    {
+      auto guard = use();
+      call(mdb_cursor_open(*transaction_, database_, &cursor_));
+    }
+    try {
+      last();
+    } catch (std::out_of_range&) {
+      seek_end();
+    }
+    return;
+  }
+  auto guard = use();
   try {
     call(mdb_cursor_get(cursor_, key_, value_, MDB_PREV));
   } catch (std::out_of_range&) {
-    *this = cursor();
-  }
-}
-
-std::unique_ptr<client::cursor> lmdb::cursor::clone() const {
-  auto result = std::make_unique<lmdb::cursor>(database_, transaction_);
-  if (database_ && transaction_ && key() != buffer()) {
-    result->seek(key());
+    seek_end();
   }
-  return result;
 }
 
 void lmdb::cursor::erase() {
@@ -335,10 +1906,25 @@ void lmdb::cursor::erase() {
 }
 
 void lmdb::cursor::first() {
+  auto guard = use();
   call(mdb_cursor_get(cursor_, key_, value_, MDB_FIRST));
 }
 
+void lmdb::cursor::last() {
+  auto guard = use();
+  call(mdb_cursor_get(cursor_, key_, value_, MDB_LAST));
+}
+
+void lmdb::cursor::seek_end() {
+  close();
+  // Cursors of write transactions are closed with the transaction
+  cursor_ = nullptr;
+  key_ = value_ = buffer();
+}
+
 void lmdb::cursor::close() {
+  // Read only cursors belong to no transaction in LMDB, so closing one needs
+  // no guard
   if (cursor_ && transaction_) {
     if (transaction_->readonly()) {
       // lmdb automatically closes cursors on write transactions
@@ -354,18 +1940,24 @@ const std::shared_ptr<lmdb::transaction>& lmdb::cursor::transaction() const {
   return transaction_;
 }
 
+lmdb::transaction::guard lmdb::cursor::use() const {
+  return lmdb::transaction::guard(transaction_.get());
+}
+
+void lmdb::cursor::read_ahead(std::shared_ptr<prefetcher> prefetcher) {
+  prefetcher_ = std::move(prefetcher);
+}
+
 bool lmdb::cursor::operator==(const lmdb::cursor& rhs) const {
-  return database_ == rhs.database_ && transaction_ == rhs.transaction_ &&
-         cursor_ == rhs.cursor_;
+  if (cursor_ == nullptr || rhs.cursor_ == nullptr) {
+    return cursor_ == rhs.cursor_;
+  }
+  return cursor_ == rhs.cursor_ ||
+         (database_ == rhs.database_ && key() == rhs.key());
 }
 
 bool lmdb::cursor::operator!=(const lmdb::cursor& rhs) const {
   return !(*this == rhs);
 }
 
-const lmdb::cursor& lmdb::cursor::default_instance() {
-  static lmdb::cursor result;
-  return result;
-}
-
 }  // namespace datastore::clients::detail
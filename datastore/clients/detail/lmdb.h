@@ -1,27 +1,118 @@
 #pragma once
+#include <datastore/clients/detail/bloom.h>
 #include <datastore/clients/lmdb.h>
 #include <lmdb.h>
-#include <set>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace datastore::clients::detail {
 
-class lmdb final : public client {
+/** LMDB backend storing a single database within an environment */
+class lmdb {
  public:
+  class cursor;
+  using key_type = client::key_type;
+  using mapped_type = client::mapped_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Merges are read and written in the transaction of their batch */
+  static constexpr bool applies_merges = true;
+
   explicit lmdb(const lmdb_configuration& config);
-  ~lmdb() final = default;
 
-  [[nodiscard]] size_type size() const override;
+  /** Stops checking readers, then closes the environment, persisting the
+   * membership filter */
+  ~lmdb();
+
+  lmdb(const lmdb&) = delete;
+  lmdb& operator=(const lmdb&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  cursor erase(cursor pos);
+
+  /** Returns the first element not ordered before from, with a thread
+   * faulting in the pages of up to window bytes of elements ahead of it */
+  [[nodiscard]] cursor read_ahead(key_type from, std::size_t window) const;
+
+  /** Reads the branch pages, then the hot ranges, into memory */
+  warm_up_report warm_up(const warm_up_policy& policy) const;
+
+  /** Returns how much of the data file is in the page cache */
+  [[nodiscard]] residency resident() const;
+
+  /** Estimates the elements in [from, to) from a sample of the keys */
+  [[nodiscard]] range_estimate estimate(key_type from, key_type to) const;
+
+  /** Applies a batch within a single write transaction */
+  void write(const batch& operations);
+
+  /** Reads and replaces a value within a single write transaction, which
+   * is aborted if the value is left as it was */
+  std::optional<std::string> update(key_type key,
+                                    const client::update_function& function);
+
+  /** Opens a blob writer holding a write transaction until it commits, so
+   * that other writes wait meanwhile, or throw std::logic_error on the
+   * thread which opened it, which must use and destroy it */
+  [[nodiscard]] std::unique_ptr<blob_writer> open_blob_writer(
+      key_type key, bool append, size_type chunk_size);
+
+  /** Opens a blob reader holding a read transaction, so that every chunk
+   * comes from the same snapshot */
+  [[nodiscard]] std::unique_ptr<blob_reader> open_blob_reader(
+      key_type key, std::uint64_t offset) const;
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+  /** Returns up to limit changes, starting at sequence from */
+  [[nodiscard]] std::vector<change> changes(std::uint64_t from,
+                                            std::size_t limit) const;
+
+  /** Erases the changes before sequence before, keeping the newest */
+  void truncate_changes(std::uint64_t before);
+
+  /** Streams a snapshot to fd through a pipe, so as to report progress */
+  backup_progress backup(int fd,
+                         const backup_configuration& configuration) const;
+
+  /** Writes a snapshot to a temporary file, then renames it into place */
+  backup_progress backup(const std::filesystem::path& directory,
+                         const backup_configuration& configuration) const;
 
- protected:
-  [[nodiscard]] std::unique_ptr<cursor> first() const override;
-  [[nodiscard]] std::unique_ptr<cursor> last() const override;
-  std::unique_ptr<client::cursor> insert_or_assign(
-      std::unique_ptr<client::cursor> pos, const value_type& value) override;
-  [[nodiscard]] std::unique_ptr<cursor> lookup(key_type key) const override;
-  std::unique_ptr<cursor> erase(std::unique_ptr<cursor> pos) override;
-  [[nodiscard]] size_type capacity() const override;
+  /** Moves the data file of a backup into directory */
+  static void restore(const std::filesystem::path& backup,
+                      const std::filesystem::path& directory);
+
+  [[nodiscard]] reader_statistics readers() const;
+
+  /** Returns the read transactions open, oldest first */
+  [[nodiscard]] std::vector<reader_info> open_readers() const;
+
+  /** Clears the slots of dead readers and applies the stale reader policy,
+   * returning the slots cleared */
+  std::size_t check_readers() const;
 
  private:
+  class transaction;
+
   class buffer {
    public:
     /** Creates an empty buffer */
@@ -48,16 +139,56 @@ class lmdb final : public client {
 
     bool operator==(const environment& rhs);
 
+    /** Records a read transaction as open, as the newest */
+    void track(transaction& txn) const;
+
+    /** Records a read transaction as closed */
+    void untrack(transaction& txn) const;
+
+    /** Returns the open read transactions, oldest first */
+    [[nodiscard]] std::vector<reader_info> readers() const;
+
+    /** Reports, after invalidating them if requested, the read transactions
+     * older than max_age which were not reported before
+     *
+     * Transactions in use are left to a later call. */
+    std::vector<reader_info> expire(std::chrono::milliseconds max_age,
+                                    bool invalidate) const;
+
    private:
+    /** Unlinks a tracked transaction, with readers_mutex_ held */
+    void unlink(transaction& txn) const;
+
     MDB_env* env_;
+    mutable std::mutex readers_mutex_;
+    /** Ends of the list of open read transactions, from oldest to newest */
+    mutable transaction* oldest_ = nullptr;
+    mutable transaction* newest_ = nullptr;
   };
 
   /** Encapsulates an LMDB transaction.
    *
-   * A transaction may span multiple databases.
+   * A transaction may span multiple databases. Read transactions are
+   * tracked by their environment while open, so that long-lived ones can be
+   * found, and may be invalidated by another thread while no guard holds
+   * them.
    */
   class transaction {
    public:
+    /** Holds off the invalidation of a read transaction while it is used */
+    class guard {
+     public:
+      /** Throws std::system_error if txn was invalidated */
+      explicit guard(transaction* txn);
+      ~guard();
+
+      guard(const guard&) = delete;
+      guard& operator=(const guard&) = delete;
+
+     private:
+      transaction* txn_;
+    };
+
     transaction() = default;
     explicit transaction(const environment& env, bool readonly = true);
     ~transaction();
@@ -71,13 +202,32 @@ class lmdb final : public client {
 
     [[nodiscard]] bool readonly() const;
 
+    /** Returns the id of the snapshot read, or of the commit written */
+    [[nodiscard]] std::size_t id();
+
+    /** Releases the snapshot of a read transaction unless a guard holds
+     * it, returning whether it did */
+    bool invalidate();
+
     operator MDB_txn*();
 
+    friend class environment;
+
    private:
     MDB_txn* txn_ = nullptr;
     bool readonly_ = true;
     bool committed_ = false;
     bool aborted_ = false;
+    const lmdb::environment* env_ = nullptr; /** Tracking it, if reading */
+    std::size_t snapshot_ = 0;
+    std::chrono::steady_clock::time_point start_;
+    std::thread::id thread_;
+    std::string origin_;
+    bool tracked_ = false;  /** Guarded by the environment */
+    bool reported_ = false; /** Guarded by the environment */
+    transaction* older_ = nullptr;
+    transaction* newer_ = nullptr;
+    std::atomic<int> users_{0}; /** Guards, negative once invalidated */
   };
 
   /** Encapsulates an LMDB database.
@@ -89,11 +239,17 @@ class lmdb final : public client {
   class database {
    public:
     database();
+
+    /** Opens the named or main database, creating it if requested */
     explicit database(const environment& env,
-                      std::string_view name = std::string_view());
+                      std::string_view name = std::string_view(),
+                      key_compare compare = nullptr, bool create = false);
 
     [[nodiscard]] const lmdb::environment& environment() const;
 
+    /** Returns whether this refers to an open database */
+    [[nodiscard]] bool opened() const;
+
     database(const database&) = default;
     database(database&&) = default;
     database& operator=(const database&) = default;
@@ -101,94 +257,304 @@ class lmdb final : public client {
 
     operator MDB_dbi() const;
 
-    bool operator==(const database& rhs);
+    bool operator==(const database& rhs) const;
 
    private:
     const lmdb::environment* env_;
     MDB_dbi dbi_;
   };
 
-  class cursor final : public client::cursor {
+  /** Walks a cursor of its own ahead of a scan, on a thread of its own
+   *
+   * LMDB transactions may not be used by two threads at once, so the walk
+   * reads from a transaction of its own, which is the snapshot of the scan
+   * unless a write commits in between. Read ahead is only a hint either
+   * way. */
+  class prefetcher {
    public:
-    using value_type = client::value_type;
-    using key_type = client::key_type;
-    using mapped_type = client::mapped_type;
+    prefetcher(database db, std::string from, std::size_t window);
 
-    /** Creates a sentinel cursor */
-    cursor() = default;
+    /** Stops the walk */
+    ~prefetcher();
 
-    /** Destroys a cursor */
-    ~cursor() override;
+    prefetcher(const prefetcher&) = delete;
+    prefetcher& operator=(const prefetcher&) = delete;
 
-    cursor(const cursor&) = delete;
-    cursor& operator=(const cursor&) = delete;
-    cursor(cursor&&) noexcept;
-    cursor& operator=(cursor&&) noexcept;
+    /** Records that the scan moved past bytes of keys and values */
+    void consumed(std::size_t bytes);
 
-    /** Creates a cursor */
-    explicit cursor(database db, std::shared_ptr<transaction> txn);
+   private:
+    void work(database db, const std::string& from);
+
+    /** Asks for the pages holding data to be read in */
+    void advise(std::string_view data);
+
+    std::size_t window_;
+    std::size_t page_size_;
+    std::atomic<std::size_t> consumed_{0};
+    std::atomic<std::size_t> wake_{0}; /** Consumption which ends a wait */
+    std::atomic<bool> stop_{false};
+    std::size_t ahead_ = 0; /** Bytes walked, by the worker only */
+    std::uintptr_t advised_begin_ = 0;
+    std::uintptr_t advised_end_ = 0;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread worker_;
+  };
 
-    /** Creates a cursor */
-    explicit cursor(database db);
+  /** A membership filter and the last transaction it reflects, published
+   * together so that readers never pair a filter with another's txnid,
+   * which is zero while it misses writes of another process */
+  struct filter_state {
+    std::shared_ptr<bloom> filter;
+    std::size_t txnid = 0;
+  };
 
-    /** Seeks to the given key */
-    void seek(const key_type& key);
+  /** Publishes filter as up to date with txnid */
+  void publish_filter(std::shared_ptr<bloom> filter, std::size_t txnid);
+
+  /** Keys found by seeking a snapshot, between which the elements were
+   * counted where few, else estimated from the key space between */
+  struct sample {
+    std::vector<std::string> bounds; /** Keys found, in order */
+    std::vector<size_type> counts;   /** Before each bound, then in all */
+    std::vector<size_type> bytes;    /** Before each bound, then in all */
+    std::vector<size_type> spread;   /** Of counts, those estimated */
+    size_type count = 0;             /** Elements in the snapshot */
+    size_type writes = 0;            /** Value of writes_ when taken */
+  };
 
-    /** Seeks to the first key */
-    void first();
+  /** Samples the snapshot of txn with a bounded number of seeks */
+  [[nodiscard]] std::shared_ptr<const sample> take_sample(
+      const std::shared_ptr<transaction>& txn) const;
+
+  /** Returns the elements written since a sample was taken, at least */
+  [[nodiscard]] size_type drift(const sample& sample, size_type count) const;
+
+  /** Compares keys in the order of the database */
+  [[nodiscard]] int compare(const std::shared_ptr<transaction>& txn,
+                            key_type lhs, key_type rhs) const;
+
+  /** Returns the number of bounds of a sample not ordered after key */
+  [[nodiscard]] std::size_t locate(const std::shared_ptr<transaction>& txn,
+                                   const sample& sample, key_type key) const;
+
+  /** Returns the number and size of the elements ordered before key, after
+   * locating it, from a sample */
+  [[nodiscard]] range_estimate rank(const std::shared_ptr<transaction>& txn,
+                                    const sample& sample, key_type key,
+                                    std::size_t after) const;
+
+  /** An open write transaction, with what committing it takes */
+  struct write_scope {
+    std::unique_lock<std::mutex> lock; /** Of write_mutex_, if filtered */
+    std::shared_ptr<transaction> txn;
+    std::size_t id = 0;
+    bool stale = false;   /** Whether the filter missed earlier writes */
+    bool cleared = false; /** Whether every element was erased */
+  };
 
-    /** Sets the mapped value at the current position */
-    void set(const mapped_type& value);
+  /** Begins a write transaction, throwing std::logic_error if a blob
+   * writer holds one on this thread, rather than waiting for itself */
+  [[nodiscard]] write_scope begin_write();
 
-    /** Inserts the given value at the given key */
-    void put(const value_type& value);
+  /** Commits a write transaction, updating the filter */
+  void commit(write_scope& scope);
 
-    /** Erases the value at the given key */
-    void erase();
+  /** Applies writes within a write transaction, returning how many */
+  size_type apply(const std::shared_ptr<transaction>& txn,
+                  const batch& writes);
 
-    /** Returns the key at the current position */
-    [[nodiscard]] key_type key() const override;
+  /** Seeks between the keys found so far on threads, halving the gaps
+   * between them each round, until limit seeks were made or no gap is
+   * left, returning how many were made */
+  size_type probe_branches(unsigned int threads, size_type limit) const;
 
-    /** Returns the value at the current position */
-    [[nodiscard]] mapped_type value() const override;
+  /** Advises the kernel of the pages of ranges, within the budget of
+   * policy, adding what was read to report */
+  void read_ranges(const warm_up_policy& policy,
+                   warm_up_report& report) const;
 
-    /** Compares with another cursor */
-    [[nodiscard]] bool equal(const client::cursor& rhs) const override;
+  /** Runs function within a write transaction, updating the filter
+   *
+   * The transaction is aborted instead if function returns false. */
+  template <typename Function>
+  void transact(Function&& function);
 
-    /** Moves the cursor forward by one position */
-    void increment() override;
+  /** Returns true if key is definitely absent */
+  [[nodiscard]] bool absent(key_type key) const;
 
-    /** Moves the cursor backwards by one position */
-    void decrement() override;
+  /** Returns the id of the last committed transaction */
+  [[nodiscard]] std::size_t last_txnid() const;
 
-    /** Creates a copy of the cursor */
-    [[nodiscard]] std::unique_ptr<client::cursor> clone() const override;
+  /** Adds a key written by this process to the filter, and to the keys
+   * which a rebuild in progress adds to the filter it builds */
+  void remember(key_type key);
 
-    /** Returns the transaction for this cursor */
-    [[nodiscard]] const std::shared_ptr<lmdb::transaction>& transaction() const;
+  /** Returns a membership filter of the entries keys of the snapshot of
+   * txn, or nothing if the datastore is closed meanwhile */
+  [[nodiscard]] std::shared_ptr<bloom> build_filter(
+      const std::shared_ptr<transaction>& txn, std::size_t entries) const;
 
-    /** Closes the cursor */
-    void close();
+  /** Rebuilds the filter on a thread of its own, unless it is rebuilding
+   * already, holding write_mutex_ */
+  void start_rebuild();
 
-    /** Compares with another lmdb cursor */
-    bool operator==(const cursor& rhs) const;
+  /** Rebuilds the filter from a snapshot, then adds the keys written since */
+  void rebuild_filter();
 
-    /** Compares with another lmdb cursor */
-    bool operator!=(const cursor& rhs) const;
+  /** Returns true if the batch only puts keys in increasing order, after
+   * every key in the database, so that they can be appended */
+  [[nodiscard]] bool appendable(const std::shared_ptr<transaction>& txn,
+                                const batch& operations) const;
 
-    /** Returns a default constructed cursor */
-    static const cursor& default_instance();
+  /** Appends the writes of txn to the change log, if it is enabled */
+  void record(const std::shared_ptr<transaction>& txn, bool cleared,
+              const batch& writes);
 
-   private:
-    void reset();
-    buffer key_, value_;
-    database database_;
-    std::shared_ptr<lmdb::transaction> transaction_ = nullptr;
-    MDB_cursor* cursor_ = nullptr;
-  };
+  /** Checks the readers every reader_check_interval_ until stopped */
+  void check_periodically();
 
   environment env_;
-  database db_;
+  database db_; /** Named if there is a change log, else the main one */
+  bool change_log_;
+  database changes_; /** Encoded writes by big endian sequence */
+  /** Transaction id and sequence of the last change recorded, written
+   * within write transactions only */
+  std::pair<std::size_t, std::uint64_t> recorded_;
+  std::filesystem::path filter_path_;
+  std::filesystem::path data_path_;
+  unsigned int filter_bits_per_key_;
+  /** Accessed with std::atomic_load, replaced holding write_mutex_ */
+  std::shared_ptr<const filter_state> filter_;
+  std::size_t filter_keys_ = 0;     /** Keys added since the rebuild */
+  std::size_t filter_erased_ = 0;   /** Keys erased since the rebuild */
+  std::size_t seen_txnid_ = 0;      /** Last committed here or rebuilt */
+  std::size_t foreign_txnid_ = 0;   /** Last known written elsewhere */
+  bool rebuilding_ = false;
+  std::vector<std::string> pending_; /** Written during the rebuild */
+  std::thread rebuilder_;
+  std::atomic<bool> closing_{false}; /** Abandons a rebuild */
+  std::mutex write_mutex_; /** Guards the filter and the members above */
+  /** Of the blob writer holding the write transaction, if any */
+  std::atomic<std::thread::id> blob_thread_{};
+  /** Accessed with std::atomic_load */
+  mutable std::shared_ptr<const sample> sample_;
+  mutable std::mutex sample_mutex_;         /** Serialises samples */
+  std::atomic<size_type> writes_{0};        /** Elements written */
+  reader_policy stale_reader_policy_;
+  std::chrono::milliseconds max_reader_age_;
+  lmdb_configuration::reader_callback stale_reader_callback_;
+  std::chrono::milliseconds reader_check_interval_;
+  mutable std::atomic<std::size_t> reaped_{0};
+  mutable std::atomic<std::size_t> warned_{0};
+  mutable std::atomic<std::size_t> invalidated_{0};
+  std::mutex checker_mutex_;
+  std::condition_variable checker_changed_;
+  bool stop_ = false;
+  std::thread checker_;
+};
+
+/** Position within a read transaction of an lmdb backend
+ *
+ * Copies share the transaction, and so the snapshot, of the original. The
+ * end of a database keeps the database and any transaction, so that it can
+ * be decremented to the last key of the same snapshot. Moves throw
+ * std::system_error once the transaction is invalidated. */
+class lmdb::cursor {
+ public:
+  using value_type = client::value_type;
+  using key_type = client::key_type;
+  using mapped_type = client::mapped_type;
+
+  /** Creates a sentinel cursor */
+  cursor() = default;
+
+  /** Creates a cursor at the end of a database, without a transaction */
+  static cursor end(database db);
+
+  /** Destroys a cursor */
+  ~cursor();
+
+  /** Creates a cursor at the same position in the same transaction */
+  cursor(const cursor& rhs);
+
+  /** Assigns a cursor at the same position in the same transaction */
+  cursor& operator=(const cursor& rhs);
+
+  cursor(cursor&&) noexcept;
+  cursor& operator=(cursor&&) noexcept;
+
+  /** Creates a cursor */
+  explicit cursor(database db, std::shared_ptr<transaction> txn);
+
+  /** Creates a cursor */
+  explicit cursor(database db);
+
+  /** Seeks to the given key */
+  void seek(const key_type& key);
+
+  /** Seeks to the first key not ordered before the given key */
+  void seek_range(const key_type& key);
+
+  /** Seeks to the first key */
+  void first();
+
+  /** Seeks to the last key */
+  void last();
+
+  /** Moves to the end, keeping the database and transaction */
+  void seek_end();
+
+  /** Sets the mapped value at the current position */
+  void set(const mapped_type& value);
+
+  /** Inserts the given value at the given key
+   *
+   * Appending skips the search for the position, but requires the key to
+   * order after every key in the database. */
+  void put(const value_type& value, bool append = false);
+
+  /** Erases the value at the given key */
+  void erase();
+
+  /** Returns the key at the current position */
+  [[nodiscard]] key_type key() const;
+
+  /** Returns the value at the current position */
+  [[nodiscard]] mapped_type value() const;
+
+  /** Moves the cursor forward by one position */
+  void increment();
+
+  /** Moves the cursor backwards by one position, from the end to the last
+   * key, or from the first key to the end */
+  void decrement();
+
+  /** Returns the transaction for this cursor */
+  [[nodiscard]] const std::shared_ptr<lmdb::transaction>& transaction() const;
+
+  /** Reports each step forwards to a prefetcher, shared with copies */
+  void read_ahead(std::shared_ptr<prefetcher> prefetcher);
+
+  /** Closes the cursor */
+  void close();
+
+  /** Compares positions, all sentinel cursors being equal */
+  bool operator==(const cursor& rhs) const;
+
+  /** Compares positions, all sentinel cursors being equal */
+  bool operator!=(const cursor& rhs) const;
+
+ private:
+  /** Holds off the invalidation of the transaction of the cursor */
+  [[nodiscard]] lmdb::transaction::guard use() const;
+
+  buffer key_, value_;
+  database database_;
+  std::shared_ptr<lmdb::transaction> transaction_ = nullptr;
+  MDB_cursor* cursor_ = nullptr;
+  std::shared_ptr<prefetcher> prefetcher_ = nullptr;
 };
 
 }  // namespace datastore::clients::detail
@@ -0,0 +1,720 @@
+#include "lsm.h"
+#include <algorithm>
+#include <charconv>
+#include <datastore/clients/detail/coding.h>
+#include <fstream>
+#include <limits>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace datastore::clients::detail {
+
+namespace {
+
+constexpr char put_record = 0;
+constexpr char erase_record = 1;
+
+/** Approximate memory used by a memtable node besides its key and value */
+constexpr std::size_t node_overhead = 64;
+
+bool sync(std::FILE* file) {
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return ::fsync(fileno(file)) == 0;
+#endif
+}
+
+/** Parses the number of a log or run file, returning false for other files */
+bool parse(const std::filesystem::path& path, std::uint64_t& number) {
+  auto stem = path.stem().string();
+  auto end = stem.data() + stem.size();
+  auto [p, error] = std::from_chars(stem.data(), end, number);
+  return error == std::errc() && p == end;
+}
+
+}  // namespace
+
+lsm::run::run(std::filesystem::path path, std::uint64_t number,
+              key_compare compare)
+    : path(std::move(path)),
+      number(number),
+      data(table_configuration(this->path, compare)),
+      bytes(std::filesystem::file_size(this->path)) {}
+
+lsm::run::~run() {
+  if (obsolete) {
+    std::error_code error;
+    std::filesystem::remove(path, error);
+  }
+}
+
+lsm::lsm(const lsm_configuration& configuration)
+    : path_(configuration.path()),
+      compare_(configuration.compare()),
+      less_(compare_),
+      memtable_size_(configuration.memtable_size()),
+      compaction_trigger_(std::max(configuration.compaction_trigger(), 2u)),
+      sync_(configuration.sync()) {
+  std::filesystem::create_directories(path_);
+  std::uint64_t log_number = 0;
+  std::vector<std::uint64_t> run_numbers;
+  {
+    std::ifstream manifest(path_ / "MANIFEST");
+    std::string kind;
+    std::uint64_t number;
+    while (manifest >> kind >> number) {
+      if (kind == "log") {
+        log_number = number;
+      } else if (kind == "run") {
+        run_numbers.push_back(number);
+      }
+    }
+  }
+
+  // Logs which were flushed and runs which were never, or are no longer,
+  // recorded in the manifest are left over from an interrupted flush
+  std::vector<std::uint64_t> logs;
+  std::vector<std::filesystem::path> obsolete;
+  std::uint64_t highest = 0;
+  for (const auto& item : std::filesystem::directory_iterator(path_)) {
+    auto extension = item.path().extension();
+    std::uint64_t number;
+    if ((extension != ".log" && extension != ".table") ||
+        !parse(item.path(), number)) {
+      continue;
+    }
+    highest = std::max(highest, number);
+    if (extension == ".log" && number >= log_number) {
+      logs.push_back(number);
+    } else if (extension == ".log" ||
+               std::find(run_numbers.begin(), run_numbers.end(), number) ==
+                   run_numbers.end()) {
+      obsolete.push_back(item.path());
+    }
+  }
+  for (const auto& path : obsolete) {
+    std::filesystem::remove(path);
+  }
+  next_number_ = highest + 1;
+
+  auto state = std::make_shared<version>();
+  state->active = std::make_shared<memtable>(less_);
+  for (auto number : run_numbers) {
+    state->runs.push_back(
+        std::make_shared<run>(file(number, ".table"), number, compare_));
+  }
+
+  // Replay the logs, stopping at a record torn by a crash
+  std::sort(logs.begin(), logs.end());
+  for (auto number : logs) {
+    std::ifstream is(file(number, ".log"), std::ios::binary);
+    auto contents = std::string(std::istreambuf_iterator<char>(is),
+                                std::istreambuf_iterator<char>());
+    auto input = std::string_view(contents);
+    while (input.size() >= 8) {
+      auto checksum = get_fixed32(input.data());
+      auto size = get_fixed32(input.data() + 4);
+      if (input.size() - 8 < size) {
+        break;
+      }
+      auto payload = input.substr(8, size);
+      input.remove_prefix(8 + size);
+      std::string_view key;
+      std::string_view value;
+      if (crc32(payload) != checksum || payload.empty()) {
+        break;
+      }
+      auto type = payload.front();
+      payload.remove_prefix(1);
+      if (!get_length_prefixed(payload, key) ||
+          (type == put_record && !get_length_prefixed(payload, value))) {
+        break;
+      }
+      (*state->active)[std::string(key)] =
+          entry{std::string(value), type == erase_record};
+    }
+  }
+  if (!state->active->empty()) {
+    state->runs.insert(state->runs.begin(),
+                       write_run(*state->active, !state->runs.empty()));
+    state->active = std::make_shared<memtable>(less_);
+  }
+  version_ = state;
+  open_log();
+  write_manifest(*state);
+  for (auto number : logs) {
+    std::filesystem::remove(file(number, ".log"));
+  }
+  worker_ = std::thread(&lsm::work, this);
+}
+
+lsm::~lsm() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  worker_.join();
+  std::fclose(log_);
+}
+
+lsm::cursor lsm::first() const {
+  auto result = cursor(current(), less_);
+  result.seek_first();
+  return result;
+}
+
+lsm::cursor lsm::last() const {
+  auto result = cursor(current(), less_);
+  result.seek_end();
+  return result;
+}
+
+lsm::cursor lsm::lookup(key_type key) const {
+  auto result = lower_bound(key);
+  if (result.current_ != result.sources_.size() && less_(key, result.key())) {
+    result.seek_end();
+  }
+  return result;
+}
+
+lsm::cursor lsm::lower_bound(key_type key) const {
+  auto result = cursor(current(), less_);
+  result.seek(key);
+  return result;
+}
+
+lsm::cursor lsm::insert_or_assign(lsm::cursor, const value_type& value) {
+  write(put_record, value.first, value.second);
+  return lookup(value.first);
+}
+
+lsm::cursor lsm::erase(lsm::cursor pos) {
+  auto key = std::string(pos.key());
+  write(erase_record, key, std::string_view());
+  return lower_bound(key);
+}
+
+client::size_type lsm::size() const {
+  size_type result = 0;
+  for (auto it = first(); it.current_ != it.sources_.size(); it.increment()) {
+    ++result;
+  }
+  return result;
+}
+
+client::size_type lsm::capacity() const {
+  return std::numeric_limits<size_type>::max();
+}
+
+void lsm::clear() {
+  std::unique_lock lock(mutex_);
+  changed_.wait(lock,
+                [this] { return (!busy_ && !current()->immutable) || error_; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  for (const auto& item : current()->runs) {
+    item->obsolete = true;
+  }
+  std::fclose(log_);
+  auto obsolete = log_number_;
+  open_log();
+  auto next = std::make_shared<version>();
+  next->active = std::make_shared<memtable>(less_);
+  write_manifest(*next);
+  publish(std::move(next));
+  bytes_ = 0;
+  std::filesystem::remove(file(obsolete, ".log"));
+}
+
+void lsm::flush() {
+  if (!current()->active->empty()) {
+    rotate();
+  }
+  std::unique_lock lock(mutex_);
+  changed_.wait(lock, [this] { return (!busy_ && !pending()) || error_; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+std::size_t lsm::runs() const { return current()->runs.size(); }
+
+std::shared_ptr<const lsm::version> lsm::current() const {
+  return std::atomic_load(&version_);
+}
+
+void lsm::publish(std::shared_ptr<const version> next) {
+  std::atomic_store(&version_, std::move(next));
+}
+
+void lsm::write(char type, key_type key, std::string_view value) {
+  check();
+  record_.assign(8, '\0');
+  record_.push_back(type);
+  put_length_prefixed(record_, key);
+  if (type == put_record) {
+    put_length_prefixed(record_, value);
+  }
+  auto payload = std::string_view(record_).substr(8);
+  auto header = std::string();
+  put_fixed32(header, crc32(payload));
+  put_fixed32(header, static_cast<std::uint32_t>(payload.size()));
+  record_.replace(0, 8, header);
+  if (std::fwrite(record_.data(), 1, record_.size(), log_) != record_.size() ||
+      std::fflush(log_) != 0 || (sync_ && !sync(log_))) {
+    throw std::system_error(errno, std::generic_category(),
+                            "unable to write log");
+  }
+
+  auto& memory = *current()->active;
+  auto it = memory.find(key);
+  if (it == memory.end()) {
+    memory.emplace(std::string(key),
+                   entry{std::string(value), type == erase_record});
+  } else {
+    it->second.value.assign(value);
+    it->second.erased = type == erase_record;
+  }
+  bytes_ += key.size() + value.size() + node_overhead;
+  if (bytes_ >= memtable_size_) {
+    rotate();
+  }
+}
+
+void lsm::open_log() {
+  auto number = next_number_++;
+  auto path = file(number, ".log");
+  log_ = std::fopen(path.string().c_str(), "ab");
+  if (log_ == nullptr) {
+    throw std::filesystem::filesystem_error(
+        "unable to open log", path,
+        std::error_code(errno, std::generic_category()));
+  }
+  log_number_ = number;
+}
+
+void lsm::rotate() {
+  std::unique_lock lock(mutex_);
+  // Writers wait for the previous memtable to be flushed
+  changed_.wait(lock, [this] { return !current()->immutable || error_; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  auto state = current();
+  auto next = std::make_shared<version>();
+  next->active = std::make_shared<memtable>(less_);
+  next->immutable = state->active;
+  next->runs = state->runs;
+  std::fclose(log_);
+  immutable_number_ = log_number_;
+  open_log();
+  publish(std::move(next));
+  bytes_ = 0;
+  changed_.notify_all();
+}
+
+void lsm::work() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this] { return stop_ || pending(); });
+    if (stop_) {
+      return;
+    }
+    busy_ = true;
+    lock.unlock();
+    try {
+      if (current()->immutable) {
+        flush_immutable();
+      } else {
+        compact();
+      }
+    } catch (...) {
+      lock.lock();
+      error_ = std::current_exception();
+      failed_ = true;
+      busy_ = false;
+      changed_.notify_all();
+      return;
+    }
+    lock.lock();
+    busy_ = false;
+    changed_.notify_all();
+  }
+}
+
+bool lsm::pending() const {
+  auto state = current();
+  return state->immutable || state->runs.size() >= compaction_trigger_;
+}
+
+void lsm::flush_immutable() {
+  auto state = current();
+  auto result = write_run(*state->immutable, !state->runs.empty());
+  std::uint64_t obsolete;
+  {
+    std::lock_guard lock(mutex_);
+    auto next = std::make_shared<version>(*current());
+    next->immutable = nullptr;
+    next->runs.insert(next->runs.begin(), std::move(result));
+    write_manifest(*next);
+    publish(std::move(next));
+    obsolete = immutable_number_;
+  }
+  std::filesystem::remove(file(obsolete, ".log"));
+}
+
+void lsm::compact() {
+  // Only the worker changes the runs, so the range stays valid
+  auto state = current();
+  auto [begin, end] = select(state->runs);
+  auto merged = std::vector<std::shared_ptr<run>>(
+      state->runs.begin() + begin, state->runs.begin() + end);
+  auto result = merge_runs(merged, end != state->runs.size());
+  {
+    std::lock_guard lock(mutex_);
+    auto next = std::make_shared<version>(*current());
+    auto it = next->runs.erase(next->runs.begin() + begin,
+                               next->runs.begin() + end);
+    if (result->data.size() == 0) {
+      result->obsolete = true;
+    } else {
+      next->runs.insert(it, std::move(result));
+    }
+    write_manifest(*next);
+    publish(std::move(next));
+  }
+  for (const auto& item : merged) {
+    item->obsolete = true;
+  }
+}
+
+std::pair<std::size_t, std::size_t> lsm::select(
+    const std::vector<std::shared_ptr<run>>& runs) {
+  // Take the newest adjacent runs where each is no larger than the newer
+  // ones together, so that a large run waits for the others to catch up
+  for (std::size_t begin = 0; begin + 1 < runs.size(); ++begin) {
+    auto bytes = runs[begin]->bytes;
+    auto end = begin + 1;
+    while (end < runs.size() && runs[end]->bytes <= bytes) {
+      bytes += runs[end++]->bytes;
+    }
+    if (end - begin > 1) {
+      return {begin, end};
+    }
+  }
+  // Sizes grow faster than that with age, so merge the smallest pair
+  auto best = std::size_t{0};
+  for (std::size_t i = 1; i + 1 < runs.size(); ++i) {
+    if (runs[i]->bytes + runs[i + 1]->bytes <
+        runs[best]->bytes + runs[best + 1]->bytes) {
+      best = i;
+    }
+  }
+  return {best, best + 2};
+}
+
+std::shared_ptr<lsm::run> lsm::write_run(const memtable& memory,
+                                         bool shadows) {
+  auto number = next_number_++;
+  auto path = file(number, ".table");
+  // Without prefix compression, keys remain valid for as long as the run
+  auto writer = table_writer(
+      table_configuration(path, compare_).set_restart_interval(1));
+  for (const auto& [key, item] : memory) {
+    if (!item.erased) {
+      writer.add(key, item.value);
+    } else if (shadows) {
+      writer.add_erasure(key);
+    }
+  }
+  writer.finish();
+  return std::make_shared<run>(path, number, compare_);
+}
+
+std::shared_ptr<lsm::run> lsm::merge_runs(
+    const std::vector<std::shared_ptr<run>>& runs, bool shadows) {
+  auto number = next_number_++;
+  auto path = file(number, ".table");
+  auto writer = table_writer(
+      table_configuration(path, compare_).set_restart_interval(1));
+  auto sources = std::vector<cursor::source>();
+  sources.reserve(runs.size());
+  for (const auto& item : runs) {
+    sources.emplace_back(&item->data);
+    sources.back().seek_first();
+  }
+  while (true) {
+    // The newest source holding the least key supplies it
+    auto best = sources.size();
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+      if (sources[i].valid() &&
+          (best == sources.size() ||
+           less_(sources[i].key(), sources[best].key()))) {
+        best = i;
+      }
+    }
+    if (best == sources.size()) {
+      break;
+    }
+    auto key = sources[best].key();
+    if (!sources[best].erased()) {
+      writer.add(key, sources[best].value());
+    } else if (shadows) {
+      writer.add_erasure(key);
+    }
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+      if (i != best && sources[i].valid() &&
+          !less_(key, sources[i].key())) {
+        sources[i].next();
+      }
+    }
+    sources[best].next();
+  }
+  writer.finish();
+  return std::make_shared<run>(path, number, compare_);
+}
+
+void lsm::write_manifest(const version& state) const {
+  auto path = path_ / "MANIFEST";
+  auto temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream os(temporary, std::ios::trunc);
+    os << "log " << (state.immutable ? immutable_number_ : log_number_)
+       << '\n';
+    for (const auto& item : state.runs) {
+      os << "run " << item->number << '\n';
+    }
+    if (!os.flush()) {
+      throw std::filesystem::filesystem_error(
+          "unable to write manifest", temporary,
+          std::make_error_code(std::errc::io_error));
+    }
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+std::filesystem::path lsm::file(std::uint64_t number,
+                                const char* extension) const {
+  auto name = std::to_string(number);
+  if (name.size() < 6) {
+    name.insert(0, 6 - name.size(), '0');
+  }
+  return path_ / (name + extension);
+}
+
+void lsm::check() const {
+  if (failed_) {
+    std::lock_guard lock(mutex_);
+    std::rethrow_exception(error_);
+  }
+}
+
+lsm::cursor::cursor(std::shared_ptr<const version> state, key_less less)
+    : version_(std::move(state)), less_(less) {
+  sources_.reserve(version_->runs.size() + 2);
+  if (version_->active) {
+    sources_.emplace_back(version_->active.get());
+  }
+  if (version_->immutable) {
+    sources_.emplace_back(version_->immutable.get());
+  }
+  for (const auto& item : version_->runs) {
+    sources_.emplace_back(&item->data);
+  }
+  current_ = sources_.size();
+}
+
+std::string_view lsm::cursor::key() const { return sources_[current_].key(); }
+
+std::string_view lsm::cursor::value() const {
+  return sources_[current_].value();
+}
+
+void lsm::cursor::increment() {
+  key_.assign(key());
+  for (auto& item : sources_) {
+    if (item.valid() && equal(item.key(), key_)) {
+      item.next();
+    }
+  }
+  settle();
+}
+
+void lsm::cursor::decrement() {
+  auto end = current_ == sources_.size();
+  if (!end) {
+    key_.assign(key());
+  }
+  while (true) {
+    // Step each source back before the key, and pick the greatest of those
+    // keys, preferring the newest source
+    auto best = sources_.size();
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+      auto& item = sources_[i];
+      if (!item.at_first()) {
+        item.previous();
+      }
+      if (item.valid() && (end || less_(item.key(), key_)) &&
+          (best == sources_.size() || less_(sources_[best].key(), item.key()))) {
+        best = i;
+      }
+    }
+    if (best == sources_.size()) {
+      seek_end();
+      return;
+    }
+    // Return the others to the first key not before the chosen key
+    auto chosen = sources_[best].key();
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+      auto& item = sources_[i];
+      if (i != best && item.valid() && (end || less_(item.key(), key_)) &&
+          !equal(item.key(), chosen)) {
+        item.next();
+      }
+    }
+    current_ = best;
+    if (!sources_[best].erased()) {
+      return;
+    }
+    key_.assign(chosen);
+    end = false;
+  }
+}
+
+bool lsm::cursor::operator==(const cursor& rhs) const {
+  auto end = current_ == sources_.size();
+  if (end || rhs.current_ == rhs.sources_.size()) {
+    return end && rhs.current_ == rhs.sources_.size();
+  }
+  return key() == rhs.key();
+}
+
+bool lsm::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+void lsm::cursor::seek(key_type key) {
+  for (auto& item : sources_) {
+    item.seek(key);
+  }
+  settle();
+}
+
+void lsm::cursor::seek_first() {
+  for (auto& item : sources_) {
+    item.seek_first();
+  }
+  settle();
+}
+
+void lsm::cursor::seek_end() {
+  for (auto& item : sources_) {
+    item.seek_end();
+  }
+  current_ = sources_.size();
+}
+
+void lsm::cursor::settle() {
+  while (true) {
+    current_ = sources_.size();
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+      if (sources_[i].valid() &&
+          (current_ == sources_.size() ||
+           less_(sources_[i].key(), sources_[current_].key()))) {
+        current_ = i;
+      }
+    }
+    if (current_ == sources_.size() || !sources_[current_].erased()) {
+      return;
+    }
+    key_.assign(sources_[current_].key());
+    for (auto& item : sources_) {
+      if (item.valid() && equal(item.key(), key_)) {
+        item.next();
+      }
+    }
+  }
+}
+
+bool lsm::cursor::equal(std::string_view lhs, std::string_view rhs) const {
+  return !less_(lhs, rhs) && !less_(rhs, lhs);
+}
+
+lsm::cursor::source::source(const memtable* memory)
+    : memory_(memory), it_(memory->end()) {}
+
+lsm::cursor::source::source(const table* run)
+    : run_(run), cursor_(run->last()) {}
+
+bool lsm::cursor::source::valid() const {
+  return memory_ != nullptr ? it_ != memory_->end() : cursor_ != run_->last();
+}
+
+bool lsm::cursor::source::at_first() const {
+  return memory_ != nullptr ? it_ == memory_->begin()
+                            : cursor_ == run_->first();
+}
+
+std::string_view lsm::cursor::source::key() const {
+  return memory_ != nullptr ? std::string_view(it_->first) : cursor_.key();
+}
+
+std::string_view lsm::cursor::source::value() const {
+  return memory_ != nullptr ? std::string_view(it_->second.value)
+                            : cursor_.value();
+}
+
+bool lsm::cursor::source::erased() const {
+  return memory_ != nullptr ? it_->second.erased : cursor_.erased();
+}
+
+void lsm::cursor::source::seek(key_type key) {
+  if (memory_ != nullptr) {
+    it_ = memory_->lower_bound(key);
+  } else {
+    cursor_ = run_->lower_bound(key);
+  }
+}
+
+void lsm::cursor::source::seek_first() {
+  if (memory_ != nullptr) {
+    it_ = memory_->begin();
+  } else {
+    cursor_ = run_->first();
+  }
+}
+
+void lsm::cursor::source::seek_end() {
+  if (memory_ != nullptr) {
+    it_ = memory_->end();
+  } else {
+    cursor_ = run_->last();
+  }
+}
+
+void lsm::cursor::source::next() {
+  if (memory_ != nullptr) {
+    ++it_;
+  } else {
+    cursor_.increment();
+  }
+}
+
+void lsm::cursor::source::previous() {
+  if (memory_ != nullptr) {
+    --it_;
+  } else {
+    cursor_.decrement();
+  }
+}
+
+}  // namespace datastore::clients::detail
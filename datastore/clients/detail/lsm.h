@@ -0,0 +1,218 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <datastore/client.h>
+#include <datastore/clients/detail/table.h>
+#include <datastore/clients/lsm.h>
+#include <datastore/compare.h>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** Log-structured merge backend
+ *
+ * Writes are appended to a log and applied to an in-memory memtable. A full
+ * memtable becomes immutable and a worker thread writes it to a sorted run,
+ * a table file. Once there are too many runs, the worker merges the newest
+ * runs of similar size, so that each element is rewritten a logarithmic
+ * number of times rather than on every compaction. Erasures are recorded as
+ * markers which shadow older runs until a merge including the oldest run
+ * drops them.
+ *
+ * Cursors merge the memtables and runs of the version they were created on,
+ * which they keep alive, so that background work never invalidates them.
+ * Like map, a datastore may be used by one thread at a time.
+ */
+class lsm {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Opens the datastore, replaying any writes left in the log */
+  explicit lsm(const lsm_configuration& configuration);
+
+  /** Stops background work; unflushed writes remain in the log */
+  ~lsm();
+
+  lsm(const lsm&) = delete;
+  lsm& operator=(const lsm&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+
+  /** Counts the elements, which requires a merge of every run */
+  [[nodiscard]] size_type size() const;
+
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+  /** Writes the memtable to a run and waits for background work to finish */
+  void flush();
+
+  /** Returns the number of sorted runs */
+  [[nodiscard]] std::size_t runs() const;
+
+ private:
+  struct entry {
+    std::string value;
+    bool erased;
+  };
+  using memtable = std::map<std::string, entry, key_less>;
+
+  /** A sorted run, whose file is removed once it is obsolete and unused */
+  struct run {
+    run(std::filesystem::path path, std::uint64_t number,
+        key_compare compare);
+    ~run();
+    std::filesystem::path path;
+    std::uint64_t number;
+    table data;
+    std::uintmax_t bytes; /** Size of the file */
+    std::atomic<bool> obsolete = false;
+  };
+
+  /** The memtables and runs making up the datastore, newest first */
+  struct version {
+    std::shared_ptr<memtable> active;
+    std::shared_ptr<const memtable> immutable;
+    std::vector<std::shared_ptr<run>> runs;
+  };
+
+  [[nodiscard]] std::shared_ptr<const version> current() const;
+  void publish(std::shared_ptr<const version> next);
+  void write(char type, key_type key, std::string_view value);
+  void open_log();
+  void rotate();
+  void work();
+  [[nodiscard]] bool pending() const;
+  void flush_immutable();
+  void compact();
+
+  /** Returns the range of adjacent runs to merge, newest first */
+  [[nodiscard]] static std::pair<std::size_t, std::size_t> select(
+      const std::vector<std::shared_ptr<run>>& runs);
+
+  /** Writes the memory to a new run, with markers for its erased keys if
+   * there are older runs for them to shadow */
+  std::shared_ptr<run> write_run(const memtable& memory, bool shadows);
+
+  /** Merges adjacent runs, newest first, into a new run, keeping erasure
+   * markers if there are older runs for them to shadow */
+  std::shared_ptr<run> merge_runs(const std::vector<std::shared_ptr<run>>& runs,
+                                  bool shadows);
+  void write_manifest(const version& state) const;
+  [[nodiscard]] std::filesystem::path file(std::uint64_t number,
+                                           const char* extension) const;
+  void check() const;
+
+  std::filesystem::path path_;
+  key_compare compare_;
+  key_less less_;
+  std::size_t memtable_size_;
+  std::size_t compaction_trigger_;
+  bool sync_;
+
+  std::shared_ptr<const version> version_; /** Accessed atomically */
+  std::size_t bytes_ = 0;                  /** Size of the active memtable */
+  std::FILE* log_ = nullptr;
+  std::string record_; /** Buffer for encoding log records */
+  std::uint64_t log_number_ = 0;       /** Log of the active memtable */
+  std::uint64_t immutable_number_ = 0; /** Log of the immutable memtable */
+  std::atomic<std::uint64_t> next_number_ = 1;
+
+  mutable std::mutex mutex_; /** Guards background work and the manifest */
+  std::condition_variable changed_;
+  bool stop_ = false;
+  bool busy_ = false;
+  std::exception_ptr error_; /** Failure of the worker */
+  std::atomic<bool> failed_ = false;
+  std::thread worker_;
+};
+
+/** Merges the memtables and runs of a version into one ordered sequence
+ *
+ * Each source is kept at the first of its keys which does not order before
+ * the current key, and the newest source holding the current key supplies
+ * its value. Erased keys are skipped in both directions. */
+class lsm::cursor {
+ public:
+  /** Keys of tables are decoded into a buffer of the cursor */
+  static constexpr bool transient_keys = true;
+
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class lsm;
+
+ private:
+  /** Position in a single memtable or run */
+  class source {
+   public:
+    explicit source(const memtable* memory);
+    explicit source(const table* run);
+    [[nodiscard]] bool valid() const;
+    [[nodiscard]] bool at_first() const;
+    [[nodiscard]] std::string_view key() const;
+    [[nodiscard]] std::string_view value() const;
+    [[nodiscard]] bool erased() const;
+    void seek(key_type key);
+    void seek_first();
+    void seek_end();
+    void next();
+    void previous();
+
+   private:
+    const memtable* memory_ = nullptr;
+    memtable::const_iterator it_;
+    const table* run_ = nullptr;
+    table::cursor cursor_;
+  };
+
+  cursor(std::shared_ptr<const version> state, key_less less);
+
+  /** Positions every source at key and settles on the first visible key */
+  void seek(key_type key);
+
+  /** Positions every source at its first key */
+  void seek_first();
+
+  /** Positions every source at its end */
+  void seek_end();
+
+  /** Moves forwards from the current sources to the first unerased key */
+  void settle();
+
+  [[nodiscard]] bool equal(std::string_view lhs, std::string_view rhs) const;
+
+  std::shared_ptr<const version> version_;
+  key_less less_;
+  std::vector<source> sources_;
+  std::size_t current_ = 0; /** Source supplying the element, or the end */
+  std::string key_;         /** Copy of a key while sources move past it */
+};
+
+}  // namespace datastore::clients::detail
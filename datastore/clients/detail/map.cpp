@@ -1,58 +1,282 @@
 #include "map.h"
+#include <limits>
 
 namespace datastore::clients::detail {
 
-std::unique_ptr<client::cursor> map::erase(
-    std::unique_ptr<client::cursor> pos) {
-  auto cursor = dynamic_cast<const map::cursor*>(pos.get());
-  if (cursor) {
-    auto it = data_.erase(cursor->it_);
-    pos = std::make_unique<map::cursor>(it);
+namespace {
+
+/** Derives a node's priority from its key, so that the shape of the treap
+ * only depends on its keys */
+std::uint64_t priority(std::string_view key) noexcept {
+  auto h = static_cast<std::uint64_t>(std::hash<std::string_view>()(key));
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+}  // namespace
+
+map::item::item(std::string_view key, std::string_view value)
+    : key(key), value(value) {}
+
+map::node::node(item_ptr value, std::uint64_t priority, node_ptr left,
+                node_ptr right)
+    : value(std::move(value)),
+      priority(priority),
+      left(std::move(left)),
+      right(std::move(right)),
+      size(count(this->left) + count(this->right) + 1),
+      bytes(weight(this->left) + weight(this->right) +
+            this->value->key.size() + this->value->value.size()) {}
+
+client::size_type map::node::count(const node_ptr& tree) noexcept {
+  return tree ? tree->size : 0;
+}
+
+client::size_type map::node::weight(const node_ptr& tree) noexcept {
+  return tree ? tree->bytes : 0;
+}
+
+map::map(key_compare compare) : less_(compare) {}
+
+map::map(const map& rhs) : less_(rhs.less_), root_(rhs.root()) {}
+
+map::cursor map::first() const {
+  auto result = cursor(root(), less_);
+  if (result.root_) {
+    result.path_.push_back(result.root_.get());
+    result.leftmost();
   }
-  return pos;
+  return result;
 }
 
-std::unique_ptr<client::cursor> map::lookup(key_type key) const {
-  return std::make_unique<cursor>(data_.find(key));
+map::cursor map::last() const { return cursor(root(), less_); }
+
+map::cursor map::lookup(key_type key) const {
+  auto result = lower_bound(key);
+  if (!result.path_.empty() && less_(key, result.key())) {
+    result.path_.clear();
+  }
+  return result;
 }
 
-std::unique_ptr<client::cursor> map::first() const {
-  return std::make_unique<cursor>(data_.begin());
+map::cursor map::lower_bound(key_type key) const {
+  auto result = cursor(root(), less_);
+  // The path is cut back to the last node which does not order before key
+  auto found = std::size_t{0};
+  for (auto position = result.root_.get(); position != nullptr;) {
+    result.path_.push_back(position);
+    if (less_(position->value->key, key)) {
+      position = position->right.get();
+    } else {
+      found = result.path_.size();
+      position = position->left.get();
+    }
+  }
+  result.path_.resize(found);
+  return result;
+}
+
+map::cursor map::insert_or_assign(map::cursor, const value_type& value) {
+  auto tree = insert(root(), item_ptr(new item(value.first, value.second)));
+  publish(tree);
+  return lookup(value.first);
 }
 
-std::unique_ptr<client::cursor> map::last() const {
-  return std::make_unique<cursor>(data_.end());
+map::cursor map::erase(map::cursor pos) {
+  auto key = std::string(pos.key());
+  publish(erase(root(), key));
+  return lower_bound(key);
 }
 
-std::unique_ptr<client::cursor> map::insert_or_assign(
-    std::unique_ptr<client::cursor> pos, const value_type& value) {
-  auto cursor = dynamic_cast<const map::cursor*>(pos.get());
-  if (cursor) {
-    pos = std::make_unique<map::cursor>(data_.insert_or_assign(
-        cursor->it_, std::string(value.first), std::string(value.second)));
+client::size_type map::size() const { return node::count(root()); }
+
+client::size_type map::capacity() const {
+  return std::numeric_limits<size_type>::max();
+}
+
+void map::clear() { publish(nullptr); }
+
+range_estimate map::estimate(key_type from, key_type to) const {
+  // Both ends are ranked in the same version
+  auto tree = root();
+  auto first = before(tree, from);
+  auto last = to.empty() ? range_estimate{node::count(tree), node::weight(tree)}
+                         : before(tree, to);
+  if (last.count < first.count) {
+    return {};
   }
-  return pos;
+  return {last.count - first.count, last.bytes - first.bytes};
 }
 
-client::size_type map::capacity() const { return data_.max_size(); }
+map map::snapshot() const { return map(*this); }
 
-map::cursor::cursor(map::cursor::iterator it) : it_(it) {}
+range_estimate map::before(const node_ptr& tree, key_type key) const {
+  auto result = range_estimate();
+  for (auto position = tree.get(); position != nullptr;) {
+    if (less_(position->value->key, key)) {
+      result.count += node::count(position->left) + 1;
+      result.bytes += node::weight(position->left) +
+                      position->value->key.size() +
+                      position->value->value.size();
+      position = position->right.get();
+    } else {
+      position = position->left.get();
+    }
+  }
+  return result;
+}
 
-std::string_view map::cursor::key() const { return it_->first; }
+map::node_ptr map::root() const {
+  std::lock_guard lock(mutex_);
+  return root_;
+}
 
-std::string_view map::cursor::value() const { return it_->second; }
+void map::publish(node_ptr root) {
+  {
+    std::lock_guard lock(mutex_);
+    root_.swap(root);
+  }
+  // The previous version, if unshared, is freed outside of the lock
+}
 
-bool map::cursor::equal(const client::cursor& rhs) const {
-  auto c = dynamic_cast<const map::cursor&>(rhs);
-  return it_ == c.it_;
+map::node_ptr map::insert(const node_ptr& tree, const item_ptr& value) {
+  if (!tree) {
+    return node_ptr(new node(value, priority(value->key), nullptr, nullptr));
+  }
+  if (less_(value->key, tree->value->key)) {
+    auto left = insert(tree->left, value);
+    if (left->priority > tree->priority) {
+      // Rotate the new subtree root above this node
+      return node_ptr(new node(
+          left->value, left->priority, left->left,
+          node_ptr(new node(tree->value, tree->priority, left->right,
+                            tree->right))));
+    }
+    return node_ptr(
+        new node(tree->value, tree->priority, std::move(left), tree->right));
+  }
+  if (less_(tree->value->key, value->key)) {
+    auto right = insert(tree->right, value);
+    if (right->priority > tree->priority) {
+      return node_ptr(new node(
+          right->value, right->priority,
+          node_ptr(new node(tree->value, tree->priority, tree->left,
+                            right->left)),
+          right->right));
+    }
+    return node_ptr(
+        new node(tree->value, tree->priority, tree->left, std::move(right)));
+  }
+  return node_ptr(new node(value, tree->priority, tree->left, tree->right));
+}
+
+map::node_ptr map::erase(const node_ptr& tree, key_type key) {
+  if (!tree) {
+    return tree;
+  }
+  if (less_(key, tree->value->key)) {
+    auto left = erase(tree->left, key);
+    return left == tree->left ? tree
+                              : node_ptr(new node(tree->value, tree->priority,
+                                                  std::move(left),
+                                                  tree->right));
+  }
+  if (less_(tree->value->key, key)) {
+    auto right = erase(tree->right, key);
+    return right == tree->right
+               ? tree
+               : node_ptr(new node(tree->value, tree->priority, tree->left,
+                                   std::move(right)));
+  }
+  // Merge the children, keeping the one with the higher priority on top
+  struct merge {
+    node_ptr operator()(const node_ptr& lhs, const node_ptr& rhs) const {
+      if (!lhs || !rhs) {
+        return lhs ? lhs : rhs;
+      }
+      if (lhs->priority > rhs->priority) {
+        return node_ptr(new node(lhs->value, lhs->priority, lhs->left,
+                                 (*this)(lhs->right, rhs)));
+      }
+      return node_ptr(new node(rhs->value, rhs->priority,
+                               (*this)(lhs, rhs->left), rhs->right));
+    }
+  };
+  return merge()(tree->left, tree->right);
+}
+
+map::cursor::cursor(node_ptr root, key_less less)
+    : root_(std::move(root)), less_(less) {}
+
+std::string_view map::cursor::key() const {
+  return path_.back()->value->key;
+}
+
+std::string_view map::cursor::value() const {
+  return path_.back()->value->value;
+}
+
+void map::cursor::increment() {
+  if (path_.back()->right) {
+    path_.push_back(path_.back()->right.get());
+    leftmost();
+    return;
+  }
+  // The successor is the nearest ancestor reached from its left, and as a
+  // scan walks each edge twice, steps take amortised constant time
+  const node* child;
+  do {
+    child = path_.back();
+    path_.pop_back();
+  } while (!path_.empty() && path_.back()->right.get() == child);
 }
 
-void map::cursor::increment() { ++it_; }
+void map::cursor::decrement() {
+  if (path_.empty()) {
+    if (root_) {
+      path_.push_back(root_.get());
+      rightmost();
+    }
+    return;
+  }
+  if (path_.back()->left) {
+    path_.push_back(path_.back()->left.get());
+    rightmost();
+    return;
+  }
+  const node* child;
+  do {
+    child = path_.back();
+    path_.pop_back();
+  } while (!path_.empty() && path_.back()->left.get() == child);
+}
 
-void map::cursor::decrement() { --it_; }
+void map::cursor::leftmost() {
+  while (path_.back()->left) {
+    path_.push_back(path_.back()->left.get());
+  }
+}
+
+void map::cursor::rightmost() {
+  while (path_.back()->right) {
+    path_.push_back(path_.back()->right.get());
+  }
+}
+
+bool map::cursor::operator==(const map::cursor& rhs) const {
+  if (path_.empty() || rhs.path_.empty()) {
+    return path_.empty() && rhs.path_.empty();
+  }
+  // Versions share items, so comparing the keys is rarely needed
+  const auto& lhs = path_.back()->value;
+  return lhs == rhs.path_.back()->value ||
+         (!less_(key(), rhs.key()) && !less_(rhs.key(), key()));
+}
 
-std::unique_ptr<client::cursor> map::cursor::clone() const {
-  return std::make_unique<map::cursor>(it_);
+bool map::cursor::operator!=(const map::cursor& rhs) const {
+  return !(*this == rhs);
 }
 
-}  // namespace datastore::clients::detail
\ No newline at end of file
+}  // namespace datastore::clients::detail
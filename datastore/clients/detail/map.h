@@ -1,45 +1,141 @@
 #pragma once
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <boost/smart_ptr/intrusive_ref_counter.hpp>
+#include <cstdint>
 #include <datastore/client.h>
-#include <map>
-#include "lmdb.h"
+#include <datastore/compare.h>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace datastore::clients::detail {
 
-class map final : public client {
+/** In-memory backend over a persistent treap
+ *
+ * Writes copy the path from the root to the modified node and publish a new
+ * root, leaving every other version intact. Copying a map or a cursor
+ * therefore captures a point-in-time snapshot in constant time: cursors
+ * iterate the version they were created on, and are never invalidated by
+ * later writes.
+ *
+ * Writes must be serialised, but since the root is swapped under a mutex,
+ * other threads may take snapshots and read them while one thread writes.
+ *
+ * Each node counts the elements and bytes of its subtree, so that ranges of
+ * keys are sized exactly in O(log n).
+ */
+class map {
  public:
-  using iterator = iterator;
-  std::unique_ptr<client::cursor> erase(
-      std::unique_ptr<client::cursor> pos) override;
-  [[nodiscard]] std::unique_ptr<client::cursor> lookup(
-      key_type key) const override;
-  [[nodiscard]] std::unique_ptr<client::cursor> first() const override;
-  [[nodiscard]] std::unique_ptr<client::cursor> last() const override;
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
 
- protected:
-  [[nodiscard]] size_type capacity() const override;
+  /** Creates an empty map ordered by the given comparator */
+  explicit map(key_compare compare = nullptr);
 
- protected:
-  std::unique_ptr<client::cursor> insert_or_assign(
-      std::unique_ptr<client::cursor> cursor, const value_type& value) override;
+  /** Creates a snapshot of rhs, which shares its structure */
+  map(const map& rhs);
+
+  map& operator=(const map& rhs) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+  /** Returns the exact number and size of the elements in [from, to) */
+  [[nodiscard]] range_estimate estimate(key_type from, key_type to) const;
+
+  /** Returns a point-in-time copy, which may be modified independently */
+  [[nodiscard]] map snapshot() const;
 
  private:
-  class cursor : public client::cursor {
-   public:
-    using iterator = std::map<std::string, std::string>::const_iterator;
-    explicit cursor(iterator it);
-    [[nodiscard]] std::string_view key() const override;
-    [[nodiscard]] std::string_view value() const override;
-    [[nodiscard]] bool equal(const client::cursor& rhs) const override;
-    void increment() override;
-    void decrement() override;
-    [[nodiscard]] std::unique_ptr<client::cursor> clone() const override;
-
-    friend class map;
-
-   private:
-    iterator it_;
-  };
-
-  std::map<std::string, std::string, std::less<>> data_;
+  struct item;
+  struct node;
+  using item_ptr = boost::intrusive_ptr<const item>;
+  using node_ptr = boost::intrusive_ptr<const node>;
+
+  [[nodiscard]] node_ptr root() const;
+  void publish(node_ptr root);
+
+  [[nodiscard]] node_ptr insert(const node_ptr& tree, const item_ptr& value);
+  [[nodiscard]] node_ptr erase(const node_ptr& tree, key_type key);
+
+  /** Returns the number and size of the elements of tree ordered before key
+   */
+  [[nodiscard]] range_estimate before(const node_ptr& tree,
+                                      key_type key) const;
+
+  key_less less_;
+  mutable std::mutex mutex_; /** Guards the root */
+  node_ptr root_;
+};
+
+/** An immutable key and value, shared between versions */
+struct map::item
+    : boost::intrusive_ref_counter<item, boost::thread_safe_counter> {
+  item(std::string_view key, std::string_view value);
+  const std::string key;
+  const std::string value;
 };
-}  // namespace datastore::clients::detail
\ No newline at end of file
+
+/** An immutable node of the treap, shared between versions */
+struct map::node
+    : boost::intrusive_ref_counter<node, boost::thread_safe_counter> {
+  node(item_ptr value, std::uint64_t priority, node_ptr left, node_ptr right);
+
+  /** Returns the number of elements in tree */
+  static size_type count(const node_ptr& tree) noexcept;
+
+  /** Returns the bytes of the keys and values in tree */
+  static size_type weight(const node_ptr& tree) noexcept;
+
+  const item_ptr value;
+  const std::uint64_t priority; /** Heap order, derived from the key */
+  const node_ptr left;
+  const node_ptr right;
+  const size_type size;  /** Elements in this subtree */
+  const size_type bytes; /** Of the keys and values in this subtree */
+};
+
+class map::cursor {
+ public:
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+
+  /** Cursors are equal at the same element, even in different versions */
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class map;
+
+ private:
+  cursor(node_ptr root, key_less less);
+
+  /** Descends from the last node of the path to its first descendant */
+  void leftmost();
+
+  /** Descends from the last node of the path to its last descendant */
+  void rightmost();
+
+  node_ptr root_; /** Version being iterated */
+  /** Nodes from the root to the current node, empty at the end */
+  std::vector<const node*> path_;
+  key_less less_;
+};
+
+}  // namespace datastore::clients::detail
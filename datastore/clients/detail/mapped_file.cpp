@@ -0,0 +1,103 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace datastore::clients::detail {
+
+#ifndef _WIN32
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), path.string());
+  }
+  struct stat status {};
+  if (::fstat(fd, &status) != 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), path.string());
+  }
+  size_ = static_cast<std::size_t>(status.st_size);
+  if (size_ > 0) {
+    auto address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      auto error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), path.string());
+    }
+    data_ = static_cast<const char*>(address);
+  }
+  // The mapping remains valid once the descriptor is closed
+  ::close(fd);
+}
+
+mapped_file::~mapped_file() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+void mapped_file::advise(std::size_t offset, std::size_t length,
+                         advice hint) const {
+  if (data_ == nullptr || offset >= size_) {
+    return;
+  }
+  // madvise requires a page aligned start
+  auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  auto start = offset / page * page;
+  length = std::min(length, size_ - offset) + (offset - start);
+  int flags = MADV_NORMAL;
+  switch (hint) {
+    case advice::normal:
+      flags = MADV_NORMAL;
+      break;
+    case advice::random:
+      flags = MADV_RANDOM;
+      break;
+    case advice::sequential:
+      flags = MADV_SEQUENTIAL;
+      break;
+    case advice::willneed:
+      flags = MADV_WILLNEED;
+      break;
+    case advice::dontneed:
+      flags = MADV_DONTNEED;
+      break;
+  }
+  // Advice is only a hint, so failures are ignored
+  ::madvise(const_cast<char*>(data_) + start, length, flags);
+}
+
+#else
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is) {
+    throw std::system_error(
+        std::make_error_code(std::errc::no_such_file_or_directory),
+        path.string());
+  }
+  fallback_.assign(std::istreambuf_iterator<char>(is),
+                   std::istreambuf_iterator<char>());
+  data_ = fallback_.data();
+  size_ = fallback_.size();
+}
+
+mapped_file::~mapped_file() = default;
+
+void mapped_file::advise(std::size_t, std::size_t, advice) const {}
+
+#endif
+
+std::string_view mapped_file::data() const noexcept {
+  return std::string_view(data_, size_);
+}
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,35 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace datastore::clients::detail {
+
+/** A read-only memory mapping of a whole file */
+class mapped_file {
+ public:
+  /** Expected access pattern of a range of the mapping */
+  enum class advice { normal, random, sequential, willneed, dontneed };
+
+  /** Maps the file at path */
+  explicit mapped_file(const std::filesystem::path& path);
+
+  /** Unmaps the file */
+  ~mapped_file();
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  /** Returns the mapped contents */
+  [[nodiscard]] std::string_view data() const noexcept;
+
+  /** Hints the expected access to a range of the mapping to the kernel */
+  void advise(std::size_t offset, std::size_t length, advice hint) const;
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::string fallback_; /** Contents, where mapping is unavailable */
+};
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,280 @@
+#include "skiplist.h"
+#include <cmath>
+#include <limits>
+#include <new>
+
+namespace datastore::clients::detail {
+
+/** An element with a tower of links, allocated in one block */
+class skiplist::node {
+ public:
+  /** Allocates a node of the given height */
+  static node* make(std::string_view key, const std::string* value,
+                    int height) {
+    auto memory = ::operator new(sizeof(node) +
+                                 height * sizeof(std::atomic<node*>));
+    auto result = new (memory) node(key, value, height);
+    for (auto i = 0; i < height; ++i) {
+      new (&result->next(i)) std::atomic<node*>(nullptr);
+    }
+    return result;
+  }
+
+  /** Frees a node and its value */
+  static void destroy(void* item) {
+    auto self = static_cast<node*>(item);
+    delete self->value.load(std::memory_order_relaxed);
+    self->~node();
+    ::operator delete(self);
+  }
+
+  std::atomic<node*>& next(int level) {
+    return reinterpret_cast<std::atomic<node*>*>(this + 1)[level];
+  }
+
+  const std::string key;
+  std::atomic<const std::string*> value;
+  std::atomic<bool> erased{false};
+  const int height;
+
+ private:
+  node(std::string_view key, const std::string* value, int height)
+      : key(key), value(value), height(height) {}
+};
+
+namespace {
+
+void destroy_value(void* item) { delete static_cast<std::string*>(item); }
+
+/** Nodes of a level in a range which make a large enough sample */
+constexpr std::size_t min_sample = 256;
+
+}  // namespace
+
+skiplist::skiplist(key_compare compare)
+    : less_(compare), head_(node::make({}, nullptr, max_height)) {}
+
+skiplist::~skiplist() {
+  auto item = head_->next(0).load(std::memory_order_relaxed);
+  while (item != nullptr) {
+    auto next = item->next(0).load(std::memory_order_relaxed);
+    node::destroy(item);
+    item = next;
+  }
+  node::destroy(head_);
+}
+
+skiplist::cursor skiplist::first() const {
+  auto result = cursor(this, epoch_.pin());
+  result.node_ = head_->next(0).load(std::memory_order_acquire);
+  return result;
+}
+
+skiplist::cursor skiplist::last() const { return cursor(this, epoch_.pin()); }
+
+skiplist::cursor skiplist::lookup(key_type key) const {
+  auto result = cursor(this, epoch_.pin());
+  auto item = find(key, nullptr);
+  if (item != nullptr && !less_(key, item->key)) {
+    result.node_ = item;
+  }
+  return result;
+}
+
+skiplist::cursor skiplist::lower_bound(key_type key) const {
+  auto result = cursor(this, epoch_.pin());
+  result.node_ = find(key, nullptr);
+  return result;
+}
+
+skiplist::cursor skiplist::insert_or_assign(skiplist::cursor,
+                                            const value_type& value) {
+  auto result = cursor(this, epoch_.pin());
+  std::lock_guard lock(write_mutex_);
+  node* predecessors[max_height];
+  auto item = find(value.first, predecessors);
+  auto replacement = new std::string(value.second);
+  if (item != nullptr && !less_(value.first, item->key)) {
+    // Readers holding the previous value keep it until they unpin
+    auto previous = item->value.exchange(replacement, std::memory_order_acq_rel);
+    epoch_.retire(const_cast<std::string*>(previous), destroy_value);
+  } else {
+    auto height = random_height();
+    if (height > height_.load(std::memory_order_relaxed)) {
+      for (auto i = height_.load(std::memory_order_relaxed); i < height; ++i) {
+        predecessors[i] = head_;
+      }
+      height_.store(height, std::memory_order_relaxed);
+    }
+    item = node::make(value.first, replacement, height);
+    // Complete the tower before publishing it, from the bottom up, so that
+    // a reader finding the node at any level can follow it down
+    for (auto i = 0; i < height; ++i) {
+      item->next(i).store(
+          predecessors[i]->next(i).load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+    }
+    for (auto i = 0; i < height; ++i) {
+      predecessors[i]->next(i).store(item, std::memory_order_release);
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+  epoch_.reclaim();
+  result.node_ = item;
+  return result;
+}
+
+skiplist::cursor skiplist::erase(skiplist::cursor pos) {
+  auto result = cursor(this, epoch_.pin());
+  std::lock_guard lock(write_mutex_);
+  node* predecessors[max_height];
+  auto item = find(pos.key(), predecessors);
+  if (item != nullptr && !less_(pos.key(), item->key)) {
+    item->erased.store(true, std::memory_order_release);
+    // The node keeps its own links, so that cursors at it can move on
+    for (auto i = item->height - 1; i >= 0; --i) {
+      predecessors[i]->next(i).store(
+          item->next(i).load(std::memory_order_relaxed),
+          std::memory_order_release);
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    result.node_ = item->next(0).load(std::memory_order_relaxed);
+    retire(item);
+    epoch_.reclaim();
+  } else {
+    result.node_ = item;
+  }
+  return result;
+}
+
+client::size_type skiplist::size() const {
+  return size_.load(std::memory_order_relaxed);
+}
+
+client::size_type skiplist::capacity() const {
+  return std::numeric_limits<size_type>::max();
+}
+
+void skiplist::clear() {
+  std::lock_guard lock(write_mutex_);
+  auto item = head_->next(0).load(std::memory_order_relaxed);
+  for (auto i = 0; i < max_height; ++i) {
+    head_->next(i).store(nullptr, std::memory_order_release);
+  }
+  while (item != nullptr) {
+    auto next = item->next(0).load(std::memory_order_relaxed);
+    item->erased.store(true, std::memory_order_release);
+    retire(item);
+    item = next;
+  }
+  size_.store(0, std::memory_order_relaxed);
+  epoch_.reclaim();
+}
+
+range_estimate skiplist::estimate(key_type from, key_type to) const {
+  auto guard = epoch_.pin();
+  auto item = head_;
+  // Descends as find does, sampling the range at each level on the way
+  for (auto level = height_.load(std::memory_order_relaxed) - 1; level >= 0;
+       --level) {
+    auto next = item->next(level).load(std::memory_order_acquire);
+    while (next != nullptr && less_(next->key, from)) {
+      item = next;
+      next = item->next(level).load(std::memory_order_acquire);
+    }
+    auto result = range_estimate();
+    for (; next != nullptr && (to.empty() || less_(next->key, to));
+         next = next->next(level).load(std::memory_order_acquire)) {
+      if (!next->erased.load(std::memory_order_acquire)) {
+        ++result.count;
+        result.bytes += next->key.size() +
+                        next->value.load(std::memory_order_acquire)->size();
+      }
+    }
+    if (result.count >= min_sample || level == 0) {
+      // A node reaches each level with a quarter of the probability of the
+      // level below, so the sample has a binomial count
+      auto scale = size_type{1} << (2 * level);
+      result.error =
+          level == 0 ? 0
+                     : static_cast<size_type>(2 * std::sqrt(result.count)) *
+                           scale;
+      result.count *= scale;
+      result.bytes *= scale;
+      return result;
+    }
+  }
+  return {};
+}
+
+skiplist::node* skiplist::find(key_type key, node** predecessors) const {
+  auto item = head_;
+  for (auto level = height_.load(std::memory_order_relaxed) - 1; level >= 0;
+       --level) {
+    auto next = item->next(level).load(std::memory_order_acquire);
+    while (next != nullptr && less_(next->key, key)) {
+      item = next;
+      next = item->next(level).load(std::memory_order_acquire);
+    }
+    if (predecessors != nullptr) {
+      predecessors[level] = item;
+    }
+    if (level == 0) {
+      return next;
+    }
+  }
+  return nullptr;
+}
+
+skiplist::node* skiplist::find_before(const std::string* key) const {
+  auto item = head_;
+  for (auto level = height_.load(std::memory_order_relaxed) - 1; level >= 0;
+       --level) {
+    auto next = item->next(level).load(std::memory_order_acquire);
+    while (next != nullptr && (key == nullptr || less_(next->key, *key))) {
+      item = next;
+      next = item->next(level).load(std::memory_order_acquire);
+    }
+  }
+  return item == head_ ? nullptr : item;
+}
+
+int skiplist::random_height() {
+  // Each level holds a quarter of the nodes of the level below
+  auto height = 1;
+  while (height < max_height && random_() % 4 == 0) {
+    ++height;
+  }
+  return height;
+}
+
+void skiplist::retire(node* item) { epoch_.retire(item, node::destroy); }
+
+skiplist::cursor::cursor(const skiplist* list, epoch::guard guard)
+    : list_(list), guard_(std::move(guard)) {}
+
+std::string_view skiplist::cursor::key() const { return node_->key; }
+
+std::string_view skiplist::cursor::value() const {
+  return *node_->value.load(std::memory_order_acquire);
+}
+
+void skiplist::cursor::increment() {
+  do {
+    node_ = node_->next(0).load(std::memory_order_acquire);
+  } while (node_ != nullptr && node_->erased.load(std::memory_order_acquire));
+}
+
+void skiplist::cursor::decrement() {
+  node_ = list_->find_before(node_ != nullptr ? &node_->key : nullptr);
+}
+
+bool skiplist::cursor::operator==(const cursor& rhs) const {
+  return list_ == rhs.list_ && node_ == rhs.node_;
+}
+
+bool skiplist::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <datastore/client.h>
+#include <datastore/clients/detail/epoch.h>
+#include <datastore/compare.h>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace datastore::clients::detail {
+
+/** Concurrent in-memory backend over a skiplist
+ *
+ * Readers traverse the list without locks, while writers are serialised by
+ * a mutex, as in LMDB. A writer links a node only once it is complete, and
+ * publishes new values by swapping a pointer, so readers see each element
+ * either before or after a write.
+ *
+ * Cursors pin an epoch, so erased nodes and replaced values stay allocated
+ * for as long as a cursor may refer to them. A cursor at an erased element
+ * still moves on to its neighbours. Long-lived cursors therefore hold back
+ * reclamation, much like long-lived LMDB read transactions.
+ *
+ * As the height of a node is independent of its key, the nodes of each
+ * level are a random sample of those below, from which ranges of keys are
+ * sized in O(log n).
+ */
+class skiplist {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Creates an empty list ordered by the given comparator */
+  explicit skiplist(key_compare compare = nullptr);
+
+  /** Frees every node; no cursor may outlive the list */
+  ~skiplist();
+
+  skiplist(const skiplist&) = delete;
+  skiplist& operator=(const skiplist&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+  /** Estimates the elements in [from, to) from the highest level with at
+   * least 256 nodes in the range, with an error within two standard
+   * deviations, which holds about 95% of the time. Ranges with fewer nodes
+   * are counted exactly. */
+  [[nodiscard]] range_estimate estimate(key_type from, key_type to) const;
+
+ private:
+  static constexpr int max_height = 16;
+
+  class node;
+
+  /** Returns the first node whose key does not order before key, filling
+   * in its predecessor at each level if given */
+  node* find(key_type key, node** predecessors) const;
+
+  /** Returns the last node whose key orders before key, or the last node
+   * if key is null */
+  node* find_before(const std::string* key) const;
+
+  [[nodiscard]] int random_height();
+  void retire(node* item);
+
+  key_less less_;
+  node* head_;
+  std::atomic<int> height_{1};
+  std::atomic<size_type> size_{0};
+  std::mutex write_mutex_;
+  std::minstd_rand random_;
+  epoch epoch_;
+};
+
+class skiplist::cursor {
+ public:
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class skiplist;
+
+ private:
+  cursor(const skiplist* list, epoch::guard guard);
+
+  const skiplist* list_ = nullptr;
+  epoch::guard guard_;
+  node* node_ = nullptr; /** Current node, nullptr at the end */
+};
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,297 @@
+#include "table.h"
+#include <algorithm>
+#include <datastore/clients/detail/coding.h>
+#include <stdexcept>
+#include <system_error>
+
+namespace datastore::clients::detail {
+
+namespace {
+
+constexpr std::uint64_t magic = 0x31454c4241545344;  // "DSTABLE1"
+constexpr std::uint32_t version = 1;
+constexpr std::size_t footer_size = 40;
+
+[[noreturn]] void corrupt(const std::filesystem::path& path) {
+  throw std::filesystem::filesystem_error(
+      "corrupt table", path,
+      std::make_error_code(std::errc::illegal_byte_sequence));
+}
+
+[[noreturn]] void read_only() {
+  throw std::system_error(
+      std::make_error_code(std::errc::read_only_file_system),
+      "table is read-only");
+}
+
+}  // namespace
+
+table::table(const table_configuration& configuration)
+    : file_(configuration.path()), less_(configuration.compare()) {
+  auto data = file_.data();
+  if (data.size() < footer_size) {
+    corrupt(configuration.path());
+  }
+  auto footer = data.data() + data.size() - footer_size;
+  auto index_offset = get_fixed64(footer);
+  auto index_size = get_fixed64(footer + 8);
+  count_ = get_fixed64(footer + 16);
+  auto block_count = get_fixed32(footer + 24);
+  if (get_fixed64(footer + 32) != magic || get_fixed32(footer + 28) != version ||
+      index_offset > data.size() - footer_size ||
+      index_size > data.size() - footer_size - index_offset) {
+    corrupt(configuration.path());
+  }
+  file_.advise(0, index_offset,
+               configuration.preload() ? mapped_file::advice::willneed
+                                       : mapped_file::advice::random);
+  file_.advise(index_offset, index_size, mapped_file::advice::willneed);
+
+  auto index = data.substr(index_offset, index_size);
+  blocks_.reserve(block_count);
+  while (!index.empty()) {
+    std::string_view last_key;
+    if (!get_length_prefixed(index, last_key) || index.size() < 12) {
+      corrupt(configuration.path());
+    }
+    auto offset = get_fixed64(index.data());
+    auto size = get_fixed32(index.data() + 8);
+    index.remove_prefix(12);
+    if (offset > index_offset || size > index_offset - offset || size < 4) {
+      corrupt(configuration.path());
+    }
+    auto entries = data.data() + offset;
+    auto restart_count = get_fixed32(entries + size - 4);
+    if (restart_count == 0 || restart_count > (size - 4) / 4) {
+      corrupt(configuration.path());
+    }
+    auto restarts = entries + size - 4 - 4 * restart_count;
+    blocks_.push_back(block{last_key, entries, restarts, restart_count});
+  }
+  if (blocks_.size() != block_count) {
+    corrupt(configuration.path());
+  }
+}
+
+table::cursor table::first() const { return cursor(this, 0); }
+
+table::cursor table::last() const { return cursor(this, blocks_.size()); }
+
+table::cursor table::lookup(key_type key) const {
+  auto result = lower_bound(key);
+  if (result.entry_ == nullptr || less_(key, result.key_)) {
+    return last();
+  }
+  return result;
+}
+
+table::cursor table::lower_bound(key_type key) const {
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), key,
+      [this](const block& lhs, key_type rhs) { return less_(lhs.last_key, rhs); });
+  if (it == blocks_.end()) {
+    return last();
+  }
+  auto result = cursor(this, static_cast<std::size_t>(it - blocks_.begin()));
+  // Find the last restart point ordering before key, where keys are whole
+  auto restart = [&it](std::uint32_t i) {
+    return it->entries + get_fixed32(it->restarts + 4 * i);
+  };
+  std::uint32_t low = 0;
+  std::uint32_t high = it->restart_count - 1;
+  while (low < high) {
+    auto middle = low + (high - low + 1) / 2;
+    result.decode(restart(middle));
+    if (less_(result.key_, key)) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+  result.decode(restart(low));
+  // The block's last key does not order before key, so this stays in block
+  while (less_(result.key_, key)) {
+    result.increment();
+  }
+  return result;
+}
+
+table::cursor table::insert_or_assign(table::cursor, const value_type&) {
+  read_only();
+}
+
+table::cursor table::erase(table::cursor) { read_only(); }
+
+client::size_type table::size() const { return count_; }
+
+client::size_type table::capacity() const { return count_; }
+
+void table::clear() { read_only(); }
+
+table::cursor::cursor(const table* owner, std::size_t block)
+    : table_(owner), block_(block) {
+  if (block_ < table_->blocks_.size()) {
+    decode(table_->blocks_[block_].entries);
+  }
+}
+
+table::cursor::cursor(const cursor& rhs) { assign(rhs); }
+
+table::cursor::cursor(cursor&& rhs) noexcept
+    : table_(rhs.table_),
+      block_(rhs.block_),
+      entry_(rhs.entry_),
+      next_(rhs.next_),
+      key_(rhs.key_),
+      value_(rhs.value_),
+      erased_(rhs.erased_) {
+  // Moving a short string moves its characters, so re-point the key
+  auto owned = !rhs.buffer_.empty() && rhs.key_.data() == rhs.buffer_.data();
+  buffer_ = std::move(rhs.buffer_);
+  if (owned) {
+    key_ = buffer_;
+  }
+}
+
+table::cursor& table::cursor::operator=(const cursor& rhs) {
+  if (this != &rhs) {
+    assign(rhs);
+  }
+  return *this;
+}
+
+table::cursor& table::cursor::operator=(cursor&& rhs) noexcept {
+  if (this != &rhs) {
+    auto owned = !rhs.buffer_.empty() && rhs.key_.data() == rhs.buffer_.data();
+    table_ = rhs.table_;
+    block_ = rhs.block_;
+    entry_ = rhs.entry_;
+    next_ = rhs.next_;
+    key_ = rhs.key_;
+    value_ = rhs.value_;
+    erased_ = rhs.erased_;
+    buffer_ = std::move(rhs.buffer_);
+    if (owned) {
+      key_ = buffer_;
+    }
+  }
+  return *this;
+}
+
+void table::cursor::assign(const cursor& rhs) {
+  table_ = rhs.table_;
+  block_ = rhs.block_;
+  entry_ = rhs.entry_;
+  next_ = rhs.next_;
+  key_ = rhs.key_;
+  value_ = rhs.value_;
+  erased_ = rhs.erased_;
+  if (!rhs.buffer_.empty() && rhs.key_.data() == rhs.buffer_.data()) {
+    buffer_ = rhs.buffer_;
+    key_ = buffer_;
+  }
+}
+
+std::string_view table::cursor::key() const { return key_; }
+
+std::string_view table::cursor::value() const { return value_; }
+
+bool table::cursor::erased() const { return erased_; }
+
+void table::cursor::increment() {
+  auto& blocks = table_->blocks_;
+  if (next_ != blocks[block_].restarts) {
+    decode(next_);
+  } else if (++block_ < blocks.size()) {
+    decode(blocks[block_].entries);
+  } else {
+    entry_ = next_ = nullptr;
+    key_ = value_ = std::string_view();
+  }
+}
+
+void table::cursor::decrement() {
+  auto& blocks = table_->blocks_;
+  if (entry_ != nullptr && block_ == 0 && entry_ == blocks[0].entries) {
+    // Before the first entry is the end
+    block_ = blocks.size();
+    entry_ = next_ = nullptr;
+    key_ = value_ = std::string_view();
+    return;
+  }
+  if (entry_ == nullptr || entry_ == blocks[block_].entries) {
+    --block_;
+    seek_last();
+    return;
+  }
+  // Decode forwards from the last restart point before the current entry
+  auto& current = blocks[block_];
+  auto target = entry_;
+  auto restart = [&current](std::uint32_t i) {
+    return current.entries + get_fixed32(current.restarts + 4 * i);
+  };
+  std::uint32_t low = 0;
+  std::uint32_t high = current.restart_count - 1;
+  while (low < high) {
+    auto middle = low + (high - low + 1) / 2;
+    if (restart(middle) < target) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+  decode(restart(low));
+  while (next_ != target) {
+    decode(next_);
+  }
+}
+
+bool table::cursor::operator==(const cursor& rhs) const {
+  return table_ == rhs.table_ && block_ == rhs.block_ && entry_ == rhs.entry_;
+}
+
+bool table::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+void table::cursor::decode(const char* position) {
+  auto limit = table_->blocks_[block_].restarts;
+  std::uint64_t shared = 0;
+  std::uint64_t unshared = 0;
+  std::uint64_t value = 0;
+  auto p = position < limit ? get_varint(position, limit, shared) : nullptr;
+  p = p ? get_varint(p, limit, unshared) : nullptr;
+  p = p ? get_varint(p, limit, value) : nullptr;
+  auto size = value >> 1;
+  if (p == nullptr || shared > key_.size() ||
+      static_cast<std::uint64_t>(limit - p) < unshared ||
+      static_cast<std::uint64_t>(limit - p) - unshared < size) {
+    throw std::runtime_error("corrupt table entry");
+  }
+  if (shared == 0) {
+    key_ = std::string_view(p, unshared);
+  } else {
+    if (key_.data() == buffer_.data()) {
+      buffer_.resize(shared);
+    } else {
+      buffer_.assign(key_.data(), shared);
+    }
+    buffer_.append(p, unshared);
+    key_ = buffer_;
+  }
+  value_ = std::string_view(p + unshared, size);
+  erased_ = (value & 1) != 0;
+  entry_ = position;
+  next_ = p + unshared + size;
+}
+
+void table::cursor::seek_last() {
+  auto& current = table_->blocks_[block_];
+  decode(current.entries +
+         get_fixed32(current.restarts + 4 * (current.restart_count - 1)));
+  while (next_ != current.restarts) {
+    decode(next_);
+  }
+}
+
+}  // namespace datastore::clients::detail
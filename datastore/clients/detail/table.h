@@ -0,0 +1,129 @@
+#pragma once
+#include <datastore/client.h>
+#include <datastore/clients/detail/mapped_file.h>
+#include <datastore/clients/table.h>
+#include <datastore/compare.h>
+#include <string>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** Read-only backend over an immutable, memory-mapped sorted table
+ *
+ * The file is a sequence of data blocks, an index holding the last key of
+ * each block, and a fixed size footer locating the index
+ *
+ *   block  := entry* u32(restart offset)* u32(restart count)
+ *   entry  := varint(shared) varint(unshared) varint(value size << 1 | erased)
+ *             key suffix, value
+ *   index  := (varint(key size) key, u64(block offset), u32(block size))*
+ *   footer := u64(index offset) u64(index size) u64(count) u32(blocks)
+ *             u32(version) u64(magic)
+ *
+ * where shared is the length of the prefix an entry shares with the previous
+ * key, which is zero at the restart points. The index is decoded once on
+ * open, so a lookup binary searches the index, then the restart points of a
+ * single block, without locks, transactions or allocation.
+ */
+class table {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Opens the table at the configured path */
+  explicit table(const table_configuration& configuration);
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  /** Throws std::system_error, as tables are immutable */
+  cursor insert_or_assign(cursor pos, const value_type& value);
+
+  /** Throws std::system_error, as tables are immutable */
+  cursor erase(cursor pos);
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+
+  /** Throws std::system_error, as tables are immutable */
+  void clear();
+
+ private:
+  friend class cursor;
+
+  struct block {
+    std::string_view last_key; /** Last key in the block */
+    const char* entries;       /** First entry */
+    const char* restarts;      /** Restart offsets, following the entries */
+    std::uint32_t restart_count;
+  };
+
+  mapped_file file_;
+  key_less less_;
+  std::vector<block> blocks_;
+  size_type count_ = 0;
+};
+
+/** Position in a table, decoding entries in place
+ *
+ * Keys are views of the mapping, unless they are prefix compressed, in which
+ * case the cursor assembles them in a buffer of its own and a key is only
+ * valid until the cursor moves. */
+class table::cursor {
+ public:
+  /** Prefix compressed keys are decoded into a buffer of the cursor */
+  static constexpr bool transient_keys = true;
+
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  cursor(const cursor& rhs);
+  cursor(cursor&& rhs) noexcept;
+  cursor& operator=(const cursor& rhs);
+  cursor& operator=(cursor&& rhs) noexcept;
+  ~cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+
+  /** Returns true if the entry records the erasure of its key */
+  [[nodiscard]] bool erased() const;
+
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class table;
+
+ private:
+  /** Creates a cursor at the first entry of a block, or the end */
+  cursor(const table* owner, std::size_t block);
+
+  /** Decodes the entry at position, which follows the current entry or is a
+   * restart point */
+  void decode(const char* position);
+
+  /** Moves to the last entry of the current block */
+  void seek_last();
+
+  /** Copies the position of rhs, pointing the key into the own buffer */
+  void assign(const cursor& rhs);
+
+  const table* table_ = nullptr;
+  std::size_t block_ = 0;
+  const char* entry_ = nullptr; /** Current entry, nullptr at the end */
+  const char* next_ = nullptr;  /** Entry following the current entry */
+  std::string_view key_;
+  std::string_view value_;
+  bool erased_ = false;
+  std::string buffer_;
+};
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,460 @@
+#include "tiered.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+namespace datastore::clients::detail {
+
+namespace {
+
+std::unique_ptr<client> require(std::unique_ptr<client> cold) {
+  if (cold == nullptr) {
+    throw std::invalid_argument("a tiered datastore requires a cold tier");
+  }
+  return cold;
+}
+
+}  // namespace
+
+tiered::tiered(std::unique_ptr<client> cold,
+               const tiered_configuration& configuration)
+    : hot_(configuration.compare()),
+      cold_(require(std::move(cold))),
+      cold_end_(cold_->end()),
+      less_(configuration.compare()),
+      hot_capacity_(configuration.hot_capacity()),
+      promotion_threshold_(
+          std::max(1u, configuration.promotion_threshold())),
+      batch_size_(std::max<std::size_t>(1, configuration.batch_size())),
+      interval_(configuration.interval()),
+      close_error_callback_(configuration.close_error_callback()) {
+  if (!close_error_callback_) {
+    close_error_callback_ = [](const std::exception& error) {
+      std::cerr << "datastore: tiered write-back on close failed: "
+                << error.what() << std::endl;
+    };
+  }
+  worker_ = std::thread([this] { work(); });
+}
+
+tiered::~tiered() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  worker_.join();
+  try {
+    std::lock_guard lock(mutex_);
+    write_back(std::vector<std::string>(dirty_.begin(), dirty_.end()));
+  } catch (std::exception& error) {
+    close_error_callback_(error);
+  }
+}
+
+tiered::cursor tiered::first() const {
+  std::lock_guard lock(mutex_);
+  return cursor(this, hot_.first(), cold_->begin(), true);
+}
+
+tiered::cursor tiered::last() const {
+  // A fresh end, as cursors of some backends decrement within their version
+  return cursor(this, hot_.last(), cold_->end(), true);
+}
+
+tiered::cursor tiered::lookup(key_type key) const {
+  std::lock_guard lock(mutex_);
+  auto hot = hot_.lookup(key);
+  if (hot != hot_.last()) {
+    touch(key, false);
+    return cursor(this, std::move(hot), client::iterator(), false);
+  }
+  auto cold = cold_->find(key);
+  if (cold == cold_end_) {
+    return last();
+  }
+  touch(key, true);
+  return cursor(this, hot_.lower_bound(key), std::move(cold), true);
+}
+
+tiered::cursor tiered::lower_bound(key_type key) const {
+  std::lock_guard lock(mutex_);
+  return cursor(this, hot_.lower_bound(key), cold_->lower_bound(key), true);
+}
+
+tiered::cursor tiered::insert_or_assign(tiered::cursor,
+                                        const value_type& value) {
+  std::unique_lock lock(mutex_);
+  check();
+  put_hot(value);
+  reads_.add(value.first);
+  dirty_.emplace(value.first);
+  auto result =
+      cursor(this, hot_.lookup(value.first), client::iterator(), false);
+  auto full = hot_bytes_ > hot_capacity_;
+  lock.unlock();
+  if (full) {
+    changed_.notify_one();
+  }
+  return result;
+}
+
+tiered::cursor tiered::erase(tiered::cursor pos) {
+  auto key = std::string(pos.key());
+  {
+    std::lock_guard lock(mutex_);
+    check();
+    erase_hot(key);
+    dirty_.erase(key);
+    cold_->erase(key);
+  }
+  return lower_bound(key);
+}
+
+void tiered::write(const batch& operations) {
+  bool full;
+  {
+    std::lock_guard lock(mutex_);
+    check();
+    batch erasures;
+    for (const auto& operation : operations) {
+      if (operation.type == batch::kind::put) {
+        put_hot({operation.key, operation.value});
+        reads_.add(operation.key);
+        dirty_.emplace(operation.key);
+      } else {
+        erase_hot(operation.key);
+        dirty_.erase(operation.key);
+        erasures.erase(operation.key);
+      }
+    }
+    if (!erasures.empty()) {
+      cold_->write(erasures);
+    }
+    full = hot_bytes_ > hot_capacity_;
+  }
+  if (full) {
+    changed_.notify_one();
+  }
+}
+
+client::size_type tiered::size() const {
+  size_type result = 0;
+  for (auto it = first(); !it.end(); it.increment()) {
+    ++result;
+  }
+  return result;
+}
+
+client::size_type tiered::capacity() const { return cold_->max_size(); }
+
+void tiered::clear() {
+  std::lock_guard lock(mutex_);
+  check();
+  hot_.clear();
+  cold_->clear();
+  hot_bytes_ = 0;
+  reads_.clear();
+  candidates_.clear();
+  dirty_.clear();
+}
+
+void tiered::balance() {
+  std::lock_guard lock(mutex_);
+  check();
+  promote();
+  demote();
+  reads_.age();
+}
+
+void tiered::flush() {
+  std::lock_guard lock(mutex_);
+  check();
+  write_back(std::vector<std::string>(dirty_.begin(), dirty_.end()));
+}
+
+client::size_type tiered::hot_size() const {
+  std::lock_guard lock(mutex_);
+  return hot_.size();
+}
+
+std::size_t tiered::hot_bytes() const {
+  std::lock_guard lock(mutex_);
+  return hot_bytes_;
+}
+
+void tiered::touch(key_type key, bool cold) const {
+  reads_.add(key);
+  // Bound the candidates, so that a scan of cold keys cannot exhaust memory
+  if (cold && reads_.estimate(key) >= promotion_threshold_ &&
+      candidates_.size() < 16 * batch_size_) {
+    candidates_.emplace(key);
+  }
+}
+
+void tiered::put_hot(const value_type& value) {
+  auto pos = hot_.lookup(value.first);
+  if (pos != hot_.last()) {
+    hot_bytes_ -= pos.key().size() + pos.value().size();
+  }
+  hot_.insert_or_assign(std::move(pos), value);
+  hot_bytes_ += value.first.size() + value.second.size();
+}
+
+void tiered::erase_hot(key_type key) {
+  auto pos = hot_.lookup(key);
+  if (pos != hot_.last()) {
+    hot_bytes_ -= pos.key().size() + pos.value().size();
+    hot_.erase(std::move(pos));
+  }
+}
+
+void tiered::write_back(std::vector<std::string> keys) {
+  // Write each transaction in key order
+  std::sort(keys.begin(), keys.end(), std::ref(less_));
+  for (auto begin = keys.begin(); begin != keys.end();) {
+    auto end =
+        begin + std::min<std::ptrdiff_t>(batch_size_, keys.end() - begin);
+    batch puts;
+    std::for_each(begin, end, [&](const std::string& key) {
+      auto pos = hot_.lookup(key);
+      puts.put(key, pos.value());
+    });
+    cold_->write(puts);
+    for (; begin != end; ++begin) {
+      dirty_.erase(*begin);
+    }
+  }
+}
+
+void tiered::promote() {
+  // The cold tier keeps its copies, so promotion never writes to it
+  for (const auto& key : candidates_) {
+    if (hot_.lookup(key) == hot_.last()) {
+      auto it = cold_->find(key);
+      if (it != cold_end_) {
+        put_hot(*it);
+      }
+    }
+  }
+  candidates_.clear();
+}
+
+void tiered::demote() {
+  if (hot_bytes_ <= hot_capacity_) {
+    return;
+  }
+  // Free a tenth of the capacity, so that demotion does not follow every
+  // write; the snapshot keeps the victims' keys and values alive
+  auto target = hot_capacity_ - hot_capacity_ / 10;
+  auto snapshot = hot_.snapshot();
+  struct victim {
+    unsigned int reads;
+    key_type key;
+    key_type value;
+  };
+  std::vector<victim> victims;
+  victims.reserve(snapshot.size());
+  for (auto it = snapshot.first(); it != snapshot.last(); it.increment()) {
+    victims.push_back({reads_.estimate(it.key()), it.key(), it.value()});
+  }
+  std::stable_sort(
+      victims.begin(), victims.end(),
+      [](const victim& lhs, const victim& rhs) { return lhs.reads < rhs.reads; });
+  auto freed = std::size_t{0};
+  auto count = std::size_t{0};
+  while (count < victims.size() && hot_bytes_ - freed > target) {
+    freed += victims[count].key.size() + victims[count].value.size();
+    ++count;
+  }
+  victims.resize(count);
+  // Only the victims newer than the cold tier are written back
+  auto keys = std::vector<std::string>();
+  for (const auto& item : victims) {
+    if (dirty_.count(std::string(item.key)) != 0) {
+      keys.emplace_back(item.key);
+    }
+  }
+  write_back(std::move(keys));
+  for (const auto& item : victims) {
+    erase_hot(item.key);
+  }
+}
+
+void tiered::work() {
+  std::unique_lock lock(mutex_);
+  while (!stop_) {
+    changed_.wait_for(lock, interval_,
+                      [this] { return stop_ || hot_bytes_ > hot_capacity_; });
+    if (stop_) {
+      break;
+    }
+    try {
+      promote();
+      demote();
+      reads_.age();
+    } catch (...) {
+      // Reported by the next write, as the tiers can no longer be balanced
+      error_ = std::current_exception();
+      return;
+    }
+  }
+}
+
+void tiered::check() const {
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+tiered::frequency::frequency() : counts_(rows * width) {}
+
+void tiered::frequency::add(key_type key) {
+  auto hash = std::hash<key_type>()(key);
+  for (std::size_t row = 0; row < rows; ++row) {
+    auto& count = counts_[slot(row, hash)];
+    if (count != 0xff) {
+      ++count;
+    }
+  }
+}
+
+unsigned int tiered::frequency::estimate(key_type key) const {
+  auto hash = std::hash<key_type>()(key);
+  auto result = 0xffu;
+  for (std::size_t row = 0; row < rows; ++row) {
+    result = std::min<unsigned int>(result, counts_[slot(row, hash)]);
+  }
+  return result;
+}
+
+void tiered::frequency::age() {
+  for (auto& count : counts_) {
+    count >>= 1;
+  }
+}
+
+void tiered::frequency::clear() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+}
+
+std::size_t tiered::frequency::slot(std::size_t row,
+                                    std::uint64_t hash) const {
+  // Derive an independent hash for each row
+  hash ^= row * 0x9e3779b97f4a7c15ULL;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return row * width + (hash & (width - 1));
+}
+
+tiered::cursor::cursor(const tiered* owner, map::cursor hot,
+                       client::iterator cold, bool positioned)
+    : owner_(owner),
+      hot_(std::move(hot)),
+      cold_(std::move(cold)),
+      positioned_(positioned) {
+  if (positioned_) {
+    settle();
+  }
+}
+
+std::string_view tiered::cursor::key() const {
+  return hot_current_ ? hot_.key() : cold_->first;
+}
+
+std::string_view tiered::cursor::value() const {
+  return hot_current_ ? hot_.value() : cold_->second;
+}
+
+void tiered::cursor::increment() {
+  if (!positioned_) {
+    auto key = std::string(hot_.key());
+    position();
+    // The element may have moved tiers, or been erased, in the meantime
+    if (!hot_end() && equal(hot_.key(), key)) {
+      hot_.increment();
+    }
+    if (!cold_end() && equal(cold_->first, key)) {
+      ++cold_;
+    }
+  } else if (hot_current_) {
+    if (!cold_end() && equal(cold_->first, hot_.key())) {
+      ++cold_;
+    }
+    hot_.increment();
+  } else {
+    ++cold_;
+  }
+  settle();
+}
+
+void tiered::cursor::decrement() {
+  if (!positioned_) {
+    position();
+  }
+  // Both tiers are at the first key not ordered before the current one, so
+  // the previous element is the greater of their predecessors
+  auto hot = hot_;
+  hot.decrement();
+  auto cold = cold_;
+  --cold;
+  auto has_hot = hot != map::cursor();
+  auto has_cold = cold != owner_->cold_end_;
+  if (has_hot && (!has_cold || !owner_->less_(hot.key(), cold->first))) {
+    if (has_cold && equal(hot.key(), cold->first)) {
+      cold_ = std::move(cold);
+    }
+    hot_ = std::move(hot);
+  } else if (has_cold) {
+    cold_ = std::move(cold);
+  } else {
+    // Before the first element is the end
+    hot_ = std::move(hot);
+    cold_ = std::move(cold);
+  }
+  settle();
+}
+
+bool tiered::cursor::operator==(const cursor& rhs) const {
+  if (owner_ == nullptr || rhs.owner_ == nullptr) {
+    return owner_ == rhs.owner_;
+  }
+  if (end() || rhs.end()) {
+    return end() == rhs.end();
+  }
+  return equal(key(), rhs.key());
+}
+
+bool tiered::cursor::operator!=(const cursor& rhs) const {
+  return !(*this == rhs);
+}
+
+bool tiered::cursor::end() const { return hot_current_ && hot_end(); }
+
+bool tiered::cursor::hot_end() const { return hot_ == map::cursor(); }
+
+bool tiered::cursor::cold_end() const { return cold_ == owner_->cold_end_; }
+
+bool tiered::cursor::equal(key_type lhs, key_type rhs) const {
+  return !owner_->less_(lhs, rhs) && !owner_->less_(rhs, lhs);
+}
+
+void tiered::cursor::position() {
+  auto key = std::string(hot_.key());
+  std::lock_guard lock(owner_->mutex_);
+  hot_ = owner_->hot_.lower_bound(key);
+  cold_ = owner_->cold_->lower_bound(key);
+  positioned_ = true;
+}
+
+void tiered::cursor::settle() {
+  if (hot_end()) {
+    hot_current_ = cold_end();
+  } else {
+    hot_current_ =
+        cold_end() || !owner_->less_(cold_->first, hot_.key());
+  }
+}
+
+}  // namespace datastore::clients::detail
@@ -0,0 +1,187 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <datastore/client.h>
+#include <datastore/clients/detail/map.h>
+#include <datastore/clients/tiered.h>
+#include <datastore/compare.h>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace datastore::clients::detail {
+
+/** Hot in-memory tier in front of a cold datastore
+ *
+ * Writes go to the hot tier, which keeps the set of keys it holds newer
+ * values of than the cold tier; erasures go to both. Reads are counted in a
+ * small frequency sketch, which is halved after each round of balancing so
+ * that it favours recent reads. A round first copies the cold keys read at
+ * least the threshold number of times to the hot tier, then demotes the
+ * least read hot keys until the hot tier is back under its capacity, writing
+ * back those which are newer. Each batch of write-backs is one write to the
+ * cold tier, so one LMDB transaction. Where a key is in both tiers, the hot
+ * tier supplies its value.
+ */
+class tiered {
+ public:
+  class cursor;
+  using key_type = client::key_type;
+  using value_type = client::value_type;
+  using size_type = client::size_type;
+
+  /** Starts balancing the tiers in the background */
+  tiered(std::unique_ptr<client> cold,
+         const tiered_configuration& configuration);
+
+  /** Stops background work and writes back the hot tier, reporting a
+   * failure to the close error callback */
+  ~tiered();
+
+  tiered(const tiered&) = delete;
+  tiered& operator=(const tiered&) = delete;
+
+  [[nodiscard]] cursor first() const;
+  [[nodiscard]] cursor last() const;
+
+  /** Finds key, counting the read towards its promotion or retention */
+  [[nodiscard]] cursor lookup(key_type key) const;
+
+  /** Returns the first element whose key does not order before key */
+  [[nodiscard]] cursor lower_bound(key_type key) const;
+
+  cursor insert_or_assign(cursor pos, const value_type& value);
+  cursor erase(cursor pos);
+
+  /** Writes the puts to the hot tier, and the erasures to both tiers, those
+   * of the cold tier in one transaction */
+  void write(const batch& operations);
+
+  /** Counts the elements, which requires a merge of both tiers */
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] size_type capacity() const;
+  void clear();
+
+  /** Runs a round of promotion and demotion without waiting for the timer */
+  void balance();
+
+  /** Writes the hot elements which are newer than the cold tier to it */
+  void flush();
+
+  /** Returns the number of elements in the hot tier */
+  [[nodiscard]] size_type hot_size() const;
+
+  /** Returns the bytes of keys and values in the hot tier */
+  [[nodiscard]] std::size_t hot_bytes() const;
+
+ private:
+  /** Approximate read counts of keys, in a count-min sketch */
+  class frequency {
+   public:
+    frequency();
+    void add(key_type key);
+    [[nodiscard]] unsigned int estimate(key_type key) const;
+
+    /** Halves every count */
+    void age();
+
+    void clear();
+
+   private:
+    static constexpr std::size_t rows = 4;
+    static constexpr std::size_t width = 1 << 16;
+    [[nodiscard]] std::size_t slot(std::size_t row, std::uint64_t hash) const;
+    std::vector<std::uint8_t> counts_;
+  };
+
+  /** Records a read of a hot or cold key */
+  void touch(key_type key, bool cold) const;
+
+  /** Writes value to the hot tier, keeping track of its size */
+  void put_hot(const value_type& value);
+  void erase_hot(key_type key);
+
+  /** Writes back the dirty keys, in batches */
+  void write_back(std::vector<std::string> keys);
+
+  void promote();
+  void demote();
+  void work();
+  void check() const;
+
+  map hot_;
+  std::unique_ptr<client> cold_;
+  client::iterator cold_end_; /** Compared against, never moved */
+  key_less less_;
+  std::size_t hot_capacity_;
+  unsigned int promotion_threshold_;
+  std::size_t batch_size_;
+  std::chrono::milliseconds interval_;
+  tiered_configuration::error_callback close_error_callback_;
+
+  mutable std::mutex mutex_; /** Guards both tiers and the statistics */
+  std::size_t hot_bytes_ = 0;
+  mutable frequency reads_;
+  mutable std::unordered_set<std::string> candidates_; /** For promotion */
+  std::unordered_set<std::string> dirty_; /** Hot keys newer than cold */
+  std::condition_variable changed_;
+  bool stop_ = false;
+  std::exception_ptr error_; /** Failure of the worker */
+  std::thread worker_;
+};
+
+/** Merges the positions of both tiers into one ordered sequence
+ *
+ * A cursor returned by a lookup in the hot tier starts with only its hot
+ * position. Both tiers are positioned at its key, together, the first time
+ * it moves, so that lookups never touch the cold tier. */
+class tiered::cursor {
+ public:
+  /** Keys of the cold tier come from an iterator of any client */
+  static constexpr bool transient_keys = true;
+
+  /** So do its values */
+  static constexpr bool transient_values = true;
+
+  /** Creates a singular cursor */
+  cursor() = default;
+
+  [[nodiscard]] std::string_view key() const;
+  [[nodiscard]] std::string_view value() const;
+  void increment();
+  void decrement();
+  bool operator==(const cursor& rhs) const;
+  bool operator!=(const cursor& rhs) const;
+
+  friend class tiered;
+
+ private:
+  /** Creates a cursor at the given positions, or at a hot element only if
+   * not positioned */
+  cursor(const tiered* owner, map::cursor hot, client::iterator cold,
+         bool positioned);
+
+  [[nodiscard]] bool end() const;
+  [[nodiscard]] bool hot_end() const;
+  [[nodiscard]] bool cold_end() const;
+  [[nodiscard]] bool equal(key_type lhs, key_type rhs) const;
+
+  /** Positions both tiers at the current key, if this is the cursor of a
+   * hot lookup */
+  void position();
+
+  /** Picks the tier supplying the least key */
+  void settle();
+
+  const tiered* owner_ = nullptr;
+  map::cursor hot_;
+  client::iterator cold_;
+  bool positioned_ = true;
+  bool hot_current_ = true; /** Whether the hot tier supplies the element */
+};
+
+}  // namespace datastore::clients::detail
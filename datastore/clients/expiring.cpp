@@ -0,0 +1,73 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/expiring.h>
+#include <stdexcept>
+
+namespace datastore::clients {
+
+expiring_configuration::expiring_configuration()
+    : now_([] { return std::chrono::system_clock::now(); }) {}
+
+std::chrono::milliseconds expiring_configuration::default_ttl() const {
+  return default_ttl_;
+}
+
+std::size_t expiring_configuration::batch_size() const { return batch_size_; }
+
+std::chrono::milliseconds expiring_configuration::max_pause() const {
+  return max_pause_;
+}
+
+std::chrono::milliseconds expiring_configuration::interval() const {
+  return interval_;
+}
+
+const expiring_configuration::clock& expiring_configuration::now() const {
+  return now_;
+}
+
+expiring_configuration& expiring_configuration::set_default_ttl(
+    std::chrono::milliseconds ttl) {
+  default_ttl_ = ttl;
+  return *this;
+}
+
+expiring_configuration& expiring_configuration::set_batch_size(
+    std::size_t batch_size) {
+  batch_size_ = batch_size;
+  return *this;
+}
+
+expiring_configuration& expiring_configuration::set_max_pause(
+    std::chrono::milliseconds pause) {
+  max_pause_ = pause;
+  return *this;
+}
+
+expiring_configuration& expiring_configuration::set_interval(
+    std::chrono::milliseconds interval) {
+  interval_ = interval;
+  return *this;
+}
+
+expiring_configuration& expiring_configuration::set_clock(clock now) {
+  now_ = std::move(now);
+  return *this;
+}
+
+std::unique_ptr<client> make_expiring(
+    std::unique_ptr<client> store,
+    const expiring_configuration& configuration) {
+  return std::make_unique<detail::adapter<detail::expiring>>(std::move(store),
+                                                             configuration);
+}
+
+void expire(client& datastore, client::key_type key,
+            std::chrono::milliseconds ttl) {
+  auto expiring = dynamic_cast<detail::adapter<detail::expiring>*>(&datastore);
+  if (expiring == nullptr) {
+    throw std::invalid_argument("datastore has no expiring elements");
+  }
+  expiring->get().backend().expire(key, ttl);
+}
+
+}  // namespace datastore::clients
@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <functional>
+#include <memory>
+
+namespace datastore::clients {
+
+class expiring_configuration {
+ public:
+  using clock = std::function<std::chrono::system_clock::time_point()>;
+
+  /** Configures elements which never expire unless given a time to live */
+  expiring_configuration();
+
+  /** Returns the time to live of inserted elements, zero for none */
+  [[nodiscard]] std::chrono::milliseconds default_ttl() const;
+
+  /** Returns the maximum number of elements erased per write */
+  [[nodiscard]] std::size_t batch_size() const;
+
+  /** Returns the longest the sweeper may block writers for */
+  [[nodiscard]] std::chrono::milliseconds max_pause() const;
+
+  /** Returns the time between two sweeps */
+  [[nodiscard]] std::chrono::milliseconds interval() const;
+
+  /** Returns the source of the current time */
+  [[nodiscard]] const clock& now() const;
+
+  expiring_configuration& set_default_ttl(std::chrono::milliseconds ttl);
+  expiring_configuration& set_batch_size(std::size_t batch_size);
+  expiring_configuration& set_max_pause(std::chrono::milliseconds pause);
+  expiring_configuration& set_interval(std::chrono::milliseconds interval);
+  expiring_configuration& set_clock(clock now);
+
+ private:
+  std::chrono::milliseconds default_ttl_{0};
+  std::size_t batch_size_ = 256;
+  std::chrono::milliseconds max_pause_{10};
+  std::chrono::milliseconds interval_{1000};
+  clock now_;
+};
+
+namespace detail {
+class expiring;
+}
+
+/** Statically dispatched datastore of expiring elements
+ *
+ * Include datastore/clients/detail/expiring.h to instantiate it. */
+using expiring_client = basic_client<detail::expiring>;
+
+/** Creates a datastore whose elements may expire
+ *
+ * Each value is stored with its expiry time, so lookups and iteration skip
+ * expired elements without any extra read. A background thread erases
+ * expired elements in batches of bounded size and duration, so that it
+ * never blocks writers for long.
+ *
+ * The store must only hold elements written through the returned
+ * datastore, as each value carries an 8 byte header. */
+std::unique_ptr<client> make_expiring(
+    std::unique_ptr<client> store,
+    const expiring_configuration& configuration = expiring_configuration());
+
+/** Sets the time to live of an element of a datastore created by
+ * make_expiring, or makes it permanent if ttl is zero
+ *
+ * Throws std::out_of_range if the key is absent or expired, and
+ * std::invalid_argument if the datastore was not created by make_expiring.
+ */
+void expire(client& datastore, client::key_type key,
+            std::chrono::milliseconds ttl);
+
+}  // namespace datastore::clients
@@ -0,0 +1,47 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/indexed.h>
+#include <stdexcept>
+
+namespace datastore::clients {
+
+std::unique_ptr<client> make_indexed(std::unique_ptr<client> store) {
+  return std::make_unique<detail::adapter<detail::indexed>>(std::move(store));
+}
+
+namespace {
+
+const detail::indexed& backend(const client& datastore) {
+  auto indexed =
+      dynamic_cast<const detail::adapter<detail::indexed>*>(&datastore);
+  if (indexed == nullptr) {
+    throw std::invalid_argument("datastore has no indexes");
+  }
+  return indexed->get().backend();
+}
+
+}  // namespace
+
+void add_index(client& datastore, std::string_view name,
+               index_extractor extract, bool rebuild) {
+  auto indexed = dynamic_cast<detail::adapter<detail::indexed>*>(&datastore);
+  if (indexed == nullptr) {
+    throw std::invalid_argument("datastore has no indexes");
+  }
+  indexed->get().backend().add_index(name, std::move(extract), rebuild);
+}
+
+void scan_index(const client& datastore, std::string_view name,
+                std::string_view from, std::string_view to,
+                const std::function<void(const client::chunk&)>& function,
+                client::size_type max_items) {
+  backend(datastore).scan(name, from, to, function, max_items, false);
+}
+
+void join_index(const client& datastore, std::string_view name,
+                std::string_view from, std::string_view to,
+                const std::function<void(const client::chunk&)>& function,
+                client::size_type max_items) {
+  backend(datastore).scan(name, from, to, function, max_items, true);
+}
+
+}  // namespace datastore::clients
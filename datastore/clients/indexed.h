@@ -0,0 +1,81 @@
+#pragma once
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace datastore::clients {
+
+/** Returns the index key of a record, or nothing to leave it out */
+using index_extractor = std::function<std::optional<std::string>(
+    client::key_type key, client::mapped_type value)>;
+
+/** Adapts a function of decoded values to an index_extractor
+ *
+ * mapped decodes stored values, as the mapped codec of a datastore::map,
+ * and index encodes the index keys extract returns. */
+template <typename MappedCodec, typename IndexCodec, typename Extractor>
+index_extractor make_extractor(MappedCodec mapped, IndexCodec index,
+                               Extractor extract);
+
+namespace detail {
+class indexed;
+}
+
+/** Statically dispatched datastore with secondary indexes
+ *
+ * Include datastore/clients/detail/indexed.h to instantiate it. */
+using indexed_client = basic_client<detail::indexed>;
+
+/** Creates a datastore which maintains secondary indexes over its records
+ *
+ * Index entries are stored in the store itself, under a reserved range of
+ * keys which the returned datastore hides, and are written in the same
+ * batch as the records they index. Over a store which writes a batch in one
+ * transaction, such as LMDB, records and indexes can therefore not
+ * disagree, even after a crash. The store must order keys byte-wise. */
+std::unique_ptr<client> make_indexed(std::unique_ptr<client> store);
+
+/** Registers an index of a datastore created by make_indexed
+ *
+ * An index built before, by an earlier datastore over the same store, is
+ * used as it is, unless rebuild is set, as when extract changed, or unless
+ * records were written through this datastore before adding it. Otherwise
+ * it is built from every record, blocking writes meanwhile. Writes to the
+ * store through any other datastore are not seen by its indexes. Throws
+ * std::invalid_argument if the datastore was not created by make_indexed
+ * or already has an index of that name. */
+void add_index(client& datastore, std::string_view name,
+               index_extractor extract, bool rebuild = false);
+
+/** Calls function with chunks of the index keys and primary keys of the
+ * records whose index key is in [from, to), in index key order
+ *
+ * An empty to stands for the end of the index. Throws std::invalid_argument
+ * if the datastore was not created by make_indexed. */
+void scan_index(const client& datastore, std::string_view name,
+                std::string_view from, std::string_view to,
+                const std::function<void(const client::chunk&)>& function,
+                client::size_type max_items = 1024);
+
+/** Calls function with chunks of the records whose index key is in
+ * [from, to), in index key order, looking each up by its primary key */
+void join_index(const client& datastore, std::string_view name,
+                std::string_view from, std::string_view to,
+                const std::function<void(const client::chunk&)>& function,
+                client::size_type max_items = 1024);
+
+template <typename MappedCodec, typename IndexCodec, typename Extractor>
+index_extractor make_extractor(MappedCodec mapped, IndexCodec index,
+                               Extractor extract) {
+  return [mapped = std::move(mapped), index = std::move(index),
+          extract = std::move(extract)](
+             client::key_type, client::mapped_type value)
+             -> std::optional<std::string> {
+    return std::string(index.f(extract(mapped.g(value))));
+  };
+}
+
+}  // namespace datastore::clients
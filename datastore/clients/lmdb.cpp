@@ -1,10 +1,17 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/coding.h>
 #include <datastore/clients/detail/lmdb.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
 
 namespace datastore::clients {
 
 lmdb_configuration::lmdb_configuration(std::filesystem::path path,
-                                       unsigned int flags, unsigned int mode)
-    : path_(std::move(path)), flags_(flags), mode_(mode) {}
+                                       unsigned int flags, unsigned int mode,
+                                       key_compare compare)
+    : path_(std::move(path)), flags_(flags), mode_(mode), compare_(compare) {}
 
 const std::filesystem::path& lmdb_configuration::path() const { return path_; }
 
@@ -12,7 +19,263 @@ unsigned int lmdb_configuration::flags() const { return flags_; }
 
 unsigned int lmdb_configuration::mode() const { return mode_; }
 
+key_compare lmdb_configuration::compare() const { return compare_; }
+
+unsigned int lmdb_configuration::filter_bits_per_key() const {
+  return filter_bits_per_key_;
+}
+
+lmdb_configuration& lmdb_configuration::set_filter_bits_per_key(
+    unsigned int bits_per_key) {
+  filter_bits_per_key_ = bits_per_key;
+  return *this;
+}
+
+bool lmdb_configuration::change_log() const { return change_log_; }
+
+lmdb_configuration& lmdb_configuration::set_change_log(bool enabled) {
+  change_log_ = enabled;
+  return *this;
+}
+
+std::chrono::milliseconds lmdb_configuration::reader_check_interval() const {
+  return reader_check_interval_;
+}
+
+reader_policy lmdb_configuration::stale_reader_policy() const {
+  return stale_reader_policy_;
+}
+
+std::chrono::milliseconds lmdb_configuration::max_reader_age() const {
+  return max_reader_age_;
+}
+
+const lmdb_configuration::reader_callback&
+lmdb_configuration::stale_reader_callback() const {
+  return stale_reader_callback_;
+}
+
+lmdb_configuration& lmdb_configuration::set_reader_check_interval(
+    std::chrono::milliseconds interval) {
+  reader_check_interval_ = interval;
+  return *this;
+}
+
+lmdb_configuration& lmdb_configuration::set_stale_readers(
+    reader_policy policy, std::chrono::milliseconds max_age) {
+  stale_reader_policy_ = policy;
+  max_reader_age_ = max_age;
+  return *this;
+}
+
+lmdb_configuration& lmdb_configuration::set_stale_reader_callback(
+    reader_callback callback) {
+  stale_reader_callback_ = std::move(callback);
+  return *this;
+}
+
+double backup_progress::throughput() const {
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  return seconds > 0 ? bytes / seconds : 0;
+}
+
+bool backup_configuration::compact() const { return compact_; }
+
+const backup_configuration::callback& backup_configuration::progress() const {
+  return progress_;
+}
+
+backup_configuration& backup_configuration::set_compact(bool compact) {
+  compact_ = compact;
+  return *this;
+}
+
+backup_configuration& backup_configuration::set_progress(callback progress) {
+  progress_ = std::move(progress);
+  return *this;
+}
+
+double reader_statistics::occupancy() const {
+  return slots != 0 ? static_cast<double>(slots_used) / slots : 0;
+}
+
+double residency::fraction() const {
+  return size != 0 ? static_cast<double>(resident) / size : 0;
+}
+
+unsigned int warm_up_policy::threads() const { return threads_; }
+
+bool warm_up_policy::branches() const { return branches_; }
+
+const std::vector<key_range>& warm_up_policy::ranges() const {
+  return ranges_;
+}
+
+std::size_t warm_up_policy::max_bytes() const { return max_bytes_; }
+
+std::size_t warm_up_policy::bytes_per_second() const {
+  return bytes_per_second_;
+}
+
+warm_up_policy& warm_up_policy::set_threads(unsigned int threads) {
+  if (threads == 0) {
+    throw std::invalid_argument("warm up requires a thread");
+  }
+  threads_ = threads;
+  return *this;
+}
+
+warm_up_policy& warm_up_policy::set_branches(bool branches) {
+  branches_ = branches;
+  return *this;
+}
+
+warm_up_policy& warm_up_policy::set_ranges(std::vector<key_range> ranges) {
+  ranges_ = std::move(ranges);
+  return *this;
+}
+
+warm_up_policy& warm_up_policy::set_max_bytes(std::size_t bytes) {
+  max_bytes_ = bytes;
+  return *this;
+}
+
+warm_up_policy& warm_up_policy::set_bytes_per_second(
+    std::size_t bytes_per_second) {
+  bytes_per_second_ = bytes_per_second;
+  return *this;
+}
+
+namespace {
+thread_local std::string origin;
+}
+
+reader_origin::reader_origin(std::string label)
+    : previous_(std::exchange(origin, std::move(label))) {}
+
+reader_origin::~reader_origin() { origin = std::move(previous_); }
+
+const std::string& reader_origin::current() { return origin; }
+
 std::unique_ptr<client> make_lmdb(const lmdb_configuration& configuration) {
-  return std::make_unique<detail::lmdb>(configuration);
+  return std::make_unique<detail::adapter<detail::lmdb>>(configuration);
 }
+
+namespace {
+
+const detail::adapter<detail::lmdb>& adapter(const client& datastore) {
+  auto lmdb = dynamic_cast<const detail::adapter<detail::lmdb>*>(&datastore);
+  if (lmdb == nullptr) {
+    throw std::invalid_argument("datastore is not an lmdb datastore");
+  }
+  return *lmdb;
+}
+
+const detail::lmdb& backend(const client& datastore) {
+  return adapter(datastore).get().backend();
+}
+
+}  // namespace
+
+std::vector<change> read_changes(const client& datastore, std::uint64_t from,
+                                 std::size_t limit) {
+  return backend(datastore).changes(from, limit);
+}
+
+void truncate_changes(client& datastore, std::uint64_t before) {
+  auto lmdb = dynamic_cast<detail::adapter<detail::lmdb>*>(&datastore);
+  if (lmdb == nullptr) {
+    throw std::invalid_argument("datastore is not an lmdb datastore");
+  }
+  lmdb->get().backend().truncate_changes(before);
+}
+
+backup_progress backup(const client& datastore, int fd,
+                       const backup_configuration& configuration) {
+  return backend(datastore).backup(fd, configuration);
+}
+
+backup_progress backup(const client& datastore,
+                       const std::filesystem::path& directory,
+                       const backup_configuration& configuration) {
+  return backend(datastore).backup(directory, configuration);
+}
+
+client::iterator read_ahead(const client& datastore, client::key_type from,
+                            std::size_t window) {
+  const auto& lmdb = adapter(datastore);
+  return lmdb.make_iterator(lmdb.get().backend().read_ahead(from, window));
+}
+
+reader_statistics readers(const client& datastore) {
+  return backend(datastore).readers();
+}
+
+std::vector<reader_info> open_readers(const client& datastore) {
+  return backend(datastore).open_readers();
+}
+
+std::size_t check_readers(const client& datastore) {
+  return backend(datastore).check_readers();
+}
+
+warm_up_report warm_up(const client& datastore,
+                       const warm_up_policy& policy) {
+  return backend(datastore).warm_up(policy);
+}
+
+residency resident(const client& datastore) {
+  return backend(datastore).resident();
+}
+
+void save_access_profile(const std::filesystem::path& path,
+                         const std::vector<key_range>& ranges) {
+  auto data = std::string();
+  for (const auto& [from, to] : ranges) {
+    detail::put_length_prefixed(data, from);
+    detail::put_length_prefixed(data, to);
+  }
+  detail::put_fixed32(data, detail::crc32(data));
+  auto temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!out.flush()) {
+      throw std::runtime_error("failed to write the access profile");
+    }
+  }
+  std::filesystem::rename(temporary, path);
+}
+
+std::vector<key_range> load_access_profile(
+    const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("failed to read the access profile");
+  }
+  auto data = std::string(std::istreambuf_iterator<char>(in), {});
+  if (data.size() < 4 ||
+      detail::get_fixed32(data.data() + data.size() - 4) !=
+          detail::crc32(std::string_view(data).substr(0, data.size() - 4))) {
+    throw std::runtime_error("access profile is corrupt");
+  }
+  auto input = std::string_view(data).substr(0, data.size() - 4);
+  auto result = std::vector<key_range>();
+  while (!input.empty()) {
+    std::string_view from, to;
+    if (!detail::get_length_prefixed(input, from) ||
+        !detail::get_length_prefixed(input, to)) {
+      throw std::runtime_error("access profile is corrupt");
+    }
+    result.emplace_back(from, to);
+  }
+  return result;
+}
+
+void restore(const std::filesystem::path& backup,
+             const std::filesystem::path& directory) {
+  detail::lmdb::restore(backup, directory);
+}
+
 }  // namespace datastore::clients
@@ -1,24 +1,365 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <datastore/basic_client.h>
+#include <datastore/changes.h>
 #include <datastore/client.h>
+#include <datastore/compare.h>
 #include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace datastore::clients {
 
+/** An open read transaction of an lmdb datastore */
+struct reader_info {
+  std::size_t snapshot = 0; /** Id of the transaction whose writes it sees */
+  std::chrono::steady_clock::duration age{};
+  std::thread::id thread; /** Thread which began it */
+  std::string origin;     /** Label of its reader_origin, if any */
+};
+
+/** What happens to read transactions held open for too long */
+enum class reader_policy {
+  none,      /** They are only reported by open_readers */
+  warn,      /** The stale reader callback is called once for each */
+  invalidate /** They release their snapshot, then the callback is called */
+};
+
 class lmdb_configuration {
  public:
   explicit lmdb_configuration(std::filesystem::path path,
-                              unsigned int flags = 0, unsigned int mode = 0644);
+                              unsigned int flags = 0, unsigned int mode = 0644,
+                              key_compare compare = nullptr);
   [[nodiscard]] const std::filesystem::path& path() const;
   [[nodiscard]] unsigned int flags() const;
   [[nodiscard]] unsigned int mode() const;
 
+  /** Returns the key ordering, or nullptr for LMDB's byte order */
+  [[nodiscard]] key_compare compare() const;
+
+  /** Returns the bits per key of the membership filter, 0 if disabled */
+  [[nodiscard]] unsigned int filter_bits_per_key() const;
+
+  /** Enables a membership filter which answers definite misses without
+   * opening a transaction.
+   *
+   * The filter is kept in memory, persisted in the environment directory on
+   * close and reloaded if no writes happened in between. 10 bits per key
+   * give a false positive rate of about 1%. Writes by other processes are
+   * detected and bypass the filter until it is rebuilt, on a thread of its
+   * own, as it is once it fills up. */
+  lmdb_configuration& set_filter_bits_per_key(unsigned int bits_per_key);
+
+  /** Returns whether writes are recorded in a change log */
+  [[nodiscard]] bool change_log() const;
+
+  /** Records every committed write transaction in a change log
+   *
+   * The log is a database within the environment, written in the same
+   * transaction as the data, so it holds exactly the committed writes in
+   * commit order. A transaction writing in several batches, as a blob writer
+   * does, is recorded as several changes, each but the last marked
+   * continued. The elements then live in a named database of their own,
+   * so the log must be enabled when the environment is created, and by
+   * every process opening it. */
+  lmdb_configuration& set_change_log(bool enabled);
+
+  using reader_callback = std::function<void(const reader_info&)>;
+
+  /** Returns the time between two checks of the readers, zero for none */
+  [[nodiscard]] std::chrono::milliseconds reader_check_interval() const;
+
+  /** Returns what happens to readers older than max_reader_age */
+  [[nodiscard]] reader_policy stale_reader_policy() const;
+
+  [[nodiscard]] std::chrono::milliseconds max_reader_age() const;
+
+  /** Returns the callback for stale readers, which defaults to a line on
+   * standard error */
+  [[nodiscard]] const reader_callback& stale_reader_callback() const;
+
+  /** Checks the readers periodically on a thread of its own
+   *
+   * Each check clears the reader table slots of dead processes, which would
+   * otherwise pin their snapshot forever, then applies the stale reader
+   * policy. */
+  lmdb_configuration& set_reader_check_interval(
+      std::chrono::milliseconds interval);
+
+  /** Warns about, or invalidates, read transactions open for longer than
+   * max_age
+   *
+   * A read transaction pins its snapshot, so that the pages freed by later
+   * writes cannot be reused and the database file grows meanwhile. An
+   * invalidated transaction releases its snapshot as soon as no operation
+   * is running on it: its iterators then throw std::system_error with
+   * std::errc::timed_out, and the keys and values they returned may be
+   * overwritten. */
+  lmdb_configuration& set_stale_readers(reader_policy policy,
+                                        std::chrono::milliseconds max_age);
+
+  lmdb_configuration& set_stale_reader_callback(reader_callback callback);
+
  private:
   std::filesystem::path path_;
   unsigned int flags_;
   unsigned int mode_;
+  key_compare compare_;
+  unsigned int filter_bits_per_key_ = 0;
+  bool change_log_ = false;
+  std::chrono::milliseconds reader_check_interval_{0};
+  reader_policy stale_reader_policy_ = reader_policy::none;
+  std::chrono::milliseconds max_reader_age_{0};
+  reader_callback stale_reader_callback_;
 };
 
-/** Creates an lmdb datastore */
+/** Progress of a backup of an lmdb datastore */
+struct backup_progress {
+  std::uint64_t bytes = 0;    /** Written so far */
+  std::uint64_t estimate = 0; /** Size of the environment, which bounds a
+                                 compacted copy */
+  std::chrono::steady_clock::duration elapsed{};
+
+  /** Returns the bytes written per second */
+  [[nodiscard]] double throughput() const;
+};
+
+class backup_configuration {
+ public:
+  using callback = std::function<void(const backup_progress&)>;
+
+  [[nodiscard]] bool compact() const;
+  [[nodiscard]] const callback& progress() const;
+
+  /** Omits free pages and renumbers the others, so that the copy is only as
+   * large as the live data, at the cost of more CPU */
+  backup_configuration& set_compact(bool compact);
+
+  /** Reports progress after each chunk written */
+  backup_configuration& set_progress(callback progress);
+
+ private:
+  bool compact_ = false;
+  callback progress_;
+};
+
+/** Keys in [first, second), an empty second standing for the end */
+using key_range = std::pair<std::string, std::string>;
+
+/** How much of the data file of an lmdb environment is in memory */
+struct residency {
+  std::size_t resident = 0; /** Bytes in the page cache */
+  std::size_t size = 0;     /** Bytes of the file */
+
+  /** Returns the fraction of the file in memory */
+  [[nodiscard]] double fraction() const;
+};
+
+/** What warm_up reads into memory, and how fast */
+class warm_up_policy {
+ public:
+  [[nodiscard]] unsigned int threads() const;
+  [[nodiscard]] bool branches() const;
+  [[nodiscard]] const std::vector<key_range>& ranges() const;
+  [[nodiscard]] std::size_t max_bytes() const;
+  [[nodiscard]] std::size_t bytes_per_second() const;
+
+  /** Sets how many threads read at once, so that their reads overlap */
+  warm_up_policy& set_threads(unsigned int threads);
+
+  /** Sets whether the branch pages of the tree are read first */
+  warm_up_policy& set_branches(bool branches);
+
+  /** Sets the ranges of keys whose pages are read next, hottest first, as
+   * saved by save_access_profile */
+  warm_up_policy& set_ranges(std::vector<key_range> ranges);
+
+  /** Bounds the bytes of keys and values of ranges read, 0 for no bound */
+  warm_up_policy& set_max_bytes(std::size_t bytes);
+
+  /** Bounds the rate at which they are read, 0 for no bound */
+  warm_up_policy& set_bytes_per_second(std::size_t bytes_per_second);
+
+ private:
+  unsigned int threads_ = 4;
+  bool branches_ = true;
+  std::vector<key_range> ranges_;
+  std::size_t max_bytes_ = 0;
+  std::size_t bytes_per_second_ = 0;
+};
+
+/** What warm_up read */
+struct warm_up_report {
+  std::size_t branch_pages = 0; /** Of the tree, as LMDB counts them */
+  std::size_t probes = 0;       /** Seeks made to read them */
+  std::size_t ranges = 0;       /** Ranges read, entirely or in part */
+  std::size_t elements = 0;     /** Elements of those ranges */
+  std::size_t bytes = 0;        /** Bytes of their keys and values */
+  residency before;
+  residency after;
+  std::chrono::steady_clock::duration elapsed{};
+};
+
+namespace detail {
+class lmdb;
+}
+
+/** Statically dispatched lmdb datastore
+ *
+ * Include datastore/clients/detail/lmdb.h to instantiate it. */
+using lmdb_client = basic_client<detail::lmdb>;
+
+/** Creates an lmdb datastore
+ *
+ * estimate counts ranges of up to 32 elements exactly. Larger ones are
+ * placed within a sample taken with at most 1024 seeks, which halve the key
+ * space between the keys found while more than 32 elements lie between
+ * them. Those gaps are shared out among the elements not counted by their
+ * parts of the key space, and bound the error of a count where the range
+ * meets them. The sample is taken again once writes since amount to an
+ * eighth of the elements, which the error includes meanwhile.
+ *
+ * update and the merges of a batch read and write in one write transaction,
+ * so that they are atomic against every other write, even from another
+ * process. The change log records the values merges leave.
+ *
+ * A blob writer holds one write transaction until it commits, blocking
+ * writers on other threads and failing those on its own with
+ * std::logic_error, and a blob reader reads every chunk from one snapshot,
+ * copying only the pages of the range it reads out of the map. */
 std::unique_ptr<client> make_lmdb(const lmdb_configuration& configuration);
 
+/** Reads up to limit changes from the change log of an lmdb datastore,
+ * starting at sequence from
+ *
+ * Throws std::invalid_argument if the datastore is not an lmdb datastore
+ * with a change log. */
+std::vector<change> read_changes(const client& datastore, std::uint64_t from,
+                                 std::size_t limit = 1024);
+
+/** Erases the changes before sequence before from the change log of an
+ * lmdb datastore, once every follower has applied them
+ *
+ * The newest change is always kept, so that sequences keep increasing. */
+void truncate_changes(client& datastore, std::uint64_t before);
+
+/** Streams a consistent snapshot of an lmdb datastore to a file descriptor
+ *
+ * Writers carry on meanwhile, as the copy reads from a single read
+ * transaction. Throws std::invalid_argument if the datastore is not an lmdb
+ * datastore. */
+backup_progress backup(
+    const client& datastore, int fd,
+    const backup_configuration& configuration = backup_configuration());
+
+/** Copies a consistent snapshot of an lmdb datastore into the environment
+ * directory, which is replaced only once the copy is complete and synced */
+backup_progress backup(
+    const client& datastore, const std::filesystem::path& directory,
+    const backup_configuration& configuration = backup_configuration());
+
+/** Returns an iterator at the first key of an lmdb datastore not ordered
+ * before from, which reads ahead of itself
+ *
+ * For scans of stores larger than memory, a thread walks a cursor of its own
+ * up to window bytes of keys and values ahead of the iterator, faulting in
+ * the pages of the tree and advising the kernel of the pages of the values,
+ * so that the scan waits on the bandwidth of the disk rather than on one
+ * fault after another. The thread stops once the iterator and every copy of
+ * it are destroyed. Throws std::invalid_argument if the datastore is not an
+ * lmdb datastore. */
+client::iterator read_ahead(const client& datastore,
+                            client::key_type from = client::key_type(),
+                            std::size_t window = 16 << 20);
+
+/** Reads the pages an lmdb datastore is likely to need into memory, as
+ * after a restart, so that the first requests do not each wait on faults
+ *
+ * LMDB does not expose its pages, so the branch pages are reached through
+ * the keys: threads seek between the keys found so far, level by level,
+ * until they have made twice as many seeks as there are branch pages. The
+ * upper levels of the tree are thus read before the lower ones, and the
+ * leaves only along the way. The pages of the keys and values of the ranges
+ * of the policy are then handed to the kernel to read ahead, MADV_WILLNEED,
+ * within the bounds of the policy. Throws std::invalid_argument if the
+ * datastore is not an lmdb datastore. */
+warm_up_report warm_up(const client& datastore,
+                       const warm_up_policy& policy = warm_up_policy());
+
+/** Returns how much of the data file of an lmdb datastore is in the page
+ * cache, as mincore reports, or nothing resident where mincore is missing
+ *
+ * Throws std::invalid_argument if the datastore is not an lmdb datastore. */
+residency resident(const client& datastore);
+
+/** Saves ranges of keys for a later warm_up, replacing the file at path
+ * once they are written */
+void save_access_profile(const std::filesystem::path& path,
+                         const std::vector<key_range>& ranges);
+
+/** Loads ranges saved by save_access_profile
+ *
+ * Throws std::runtime_error if the file cannot be read or is corrupt. */
+std::vector<key_range> load_access_profile(const std::filesystem::path& path);
+
+/** Occupancy of the reader table of an lmdb environment */
+struct reader_statistics {
+  std::size_t open = 0; /** Read transactions of the datastore */
+  std::chrono::steady_clock::duration oldest{}; /** Age of the oldest */
+  unsigned int slots_used = 0; /** Slots claimed, by every process */
+  unsigned int slots = 0;      /** Size of the table */
+  std::size_t reaped = 0;      /** Slots of dead processes cleared */
+  std::size_t warned = 0;      /** Stale readers reported */
+  std::size_t invalidated = 0; /** Stale readers invalidated */
+
+  /** Returns the fraction of the slots claimed */
+  [[nodiscard]] double occupancy() const;
+};
+
+/** Labels the read transactions begun by the current thread while it lives
+ *
+ * Labels nest, the innermost applying, so that a reader held for too long
+ * can be traced back to the code which began it. */
+class reader_origin {
+ public:
+  explicit reader_origin(std::string label);
+  ~reader_origin();
+
+  reader_origin(const reader_origin&) = delete;
+  reader_origin& operator=(const reader_origin&) = delete;
+
+  /** Returns the label of the current thread, empty if none */
+  [[nodiscard]] static const std::string& current();
+
+ private:
+  std::string previous_;
+};
+
+/** Returns the reader table occupancy and the age of the oldest read
+ * transaction of an lmdb datastore
+ *
+ * Every iterator, and every copy of it, holds a read transaction until it
+ * is destroyed or reaches the end. Throws std::invalid_argument if the
+ * datastore is not an lmdb datastore. */
+reader_statistics readers(const client& datastore);
+
+/** Returns the open read transactions of an lmdb datastore, oldest first */
+std::vector<reader_info> open_readers(const client& datastore);
+
+/** Clears the reader table slots of dead processes, then applies the stale
+ * reader policy, as the periodic check does, returning the slots cleared */
+std::size_t check_readers(const client& datastore);
+
+/** Replaces the environment in directory with a backup, atomically
+ *
+ * Combined with a compacted backup, this shrinks an environment: back up
+ * with compaction, close every client of the environment, restore, then
+ * reopen. Both directories must be on the same file system. */
+void restore(const std::filesystem::path& backup,
+             const std::filesystem::path& directory);
+
 }  // namespace datastore::clients
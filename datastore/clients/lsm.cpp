@@ -0,0 +1,45 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/lsm.h>
+
+namespace datastore::clients {
+
+lsm_configuration::lsm_configuration(std::filesystem::path path,
+                                     key_compare compare)
+    : path_(std::move(path)), compare_(compare) {}
+
+const std::filesystem::path& lsm_configuration::path() const { return path_; }
+
+key_compare lsm_configuration::compare() const { return compare_; }
+
+std::size_t lsm_configuration::memtable_size() const {
+  return memtable_size_;
+}
+
+unsigned int lsm_configuration::compaction_trigger() const {
+  return compaction_trigger_;
+}
+
+bool lsm_configuration::sync() const { return sync_; }
+
+lsm_configuration& lsm_configuration::set_memtable_size(
+    std::size_t memtable_size) {
+  memtable_size_ = memtable_size;
+  return *this;
+}
+
+lsm_configuration& lsm_configuration::set_compaction_trigger(
+    unsigned int compaction_trigger) {
+  compaction_trigger_ = compaction_trigger;
+  return *this;
+}
+
+lsm_configuration& lsm_configuration::set_sync(bool sync) {
+  sync_ = sync;
+  return *this;
+}
+
+std::unique_ptr<client> make_lsm(const lsm_configuration& configuration) {
+  return std::make_unique<detail::adapter<detail::lsm>>(configuration);
+}
+
+}  // namespace datastore::clients
@@ -0,0 +1,69 @@
+#pragma once
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <datastore/compare.h>
+#include <filesystem>
+
+namespace datastore::clients {
+
+class lsm_configuration {
+ public:
+  explicit lsm_configuration(std::filesystem::path path,
+                             key_compare compare = nullptr);
+
+  /** Returns the directory holding the log and the sorted runs */
+  [[nodiscard]] const std::filesystem::path& path() const;
+
+  /** Returns the key ordering, or nullptr for byte order */
+  [[nodiscard]] key_compare compare() const;
+
+  /** Returns the size in bytes at which the memtable is flushed to a run */
+  [[nodiscard]] std::size_t memtable_size() const;
+
+  /** Returns the number of runs which triggers a compaction */
+  [[nodiscard]] unsigned int compaction_trigger() const;
+
+  /** Returns whether each write is synced to disk before it returns */
+  [[nodiscard]] bool sync() const;
+
+  /** Sets the size of the memtable, 4MiB by default
+   *
+   * Writes are buffered in memory up to this size, so a larger memtable
+   * makes for fewer, larger runs at the cost of memory and recovery time. */
+  lsm_configuration& set_memtable_size(std::size_t memtable_size);
+
+  /** Sets the number of runs at which adjacent runs of similar size are
+   * merged, 4 by default
+   *
+   * Lookups consult every run, so fewer runs favour reads, while more runs
+   * rewrite each element fewer times. */
+  lsm_configuration& set_compaction_trigger(unsigned int compaction_trigger);
+
+  /** Syncs the log on every write, off by default
+   *
+   * Without syncing, writes survive a crash of the process but the most
+   * recent ones may be lost if the machine fails. */
+  lsm_configuration& set_sync(bool sync);
+
+ private:
+  std::filesystem::path path_;
+  key_compare compare_;
+  std::size_t memtable_size_ = 4 << 20;
+  unsigned int compaction_trigger_ = 4;
+  bool sync_ = false;
+};
+
+namespace detail {
+class lsm;
+}
+
+/** Statically dispatched log-structured merge datastore
+ *
+ * Include datastore/clients/detail/lsm.h to instantiate it. */
+using lsm_client = basic_client<detail::lsm>;
+
+/** Creates a write-optimised datastore, which logs writes to an in-memory
+ * table and merges them into sorted runs in the background */
+std::unique_ptr<client> make_lsm(const lsm_configuration& configuration);
+
+}  // namespace datastore::clients
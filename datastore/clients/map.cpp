@@ -1,10 +1,20 @@
 #include "map.h"
-#include <datastore/clients/detail/map.h>
+#include <datastore/clients/detail/adapter.h>
+#include <stdexcept>
 
 namespace datastore::clients {
 
-std::unique_ptr<client> make_map() {
-  return std::make_unique<clients::detail::map>();
+std::unique_ptr<client> make_map(key_compare compare) {
+  return std::make_unique<detail::adapter<detail::map>>(compare);
+}
+
+std::unique_ptr<client> snapshot(const client& datastore) {
+  auto map = dynamic_cast<const detail::adapter<detail::map>*>(&datastore);
+  if (map == nullptr) {
+    throw std::invalid_argument("datastore is not an in-memory map");
+  }
+  return std::make_unique<detail::adapter<detail::map>>(
+      map->get().backend());
 }
 
 }  // namespace datastore::clients
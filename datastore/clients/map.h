@@ -1,9 +1,25 @@
 #pragma once
+#include <datastore/basic_client.h>
 #include <datastore/client.h>
+#include <datastore/clients/detail/map.h>
+#include <datastore/compare.h>
 #include <memory>
 
 namespace datastore::clients {
 
-std::unique_ptr<client> make_map();
+/** Statically dispatched in-memory datastore */
+using map_client = basic_client<detail::map>;
+
+/** Creates an in-memory datastore, optionally with a custom key order
+ *
+ * Ranges of keys are sized exactly by estimate, in O(log n). */
+std::unique_ptr<client> make_map(key_compare compare = nullptr);
+
+/** Creates a point-in-time copy of a datastore created by make_map
+ *
+ * The copy shares the structure of the original, so this takes constant time
+ * and memory, and either may then be modified without affecting the other.
+ * Throws std::invalid_argument if the datastore is not an in-memory map. */
+std::unique_ptr<client> snapshot(const client& datastore);
 
 }  // namespace datastore::clients
@@ -0,0 +1,10 @@
+#include "radix_map.h"
+#include <datastore/clients/detail/adapter.h>
+
+namespace datastore::clients {
+
+std::unique_ptr<client> make_radix_map() {
+  return std::make_unique<detail::adapter<detail::art>>();
+}
+
+}  // namespace datastore::clients
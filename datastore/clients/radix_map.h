@@ -0,0 +1,19 @@
+#pragma once
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <datastore/clients/detail/art.h>
+#include <memory>
+
+namespace datastore::clients {
+
+/** Statically dispatched in-memory datastore over a radix tree */
+using radix_map_client = basic_client<detail::art>;
+
+/** Creates an in-memory datastore over an adaptive radix tree
+ *
+ * Suits keys which share long prefixes, which are stored once, and whose
+ * lookups cost one step per distinct key byte instead of whole key
+ * comparisons. Keys are always in lexicographic byte order. */
+std::unique_ptr<client> make_radix_map();
+
+}  // namespace datastore::clients
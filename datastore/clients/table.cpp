@@ -0,0 +1,157 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/coding.h>
+#include <datastore/clients/detail/table.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace datastore::clients {
+
+namespace {
+
+constexpr std::uint64_t magic = 0x31454c4241545344;  // "DSTABLE1"
+constexpr std::uint32_t version = 1;
+
+}  // namespace
+
+table_configuration::table_configuration(std::filesystem::path path,
+                                         key_compare compare)
+    : path_(std::move(path)), compare_(compare) {}
+
+const std::filesystem::path& table_configuration::path() const {
+  return path_;
+}
+
+key_compare table_configuration::compare() const { return compare_; }
+
+std::size_t table_configuration::block_size() const { return block_size_; }
+
+unsigned int table_configuration::restart_interval() const {
+  return restart_interval_;
+}
+
+bool table_configuration::preload() const { return preload_; }
+
+table_configuration& table_configuration::set_block_size(
+    std::size_t block_size) {
+  block_size_ = block_size;
+  return *this;
+}
+
+table_configuration& table_configuration::set_restart_interval(
+    unsigned int restart_interval) {
+  restart_interval_ = std::max(restart_interval, 1u);
+  return *this;
+}
+
+table_configuration& table_configuration::set_preload(bool preload) {
+  preload_ = preload;
+  return *this;
+}
+
+table_writer::table_writer(const table_configuration& configuration)
+    : configuration_(configuration),
+      temporary_(configuration.path().string() + ".tmp"),
+      os_(temporary_, std::ios::binary | std::ios::trunc) {
+  if (!os_) {
+    throw std::filesystem::filesystem_error(
+        "unable to create table", temporary_,
+        std::make_error_code(std::errc::io_error));
+  }
+}
+
+table_writer::~table_writer() {
+  if (!finished_) {
+    os_.close();
+    std::error_code error;
+    std::filesystem::remove(temporary_, error);
+  }
+}
+
+void table_writer::add(std::string_view key, std::string_view value) {
+  append(key, value, false);
+}
+
+void table_writer::add_erasure(std::string_view key) {
+  append(key, std::string_view(), true);
+}
+
+void table_writer::append(std::string_view key, std::string_view value,
+                          bool erased) {
+  if (count_ > 0 && !key_less(configuration_.compare())(last_key_, key)) {
+    throw std::invalid_argument("table keys must be strictly increasing");
+  }
+  std::size_t shared = 0;
+  if (block_.empty() || since_restart_ == configuration_.restart_interval()) {
+    detail::put_fixed32(restarts_, static_cast<std::uint32_t>(block_.size()));
+    since_restart_ = 0;
+  } else {
+    auto limit = std::min(last_key_.size(), key.size());
+    while (shared < limit && last_key_[shared] == key[shared]) {
+      ++shared;
+    }
+  }
+  ++since_restart_;
+  detail::put_varint(block_, shared);
+  detail::put_varint(block_, key.size() - shared);
+  detail::put_varint(block_, value.size() << 1 | (erased ? 1 : 0));
+  block_.append(key.substr(shared));
+  block_.append(value);
+  last_key_.assign(key);
+  ++count_;
+  if (block_.size() + restarts_.size() + 4 >= configuration_.block_size()) {
+    flush();
+  }
+}
+
+void table_writer::flush() {
+  if (block_.empty()) {
+    return;
+  }
+  block_.append(restarts_);
+  detail::put_fixed32(block_,
+                      static_cast<std::uint32_t>(restarts_.size() / 4));
+  os_.write(block_.data(), static_cast<std::streamsize>(block_.size()));
+  detail::put_length_prefixed(index_, last_key_);
+  detail::put_fixed64(index_, offset_);
+  detail::put_fixed32(index_, static_cast<std::uint32_t>(block_.size()));
+  offset_ += block_.size();
+  ++block_count_;
+  block_.clear();
+  restarts_.clear();
+}
+
+void table_writer::finish() {
+  flush();
+  auto footer = std::string();
+  detail::put_fixed64(footer, offset_);
+  detail::put_fixed64(footer, index_.size());
+  detail::put_fixed64(footer, count_);
+  detail::put_fixed32(footer, block_count_);
+  detail::put_fixed32(footer, version);
+  detail::put_fixed64(footer, magic);
+  os_.write(index_.data(), static_cast<std::streamsize>(index_.size()));
+  os_.write(footer.data(), static_cast<std::streamsize>(footer.size()));
+  os_.close();
+  if (!os_) {
+    throw std::filesystem::filesystem_error(
+        "unable to write table", temporary_,
+        std::make_error_code(std::errc::io_error));
+  }
+  std::filesystem::rename(temporary_, configuration_.path());
+  finished_ = true;
+}
+
+void write_table(const client& source,
+                 const table_configuration& configuration) {
+  auto writer = table_writer(configuration);
+  for (const auto& [key, value] : source) {
+    writer.add(key, value);
+  }
+  writer.finish();
+}
+
+std::unique_ptr<client> make_table(const table_configuration& configuration) {
+  return std::make_unique<detail::adapter<detail::table>>(configuration);
+}
+
+}  // namespace datastore::clients
@@ -0,0 +1,120 @@
+#pragma once
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <datastore/compare.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace datastore::clients {
+
+class table_configuration {
+ public:
+  explicit table_configuration(std::filesystem::path path,
+                               key_compare compare = nullptr);
+  [[nodiscard]] const std::filesystem::path& path() const;
+
+  /** Returns the key ordering, or nullptr for byte order */
+  [[nodiscard]] key_compare compare() const;
+
+  /** Returns the target size in bytes of a data block */
+  [[nodiscard]] std::size_t block_size() const;
+
+  /** Returns the number of keys between uncompressed keys in a block */
+  [[nodiscard]] unsigned int restart_interval() const;
+
+  /** Returns whether the whole table is read ahead when opened */
+  [[nodiscard]] bool preload() const;
+
+  /** Sets the target size of a data block, 4KiB by default
+   *
+   * A lookup binary searches the in-memory index and then touches a single
+   * block, so blocks of a page keep a lookup to one page fault. */
+  table_configuration& set_block_size(std::size_t block_size);
+
+  /** Sets how often a key is stored in full, 16 by default
+   *
+   * Keys in between only store the suffix they do not share with the
+   * previous key. An interval of 1 disables prefix compression, which lets
+   * cursors refer to keys in the mapping without copying them. */
+  table_configuration& set_restart_interval(unsigned int restart_interval);
+
+  /** Asks the kernel to read the whole table ahead, rather than fault it in
+   * page by page as it is looked up */
+  table_configuration& set_preload(bool preload);
+
+ private:
+  std::filesystem::path path_;
+  key_compare compare_;
+  std::size_t block_size_ = 4096;
+  unsigned int restart_interval_ = 16;
+  bool preload_ = false;
+};
+
+/** Writes a table from keys given in strictly increasing order
+ *
+ * The table is written to a temporary file which replaces the file at the
+ * configured path once finished, so that readers never see a partial table.
+ */
+class table_writer {
+ public:
+  explicit table_writer(const table_configuration& configuration);
+
+  /** Discards the table unless it was finished */
+  ~table_writer();
+
+  table_writer(const table_writer&) = delete;
+  table_writer& operator=(const table_writer&) = delete;
+
+  /** Appends an element, throwing std::invalid_argument if its key does not
+   * order after the previous key */
+  void add(std::string_view key, std::string_view value);
+
+  /** Appends a marker recording the erasure of key
+   *
+   * Markers let a table shadow older tables layered beneath it, as the runs
+   * of an lsm datastore do. A table opened on its own reports them as
+   * elements with an empty value. */
+  void add_erasure(std::string_view key);
+
+  /** Writes the index and publishes the table */
+  void finish();
+
+ private:
+  void append(std::string_view key, std::string_view value, bool erased);
+  void flush();
+
+  table_configuration configuration_;
+  std::filesystem::path temporary_;
+  std::ofstream os_;
+  std::string block_;
+  std::string restarts_;
+  std::string index_;
+  std::string last_key_;
+  std::uint64_t offset_ = 0;
+  std::uint64_t count_ = 0;
+  unsigned int block_count_ = 0;
+  unsigned int since_restart_ = 0;
+  bool finished_ = false;
+};
+
+/** Writes the contents of a datastore to a table */
+void write_table(const client& source,
+                 const table_configuration& configuration);
+
+namespace detail {
+class table;
+}
+
+/** Statically dispatched read-only table datastore
+ *
+ * Include datastore/clients/detail/table.h to instantiate it. */
+using table_client = basic_client<detail::table>;
+
+/** Opens a read-only datastore over a table written by a table_writer
+ *
+ * The table must be opened with the ordering it was written with. Any
+ * modification throws std::system_error. */
+std::unique_ptr<client> make_table(const table_configuration& configuration);
+
+}  // namespace datastore::clients
@@ -0,0 +1,61 @@
+#include <datastore/clients/detail/adapter.h>
+#include <datastore/clients/detail/tiered.h>
+
+namespace datastore::clients {
+
+tiered_configuration::tiered_configuration(std::size_t hot_capacity,
+                                           key_compare compare)
+    : hot_capacity_(hot_capacity), compare_(compare) {}
+
+std::size_t tiered_configuration::hot_capacity() const {
+  return hot_capacity_;
+}
+
+key_compare tiered_configuration::compare() const { return compare_; }
+
+unsigned int tiered_configuration::promotion_threshold() const {
+  return promotion_threshold_;
+}
+
+std::size_t tiered_configuration::batch_size() const { return batch_size_; }
+
+std::chrono::milliseconds tiered_configuration::interval() const {
+  return interval_;
+}
+
+const tiered_configuration::error_callback&
+tiered_configuration::close_error_callback() const {
+  return close_error_callback_;
+}
+
+tiered_configuration& tiered_configuration::set_promotion_threshold(
+    unsigned int threshold) {
+  promotion_threshold_ = threshold;
+  return *this;
+}
+
+tiered_configuration& tiered_configuration::set_batch_size(
+    std::size_t batch_size) {
+  batch_size_ = batch_size;
+  return *this;
+}
+
+tiered_configuration& tiered_configuration::set_interval(
+    std::chrono::milliseconds interval) {
+  interval_ = interval;
+  return *this;
+}
+
+tiered_configuration& tiered_configuration::set_close_error_callback(
+    error_callback callback) {
+  close_error_callback_ = std::move(callback);
+  return *this;
+}
+
+std::unique_ptr<client> make_tiered(std::unique_ptr<client> cold,
+                                    const tiered_configuration& configuration) {
+  return std::make_unique<detail::adapter<detail::tiered>>(std::move(cold),
+                                                           configuration);
+}
+
+}  // namespace datastore::clients
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <datastore/basic_client.h>
+#include <datastore/client.h>
+#include <datastore/compare.h>
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace datastore::clients {
+
+class tiered_configuration {
+ public:
+  /** Configures a hot tier holding up to hot_capacity bytes of keys and
+   * values, ordered like the cold tier */
+  explicit tiered_configuration(std::size_t hot_capacity,
+                                key_compare compare = nullptr);
+
+  [[nodiscard]] std::size_t hot_capacity() const;
+  [[nodiscard]] key_compare compare() const;
+
+  /** Returns the number of reads of a cold key before it is promoted */
+  [[nodiscard]] unsigned int promotion_threshold() const;
+
+  /** Returns the maximum number of elements moved per cold transaction */
+  [[nodiscard]] std::size_t batch_size() const;
+
+  /** Returns the time between two rounds of promotion and demotion */
+  [[nodiscard]] std::chrono::milliseconds interval() const;
+
+  using error_callback = std::function<void(const std::exception&)>;
+
+  /** Returns the callback for a failure to write back the hot tier when the
+   * datastore is destroyed, which defaults to a line on standard error */
+  [[nodiscard]] const error_callback& close_error_callback() const;
+
+  tiered_configuration& set_promotion_threshold(unsigned int threshold);
+  tiered_configuration& set_batch_size(std::size_t batch_size);
+  tiered_configuration& set_interval(std::chrono::milliseconds interval);
+
+  /** Reports a failure of the destructor to write back the hot tier, whose
+   * writes are then lost; the callback must not throw */
+  tiered_configuration& set_close_error_callback(error_callback callback);
+
+ private:
+  std::size_t hot_capacity_;
+  key_compare compare_;
+  unsigned int promotion_threshold_ = 4;
+  std::size_t batch_size_ = 1024;
+  std::chrono::milliseconds interval_{1000};
+  error_callback close_error_callback_;
+};
+
+namespace detail {
+class tiered;
+}
+
+/** Statically dispatched tiered datastore
+ *
+ * Include datastore/clients/detail/tiered.h to instantiate it. */
+using tiered_client = basic_client<detail::tiered>;
+
+/** Creates a datastore keeping frequently read elements in memory
+ *
+ * Writes go to an in-memory hot tier, and reads fall back to the cold
+ * datastore. A background thread demotes the least frequently read
+ * elements whenever the hot tier exceeds its capacity, writing back those
+ * written since they were last in the cold tier, and copies cold elements
+ * which are read often to the hot tier. Iteration merges both tiers in
+ * order. Erasures are written to the cold tier straight away, while other
+ * writes reach it on demotion or when the datastore is destroyed. The
+ * destructor can only report a failure to the close error callback, so call
+ * flush() before destroying the datastore to handle it instead.
+ *
+ * The cold datastore, typically LMDB, is written by the background thread
+ * and must be ordered like the configuration. Its iterators must remain
+ * valid while it is written, as LMDB's do. */
+std::unique_ptr<client> make_tiered(std::unique_ptr<client> cold,
+                                    const tiered_configuration& configuration);
+
+}  // namespace datastore::clients
@@ -0,0 +1,119 @@
+#include <datastore/compare.h>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define DATASTORE_X86_64
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+using kernel = int (*)(const unsigned char*, const unsigned char*,
+                       std::size_t);
+
+int scalar(const unsigned char* lhs, const unsigned char* rhs,
+           std::size_t n) {
+  for (; n >= sizeof(std::uint64_t); n -= sizeof(std::uint64_t)) {
+    std::uint64_t x, y;
+    std::memcpy(&x, lhs, sizeof(x));
+    std::memcpy(&y, rhs, sizeof(y));
+    if (x != y) {
+      return std::memcmp(lhs, rhs, sizeof(x));
+    }
+    lhs += sizeof(x);
+    rhs += sizeof(y);
+  }
+  return n == 0 ? 0 : std::memcmp(lhs, rhs, n);
+}
+
+#ifdef DATASTORE_X86_64
+
+/** Returns the index of the lowest set bit of a non-zero mask */
+unsigned int lowest(unsigned int mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+int sse2(const unsigned char* lhs, const unsigned char* rhs, std::size_t n) {
+  for (; n >= 16; n -= 16, lhs += 16, rhs += 16) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs));
+    auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs));
+    auto mask = static_cast<unsigned int>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) ^
+                0xffffu;
+    if (mask != 0) {
+      auto i = lowest(mask);
+      return int{lhs[i]} - int{rhs[i]};
+    }
+  }
+  return scalar(lhs, rhs, n);
+}
+
+#if defined(__GNUC__)
+__attribute__((target("avx2"))) int avx2(const unsigned char* lhs,
+                                         const unsigned char* rhs,
+                                         std::size_t n) {
+  for (; n >= 32; n -= 32, lhs += 32, rhs += 32) {
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs));
+    auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs));
+    auto mask = ~static_cast<unsigned int>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+    if (mask != 0) {
+      auto i = lowest(mask);
+      return int{lhs[i]} - int{rhs[i]};
+    }
+  }
+  return sse2(lhs, rhs, n);
+}
+#endif
+
+#endif
+
+kernel select() {
+#ifdef DATASTORE_X86_64
+#if defined(__GNUC__)
+  if (__builtin_cpu_supports("avx2")) {
+    return avx2;
+  }
+#endif
+  return sse2;
+#else
+  return scalar;
+#endif
+}
+
+}  // namespace
+
+namespace datastore {
+
+key_less::key_less(key_compare compare) noexcept : compare_(compare) {}
+
+bool key_less::operator()(std::string_view lhs, std::string_view rhs) const {
+  return compare_ ? compare_(lhs, rhs) < 0 : lhs < rhs;
+}
+
+key_compare key_less::compare() const noexcept { return compare_; }
+
+namespace compare {
+
+int lexicographic(std::string_view lhs, std::string_view rhs) {
+  return lhs.compare(rhs);
+}
+
+int bytes(const void* lhs, const void* rhs, std::size_t n) {
+  static const kernel compare_bytes = select();
+  return compare_bytes(static_cast<const unsigned char*>(lhs),
+                       static_cast<const unsigned char*>(rhs), n);
+}
+
+}  // namespace compare
+
+}  // namespace datastore
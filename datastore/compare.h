@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace datastore {
+
+/** Three-way comparison of two keys
+ *
+ * Returns a negative value if lhs orders before rhs, zero if they are
+ * equivalent and a positive value otherwise. Comparators are plain functions
+ * so that they can be installed into backends, such as LMDB, which do not
+ * carry any state alongside the comparison function. */
+using key_compare = int (*)(std::string_view lhs, std::string_view rhs);
+
+/** Adapts a key_compare to a transparent strict weak ordering */
+class key_less {
+ public:
+  using is_transparent = void;
+
+  /** Creates an ordering, defaulting to lexicographic byte order */
+  explicit key_less(key_compare compare = nullptr) noexcept;
+
+  /** Returns true if lhs orders before rhs */
+  bool operator()(std::string_view lhs, std::string_view rhs) const;
+
+  /** Returns the underlying comparator, or nullptr for byte order */
+  [[nodiscard]] key_compare compare() const noexcept;
+
+ private:
+  key_compare compare_;
+};
+
+namespace compare {
+
+/** Orders keys byte-wise, with a shorter key first on a common prefix.
+ *
+ * This is the default ordering of every backend. */
+int lexicographic(std::string_view lhs, std::string_view rhs);
+
+/** Compares n bytes as unsigned chars, like memcmp
+ *
+ * Uses AVX2 or SSE2 on x86-64 when the processor supports it. */
+int bytes(const void* lhs, const void* rhs, std::size_t n);
+
+/** Orders fixed width keys of N bytes, such as hashes
+ *
+ * Produces the same order as lexicographic, but compares a whole vector of
+ * bytes per step. Keys which are not N bytes long are compared
+ * lexicographically. */
+template <std::size_t N>
+int fixed(std::string_view lhs, std::string_view rhs);
+
+/** Orders keys made of a sequence of fixed width integers in native byte
+ * order, comparing numerically field by field.
+ *
+ * For example, tuple<std::uint64_t, std::uint64_t> orders a (tenant,
+ * timestamp) key by tenant, then by timestamp. Bytes beyond the last field
+ * are compared lexicographically. A key too short for a field orders before
+ * every key with the same earlier fields which has it, and such keys are
+ * compared lexicographically among themselves. */
+template <typename... Ts>
+int tuple(std::string_view lhs, std::string_view rhs);
+
+template <std::size_t N>
+int fixed(std::string_view lhs, std::string_view rhs) {
+  if (lhs.size() != N || rhs.size() != N) {
+    return lexicographic(lhs, rhs);
+  }
+  return bytes(lhs.data(), rhs.data(), N);
+}
+
+namespace detail {
+
+template <typename T, typename... Ts>
+int fields(std::string_view lhs, std::string_view rhs) {
+  static_assert(std::is_integral_v<T>, "tuple fields must be integers");
+  // Keys too short for the field order before those which have it
+  if (lhs.size() < sizeof(T) || rhs.size() < sizeof(T)) {
+    if (lhs.size() >= sizeof(T) || rhs.size() >= sizeof(T)) {
+      return lhs.size() < sizeof(T) ? -1 : 1;
+    }
+    return lexicographic(lhs, rhs);
+  }
+  T x, y;
+  std::memcpy(&x, lhs.data(), sizeof(T));
+  std::memcpy(&y, rhs.data(), sizeof(T));
+  if (x != y) {
+    return x < y ? -1 : 1;
+  }
+  lhs.remove_prefix(sizeof(T));
+  rhs.remove_prefix(sizeof(T));
+  if constexpr (sizeof...(Ts) == 0) {
+    return lexicographic(lhs, rhs);
+  } else {
+    return fields<Ts...>(lhs, rhs);
+  }
+}
+
+}  // namespace detail
+
+template <typename... Ts>
+int tuple(std::string_view lhs, std::string_view rhs) {
+  return detail::fields<Ts...>(lhs, rhs);
+}
+
+}  // namespace compare
+
+}  // namespace datastore
@@ -0,0 +1,556 @@
+#include <datastore/clients/detail/coding.h>
+#include <datastore/compression.h>
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#ifdef DATASTORE_HAS_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+namespace datastore {
+
+namespace {
+
+using clients::detail::get_varint;
+using clients::detail::put_varint;
+
+/** Matches reach back at most this far, for a two byte offset */
+constexpr std::size_t window = 0xffff;
+constexpr std::size_t min_match = 4;
+
+/** Bits of the hash table of a dictionary */
+constexpr unsigned int dictionary_bits = 16;
+
+/** Bytes of the strings counted when training a dictionary */
+constexpr std::size_t gram = 8;
+
+/** Bytes of the pieces of samples a dictionary is made of */
+constexpr std::size_t segment = 32;
+
+std::uint32_t read32(const char* data) {
+  std::uint32_t result;
+  std::memcpy(&result, data, sizeof(result));
+  return result;
+}
+
+std::uint64_t read64(const char* data) {
+  std::uint64_t result;
+  std::memcpy(&result, data, sizeof(result));
+  return result;
+}
+
+std::uint32_t hash(std::uint32_t word, unsigned int bits) {
+  return (word * 2654435761u) >> (32 - bits);
+}
+
+[[noreturn]] void corrupt() {
+  throw std::runtime_error("compressed value is corrupt");
+}
+
+#ifdef DATASTORE_HAS_ZSTD
+struct cctx_deleter {
+  void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+};
+
+struct dctx_deleter {
+  void operator()(ZSTD_DCtx* context) const { ZSTD_freeDCtx(context); }
+};
+#endif
+
+/** Buffers of a thread, reused from one value to the next */
+struct scratch {
+  std::string compressed;
+  std::string decompressed;
+  std::vector<std::uint32_t> table;
+#ifdef DATASTORE_HAS_ZSTD
+  std::unique_ptr<ZSTD_CCtx, cctx_deleter> cctx{ZSTD_createCCtx()};
+  std::unique_ptr<ZSTD_DCtx, dctx_deleter> dctx{ZSTD_createDCtx()};
+#endif
+};
+
+scratch& local() {
+  thread_local scratch buffers;
+  return buffers;
+}
+
+/** Appends the part of a length beyond its 15 in a token nibble */
+void put_length(std::string& output, std::size_t length) {
+  for (; length >= 255; length -= 255) {
+    output.push_back(static_cast<char>(255));
+  }
+  output.push_back(static_cast<char>(length));
+}
+
+/** Adds the part of a length beyond its 15 in a token nibble */
+void get_length(const char*& input, const char* end, std::size_t& length) {
+  auto byte = 255u;
+  while (byte == 255) {
+    if (input == end) {
+      corrupt();
+    }
+    byte = static_cast<unsigned char>(*input++);
+    length += byte;
+  }
+}
+
+/** Appends literals followed by a match, or by nothing if match is zero
+ *
+ * A token holds the number of literals and the length of the match beyond
+ * min_match in a nibble each, with 15 standing for more bytes to come. */
+void put_sequence(std::string& output, std::string_view literals,
+                  std::size_t offset, std::size_t match) {
+  auto literal_nibble = std::min<std::size_t>(literals.size(), 15);
+  auto match_nibble =
+      match == 0 ? 0 : std::min<std::size_t>(match - min_match, 15);
+  output.push_back(static_cast<char>(literal_nibble << 4 | match_nibble));
+  if (literal_nibble == 15) {
+    put_length(output, literals.size() - 15);
+  }
+  output.append(literals);
+  if (match != 0) {
+    output.push_back(static_cast<char>(offset & 0xff));
+    output.push_back(static_cast<char>(offset >> 8));
+    if (match_nibble == 15) {
+      put_length(output, match - min_match - 15);
+    }
+  }
+}
+
+/** Compresses input greedily, with matches into the input so far or into
+ * the dictionary before it
+ *
+ * dictionary_table holds the last position, plus one, of each hash of four
+ * bytes in the dictionary, or is empty without a dictionary. */
+void lz_compress(std::string_view input, std::string_view dictionary,
+                 const std::vector<std::uint32_t>& dictionary_table,
+                 std::vector<std::uint32_t>& table, std::string& output) {
+  auto size = input.size();
+  auto bits = 8u;
+  while (bits < 14 && (std::size_t{1} << bits) < size) {
+    ++bits;
+  }
+  table.assign(std::size_t{1} << bits, 0);
+  auto data = input.data();
+  auto limit = size >= min_match ? size - min_match + 1 : 0;
+  std::size_t anchor = 0;
+  std::size_t position = 0;
+  std::size_t misses = 0;
+  while (position < limit) {
+    auto word = read32(data + position);
+    auto& slot = table[hash(word, bits)];
+    std::size_t candidate = slot;
+    slot = static_cast<std::uint32_t>(position + 1);
+    std::size_t offset = 0;
+    std::size_t length = 0;
+    if (candidate != 0 && position - (candidate - 1) <= window &&
+        read32(data + candidate - 1) == word) {
+      offset = position - (candidate - 1);
+      length = min_match;
+      while (position + length < size &&
+             data[candidate - 1 + length] == data[position + length]) {
+        ++length;
+      }
+    } else if (!dictionary_table.empty()) {
+      candidate = dictionary_table[hash(word, dictionary_bits)];
+      auto start = candidate - 1;
+      if (candidate != 0 && position + dictionary.size() - start <= window) {
+        // The match may run on from the end of the dictionary into the input
+        std::size_t matched = 0;
+        while (position + matched < size &&
+               start + matched < dictionary.size() &&
+               dictionary[start + matched] == data[position + matched]) {
+          ++matched;
+        }
+        if (start + matched == dictionary.size()) {
+          for (std::size_t from = 0; position + matched < size &&
+                                     data[from] == data[position + matched];
+               ++from) {
+            ++matched;
+          }
+        }
+        if (matched >= min_match) {
+          offset = position + dictionary.size() - start;
+          length = matched;
+        }
+      }
+    }
+    if (length == 0) {
+      // Skip faster through data which does not compress
+      position += 1 + (misses++ >> 5);
+      continue;
+    }
+    put_sequence(output, input.substr(anchor, position - anchor), offset,
+                 length);
+    position += length;
+    anchor = position;
+    misses = 0;
+  }
+  put_sequence(output, input.substr(anchor), 0, 0);
+}
+
+void lz_decompress(std::string_view input, std::string_view dictionary,
+                   std::size_t size, std::string& output) {
+  output.resize(size);
+  auto out = output.data();
+  std::size_t written = 0;
+  auto in = input.data();
+  auto end = in + input.size();
+  while (true) {
+    if (in == end) {
+      corrupt();
+    }
+    auto token = static_cast<unsigned char>(*in++);
+    std::size_t literals = token >> 4;
+    if (literals == 15) {
+      get_length(in, end, literals);
+    }
+    if (literals > static_cast<std::size_t>(end - in) ||
+        literals > size - written) {
+      corrupt();
+    }
+    std::memcpy(out + written, in, literals);
+    in += literals;
+    written += literals;
+    if (in == end) {
+      break;
+    }
+    if (end - in < 2) {
+      corrupt();
+    }
+    std::size_t offset = static_cast<unsigned char>(in[0]) |
+                         static_cast<std::size_t>(
+                             static_cast<unsigned char>(in[1]))
+                             << 8;
+    in += 2;
+    std::size_t length = token & 15;
+    if (length == 15) {
+      get_length(in, end, length);
+    }
+    length += min_match;
+    if (offset == 0 || length > size - written ||
+        offset > written + dictionary.size()) {
+      corrupt();
+    }
+    if (offset <= written) {
+      // Byte by byte, as the match may overlap what it writes
+      auto from = out + written - offset;
+      for (std::size_t i = 0; i < length; ++i) {
+        out[written + i] = from[i];
+      }
+    } else {
+      auto from = dictionary.size() - (offset - written);
+      for (std::size_t i = 0; i < length; ++i) {
+        auto source = from + i;
+        out[written + i] = source < dictionary.size()
+                               ? dictionary[source]
+                               : out[source - dictionary.size()];
+      }
+    }
+    written += length;
+  }
+  if (written != size) {
+    corrupt();
+  }
+}
+
+/** Picks the segments of samples whose strings are shared by the most
+ * samples, greedily, as strings already picked no longer count */
+std::string train_segments(const std::vector<std::string_view>& samples,
+                           std::size_t capacity) {
+  struct count {
+    std::uint32_t samples = 0;
+    std::uint32_t last = 0; /** Sample last counted in, plus one */
+  };
+  std::unordered_map<std::uint64_t, count> counts;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    for (std::size_t j = 0; j + gram <= samples[i].size(); ++j) {
+      auto& entry = counts[read64(samples[i].data() + j)];
+      if (entry.last != i + 1) {
+        entry.last = static_cast<std::uint32_t>(i + 1);
+        ++entry.samples;
+      }
+    }
+  }
+  auto score = [&counts](std::string_view piece) {
+    std::uint64_t result = 0;
+    for (std::size_t j = 0; j + gram <= piece.size(); ++j) {
+      // Strings of a single sample are of no use to the others
+      auto found = counts.find(read64(piece.data() + j));
+      result += std::max<std::uint32_t>(found->second.samples, 1) - 1;
+    }
+    return result;
+  };
+  using candidate = std::pair<std::uint64_t, std::string_view>;
+  auto lower = [](const candidate& lhs, const candidate& rhs) {
+    return lhs.first < rhs.first;
+  };
+  std::priority_queue<candidate, std::vector<candidate>, decltype(lower)>
+      candidates(lower);
+  for (auto sample : samples) {
+    for (std::size_t j = 0; j + gram <= sample.size(); j += segment) {
+      auto piece = sample.substr(j, segment);
+      candidates.emplace(score(piece), piece);
+    }
+  }
+  std::vector<std::string_view> picked;
+  std::size_t size = 0;
+  while (!candidates.empty() && size < capacity) {
+    auto [previous, piece] = candidates.top();
+    candidates.pop();
+    auto current = score(piece);
+    if (current == 0) {
+      continue;
+    }
+    if (current < previous && !candidates.empty() &&
+        current < candidates.top().first) {
+      candidates.emplace(current, piece);
+      continue;
+    }
+    picked.push_back(piece);
+    size += piece.size();
+    for (std::size_t j = 0; j + gram <= piece.size(); ++j) {
+      counts.find(read64(piece.data() + j))->second.samples = 0;
+    }
+  }
+  // The best segments go last, nearest to the values, so that the most
+  // matches have the shortest offsets
+  std::string result;
+  for (auto it = picked.rbegin(); it != picked.rend(); ++it) {
+    result.append(*it);
+  }
+  if (result.size() > capacity) {
+    result.erase(0, result.size() - capacity);
+  }
+  return result;
+}
+
+}  // namespace
+
+/** A dictionary, prepared for compressing and decompressing with */
+class compressor::dictionary {
+ public:
+  dictionary(std::uint32_t id, std::string_view data, int level)
+      : id_(id), data_(data), table_(std::size_t{1} << dictionary_bits) {
+    // Matches only reach back over the last window bytes
+    auto begin = data_.size() > window ? data_.size() - window : 0;
+    for (auto i = begin; i + min_match <= data_.size(); ++i) {
+      table_[hash(read32(data_.data() + i), dictionary_bits)] =
+          static_cast<std::uint32_t>(i + 1);
+    }
+#ifdef DATASTORE_HAS_ZSTD
+    cdict_ = ZSTD_createCDict(data_.data(), data_.size(), level);
+    ddict_ = ZSTD_createDDict(data_.data(), data_.size());
+#else
+    static_cast<void>(level);
+#endif
+  }
+
+  ~dictionary() {
+#ifdef DATASTORE_HAS_ZSTD
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+#endif
+  }
+
+  dictionary(const dictionary&) = delete;
+  dictionary& operator=(const dictionary&) = delete;
+
+  [[nodiscard]] std::uint32_t id() const { return id_; }
+  [[nodiscard]] std::string_view data() const { return data_; }
+  [[nodiscard]] const std::vector<std::uint32_t>& table() const {
+    return table_;
+  }
+
+#ifdef DATASTORE_HAS_ZSTD
+  [[nodiscard]] const ZSTD_CDict* cdict() const { return cdict_; }
+  [[nodiscard]] const ZSTD_DDict* ddict() const { return ddict_; }
+#endif
+
+ private:
+  std::uint32_t id_;
+  std::string data_;
+  std::vector<std::uint32_t> table_;
+#ifdef DATASTORE_HAS_ZSTD
+  ZSTD_CDict* cdict_ = nullptr;
+  ZSTD_DDict* ddict_ = nullptr;
+#endif
+};
+
+bool available(compression algorithm) {
+  switch (algorithm) {
+    case compression::none:
+    case compression::lz:
+      return true;
+    case compression::zstd:
+#ifdef DATASTORE_HAS_ZSTD
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+std::string train_dictionary(const std::vector<std::string_view>& samples,
+                             std::size_t capacity, compression algorithm) {
+#ifdef DATASTORE_HAS_ZSTD
+  if (algorithm == compression::zstd) {
+    std::string buffer;
+    std::vector<std::size_t> sizes;
+    for (auto sample : samples) {
+      buffer.append(sample);
+      sizes.push_back(sample.size());
+    }
+    std::string result(capacity, '\0');
+    auto size = ZDICT_trainFromBuffer(result.data(), result.size(),
+                                      buffer.data(), sizes.data(),
+                                      static_cast<unsigned>(sizes.size()));
+    // Too few samples for zstd still make a dictionary of shared strings
+    if (!ZDICT_isError(size)) {
+      result.resize(size);
+      return result;
+    }
+  }
+#else
+  static_cast<void>(algorithm);
+#endif
+  return train_segments(samples, capacity);
+}
+
+compressor::compressor(compression algorithm, int level, std::size_t min_size)
+    : algorithm_(algorithm), level_(level), min_size_(min_size) {
+  if (!available(algorithm)) {
+    throw std::invalid_argument("compression algorithm is not available");
+  }
+}
+
+void compressor::add_dictionary(std::uint32_t id, std::string_view dictionary,
+                                bool current) {
+  if (id == 0 || dictionaries_.count(id) != 0) {
+    throw std::invalid_argument("dictionary ids must be unique and nonzero");
+  }
+  auto added =
+      std::make_shared<const compressor::dictionary>(id, dictionary, level_);
+  dictionaries_.emplace(id, added);
+  if (current) {
+    current_ = std::move(added);
+  }
+}
+
+std::uint32_t compressor::current_dictionary() const {
+  return current_ == nullptr ? 0 : current_->id();
+}
+
+std::string_view compressor::f(std::string_view value) const {
+  auto& buffer = local().compressed;
+  buffer.clear();
+  compress(value, buffer);
+  return buffer;
+}
+
+std::string_view compressor::g(std::string_view stored) const {
+  auto& buffer = local().decompressed;
+  decompress(stored, buffer);
+  return buffer;
+}
+
+void compressor::compress(std::string_view value, std::string& output) const {
+  auto start = output.size();
+  if (algorithm_ != compression::none && value.size() >= min_size_) {
+    output.push_back(static_cast<char>(algorithm_));
+    put_varint(output, current_dictionary());
+    put_varint(output, value.size());
+    if (algorithm_ == compression::lz) {
+      static const std::vector<std::uint32_t> none;
+      lz_compress(value, current_ ? current_->data() : std::string_view(),
+                  current_ ? current_->table() : none, local().table, output);
+    }
+#ifdef DATASTORE_HAS_ZSTD
+    if (algorithm_ == compression::zstd) {
+      auto header = output.size();
+      auto bound = ZSTD_compressBound(value.size());
+      output.resize(header + bound);
+      auto context = local().cctx.get();
+      auto size =
+          current_ != nullptr
+              ? ZSTD_compress_usingCDict(context, output.data() + header,
+                                         bound, value.data(), value.size(),
+                                         current_->cdict())
+              : ZSTD_compressCCtx(context, output.data() + header, bound,
+                                  value.data(), value.size(), level_);
+      if (ZSTD_isError(size)) {
+        throw std::runtime_error(ZSTD_getErrorName(size));
+      }
+      output.resize(header + size);
+    }
+#endif
+    if (output.size() - start < value.size() + 1) {
+      return;
+    }
+    output.resize(start);
+  }
+  output.push_back(static_cast<char>(compression::none));
+  output.append(value);
+}
+
+void compressor::decompress(std::string_view stored,
+                            std::string& output) const {
+  if (stored.empty()) {
+    corrupt();
+  }
+  auto algorithm = static_cast<compression>(stored.front());
+  if (algorithm == compression::none) {
+    output.assign(stored.substr(1));
+    return;
+  }
+  std::uint64_t id = 0;
+  std::uint64_t size = 0;
+  auto end = stored.data() + stored.size();
+  auto data = get_varint(stored.data() + 1, end, id);
+  data = data == nullptr ? nullptr : get_varint(data, end, size);
+  if (data == nullptr) {
+    corrupt();
+  }
+  auto payload = std::string_view(data, end - data);
+  const compressor::dictionary* dictionary = nullptr;
+  if (id != 0) {
+    auto found = dictionaries_.find(static_cast<std::uint32_t>(id));
+    if (found == dictionaries_.end()) {
+      throw std::runtime_error("value needs a missing dictionary");
+    }
+    dictionary = found->second.get();
+  }
+  if (algorithm == compression::lz) {
+    // A byte of input makes at most 255 bytes of output
+    if (size / 255 > payload.size()) {
+      corrupt();
+    }
+    lz_decompress(payload,
+                  dictionary ? dictionary->data() : std::string_view(),
+                  size, output);
+    return;
+  }
+#ifdef DATASTORE_HAS_ZSTD
+  if (algorithm == compression::zstd) {
+    output.resize(size);
+    auto context = local().dctx.get();
+    auto written =
+        dictionary != nullptr
+            ? ZSTD_decompress_usingDDict(context, output.data(), size,
+                                         payload.data(), payload.size(),
+                                         dictionary->ddict())
+            : ZSTD_decompressDCtx(context, output.data(), size,
+                                  payload.data(), payload.size());
+    if (ZSTD_isError(written) || written != size) {
+      corrupt();
+    }
+    return;
+  }
+#endif
+  throw std::runtime_error("value needs a missing compression algorithm");
+}
+
+}  // namespace datastore
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace datastore {
+
+/** Algorithms which compress values */
+enum class compression : std::uint8_t {
+  none = 0, /** Values are stored as they are */
+  lz = 1,   /** Built in LZ77 codec, favouring speed over ratio */
+  zstd = 2, /** Zstandard, if it was found when the library was configured */
+};
+
+/** Returns whether this build can compress with algorithm */
+bool available(compression algorithm);
+
+/** Trains a dictionary of up to capacity bytes on samples of values
+ *
+ * Samples should be representative of the values to compress and total many
+ * times the capacity. The dictionary holds the byte strings shared by the
+ * most samples, or is trained by zstd for zstd if there are enough samples.
+ */
+std::string train_dictionary(const std::vector<std::string_view>& samples,
+                             std::size_t capacity,
+                             compression algorithm = compression::lz);
+
+/** Compresses values, with one of several dictionaries
+ *
+ * Each compressed value is framed with its algorithm and the id of its
+ * dictionary, so that any compressor holding that dictionary decompresses
+ * it, whatever it compresses with itself. Values which would not shrink are
+ * stored as they are, behind a one byte header.
+ *
+ * f and g make a codec, as for bijective::function<std::string_view,
+ * std::string_view>. The views they return are of buffers of the calling
+ * thread, valid until its next call to the same function. A compressor may
+ * be used by several threads at once.
+ */
+class compressor {
+ public:
+  /** Creates a compressor without a dictionary
+   *
+   * Values shorter than min_size are not compressed. level is the zstd
+   * compression level, and is otherwise ignored. Throws
+   * std::invalid_argument if the algorithm is not available. */
+  explicit compressor(compression algorithm = compression::lz, int level = 3,
+                      std::size_t min_size = 32);
+
+  /** Adds a dictionary to decompress with, and to compress with if current
+   *
+   * Throws std::invalid_argument if id is zero, which stands for no
+   * dictionary, or if it was already added. */
+  void add_dictionary(std::uint32_t id, std::string_view dictionary,
+                      bool current = true);
+
+  /** Returns the id of the dictionary compressed with, zero for none */
+  [[nodiscard]] std::uint32_t current_dictionary() const;
+
+  /** Compresses a value into a buffer of the calling thread */
+  [[nodiscard]] std::string_view f(std::string_view value) const;
+
+  /** Decompresses a value into a buffer of the calling thread */
+  [[nodiscard]] std::string_view g(std::string_view stored) const;
+
+  /** Appends the compressed value to output */
+  void compress(std::string_view value, std::string& output) const;
+
+  /** Replaces output with the decompressed value
+   *
+   * Throws std::runtime_error if stored is corrupt, or needs an algorithm or
+   * dictionary this compressor does not have. */
+  void decompress(std::string_view stored, std::string& output) const;
+
+ private:
+  class dictionary;
+
+  compression algorithm_;
+  int level_;
+  std::size_t min_size_;
+  std::shared_ptr<const dictionary> current_;
+  std::map<std::uint32_t, std::shared_ptr<const dictionary>> dictionaries_;
+};
+
+}  // namespace datastore
@@ -0,0 +1,266 @@
+#include <datastore/client.h>
+#include <datastore/clients/detail/coding.h>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace datastore {
+
+namespace {
+
+using namespace clients::detail;
+
+/** Identifies the format, version 1 */
+constexpr char magic[] = {'d', 's', 'd', 'u', 'm', 'p', '\0', '\1'};
+
+/** Payload size after which a block is written */
+constexpr std::size_t block_size = 1 << 20;
+
+/** Payload size, element count and payload checksum, as fixed32 */
+constexpr std::size_t block_header = 12;
+
+/** Blocks parsed ahead of the writer */
+constexpr std::size_t pipeline_depth = 2;
+
+/** Writes all of data, or throws */
+using sink = std::function<void(std::string_view data)>;
+
+/** Reads up to size bytes, fewer only at the end of the input */
+using source = std::function<std::size_t(char* data, std::size_t size)>;
+
+sink stream_sink(std::ostream& os) {
+  return [&os](std::string_view data) {
+    if (!os.write(data.data(), data.size())) {
+      throw std::runtime_error("unable to write dump");
+    }
+  };
+}
+
+source stream_source(std::istream& is) {
+  return [&is](char* data, std::size_t size) {
+    is.read(data, size);
+    return static_cast<std::size_t>(is.gcount());
+  };
+}
+
+sink fd_sink(int fd) {
+  return [fd](std::string_view data) {
+    while (!data.empty()) {
+#ifdef _WIN32
+      auto written =
+          ::_write(fd, data.data(), static_cast<unsigned int>(data.size()));
+#else
+      auto written = ::write(fd, data.data(), data.size());
+#endif
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "dump");
+      }
+      data.remove_prefix(written);
+    }
+  };
+}
+
+source fd_source(int fd) {
+  return [fd](char* data, std::size_t size) {
+    auto result = std::size_t{0};
+    while (result < size) {
+#ifdef _WIN32
+      auto count = ::_read(fd, data + result,
+                           static_cast<unsigned int>(size - result));
+#else
+      auto count = ::read(fd, data + result, size - result);
+#endif
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "load");
+      }
+      if (count == 0) {
+        break;
+      }
+      result += count;
+    }
+    return result;
+  };
+}
+
+void write_block(const sink& write, std::string_view payload,
+                 std::uint32_t count) {
+  auto header = std::string();
+  put_fixed32(header, static_cast<std::uint32_t>(payload.size()));
+  put_fixed32(header, count);
+  put_fixed32(header, crc32(payload));
+  write(header);
+  if (!payload.empty()) {
+    write(payload);
+  }
+}
+
+void read_exactly(const source& read, char* data, std::size_t size) {
+  if (read(data, size) != size) {
+    throw std::runtime_error("truncated dump");
+  }
+}
+
+/** Reads the next block into operations, returning false after the last */
+bool read_block(const source& read, std::string& payload, batch& operations) {
+  char header[block_header];
+  read_exactly(read, header, sizeof(header));
+  auto size = get_fixed32(header);
+  auto count = get_fixed32(header + 4);
+  if (size == 0 && count == 0) {
+    return false;
+  }
+  payload.resize(size);
+  read_exactly(read, payload.data(), size);
+  if (crc32(payload) != get_fixed32(header + 8)) {
+    throw std::runtime_error("corrupt dump: checksum mismatch");
+  }
+  auto input = std::string_view(payload);
+  for (; count != 0; --count) {
+    std::string_view key, value;
+    if (!get_length_prefixed(input, key) ||
+        !get_length_prefixed(input, value)) {
+      throw std::runtime_error("corrupt dump: truncated element");
+    }
+    operations.put(key, value);
+  }
+  if (!input.empty()) {
+    throw std::runtime_error("corrupt dump: trailing data");
+  }
+  return true;
+}
+
+client::size_type dump(const client& datastore, const sink& write) {
+  write(std::string_view(magic, sizeof(magic)));
+  auto payload = std::string();
+  auto count = std::uint32_t{0};
+  auto result = client::size_type{0};
+  for (const auto& [key, value] : datastore) {
+    put_length_prefixed(payload, key);
+    put_length_prefixed(payload, value);
+    ++count;
+    ++result;
+    if (payload.size() >= block_size) {
+      write_block(write, payload, count);
+      payload.clear();
+      count = 0;
+    }
+  }
+  if (count != 0) {
+    write_block(write, payload, count);
+  }
+  // An empty block marks the end, so that truncation is detected
+  write_block(write, {}, 0);
+  return result;
+}
+
+client::size_type load(client& datastore, const source& read) {
+  char header[sizeof(magic)];
+  read_exactly(read, header, sizeof(header));
+  if (std::memcmp(header, magic, sizeof(magic)) != 0) {
+    throw std::runtime_error("not a datastore dump");
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<batch> ready;
+  auto done = false;
+  auto stop = false;
+  std::exception_ptr failure;
+  auto parser = std::thread([&] {
+    try {
+      auto payload = std::string();
+      for (;;) {
+        batch operations;
+        if (!read_block(read, payload, operations)) {
+          break;
+        }
+        std::unique_lock lock(mutex);
+        changed.wait(lock,
+                     [&] { return stop || ready.size() < pipeline_depth; });
+        if (stop) {
+          break;
+        }
+        ready.push_back(std::move(operations));
+        changed.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard lock(mutex);
+      failure = std::current_exception();
+    }
+    std::lock_guard lock(mutex);
+    done = true;
+    changed.notify_all();
+  });
+
+  auto result = client::size_type{0};
+  try {
+    for (;;) {
+      batch operations;
+      {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [&] { return done || !ready.empty(); });
+        if (ready.empty()) {
+          break;
+        }
+        operations = std::move(ready.front());
+        ready.pop_front();
+        changed.notify_all();
+      }
+      datastore.write(operations);
+      result += operations.size();
+    }
+  } catch (...) {
+    {
+      std::lock_guard lock(mutex);
+      stop = true;
+    }
+    changed.notify_all();
+    parser.join();
+    throw;
+  }
+  parser.join();
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+  return result;
+}
+
+}  // namespace
+
+client::size_type client::dump(std::ostream& os) const {
+  return datastore::dump(*this, stream_sink(os));
+}
+
+client::size_type client::dump(int fd) const {
+  return datastore::dump(*this, fd_sink(fd));
+}
+
+client::size_type client::load(std::istream& is) {
+  return datastore::load(*this, stream_source(is));
+}
+
+client::size_type client::load(int fd) {
+  return datastore::load(*this, fd_source(fd));
+}
+
+}  // namespace datastore
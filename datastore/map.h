@@ -8,22 +8,53 @@
 
 namespace datastore {
 
-/** map provides an std::map like interface atop a datastore */
-template <typename Key, typename T>
-class map : public datastore::bijective::map<Key, T, client> {
+/** map provides an std::map like interface atop a datastore
+ *
+ * @tparam KeyCodec codec between Key and the datastore key type
+ * @tparam MappedCodec codec between T and the datastore mapped type
+ *
+ * The codecs default to runtime bijective::function objects. Statically
+ * dispatched codecs, such as bijective::stream or bijective::binary, allow
+ * the codecs to be inlined.
+ */
+template <typename Key, typename T,
+          typename KeyCodec = bijective::function<Key, client::key_type>,
+          typename MappedCodec = bijective::function<T, client::mapped_type>>
+class map
+    : public datastore::bijective::map<Key, T, client, KeyCodec, MappedCodec> {
  public:
-  using base_type = bijective::map<Key, T, client>;
+  using base_type = bijective::map<Key, T, client, KeyCodec, MappedCodec>;
   using typename base_type::key_transform_type;
   using typename base_type::mapped_transform_type;
   explicit map(client& datastore,
-               key_transform_type key_transform = bijective::stream<Key>{},
-               mapped_transform_type mapped_transform = bijective::stream<T>{});
+               key_transform_type key_transform =
+                   default_transform<key_transform_type, Key>(),
+               mapped_transform_type mapped_transform =
+                   default_transform<mapped_transform_type, T>());
+
+ private:
+  /** Default constructs a codec, or uses a stream for runtime codecs */
+  template <typename Codec, typename U>
+  static Codec default_transform();
 };
 
-template <typename Key, typename T>
-map<Key, T>::map(client& datastore,
-                 typename map<Key, T>::key_transform_type key_transform,
-                 typename map<Key, T>::mapped_transform_type mapped_transform)
+template <typename Key, typename T, typename KeyCodec, typename MappedCodec>
+map<Key, T, KeyCodec, MappedCodec>::map(
+    client& datastore,
+    typename map<Key, T, KeyCodec, MappedCodec>::key_transform_type
+        key_transform,
+    typename map<Key, T, KeyCodec, MappedCodec>::mapped_transform_type
+        mapped_transform)
     : base_type(datastore, key_transform, mapped_transform) {}
 
+template <typename Key, typename T, typename KeyCodec, typename MappedCodec>
+template <typename Codec, typename U>
+Codec map<Key, T, KeyCodec, MappedCodec>::default_transform() {
+  if constexpr (std::is_default_constructible_v<Codec>) {
+    return Codec{};
+  } else {
+    return bijective::stream<U>{};
+  }
+}
+
 }  // namespace datastore
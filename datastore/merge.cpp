@@ -0,0 +1,51 @@
+#include "merge.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace datastore {
+
+namespace {
+
+std::uint64_t decode(std::string_view value) {
+  if (value.size() != sizeof(std::uint64_t)) {
+    throw std::invalid_argument("add_int64 requires 8 byte integers");
+  }
+  std::uint64_t result;
+  std::memcpy(&result, value.data(), sizeof(result));
+  return result;
+}
+
+class adder final : public merge_operator {
+ public:
+  std::string apply(std::optional<std::string_view> existing,
+                    std::string_view operand) const override {
+    // Unsigned arithmetic wraps without undefined behaviour
+    auto sum = (existing ? decode(*existing) : 0) + decode(operand);
+    return std::string(reinterpret_cast<const char*>(&sum), sizeof(sum));
+  }
+};
+
+class appender final : public merge_operator {
+ public:
+  std::string apply(std::optional<std::string_view> existing,
+                    std::string_view operand) const override {
+    auto result = std::string(existing.value_or(std::string_view()));
+    result.append(operand);
+    return result;
+  }
+};
+
+}  // namespace
+
+const merge_operator& add_int64() {
+  static const adder instance;
+  return instance;
+}
+
+const merge_operator& append() {
+  static const appender instance;
+  return instance;
+}
+
+}  // namespace datastore
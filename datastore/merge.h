@@ -0,0 +1,36 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace datastore {
+
+/** Combines the value stored at a key with an operand, within a write
+ *
+ * Merges are written with batch::merge. They are applied in the write
+ * transaction where the backend supports it, so that concurrent merges into
+ * one key are never lost, and the merges into one key within a batch read
+ * and write it only once. Operators must outlive the batches which refer to
+ * them. */
+class merge_operator {
+ public:
+  virtual ~merge_operator() = default;
+
+  /** Returns the value which replaces existing, which is nullopt if the key
+   * is absent */
+  [[nodiscard]] virtual std::string apply(
+      std::optional<std::string_view> existing,
+      std::string_view operand) const = 0;
+};
+
+/** Returns an operator adding 64 bit signed integers, encoded as with
+ * bijective::binary<std::int64_t>, wrapping on overflow
+ *
+ * Absent keys count as zero. Throws std::invalid_argument if a value or an
+ * operand is not 8 bytes long. */
+const merge_operator& add_int64();
+
+/** Returns an operator appending operands to the value */
+const merge_operator& append();
+
+}  // namespace datastore
@@ -0,0 +1,36 @@
+#pragma once
+#include <boost/iterator/iterator_adaptor.hpp>
+
+namespace datastore {
+
+/** Iterates backwards through a datastore
+ *
+ * Unlike std::reverse_iterator, which dereferences a decremented copy of the
+ * iterator after the element, this holds an iterator at the element itself.
+ * A copy per dereference would open a cursor and seek for some backends, and
+ * would leave the reference of a client::iterator dangling.
+ *
+ * Decrementing the first element of a datastore yields its end, which is
+ * therefore the reverse end.
+ *
+ * @tparam Iterator bidirectional iterator of a client or basic_client
+ */
+template <typename Iterator>
+class reverse_iterator
+    : public boost::iterator_adaptor<reverse_iterator<Iterator>, Iterator> {
+ public:
+  /** Create a sentinel iterator */
+  reverse_iterator() = default;
+
+  /** Construct from an iterator at the element, or at the end */
+  explicit reverse_iterator(Iterator position)
+      : reverse_iterator::iterator_adaptor_(std::move(position)) {}
+
+ private:
+  friend class boost::iterator_core_access;
+
+  void increment() { --this->base_reference(); }
+  void decrement() { ++this->base_reference(); }
+};
+
+}  // namespace datastore
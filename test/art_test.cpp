@@ -0,0 +1,140 @@
+#include <datastore/clients/map.h>
+#include <datastore/clients/radix_map.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+
+namespace test {
+
+namespace {
+
+/** Returns keys sharing prefixes of every length, including keys which are
+ * prefixes of others, with enough distinct bytes to fill large nodes */
+std::string random_key(std::mt19937& random) {
+  static const char* prefixes[] = {"", "t", "tenant/",
+                                   "tenant/entity/0123456789/"};
+  auto key = std::string(prefixes[random() % 4]);
+  auto length = random() % 4;
+  for (auto i = 0u; i < length; ++i) {
+    key += static_cast<char>(random() % 2 == 0 ? random() % 256
+                                               : 'a' + random() % 4);
+  }
+  return key;
+}
+
+}  // namespace
+
+TEST(art, map) {
+  auto random = std::mt19937(11);
+  auto expected = datastore::clients::map_client();
+  auto tree = datastore::clients::radix_map_client();
+  for (auto round = 0; round < 4; ++round) {
+    for (auto i = 0; i < 20000; ++i) {
+      auto key = random_key(random);
+      auto value = std::string(random() % 16, 'v');
+      // Erase more often in later rounds, so that nodes shrink again
+      if (static_cast<int>(random() % 4) < round) {
+        EXPECT_EQ(expected.erase(key), tree.erase(key)) << i;
+      } else {
+        expected.backend().insert_or_assign(
+            expected.backend().last(), std::pair(std::string_view(key),
+                                                 std::string_view(value)));
+        tree.backend().insert_or_assign(
+            tree.backend().last(),
+            std::pair(std::string_view(key), std::string_view(value)));
+      }
+    }
+    ASSERT_EQ(expected.size(), tree.size());
+    EXPECT_TRUE(
+        std::equal(expected.begin(), expected.end(), tree.begin(), tree.end()));
+    EXPECT_TRUE(std::equal(std::make_reverse_iterator(expected.end()),
+                           std::make_reverse_iterator(expected.begin()),
+                           std::make_reverse_iterator(tree.end()),
+                           std::make_reverse_iterator(tree.begin())));
+    for (auto i = 0; i < 1000; ++i) {
+      auto key = random_key(random);
+      auto lhs = expected.backend().lower_bound(key);
+      auto rhs = tree.backend().lower_bound(key);
+      ASSERT_EQ(lhs == expected.backend().last(), rhs == tree.backend().last());
+      if (lhs != expected.backend().last()) {
+        EXPECT_EQ(lhs.key(), rhs.key());
+      }
+      EXPECT_EQ(expected.find(key) == expected.end(),
+                tree.find(key) == tree.end());
+    }
+  }
+  tree.clear();
+  EXPECT_TRUE(tree.empty());
+}
+
+TEST(art, prefix) {
+  auto datastore = datastore::clients::radix_map_client();
+  for (auto key : {"tenant/a", "tenant/a/1", "tenant/a/2", "tenant/b",
+                   "tenant\xff", "tenant\xff\xff"}) {
+    datastore.insert(std::pair(std::string_view(key), std::string_view()));
+  }
+  auto [first, last] = datastore.prefix("tenant/a");
+  ASSERT_EQ(3, std::distance(first, last));
+  EXPECT_EQ("tenant/a", (*first).first);
+  EXPECT_EQ("tenant/b", (*last).first);
+
+  auto [high, end] = datastore.prefix("tenant\xff");
+  EXPECT_EQ(2, std::distance(high, end));
+  EXPECT_EQ(datastore.end(), end);
+
+  auto [none, none_end] = datastore.prefix("other");
+  EXPECT_EQ(none, none_end);
+}
+
+TEST(art, assign) {
+  auto datastore = datastore::clients::radix_map_client();
+  auto& tree = datastore.backend();
+  auto value = std::pair(std::string_view("key"), std::string_view("long"));
+  auto it = tree.insert_or_assign(tree.last(), value);
+  // A shorter value is written in place
+  tree.insert_or_assign(tree.last(), std::pair(value.first, "ab"));
+  EXPECT_EQ("ab", it.value());
+  tree.insert_or_assign(tree.last(), std::pair(value.first, "longer value"));
+  EXPECT_EQ("longer value", datastore.at("key").second);
+  EXPECT_EQ(1u, datastore.size());
+}
+
+TEST(art, cursor_path) {
+  auto datastore = datastore::clients::radix_map_client();
+  auto& tree = datastore.backend();
+  for (auto key : {"a", "b", "ba", "c"}) {
+    datastore.insert(std::pair(std::string_view(key), std::string_view()));
+  }
+  auto it = tree.lookup("b");
+  it.increment();
+  EXPECT_EQ("ba", it.key());
+  // Growing and shrinking nodes makes the cursor find its path again
+  for (auto i = 0; i < 256; ++i) {
+    datastore.insert(
+        std::pair(std::string("b") + static_cast<char>(i), std::string()));
+  }
+  datastore.erase("c");
+  it.increment();
+  EXPECT_EQ(std::string("bb"), it.key());
+  it.decrement();
+  it.decrement();
+  EXPECT_EQ(std::string("b\x60"), it.key());
+}
+
+TEST(art, client) {
+  auto datastore = datastore::clients::make_radix_map();
+  datastore->insert({"b", "2"});
+  datastore->insert({"a", "1"});
+  datastore->insert({"", "0"});
+  EXPECT_EQ(3u, datastore->size());
+  auto it = datastore->begin();
+  EXPECT_EQ("", it->first);
+  EXPECT_EQ("a", (++it)->first);
+  it = datastore->erase(it);
+  EXPECT_EQ("b", it->first);
+  EXPECT_EQ(datastore->end(), datastore->find("a"));
+  EXPECT_EQ("0", datastore->at("").second);
+}
+
+}  // namespace test
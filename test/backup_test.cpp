@@ -0,0 +1,98 @@
+#include <datastore/clients/lmdb.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace test {
+
+namespace {
+
+std::unique_ptr<datastore::client> open(const std::filesystem::path& path) {
+  return datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(path));
+}
+
+void fill(datastore::client& datastore, int count) {
+  for (auto i = 0; i < count; ++i) {
+    auto key = std::to_string(i);
+    datastore.insert(std::pair(std::string_view(key), std::string(100, 'v')));
+  }
+}
+
+}  // namespace
+
+TEST(backup, directory) {
+  auto path = scratch_directory("datastore_backup");
+  auto copy = std::filesystem::temp_directory_path() / "datastore_backup_copy";
+  std::filesystem::remove_all(copy);
+  auto lmdb = open(path);
+  fill(*lmdb, 1000);
+  auto reports = 0;
+  auto last = datastore::clients::backup_progress();
+  auto configuration = datastore::clients::backup_configuration();
+  configuration.set_progress([&](const auto& progress) {
+    EXPECT_LT(last.bytes, progress.bytes);
+    last = progress;
+    ++reports;
+  });
+  auto progress = datastore::clients::backup(*lmdb, copy, configuration);
+  EXPECT_LT(0, reports);
+  EXPECT_EQ(last.bytes, progress.bytes);
+  EXPECT_EQ(std::filesystem::file_size(copy / "data.mdb"), progress.bytes);
+  EXPECT_LT(0u, progress.estimate);
+  EXPECT_LE(0, progress.throughput());
+
+  // Writes after the backup are not in the copy
+  lmdb->erase("0");
+  auto restored = open(copy);
+  EXPECT_EQ(1000u, restored->size());
+  EXPECT_TRUE(std::equal(std::next(restored->begin()), restored->end(),
+                         lmdb->begin(), lmdb->end()));
+}
+
+TEST(backup, fd) {
+  auto path = scratch_directory("datastore_backup");
+  auto lmdb = open(path);
+  fill(*lmdb, 10);
+  auto file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  auto progress = datastore::clients::backup(*lmdb, fileno(file));
+  std::fseek(file, 0, SEEK_END);
+  EXPECT_EQ(static_cast<long>(progress.bytes), std::ftell(file));
+  std::fclose(file);
+
+  // Failures of the progress callback are reported once the copy ends
+  EXPECT_THROW(datastore::clients::backup(
+                   *lmdb, scratch_directory("datastore_backup_copy"),
+                   datastore::clients::backup_configuration().set_progress(
+                       [](const auto&) { throw std::runtime_error("stop"); })),
+               std::runtime_error);
+  EXPECT_FALSE(std::filesystem::exists(
+      std::filesystem::temp_directory_path() / "datastore_backup_copy" /
+      "data.mdb"));
+}
+
+TEST(backup, compact) {
+  auto path = scratch_directory("datastore_backup");
+  auto staging = scratch_directory("datastore_backup_compact");
+  {
+    auto lmdb = open(path);
+    fill(*lmdb, 1000);
+    for (auto i = 0; i < 900; ++i) {
+      lmdb->erase(std::to_string(i));
+    }
+    datastore::clients::backup(
+        *lmdb, staging,
+        datastore::clients::backup_configuration().set_compact(true));
+  }
+  datastore::clients::restore(staging, path);
+  EXPECT_FALSE(std::filesystem::exists(staging / "data.mdb"));
+  auto lmdb = open(path);
+  EXPECT_EQ(100u, lmdb->size());
+  EXPECT_EQ(std::string(100, 'v'), lmdb->at("999").second);
+}
+
+}  // namespace test
@@ -0,0 +1,82 @@
+#include <datastore/clients/detail/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+
+namespace test {
+
+namespace {
+
+template <typename Client>
+std::unique_ptr<Client> make();
+
+template <>
+std::unique_ptr<datastore::clients::map_client> make() {
+  return std::make_unique<datastore::clients::map_client>();
+}
+
+template <>
+std::unique_ptr<datastore::clients::lmdb_client> make() {
+  return std::make_unique<datastore::clients::lmdb_client>(
+      datastore::clients::lmdb_configuration(
+          scratch_directory("datastore_basic_client")));
+}
+
+}  // namespace
+
+template <typename Client>
+class basic_client : public testing::Test {
+ protected:
+  std::unique_ptr<Client> client_ = make<Client>();
+};
+
+using clients = testing::Types<datastore::clients::map_client,
+                               datastore::clients::lmdb_client>;
+TYPED_TEST_SUITE(basic_client, clients);
+
+TYPED_TEST(basic_client, insert) {
+  auto& client = *this->client_;
+  EXPECT_TRUE(client.empty());
+  auto [it, inserted] = client.insert(std::pair("a", "1"));
+  EXPECT_TRUE(inserted);
+  ASSERT_NE(client.end(), it);
+  EXPECT_EQ("1", it->second);
+  EXPECT_FALSE(client.insert(std::pair("a", "2")).second);
+  EXPECT_EQ("1", client.at("a").second);
+}
+
+TYPED_TEST(basic_client, iterate) {
+  auto& client = *this->client_;
+  for (auto key : {"c", "a", "b"}) {
+    client.insert(std::pair(key, key));
+  }
+  auto keys = std::string{};
+  for (auto [key, value] : client) {
+    keys += key;
+  }
+  EXPECT_EQ("abc", keys);
+  EXPECT_EQ(3u, client.size());
+  auto it = client.find("b");
+  auto copy = it;
+  EXPECT_EQ(it, copy);
+  ++copy;
+  EXPECT_EQ("c", copy->first);
+  EXPECT_NE(it, copy);
+  ++copy;
+  EXPECT_EQ(client.end(), copy);
+}
+
+TYPED_TEST(basic_client, erase) {
+  auto& client = *this->client_;
+  client.insert(std::pair("a", "1"));
+  client.insert(std::pair("b", "2"));
+  EXPECT_EQ(1u, client.erase("a"));
+  EXPECT_EQ(0u, client.erase("a"));
+  EXPECT_EQ(client.end(), client.find("a"));
+  EXPECT_THROW(client.at("a"), std::out_of_range);
+  client.clear();
+  EXPECT_TRUE(client.empty());
+}
+
+}  // namespace test
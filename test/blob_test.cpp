@@ -0,0 +1,167 @@
+#include <datastore/clients/concurrent_map.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace test {
+
+namespace {
+
+constexpr auto chunk_size = 1000;
+
+std::unique_ptr<datastore::client> make_lmdb() {
+  auto path = scratch_directory("datastore_blob");
+  return datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(path));
+}
+
+/** Returns size bytes which differ with their offset */
+std::string pattern(std::size_t size, char seed = 'a') {
+  auto result = std::string(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    result[i] = static_cast<char>(seed + i % 23);
+  }
+  return result;
+}
+
+/** Writes data in pieces which straddle chunks */
+void write(datastore::blob_writer& writer, std::string_view data) {
+  for (std::size_t piece = 1; !data.empty(); piece = piece * 3 + 1) {
+    auto count = std::min(piece, data.size());
+    writer.write(data.substr(0, count));
+    data.remove_prefix(count);
+  }
+}
+
+std::string read(const datastore::client& datastore, std::string_view key,
+                 std::uint64_t offset = 0, std::size_t size = 1 << 20) {
+  return datastore.open_blob_reader(key, offset)->read(size);
+}
+
+/** Checks blobs on any datastore */
+void check(datastore::client& datastore) {
+  datastore.insert({"plain", "value"});
+  auto data = pattern(4321);
+  auto writer = datastore.open_blob_writer("blob", false, chunk_size);
+  write(*writer, data);
+  EXPECT_EQ(data.size(), writer->size());
+  writer->commit();
+  EXPECT_THROW(writer->write("x"), std::logic_error);
+  writer.reset();
+  // The chunks are elements too: a manifest and five chunks
+  EXPECT_EQ(7u, datastore.size());
+  EXPECT_EQ(data, read(datastore, "blob"));
+  EXPECT_EQ(data.substr(999, 1002), read(datastore, "blob", 999, 1002));
+  EXPECT_EQ(data.substr(4000), read(datastore, "blob", 4000));
+
+  auto reader = datastore.open_blob_reader("blob", 10);
+  EXPECT_EQ(data.size(), reader->size());
+  char buffer[5];
+  EXPECT_EQ(5u, reader->read(buffer, sizeof(buffer)));
+  EXPECT_EQ(data.substr(10, 5), std::string(buffer, 5));
+  EXPECT_EQ(15u, reader->tell());
+  reader->seek(4320);
+  EXPECT_EQ(1u, reader->read(buffer, sizeof(buffer)));
+  EXPECT_EQ(0u, reader->read(buffer, sizeof(buffer)));
+  EXPECT_THROW(reader->seek(4322), std::out_of_range);
+  reader.reset();
+
+  writer = datastore.open_blob_writer("blob", true);
+  auto more = pattern(1500, 'A');
+  write(*writer, more);
+  writer->commit();
+  writer.reset();
+  EXPECT_EQ(data + more, read(datastore, "blob"));
+  EXPECT_EQ(8u, datastore.size());
+
+  // Abandoned writers leave the blob as it was
+  writer = datastore.open_blob_writer("blob", false, chunk_size);
+  write(*writer, pattern(3000, 'x'));
+  writer.reset();
+  writer = datastore.open_blob_writer("blob", true);
+  write(*writer, pattern(3000, 'x'));
+  writer.reset();
+  EXPECT_EQ(data + more, read(datastore, "blob"));
+  EXPECT_EQ(8u, datastore.size());
+
+  // Replacing erases the chunks replaced
+  writer = datastore.open_blob_writer("blob", false, 100);
+  write(*writer, "short");
+  writer->commit();
+  writer.reset();
+  EXPECT_EQ("short", read(datastore, "blob"));
+  EXPECT_EQ(3u, datastore.size());
+
+  EXPECT_THROW(datastore.open_blob_writer("absent", true),
+               std::out_of_range);
+  EXPECT_THROW(datastore.open_blob_writer("plain", true),
+               std::invalid_argument);
+  EXPECT_THROW(datastore.open_blob_writer("blob", false, 0),
+               std::invalid_argument);
+  EXPECT_THROW(read(datastore, "absent"), std::out_of_range);
+  EXPECT_THROW(read(datastore, "plain"), std::invalid_argument);
+
+  EXPECT_EQ(0u, datastore.erase_blob("plain"));
+  EXPECT_EQ(1u, datastore.erase_blob("blob"));
+  EXPECT_EQ(1u, datastore.size());
+
+  // erase leaves the chunks of a blob behind
+  writer = datastore.open_blob_writer("blob", false, chunk_size);
+  writer->write(pattern(1500));
+  writer->commit();
+  writer.reset();
+  EXPECT_EQ(1u, datastore.erase("blob"));
+  EXPECT_EQ(3u, datastore.size());
+}
+
+}  // namespace
+
+TEST(blob, map) { check(*datastore::clients::make_map()); }
+
+TEST(blob, concurrent_map) {
+  check(*datastore::clients::make_concurrent_map());
+}
+
+TEST(blob, lmdb) { check(*make_lmdb()); }
+
+TEST(blob, replaced) {
+  auto map = datastore::clients::make_map();
+  auto writer = map->open_blob_writer("blob", false, chunk_size);
+  write(*writer, pattern(2500));
+  writer->commit();
+  auto reader = map->open_blob_reader("blob");
+  writer = map->open_blob_writer("blob", false, chunk_size);
+  write(*writer, pattern(2500, 'A'));
+  // Readers of the old blob carry on until the new one is committed
+  EXPECT_EQ(pattern(2500).substr(0, 2000), reader->read(2000));
+  writer->commit();
+  EXPECT_THROW(reader->read(1), std::runtime_error);
+}
+
+TEST(blob, transaction) {
+  auto lmdb = make_lmdb();
+  auto writer = lmdb->open_blob_writer("blob", false, chunk_size);
+  write(*writer, pattern(2500));
+  writer->commit();
+  auto reader = lmdb->open_blob_reader("blob");
+  writer = lmdb->open_blob_writer("blob", false, chunk_size);
+  write(*writer, pattern(2500, 'A'));
+  // Nothing is visible before the commit
+  EXPECT_EQ(4u, lmdb->size());
+  // The writer holds the write transaction, which this thread would wait for
+  EXPECT_THROW(lmdb->insert({"other", "1"}), std::logic_error);
+  writer->commit();
+  EXPECT_TRUE(lmdb->insert({"other", "1"}).second);
+  EXPECT_EQ(5u, lmdb->size());
+  writer.reset();
+  // Readers keep their snapshot
+  EXPECT_EQ(pattern(2500), reader->read(2500));
+  EXPECT_EQ(pattern(2500, 'A'), read(*lmdb, "blob"));
+}
+
+}  // namespace test
@@ -0,0 +1,82 @@
+#include <datastore/clients/detail/bloom.h>
+#include <datastore/clients/lmdb.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+
+namespace test {
+
+TEST(bloom, membership) {
+  auto filter = datastore::clients::detail::bloom(10000, 10);
+  for (auto i = 0; i < 10000; ++i) {
+    filter.insert(std::to_string(i));
+  }
+  auto false_positives = 0;
+  for (auto i = 0; i < 10000; ++i) {
+    EXPECT_TRUE(filter.may_contain(std::to_string(i)));
+    false_positives += filter.may_contain("x" + std::to_string(i));
+  }
+  EXPECT_LT(false_positives, 300);
+}
+
+TEST(bloom, persistence) {
+  auto path = scratch_directory("datastore_bloom") / "filter";
+  auto filter = datastore::clients::detail::bloom(100, 10);
+  filter.insert("a");
+  filter.save(path, 7);
+  EXPECT_EQ(nullptr, datastore::clients::detail::bloom::load(path, 8, 10));
+  EXPECT_EQ(nullptr, datastore::clients::detail::bloom::load(path, 7, 12));
+  auto loaded = datastore::clients::detail::bloom::load(path, 7, 10);
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_TRUE(loaded->may_contain("a"));
+  EXPECT_EQ(100u, loaded->capacity());
+}
+
+TEST(bloom, lmdb) {
+  auto path = scratch_directory("datastore_bloom");
+  auto configuration = datastore::clients::lmdb_configuration(path);
+  configuration.set_filter_bits_per_key(10);
+  {
+    auto datastore = datastore::clients::make_lmdb(configuration);
+    datastore->insert(std::pair("a", "1"));
+    datastore->insert(std::pair("b", "2"));
+    datastore->erase("b");
+    EXPECT_NE(datastore->end(), datastore->find("a"));
+    EXPECT_EQ(datastore->end(), datastore->find("b"));
+    EXPECT_EQ(datastore->end(), datastore->find("c"));
+  }
+  EXPECT_TRUE(std::filesystem::exists(path / "datastore.filter"));
+  {
+    // Writes without the filter leave the persisted filter stale
+    auto datastore = datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path));
+    datastore->insert(std::pair("c", "3"));
+  }
+  {
+    auto datastore = datastore::clients::make_lmdb(configuration);
+    EXPECT_NE(datastore->end(), datastore->find("a"));
+    EXPECT_NE(datastore->end(), datastore->find("c"));
+    datastore->clear();
+    EXPECT_EQ(datastore->end(), datastore->find("a"));
+    datastore->insert(std::pair("d", "4"));
+    EXPECT_NE(datastore->end(), datastore->find("d"));
+  }
+  std::filesystem::remove_all(path);
+}
+
+TEST(bloom, rebuild) {
+  auto path = scratch_directory("datastore_bloom");
+  auto configuration = datastore::clients::lmdb_configuration(path);
+  configuration.set_filter_bits_per_key(10);
+  auto datastore = datastore::clients::make_lmdb(configuration);
+  // Outgrowing the filter rebuilds it in the background, while writes go on
+  for (auto i = 0; i < 5000; ++i) {
+    datastore->insert(std::pair(std::to_string(i), "v"));
+  }
+  for (auto i = 0; i < 5000; ++i) {
+    EXPECT_NE(datastore->end(), datastore->find(std::to_string(i))) << i;
+  }
+  EXPECT_EQ(datastore->end(), datastore->find("x"));
+}
+
+}  // namespace test
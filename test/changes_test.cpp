@@ -0,0 +1,162 @@
+#include <datastore/changes.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace test {
+
+namespace {
+
+std::unique_ptr<datastore::client> leader(const std::filesystem::path& path) {
+  return datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(path).set_change_log(true));
+}
+
+}  // namespace
+
+TEST(changes, read) {
+  auto path = scratch_directory("datastore_changes");
+  auto lmdb = leader(path);
+  lmdb->insert({"a", "1"});
+  lmdb->insert({"b", "2"});
+  lmdb->erase("a");
+  lmdb->write(datastore::batch().put("c", "3").erase("b"));
+  lmdb->clear();
+
+  auto changes = datastore::clients::read_changes(*lmdb, 1);
+  ASSERT_EQ(5u, changes.size());
+  for (auto i = 0u; i < changes.size(); ++i) {
+    EXPECT_EQ(i + 1, changes[i].sequence);
+  }
+  ASSERT_EQ(1u, changes[0].writes.size());
+  EXPECT_EQ(datastore::batch::kind::put, changes[0].writes.begin()->type);
+  EXPECT_EQ("a", changes[0].writes.begin()->key);
+  EXPECT_EQ("1", changes[0].writes.begin()->value);
+  EXPECT_EQ(datastore::batch::kind::erase, changes[2].writes.begin()->type);
+  EXPECT_EQ(2u, changes[3].writes.size());
+  EXPECT_FALSE(changes[3].cleared);
+  EXPECT_TRUE(changes[4].cleared);
+  EXPECT_TRUE(changes[4].writes.empty());
+
+  changes = datastore::clients::read_changes(*lmdb, 3, 2);
+  ASSERT_EQ(2u, changes.size());
+  EXPECT_EQ(3u, changes.front().sequence);
+  EXPECT_TRUE(datastore::clients::read_changes(*lmdb, 6).empty());
+}
+
+TEST(changes, separate) {
+  auto path = scratch_directory("datastore_changes");
+  auto lmdb = leader(path);
+  lmdb->insert({"a", "1"});
+  lmdb->insert({"datastore.changes", "2"});
+  // The log is kept apart from the elements, and survives clearing them
+  EXPECT_EQ(2u, lmdb->size());
+  EXPECT_EQ(2, std::distance(lmdb->begin(), lmdb->end()));
+  EXPECT_EQ("a", (*lmdb->begin()).first);
+  lmdb->clear();
+  EXPECT_EQ(0u, lmdb->size());
+  EXPECT_EQ(lmdb->begin(), lmdb->end());
+  EXPECT_EQ(3u, datastore::clients::read_changes(*lmdb, 1).size());
+}
+
+TEST(changes, follow) {
+  auto path = scratch_directory("datastore_changes");
+  auto lmdb = leader(path);
+  auto replica = datastore::clients::make_map();
+  auto follower = datastore::follower(*replica);
+  for (auto round = 0; round < 3; ++round) {
+    for (auto i = 0; i < 10; ++i) {
+      auto key = std::to_string(round * 10 + i);
+      lmdb->insert(std::pair(std::string_view(key), "value"));
+    }
+    lmdb->erase(std::to_string(round * 10));
+    follower.apply(datastore::clients::read_changes(
+        *lmdb, follower.sequence() + 1, 4));
+    follower.apply(
+        datastore::clients::read_changes(*lmdb, follower.sequence() + 1));
+  }
+  EXPECT_EQ(33u, follower.sequence());
+  EXPECT_TRUE(std::equal(lmdb->begin(), lmdb->end(), replica->begin(),
+                         replica->end()));
+
+  // Changes already applied are skipped
+  follower.apply(datastore::clients::read_changes(*lmdb, 1));
+  EXPECT_EQ(27u, replica->size());
+}
+
+TEST(changes, truncate) {
+  auto path = scratch_directory("datastore_changes");
+  auto lmdb = leader(path);
+  for (auto i = 0; i < 10; ++i) {
+    lmdb->insert(std::pair(std::string_view(std::to_string(i)), "value"));
+  }
+  datastore::clients::truncate_changes(*lmdb, 8);
+  auto changes = datastore::clients::read_changes(*lmdb, 1);
+  ASSERT_EQ(3u, changes.size());
+  EXPECT_EQ(8u, changes.front().sequence);
+
+  // A follower which is too far behind must start over
+  auto replica = datastore::clients::make_map();
+  auto follower = datastore::follower(*replica, 5);
+  EXPECT_THROW(follower.apply(changes), std::out_of_range);
+
+  // The newest change is kept, so that sequences keep increasing
+  datastore::clients::truncate_changes(*lmdb, 100);
+  lmdb->erase("0");
+  changes = datastore::clients::read_changes(*lmdb, 1);
+  ASSERT_EQ(2u, changes.size());
+  EXPECT_EQ(11u, changes.back().sequence);
+}
+
+TEST(changes, reopen) {
+  auto path = scratch_directory("datastore_changes");
+  leader(path)->insert({"a", "1"});
+  auto lmdb = leader(path);
+  lmdb->insert({"b", "2"});
+  EXPECT_EQ(2u, datastore::clients::read_changes(*lmdb, 1).size());
+  EXPECT_THROW(datastore::clients::read_changes(
+                   *datastore::clients::make_map(), 1),
+               std::invalid_argument);
+}
+
+TEST(changes, blob) {
+  auto path = scratch_directory("datastore_changes");
+  auto lmdb = leader(path);
+  lmdb->insert({"a", "1"});
+  auto data = std::string(3500, 'x');
+  auto writer = lmdb->open_blob_writer("blob", false, 1000);
+  for (auto i = 0; i < 7; ++i) {
+    writer->write(std::string_view(data).substr(i * 500, 500));
+  }
+  writer->commit();
+  writer.reset();
+  lmdb->insert({"b", "2"});
+
+  // The blob is one transaction, recorded in several changes
+  auto changes = datastore::clients::read_changes(*lmdb, 1);
+  ASSERT_LT(3u, changes.size());
+  EXPECT_FALSE(changes.front().continued);
+  EXPECT_FALSE(changes[changes.size() - 2].continued);
+  EXPECT_FALSE(changes.back().continued);
+  for (std::size_t i = 1; i + 2 < changes.size(); ++i) {
+    EXPECT_TRUE(changes[i].continued);
+  }
+
+  // A follower writes none of it until its last change
+  auto replica = datastore::clients::make_map();
+  auto follower = datastore::follower(*replica);
+  follower.apply(datastore::clients::read_changes(*lmdb, 1, 2));
+  EXPECT_EQ(1u, follower.sequence());
+  EXPECT_EQ(1u, replica->size());
+  follower.apply(datastore::clients::read_changes(*lmdb, 3));
+  EXPECT_EQ(changes.back().sequence, follower.sequence());
+  EXPECT_TRUE(std::equal(lmdb->begin(), lmdb->end(), replica->begin(),
+                         replica->end()));
+  EXPECT_EQ(data, replica->open_blob_reader("blob")->read(data.size()));
+}
+
+}  // namespace test
@@ -0,0 +1,128 @@
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <datastore/compare.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+int sign(int x) { return (x > 0) - (x < 0); }
+
+std::string encode(std::uint64_t tenant, std::uint64_t timestamp) {
+  std::string result(2 * sizeof(std::uint64_t), '\0');
+  std::memcpy(result.data(), &tenant, sizeof(tenant));
+  std::memcpy(result.data() + sizeof(tenant), &timestamp, sizeof(timestamp));
+  return result;
+}
+
+std::vector<std::string> tuple_keys() {
+  return {encode(1, 300), encode(2, 1), encode(1, 2), encode(256, 0),
+          encode(1, 256)};
+}
+
+void expect_tuple_order(const ::datastore::client& datastore) {
+  using fields = std::pair<std::uint64_t, std::uint64_t>;
+  auto expected = std::vector<fields>{{1, 2}, {1, 256}, {1, 300}, {2, 1},
+                                       {256, 0}};
+  auto actual = std::vector<fields>{};
+  for (auto& [key, value] : datastore) {
+    fields c;
+    std::memcpy(&c.first, key.data(), sizeof(c.first));
+    std::memcpy(&c.second, key.data() + sizeof(c.first), sizeof(c.second));
+    actual.push_back(c);
+  }
+  EXPECT_EQ(expected, actual);
+}
+
+}  // namespace
+
+TEST(compare, lexicographic) {
+  using datastore::compare::lexicographic;
+  EXPECT_EQ(0, lexicographic("abc", "abc"));
+  EXPECT_GT(0, lexicographic("ab", "abc"));
+  EXPECT_LT(0, lexicographic("b", "abc"));
+  EXPECT_GT(0, lexicographic("a", "\xff"));
+}
+
+TEST(compare, fixed) {
+  auto engine = std::mt19937{42};
+  auto byte = std::uniform_int_distribution<int>{0, 255};
+  for (auto i = 0; i < 1000; ++i) {
+    auto lhs = std::string(32, '\0');
+    for (auto& c : lhs) c = static_cast<char>(byte(engine));
+    auto rhs = lhs;
+    if (i % 10 != 0) {
+      rhs[static_cast<std::size_t>(byte(engine)) % rhs.size()] =
+          static_cast<char>(byte(engine));
+    }
+    EXPECT_EQ(sign(std::memcmp(lhs.data(), rhs.data(), lhs.size())),
+              sign(datastore::compare::fixed<32>(lhs, rhs)));
+  }
+  EXPECT_GT(0, datastore::compare::fixed<32>("a", "b"));
+}
+
+TEST(compare, tuple) {
+  auto compare = datastore::compare::tuple<std::uint64_t, std::uint64_t>;
+  EXPECT_GT(0, compare(encode(1, 256), encode(2, 1)));
+  EXPECT_GT(0, compare(encode(1, 2), encode(1, 256)));
+  EXPECT_EQ(0, compare(encode(3, 4), encode(3, 4)));
+  EXPECT_LT(0, compare(encode(3, 4) + "a", encode(3, 4)));
+}
+
+TEST(compare, tuple_short_keys) {
+  auto compare = datastore::compare::tuple<std::uint64_t>;
+  auto field = [](std::uint64_t value) {
+    auto result = std::string(sizeof(value), '\0');
+    std::memcpy(result.data(), &value, sizeof(value));
+    return result;
+  };
+  auto keys = std::vector<std::string>{
+      field(256), field(1), std::string("\x00\x02", 2), "meta", "",
+      field(1) + "a", std::string(7, '\xff'), field(0)};
+  // Keys too short for the field come first, and the order is transitive
+  EXPECT_GT(0, compare(std::string("\x00\x02", 2), field(1)));
+  EXPECT_GT(0, compare(std::string(7, '\xff'), field(0)));
+  for (const auto& a : keys) {
+    EXPECT_EQ(0, compare(a, a));
+    for (const auto& b : keys) {
+      EXPECT_EQ(sign(compare(a, b)), -sign(compare(b, a)));
+      for (const auto& c : keys) {
+        if (compare(a, b) < 0 && compare(b, c) < 0) {
+          EXPECT_GT(0, compare(a, c));
+        }
+      }
+    }
+  }
+}
+
+TEST(compare, map) {
+  auto datastore = datastore::clients::make_map(
+      datastore::compare::tuple<std::uint64_t, std::uint64_t>);
+  for (auto& key : tuple_keys()) {
+    datastore->insert(std::pair(key, "value"));
+  }
+  expect_tuple_order(*datastore);
+}
+
+TEST(compare, lmdb) {
+  auto path = scratch_directory("datastore_compare");
+  auto datastore = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(
+          path, 0, 0644,
+          datastore::compare::tuple<std::uint64_t, std::uint64_t>));
+  for (auto& key : tuple_keys()) {
+    datastore->insert(std::pair(key, "value"));
+  }
+  expect_tuple_order(*datastore);
+  datastore.reset();
+  std::filesystem::remove_all(path);
+}
+
+}  // namespace test
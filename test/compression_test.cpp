@@ -0,0 +1,203 @@
+#include <datastore/bijective/function.h>
+#include <datastore/clients/compressed.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <datastore/compression.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+/** Returns a JSON-like record, much like its neighbours */
+std::string record(int i) {
+  return R"({"id":)" + std::to_string(i) +
+         R"(,"name":"user)" + std::to_string(i * 7919 % 1000) +
+         R"(","email":"user)" + std::to_string(i) +
+         R"(@example.com","roles":["reader","writer"],"active":true,)"
+         R"("created":"2020-01-)" + std::to_string(10 + i % 20) +
+         R"(T12:00:00Z","preferences":{"theme":"dark","language":"en"}})";
+}
+
+std::string random_bytes(std::size_t size) {
+  std::mt19937 generator(42);
+  std::string result(size, '\0');
+  for (auto& byte : result) {
+    byte = static_cast<char>(generator());
+  }
+  return result;
+}
+
+std::vector<std::string> inputs() {
+  return {"",
+          "a",
+          "abcd",
+          std::string(1000, 'x'),
+          std::string(100000, 'y'),
+          random_bytes(5000),
+          record(1),
+          record(2) + record(3) + record(2)};
+}
+
+}  // namespace
+
+TEST(compression, round_trip) {
+  for (auto algorithm : {datastore::compression::none,
+                         datastore::compression::lz}) {
+    auto compressor = datastore::compressor(algorithm, 3, 0);
+    for (const auto& input : inputs()) {
+      auto stored = std::string();
+      compressor.compress(input, stored);
+      EXPECT_LE(stored.size(), input.size() + 1);
+      auto output = std::string();
+      compressor.decompress(stored, output);
+      EXPECT_EQ(input, output);
+    }
+  }
+}
+
+TEST(compression, dictionary) {
+  auto samples = std::vector<std::string>();
+  for (auto i = 0; i < 1000; ++i) {
+    samples.push_back(record(i));
+  }
+  auto dictionary = datastore::train_dictionary(
+      std::vector<std::string_view>(samples.begin(), samples.end()), 4096);
+  EXPECT_FALSE(dictionary.empty());
+  EXPECT_LE(dictionary.size(), 4096u);
+
+  auto plain = datastore::compressor();
+  auto trained = datastore::compressor();
+  trained.add_dictionary(1, dictionary);
+  EXPECT_EQ(1u, trained.current_dictionary());
+  auto value = record(5000);
+  auto without = std::string(plain.f(value));
+  auto with = std::string(trained.f(value));
+  EXPECT_LT(with.size(), without.size());
+  EXPECT_EQ(value, trained.g(with));
+  EXPECT_EQ(value, trained.g(without));
+  EXPECT_THROW(static_cast<void>(plain.g(with)), std::runtime_error);
+  EXPECT_THROW(trained.add_dictionary(1, dictionary), std::invalid_argument);
+}
+
+TEST(compression, corrupt) {
+  auto compressor = datastore::compressor();
+  auto stored = std::string(compressor.f(std::string(1000, 'x')));
+  auto output = std::string();
+  EXPECT_THROW(compressor.decompress("", output), std::runtime_error);
+  EXPECT_THROW(compressor.decompress(stored.substr(0, stored.size() - 1),
+                                     output),
+               std::runtime_error);
+  stored.back() ^= 0x40;
+  EXPECT_THROW(compressor.decompress(stored, output), std::runtime_error);
+}
+
+TEST(compression, codec) {
+  auto codec = datastore::bijective::function<std::string_view,
+                                              std::string_view>(
+      datastore::compressor());
+  auto value = record(1) + record(1);
+  EXPECT_EQ(value, codec.g(std::string(codec.f(value))));
+}
+
+TEST(compressed, client) {
+  auto compressed =
+      datastore::clients::make_compressed(datastore::clients::make_map());
+  for (auto i = 0; i < 100; ++i) {
+    auto key = std::to_string(1000 + i);
+    compressed->insert(std::pair(std::string_view(key), record(i)));
+  }
+  EXPECT_EQ(100u, compressed->size());
+  EXPECT_EQ(record(7), compressed->find("1007")->second);
+  // The value is decompressed into a cursor which at does not return
+  auto element = compressed->at("1007");
+  EXPECT_EQ(record(7), element.second);
+  auto stats = datastore::clients::statistics(*compressed);
+  EXPECT_EQ(100u, stats.values);
+  EXPECT_LE(stats.stored_bytes, stats.raw_bytes + 100);
+
+  // Records only share strings with each other, so need a dictionary
+  EXPECT_NE(0u, datastore::clients::train_dictionary(*compressed));
+  EXPECT_EQ(100u, compressed->size());
+  auto writes = datastore::batch();
+  for (auto i = 100; i < 200; ++i) {
+    writes.put(std::to_string(1000 + i), record(i));
+  }
+  compressed->write(writes);
+  EXPECT_GT(datastore::clients::statistics(*compressed).ratio(), 1.0);
+
+  auto count = 0;
+  for (auto it = compressed->begin(); it != compressed->end(); ++it) {
+    EXPECT_EQ(record(std::stoi(std::string(it->first)) - 1000), it->second);
+    ++count;
+  }
+  EXPECT_EQ(200, count);
+  count = 0;
+  for (auto it = compressed->rbegin(); it != compressed->rend(); ++it) {
+    ++count;
+  }
+  EXPECT_EQ(200, count);
+  compressed->for_each_chunk(
+      [](const datastore::client::chunk& chunk) {
+        for (const auto& [key, value] : chunk) {
+          EXPECT_EQ(record(std::stoi(std::string(key)) - 1000), value);
+        }
+      },
+      7);
+}
+
+TEST(compressed, reserved) {
+  auto compressed =
+      datastore::clients::make_compressed(datastore::clients::make_map());
+  compressed->insert({"a", record(1)});
+  datastore::clients::train_dictionary(*compressed);
+  auto key = std::string("\xff" "datastore.dict");
+  EXPECT_TRUE(compressed->find(key) == compressed->end());
+  EXPECT_THROW(compressed->insert({key, "x"}), std::invalid_argument);
+  compressed->clear();
+  EXPECT_EQ(0u, compressed->size());
+  EXPECT_TRUE(compressed->begin() == compressed->end());
+}
+
+TEST(compressed, reopen) {
+  auto path = scratch_directory("datastore_compressed");
+  auto open = [&path] {
+    return datastore::clients::make_compressed(datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path)));
+  };
+  {
+    auto compressed = open();
+    for (auto i = 0; i < 200; ++i) {
+      auto key = std::to_string(1000 + i);
+      compressed->insert(std::pair(std::string_view(key), record(i)));
+    }
+    EXPECT_EQ(1u, datastore::clients::train_dictionary(*compressed));
+    compressed->insert({"1200", record(200)});
+  }
+  auto compressed = open();
+  EXPECT_EQ(201u, compressed->size());
+  EXPECT_EQ(record(3), compressed->find("1003")->second);
+  EXPECT_EQ(record(200), compressed->find("1200")->second);
+  EXPECT_EQ(2u, datastore::clients::train_dictionary(*compressed));
+}
+
+TEST(compressed, invalid) {
+  auto map = datastore::clients::make_map();
+  EXPECT_THROW(datastore::clients::train_dictionary(*map),
+               std::invalid_argument);
+  if (!datastore::available(datastore::compression::zstd)) {
+    EXPECT_THROW(datastore::clients::make_compressed(
+                     datastore::clients::make_map(),
+                     datastore::clients::compressed_configuration()
+                         .set_algorithm(datastore::compression::zstd)),
+                 std::invalid_argument);
+  }
+}
+
+}  // namespace test
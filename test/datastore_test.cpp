@@ -1,5 +1,7 @@
+#include <datastore/clients/expiring.h>
 #include <datastore/clients/lmdb.h>
 #include <datastore/clients/map.h>
+#include <datastore/clients/tiered.h>
 #include <gtest/gtest.h>
 #include <sstream>
 
@@ -66,6 +68,117 @@ TEST_P(datastore, copy) {
                          datastore->end()));
 }
 
+TEST_P(datastore, write) {
+  auto datastore = GetParam();
+  datastore->clear();
+  datastore->insert(std::pair("a", "1"));
+  datastore->write(::datastore::batch().put("a", "2").put("b", "3").erase("c"));
+  EXPECT_EQ("2", datastore->at("a").second);
+  datastore->write(::datastore::batch().erase("a"));
+  EXPECT_EQ(datastore->end(), datastore->find("a"));
+  EXPECT_EQ(1u, datastore->size());
+}
+
+TEST_P(datastore, lower_bound) {
+  auto datastore = GetParam();
+  datastore->clear();
+  datastore->insert(std::pair("a", "1"));
+  datastore->insert(std::pair("c", "3"));
+  EXPECT_EQ("c", datastore->lower_bound("b")->first);
+  EXPECT_EQ("a", datastore->lower_bound("a")->first);
+  EXPECT_EQ(datastore->end(), datastore->lower_bound("d"));
+}
+
+TEST_P(datastore, reverse) {
+  auto datastore = GetParam();
+  datastore->clear();
+  EXPECT_EQ(datastore->rend(), datastore->rbegin());
+  datastore->write(
+      ::datastore::batch().put("a", "1").put("b", "2").put("c", "3"));
+  auto expected = std::vector<std::pair<std::string, std::string>>{
+      {"c", "3"}, {"b", "2"}, {"a", "1"}};
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), datastore->rbegin(),
+                         datastore->rend()));
+  auto it = datastore->end();
+  EXPECT_EQ("c", (--it)->first);
+  it = datastore->begin();
+  EXPECT_EQ(datastore->end(), --it);
+}
+
+TEST_P(datastore, reverse_prefix) {
+  auto datastore = GetParam();
+  datastore->clear();
+  datastore->write(::datastore::batch()
+                       .put("a", "")
+                       .put("b/1", "")
+                       .put("b/2", "")
+                       .put("b/3", "")
+                       .put("c", ""));
+  auto [first, last] = datastore->reverse_prefix("b/");
+  auto keys = std::vector<std::string>();
+  for (; first != last; ++first) {
+    keys.emplace_back(first->first);
+  }
+  EXPECT_EQ((std::vector<std::string>{"b/3", "b/2", "b/1"}), keys);
+  auto [begin, end] = datastore->reverse_prefix("c");
+  ASSERT_NE(end, begin);
+  EXPECT_EQ("c", begin->first);
+  EXPECT_EQ(end, ++begin);
+  auto empty = datastore->reverse_prefix("d");
+  EXPECT_EQ(empty.first, empty.second);
+  auto forward = datastore->prefix("b/");
+  EXPECT_EQ(3, std::distance(forward.first, forward.second));
+}
+
+TEST_P(datastore, next_batch) {
+  auto datastore = GetParam();
+  datastore->clear();
+  auto operations = ::datastore::batch();
+  for (auto i = 0; i < 25; ++i) {
+    operations.put(std::to_string(100 + i), std::to_string(i));
+  }
+  datastore->write(operations);
+  auto position = datastore->begin();
+  ::datastore::client::chunk chunk;
+  EXPECT_EQ(10u, datastore->next_batch(position, chunk, 10));
+  EXPECT_EQ("100", chunk[0].first);
+  EXPECT_EQ("9", chunk[9].second);
+  EXPECT_EQ("110", position->first);
+  auto sizes = std::vector<std::size_t>();
+  auto expected = datastore->begin();
+  datastore->for_each_chunk(
+      [&](const auto& chunk) {
+        sizes.push_back(chunk.size());
+        EXPECT_TRUE(std::equal(chunk.begin(), chunk.end(), expected,
+                               std::next(expected, chunk.size())));
+        std::advance(expected, chunk.size());
+      },
+      10);
+  EXPECT_EQ((std::vector<std::size_t>{10, 10, 5}), sizes);
+  position = datastore->end();
+  EXPECT_EQ(0u, datastore->next_batch(position, chunk, 10));
+  EXPECT_TRUE(chunk.empty());
+}
+
+TEST_P(datastore, estimate) {
+  auto datastore = GetParam();
+  datastore->clear();
+  auto operations = ::datastore::batch();
+  for (auto i = 0; i < 25; ++i) {
+    operations.put(std::to_string(100 + i), std::string(i, 'v'));
+  }
+  datastore->write(operations);
+  // Small ranges are exact everywhere
+  auto range = datastore->estimate("105", "115");
+  EXPECT_EQ(10u, range.count);
+  EXPECT_EQ(10u * 3 + 95, range.bytes);
+  EXPECT_EQ(0u, range.error);
+  EXPECT_EQ(25u, datastore->estimate("").count);
+  EXPECT_EQ(5u, datastore->estimate("120").count);
+  EXPECT_EQ(0u, datastore->estimate("2").count);
+  EXPECT_EQ(0u, datastore->estimate("110", "110").count);
+}
+
 TEST_P(datastore, at) {
   auto datastore = GetParam();
   EXPECT_THROW(datastore->at("non-existent key"), std::out_of_range);
@@ -77,6 +190,12 @@ INSTANTIATE_TEST_SUITE_P(
         ::datastore::clients::make_map().release(),
         ::datastore::clients::make_lmdb(
             lmdb_configuration(std::filesystem::temp_directory_path()))
+            .release(),
+        ::datastore::clients::make_tiered(
+            ::datastore::clients::make_map(),
+            ::datastore::clients::tiered_configuration(1 << 20))
+            .release(),
+        ::datastore::clients::make_expiring(::datastore::clients::make_map())
             .release()));
 
 }  // namespace test
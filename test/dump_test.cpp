@@ -0,0 +1,92 @@
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace test {
+
+namespace {
+
+/** Fills datastore with enough data for several blocks */
+void fill(datastore::client& datastore) {
+  auto operations = datastore::batch();
+  for (auto i = 0; i < 3000; ++i) {
+    operations.put(std::to_string(i), std::string(1000, 'a' + i % 26));
+  }
+  datastore.write(operations);
+}
+
+}  // namespace
+
+TEST(dump, round_trip) {
+  auto map = datastore::clients::make_map();
+  fill(*map);
+  std::stringstream stream;
+  EXPECT_EQ(3000u, map->dump(stream));
+
+  auto lmdb = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(
+          scratch_directory("datastore_dump")));
+  lmdb->insert({"1000", "overwritten"});
+  lmdb->insert({"extra", "kept"});
+  EXPECT_EQ(3000u, lmdb->load(stream));
+  EXPECT_EQ(3001u, lmdb->size());
+  EXPECT_EQ(std::string(1000, 'a' + 1000 % 26), lmdb->at("1000").second);
+  lmdb->erase("extra");
+  EXPECT_TRUE(
+      std::equal(map->begin(), map->end(), lmdb->begin(), lmdb->end()));
+
+  // Into an empty environment, every block is appended
+  auto copy = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(
+          scratch_directory("datastore_dump_copy")));
+  stream = std::stringstream();
+  lmdb->dump(stream);
+  EXPECT_EQ(3000u, copy->load(stream));
+  EXPECT_TRUE(
+      std::equal(copy->begin(), copy->end(), lmdb->begin(), lmdb->end()));
+}
+
+TEST(dump, fd) {
+  auto map = datastore::clients::make_map();
+  fill(*map);
+  auto file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  EXPECT_EQ(3000u, map->dump(fileno(file)));
+  std::rewind(file);
+  auto copy = datastore::clients::make_map();
+  EXPECT_EQ(3000u, copy->load(fileno(file)));
+  std::fclose(file);
+  EXPECT_TRUE(
+      std::equal(map->begin(), map->end(), copy->begin(), copy->end()));
+}
+
+TEST(dump, corrupt) {
+  auto map = datastore::clients::make_map();
+  fill(*map);
+  std::stringstream stream;
+  map->dump(stream);
+  auto dump = stream.str();
+
+  auto truncated = std::stringstream(dump.substr(0, dump.size() - 1));
+  EXPECT_THROW(datastore::clients::make_map()->load(truncated),
+               std::runtime_error);
+
+  // Blocks before the damage are loaded
+  dump[dump.size() - 100] ^= 1;
+  auto damaged = std::stringstream(dump);
+  auto copy = datastore::clients::make_map();
+  EXPECT_THROW(copy->load(damaged), std::runtime_error);
+  EXPECT_LT(0u, copy->size());
+  EXPECT_GT(3000u, copy->size());
+
+  auto empty = std::stringstream("not a dump");
+  EXPECT_THROW(copy->load(empty), std::runtime_error);
+}
+
+}  // namespace test
@@ -0,0 +1,103 @@
+#include <datastore/clients/concurrent_map.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace test {
+
+namespace {
+
+constexpr auto elements = 100000;
+
+/** Keys of 8 digits, with values of 10 to 19 bytes */
+std::string key(int i) {
+  char result[9];
+  std::snprintf(result, sizeof(result), "%08d", i);
+  return result;
+}
+
+void fill(datastore::client& datastore) {
+  auto writes = datastore::batch();
+  for (auto i = 0; i < elements; ++i) {
+    writes.put(key(i), std::string(10 + i % 10, 'v'));
+  }
+  datastore.write(writes);
+}
+
+/** Checks an estimate of the elements in [from, to) against the truth */
+void check(const datastore::client& datastore, int from, int to,
+           double tolerance) {
+  auto actual = static_cast<std::size_t>(to - from);
+  auto range = datastore.estimate(key(from), to == elements ? "" : key(to));
+  auto difference =
+      range.count > actual ? range.count - actual : actual - range.count;
+  EXPECT_LE(difference, range.error) << from << " to " << to;
+  EXPECT_LE(range.error, tolerance * elements) << from << " to " << to;
+  EXPECT_NEAR(range.bytes, actual * 22.5, tolerance * elements * 23 + 23);
+}
+
+}  // namespace
+
+TEST(estimate, map) {
+  auto map = datastore::clients::make_map();
+  fill(*map);
+  for (auto [from, to] : {std::pair(0, elements), std::pair(123, 45678),
+                          std::pair(99990, elements)}) {
+    auto range = map->estimate(key(from), to == elements ? "" : key(to));
+    EXPECT_EQ(static_cast<std::size_t>(to - from), range.count);
+    EXPECT_EQ(0u, range.error);
+  }
+  EXPECT_EQ(elements * 8u + elements / 10 * 145u, map->estimate("").bytes);
+}
+
+TEST(estimate, concurrent_map) {
+  auto map = datastore::clients::make_concurrent_map();
+  fill(*map);
+  check(*map, 0, elements, 0.15);
+  check(*map, 123, 45678, 0.15);
+  check(*map, 50000, 50100, 0.01);
+  EXPECT_EQ(10u, map->estimate(key(500), key(510)).count);
+}
+
+TEST(estimate, lmdb) {
+  auto path = scratch_directory("datastore_estimate");
+  auto lmdb = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(path));
+  fill(*lmdb);
+  // Gaps of about 100 elements between the keys of 1024 seeks are shared out
+  // by the key space between, bounded by the elements of those gaps in the
+  // range or else of those outside it
+  check(*lmdb, 0, elements, 0.01);
+  check(*lmdb, 150, 45678, 0.5);
+  check(*lmdb, 50000, 50100, 0.01);
+  EXPECT_NEAR(45528.0, lmdb->estimate(key(150), key(45678)).count, 4000);
+  EXPECT_EQ(10u, lmdb->estimate(key(3), key(13)).count);
+  EXPECT_EQ(elements, static_cast<int>(lmdb->estimate("").count));
+
+  // Writes since the sample widen the bound, until it is taken again
+  for (auto i = 0; i < 100; ++i) {
+    lmdb->erase(key(i));
+  }
+  auto range = lmdb->estimate(key(0), key(1000));
+  EXPECT_LE(range.count, 900u + range.error);
+  EXPECT_GE(range.count + range.error, 900u);
+  EXPECT_GE(range.error, 100u);
+  lmdb->clear();
+  EXPECT_EQ(0u, lmdb->estimate("").count);
+
+  // Seeks split smaller tables into gaps which are counted
+  auto writes = datastore::batch();
+  for (auto i = 0; i < 5000; ++i) {
+    writes.put(key(i), "v");
+  }
+  lmdb->write(writes);
+  range = lmdb->estimate(key(100), key(4000));
+  EXPECT_EQ(3900u, range.count);
+  EXPECT_EQ(0u, range.error);
+}
+
+}  // namespace test
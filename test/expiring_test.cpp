@@ -0,0 +1,136 @@
+#include <datastore/clients/compressed.h>
+#include <datastore/clients/detail/expiring.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace test {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+/** Configures a time to live of ttl against a clock read from now, swept
+ * only on request */
+datastore::clients::expiring_configuration configuration(
+    std::chrono::milliseconds ttl,
+    const std::chrono::system_clock::time_point& now) {
+  auto result = datastore::clients::expiring_configuration();
+  result.set_default_ttl(ttl).set_interval(1h).set_clock(
+      [&now] { return now; });
+  return result;
+}
+
+}  // namespace
+
+TEST(expiring, lookup) {
+  auto now = std::chrono::system_clock::time_point(1h);
+  auto expiring = datastore::clients::make_expiring(
+      datastore::clients::make_map(), configuration(10ms, now));
+  expiring->insert({"a", "1"});
+  expiring->insert({"b", "2"});
+  expiring->insert({"c", "3"});
+  datastore::clients::expire(*expiring, "b", 0ms);
+  datastore::clients::expire(*expiring, "c", 20ms);
+  EXPECT_EQ("1", expiring->at("a").second);
+
+  now += 10ms;
+  EXPECT_EQ(expiring->end(), expiring->find("a"));
+  EXPECT_EQ("2", expiring->at("b").second);
+  EXPECT_EQ(2, std::distance(expiring->begin(), expiring->end()));
+  EXPECT_EQ("b", (*expiring->begin()).first);
+  EXPECT_EQ("b", (*expiring->lower_bound("a")).first);
+  EXPECT_THROW(datastore::clients::expire(*expiring, "a", 10ms),
+               std::out_of_range);
+
+  // Expired elements are counted until swept
+  EXPECT_EQ(3u, expiring->size());
+  EXPECT_TRUE(expiring->insert({"a", "4"}).second);
+  EXPECT_EQ("4", expiring->at("a").second);
+}
+
+TEST(expiring, chunks) {
+  auto now = std::chrono::system_clock::time_point(1h);
+  // Values are decompressed into a buffer of the store's cursor
+  auto expiring = datastore::clients::make_expiring(
+      datastore::clients::make_compressed(datastore::clients::make_map()),
+      configuration(10ms, now));
+  for (auto i = 0; i < 100; ++i) {
+    auto key = std::to_string(i);
+    expiring->insert(std::pair(std::string_view(key), "value" + key));
+  }
+  auto count = 0;
+  expiring->for_each_chunk(
+      [&count](const auto& chunk) {
+        for (const auto& value : chunk) {
+          EXPECT_EQ("value" + std::string(value.first), value.second);
+          ++count;
+        }
+      },
+      10);
+  EXPECT_EQ(100, count);
+}
+
+TEST(expiring, sweep) {
+  auto now = std::chrono::system_clock::time_point(1h);
+  auto store = datastore::clients::make_map();
+  auto& stored = *store;
+  auto settings = configuration(10ms, now);
+  settings.set_batch_size(3);
+  auto expiring =
+      datastore::clients::expiring_client(std::move(store), settings);
+  for (auto i = 0; i < 10; ++i) {
+    auto key = std::to_string(i);
+    expiring.insert(std::pair(std::string_view(key), "value"));
+  }
+  expiring.write(datastore::batch().put("0", "permanent").erase("1"));
+  expiring.backend().expire("0", 0ms);
+  expiring.backend().expire("2", 0ms);
+  EXPECT_EQ(0u, expiring.backend().sweep());
+
+  now += 10ms;
+  EXPECT_EQ(7u, expiring.backend().sweep());
+  EXPECT_EQ(2u, stored.size());
+  EXPECT_EQ(0u, expiring.backend().sweep());
+}
+
+TEST(expiring, reopen) {
+  auto path = scratch_directory("datastore_expiring");
+  auto now = std::chrono::system_clock::time_point(1h);
+  {
+    auto expiring = datastore::clients::make_expiring(
+        datastore::clients::make_lmdb(
+            datastore::clients::lmdb_configuration(path)),
+        configuration(10ms, now));
+    expiring->insert({"a", "1"});
+  }
+  now += 10ms;
+  auto expiring = datastore::clients::expiring_client(
+      datastore::clients::make_lmdb(
+          datastore::clients::lmdb_configuration(path)),
+      configuration(10ms, now));
+  EXPECT_EQ(1u, expiring.backend().sweep());
+  EXPECT_EQ(0u, expiring.size());
+}
+
+TEST(expiring, background) {
+  auto store = datastore::clients::make_map();
+  auto& stored = *store;
+  auto settings = datastore::clients::expiring_configuration();
+  settings.set_default_ttl(1ms).set_interval(10ms).set_batch_size(8);
+  auto expiring = datastore::clients::make_expiring(std::move(store), settings);
+  for (auto i = 0; i < 50; ++i) {
+    auto key = std::to_string(i);
+    expiring->insert(std::pair(std::string_view(key), "value"));
+  }
+  for (auto i = 0; i < 500 && !stored.empty(); ++i) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(stored.empty());
+}
+
+}  // namespace test
@@ -0,0 +1,194 @@
+#include <datastore/bijective/stream.h>
+#include <datastore/clients/indexed.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <datastore/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+using entries = std::vector<std::pair<std::string, std::string>>;
+
+/** Indexes values of the form name|email by email */
+std::optional<std::string> email(std::string_view, std::string_view value) {
+  auto separator = value.find('|');
+  if (separator == std::string_view::npos) {
+    return std::nullopt;
+  }
+  return std::string(value.substr(separator + 1));
+}
+
+entries scan(const datastore::client& datastore, std::string_view from = {},
+             std::string_view to = {}, bool join = false) {
+  auto result = entries();
+  auto collect = [&result](const datastore::client::chunk& chunk) {
+    EXPECT_LE(chunk.size(), 2u);
+    for (const auto& [first, second] : chunk) {
+      result.emplace_back(first, second);
+    }
+  };
+  if (join) {
+    datastore::clients::join_index(datastore, "email", from, to, collect, 2);
+  } else {
+    datastore::clients::scan_index(datastore, "email", from, to, collect, 2);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(indexed, write) {
+  auto indexed =
+      datastore::clients::make_indexed(datastore::clients::make_map());
+  datastore::clients::add_index(*indexed, "email", email);
+  indexed->insert({"1", "ann|ann@b.org"});
+  indexed->insert({"2", "bob|bob@a.org"});
+  indexed->insert({"3", "cat"});
+  indexed->insert({"4", "dan|ann@b.org"});
+  EXPECT_EQ(4u, indexed->size());
+  EXPECT_EQ((entries{
+                {"ann@b.org", "1"}, {"ann@b.org", "4"}, {"bob@a.org", "2"}}),
+            scan(*indexed));
+
+  indexed->write(datastore::batch()
+                     .put("2", "bob|bob@c.org")
+                     .erase("4")
+                     .put("5", "eve|eve@d.org")
+                     .put("5", "eve|eve@e.org"));
+  EXPECT_EQ((entries{
+                {"ann@b.org", "1"}, {"bob@c.org", "2"}, {"eve@e.org", "5"}}),
+            scan(*indexed));
+  EXPECT_EQ((entries{{"2", "bob|bob@c.org"}, {"5", "eve|eve@e.org"}}),
+            scan(*indexed, "b", "f", true));
+  EXPECT_EQ((entries{{"bob@c.org", "2"}}), scan(*indexed, "b", "bob@d"));
+
+  indexed->erase("1");
+  EXPECT_EQ(3u, indexed->size());
+  EXPECT_EQ((entries{{"bob@c.org", "2"}, {"eve@e.org", "5"}}), scan(*indexed));
+}
+
+TEST(indexed, hidden) {
+  auto indexed =
+      datastore::clients::make_indexed(datastore::clients::make_map());
+  indexed->insert({"a", "ann|ann@b.org"});
+  indexed->insert({"\xfe", "zed|zed@b.org"});
+  datastore::clients::add_index(*indexed, "email", email);
+  auto keys = std::vector<std::string>();
+  for (const auto& [key, value] : *indexed) {
+    keys.emplace_back(key);
+  }
+  EXPECT_EQ((std::vector<std::string>{"a", "\xfe"}), keys);
+  keys.clear();
+  for (auto it = indexed->rbegin(); it != indexed->rend(); ++it) {
+    keys.emplace_back(it->first);
+  }
+  EXPECT_EQ((std::vector<std::string>{"\xfe", "a"}), keys);
+  EXPECT_THROW(indexed->insert({"\xff" "datastore.index", "x"}),
+               std::invalid_argument);
+  EXPECT_THROW(datastore::clients::add_index(*indexed, "email", email),
+               std::invalid_argument);
+
+  indexed->clear();
+  EXPECT_EQ(0u, indexed->size());
+  EXPECT_TRUE(indexed->begin() == indexed->end());
+  indexed->insert({"b", "bob|bob@a.org"});
+  EXPECT_EQ((entries{{"bob@a.org", "b"}}), scan(*indexed));
+}
+
+TEST(indexed, escaped) {
+  auto indexed =
+      datastore::clients::make_indexed(datastore::clients::make_map());
+  datastore::clients::add_index(*indexed, "email", email);
+  indexed->insert({"1", std::string("a|x\0y", 5)});
+  indexed->insert({"2", "b|x"});
+  indexed->insert({"3", "c|xa"});
+  EXPECT_EQ((entries{{"x", "2"}, {std::string("x\0y", 3), "1"}, {"xa", "3"}}),
+            scan(*indexed));
+}
+
+TEST(indexed, map) {
+  auto indexed =
+      datastore::clients::make_indexed(datastore::clients::make_map());
+  auto squares = datastore::map<std::string, int>(*indexed);
+  for (auto i = 0; i < 10; ++i) {
+    squares.insert({std::to_string(i), i * i});
+  }
+  datastore::clients::add_index(
+      *indexed, "last_digit",
+      datastore::clients::make_extractor(
+          datastore::bijective::stream<int>(),
+          datastore::bijective::stream<int>(),
+          [](int square) { return square % 10; }));
+  auto keys = std::vector<std::string>();
+  datastore::clients::scan_index(
+      *indexed, "last_digit", "6", "7",
+      [&keys](const datastore::client::chunk& chunk) {
+        for (const auto& [digit, key] : chunk) {
+          keys.emplace_back(key);
+        }
+      });
+  EXPECT_EQ((std::vector<std::string>{"4", "6"}), keys);
+}
+
+TEST(indexed, reopen) {
+  auto path = scratch_directory("datastore_indexed");
+  auto open = [&path] {
+    return datastore::clients::make_indexed(datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path)));
+  };
+  {
+    auto indexed = open();
+    for (auto i = 0; i < 3000; ++i) {
+      indexed->insert(std::pair(std::to_string(i),
+                                "u|" + std::to_string(i % 7) + "@x.org"));
+    }
+    datastore::clients::add_index(*indexed, "email", email);
+  }
+  auto indexed = open();
+  EXPECT_EQ(3000u, indexed->size());
+  auto unused = [](std::string_view, std::string_view)
+      -> std::optional<std::string> {
+    throw std::logic_error("built indexes are not rebuilt");
+  };
+  datastore::clients::add_index(*indexed, "email", unused);
+  auto count = std::size_t{0};
+  datastore::clients::scan_index(
+      *indexed, "email", "3@", "4@",
+      [&count](const datastore::client::chunk& chunk) {
+        count += chunk.size();
+      });
+  EXPECT_EQ(429u, count);
+
+  indexed.reset();
+  indexed = open();
+  datastore::clients::add_index(*indexed, "email", email, true);
+  EXPECT_EQ(3000u, indexed->size());
+  EXPECT_EQ(3000u, scan(*indexed).size());
+
+  // A write before the index is added makes adding it build it again
+  indexed.reset();
+  indexed = open();
+  indexed->insert({"new", "n|new@x.org"});
+  EXPECT_EQ(3001u, indexed->size());
+  datastore::clients::add_index(*indexed, "email", email);
+  EXPECT_EQ(3001u, indexed->size());
+  EXPECT_EQ((entries{{"new@x.org", "new"}}),
+            scan(*indexed, "new@", "new@y"));
+}
+
+TEST(indexed, invalid) {
+  auto map = datastore::clients::make_map();
+  EXPECT_THROW(datastore::clients::add_index(*map, "email", email),
+               std::invalid_argument);
+  EXPECT_THROW(scan(*map), std::invalid_argument);
+}
+
+}  // namespace test
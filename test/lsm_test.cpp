@@ -0,0 +1,172 @@
+#include <datastore/clients/detail/lsm.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace test {
+
+namespace {
+
+datastore::clients::lsm_configuration configuration() {
+  auto result = datastore::clients::lsm_configuration(
+      scratch_directory("datastore_lsm"));
+  result.set_memtable_size(4096).set_compaction_trigger(3);
+  return result;
+}
+
+/** Applies the same random writes to both datastores */
+template <typename Client>
+void write(Client& lsm, datastore::clients::map_client& expected, int count,
+           std::mt19937& random) {
+  for (auto i = 0; i < count; ++i) {
+    auto key = std::to_string(random() % 500);
+    auto value = std::to_string(i);
+    lsm.erase(key);
+    expected.erase(key);
+    if (random() % 4 != 0) {
+      lsm.insert(std::pair(std::string_view(key), std::string_view(value)));
+      expected.insert(
+          std::pair(std::string_view(key), std::string_view(value)));
+    }
+  }
+}
+
+template <typename Client>
+void expect_equal(const datastore::clients::map_client& expected,
+                  const Client& actual) {
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), actual.begin(),
+                         actual.end()));
+  EXPECT_TRUE(std::equal(std::make_reverse_iterator(expected.end()),
+                         std::make_reverse_iterator(expected.begin()),
+                         std::make_reverse_iterator(actual.end()),
+                         std::make_reverse_iterator(actual.begin())));
+  EXPECT_EQ(expected.size(), actual.size());
+  // Chunks outlive the cursor positions their keys were decoded at
+  auto it = expected.begin();
+  actual.for_each_chunk(
+      [&](const auto& chunk) {
+        for (const auto& value : chunk) {
+          ASSERT_NE(expected.end(), it);
+          EXPECT_EQ(*it++, value);
+        }
+      },
+      100);
+  EXPECT_EQ(expected.end(), it);
+}
+
+}  // namespace
+
+TEST(lsm, merge) {
+  auto random = std::mt19937(42);
+  auto expected = datastore::clients::map_client();
+  auto settings = configuration();
+  {
+    auto lsm = datastore::clients::lsm_client(settings);
+    write(lsm, expected, 5000, random);
+    expect_equal(expected, lsm);
+    lsm.backend().flush();
+    EXPECT_LT(lsm.backend().runs(), 3u);
+    expect_equal(expected, lsm);
+    write(lsm, expected, 100, random);
+  }
+  // Reopening recovers the runs and replays the log
+  auto lsm = datastore::clients::lsm_client(settings);
+  expect_equal(expected, lsm);
+}
+
+TEST(lsm, client) {
+  auto datastore = datastore::clients::make_lsm(configuration());
+  datastore->insert(std::pair("b", "2"));
+  datastore->insert(std::pair("a", "1"));
+  EXPECT_EQ("1", datastore->at("a").second);
+  EXPECT_EQ(2u, datastore->size());
+  EXPECT_EQ(1u, datastore->erase("a"));
+  EXPECT_EQ(0u, datastore->erase("a"));
+  EXPECT_EQ(datastore->end(), datastore->find("a"));
+  datastore->clear();
+  EXPECT_TRUE(datastore->empty());
+}
+
+TEST(lsm, erasure) {
+  auto lsm = datastore::clients::lsm_client(configuration());
+  lsm.insert(std::pair("a", "1"));
+  lsm.insert(std::pair("b", "2"));
+  lsm.backend().flush();
+  lsm.erase("a");
+  lsm.backend().flush();
+  // The marker in the newer run shadows the key in the older run
+  EXPECT_EQ(2u, lsm.backend().runs());
+  EXPECT_EQ(lsm.end(), lsm.find("a"));
+  EXPECT_EQ("b", (*lsm.begin()).first);
+  EXPECT_EQ("b", (*--lsm.end()).first);
+}
+
+TEST(lsm, tiered) {
+  auto settings = configuration();
+  auto lsm = datastore::clients::lsm_client(settings);
+  // Each batch fits in the memtable, so that only flush rotates it and the
+  // runs do not depend on when the worker gets to them
+  for (auto i = 0; i < 2000; ++i) {
+    lsm.insert(std::pair(std::to_string(i), std::string(10, 'x')));
+    if (i % 50 == 49) {
+      lsm.backend().flush();
+    }
+  }
+  auto largest = [&settings] {
+    auto result = std::filesystem::path();
+    auto bytes = std::uintmax_t{0};
+    for (const auto& item :
+         std::filesystem::directory_iterator(settings.path())) {
+      if (item.path().extension() == ".table" && item.file_size() > bytes) {
+        result = item.path();
+        bytes = item.file_size();
+      }
+    }
+    return result;
+  };
+  auto base = largest();
+  for (auto i = 0; i < 6; ++i) {
+    lsm.erase(std::to_string(i));
+    lsm.insert(std::pair("new" + std::to_string(i), "1"));
+    lsm.backend().flush();
+    // Small runs merge among themselves, their markers shadowing the base
+    EXPECT_EQ(base, largest());
+    EXPECT_LT(lsm.backend().runs(), 3u);
+  }
+  EXPECT_EQ(lsm.end(), lsm.find("0"));
+  EXPECT_EQ(lsm.end(), lsm.find("5"));
+  EXPECT_EQ("1", lsm.at("new5").second);
+  EXPECT_EQ(2000u, lsm.size());
+}
+
+TEST(lsm, cursor_stability) {
+  auto lsm = datastore::clients::lsm_client(configuration());
+  lsm.insert(std::pair("a", "1"));
+  lsm.insert(std::pair("c", "3"));
+  auto it = lsm.find("a");
+  lsm.backend().flush();
+  EXPECT_EQ("c", (*++it).first);
+  lsm.clear();
+  EXPECT_EQ("a", (*--it).first);
+}
+
+TEST(lsm, torn_log) {
+  auto settings = configuration();
+  {
+    auto lsm = datastore::clients::lsm_client(settings);
+    lsm.insert(std::pair("a", "1"));
+  }
+  for (const auto& item : std::filesystem::directory_iterator(settings.path())) {
+    if (item.path().extension() == ".log") {
+      std::ofstream(item.path(), std::ios::app | std::ios::binary) << "torn";
+    }
+  }
+  auto lsm = datastore::clients::lsm_client(settings);
+  EXPECT_EQ("1", lsm.at("a").second);
+  EXPECT_EQ(1u, lsm.size());
+}
+
+}  // namespace test
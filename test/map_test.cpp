@@ -1,6 +1,12 @@
+#include <datastore/bijective/binary.h>
+#include <datastore/bijective/identity.h>
+#include <datastore/clients/concurrent_map.h>
 #include <datastore/clients/map.h>
 #include <datastore/map.h>
 #include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 namespace test {
 
@@ -22,4 +28,143 @@ TEST(map, find) {
   EXPECT_DOUBLE_EQ(2.0, it->second);
 }
 
+TEST(map, reverse) {
+  auto datastore = datastore::clients::make_map();
+  datastore::map<int, double, datastore::bijective::binary<int>,
+                 datastore::bijective::binary<double>>
+      map{*datastore};
+  map.insert(std::pair{1, 2.0});
+  map.insert(std::pair{3, 4.0});
+  auto it = map.rbegin();
+  ASSERT_NE(map.rend(), it);
+  EXPECT_DOUBLE_EQ(4.0, it->second);
+  EXPECT_DOUBLE_EQ(2.0, (++it)->second);
+  EXPECT_EQ(map.rend(), ++it);
+}
+
+TEST(map, static_codecs) {
+  auto datastore = datastore::clients::make_map();
+  datastore::map<int, double, datastore::bijective::binary<int>,
+                 datastore::bijective::binary<double>>
+      map{*datastore};
+  map.insert(std::pair{1, 2.0});
+  map.insert(std::pair{3, 4.0});
+  auto it = map.find(3);
+  ASSERT_NE(map.end(), it);
+  EXPECT_DOUBLE_EQ(4.0, it->second);
+  EXPECT_EQ(map.end(), map.find(2));
+  EXPECT_EQ(2u, map.size());
+}
+
+TEST(map, identity) {
+  auto datastore = datastore::clients::make_map();
+  datastore::map<std::string, std::string,
+                 datastore::bijective::identity<std::string, std::string_view>,
+                 datastore::bijective::identity<std::string, std::string_view>>
+      map{*datastore};
+  map.insert(std::pair{std::string("a"), std::string("1")});
+  auto it = map.find("a");
+  ASSERT_NE(map.end(), it);
+  EXPECT_EQ("1", it->second);
+}
+
+TEST(map, runtime_codec) {
+  auto datastore = datastore::clients::make_map();
+  datastore::bijective::function<int, std::string_view> key =
+      datastore::bijective::binary<int>{};
+  datastore::map<int, double> map{*datastore, key};
+  map.insert(std::pair{7, 8.0});
+  auto seven = 7;
+  auto it = datastore->find(datastore::bijective::binary<int>{}.f(seven));
+  ASSERT_NE(datastore->end(), it);
+  EXPECT_DOUBLE_EQ(8.0, map.find(7)->second);
+}
+
+TEST(map, snapshot) {
+  auto datastore = datastore::clients::make_map();
+  datastore->insert({"a", "1"});
+  datastore->insert({"b", "2"});
+  auto snapshot = datastore::clients::snapshot(*datastore);
+  datastore->erase("a");
+  datastore->insert({"a", "3"});
+  datastore->erase("b");
+  datastore->insert({"c", "4"});
+  EXPECT_EQ(2u, snapshot->size());
+  EXPECT_EQ("1", snapshot->at("a").second);
+  EXPECT_EQ("2", snapshot->at("b").second);
+  EXPECT_EQ(snapshot->end(), snapshot->find("c"));
+  EXPECT_EQ("3", datastore->at("a").second);
+  EXPECT_EQ(datastore->end(), datastore->find("b"));
+
+  // Either copy may be modified without affecting the other
+  snapshot->insert({"d", "5"});
+  EXPECT_EQ(datastore->end(), datastore->find("d"));
+  EXPECT_EQ(2u, datastore->size());
+}
+
+TEST(map, snapshot_requires_map) {
+  auto datastore = datastore::clients::make_concurrent_map();
+  EXPECT_THROW(datastore::clients::snapshot(*datastore), std::invalid_argument);
+}
+
+TEST(map, iterator_survives_erase) {
+  auto datastore = datastore::clients::make_map();
+  for (auto key : {"a", "b", "c", "d"}) {
+    datastore->insert({key, key});
+  }
+  auto it = datastore->find("b");
+  datastore->erase("b");
+  datastore->erase("c");
+  ASSERT_EQ("b", it->first);
+  ++it;
+  EXPECT_EQ("c", it->first);
+  --it;
+  --it;
+  EXPECT_EQ("a", it->first);
+}
+
+TEST(map, ordered_iteration) {
+  auto datastore = datastore::clients::make_map();
+  for (auto i = 0; i < 1000; ++i) {
+    datastore->insert({std::to_string(i * 7919 % 1000), ""});
+  }
+  for (auto i = 0; i < 1000; i += 3) {
+    datastore->erase(std::to_string(i));
+  }
+  std::string previous;
+  auto count = 0u;
+  for (const auto& [key, value] : *datastore) {
+    EXPECT_LT(previous, key);
+    previous = key;
+    ++count;
+  }
+  EXPECT_EQ(datastore->size(), count);
+  auto reverse = 0u;
+  for (auto it = datastore->end(); it != datastore->begin(); --it) {
+    ++reverse;
+  }
+  EXPECT_EQ(count, reverse);
+}
+
+TEST(map, snapshot_while_writing) {
+  auto datastore = datastore::clients::make_map();
+  auto writer = std::thread([&] {
+    for (auto i = 0; i < 1000; ++i) {
+      datastore->insert({std::to_string(i), "value"});
+    }
+  });
+  for (auto i = 0; i < 100; ++i) {
+    // A snapshot never sees a write in progress
+    auto snapshot = datastore::clients::snapshot(*datastore);
+    auto count = 0u;
+    for (const auto& element : *snapshot) {
+      EXPECT_EQ("value", element.second);
+      ++count;
+    }
+    EXPECT_EQ(snapshot->size(), count);
+  }
+  writer.join();
+  EXPECT_EQ(1000u, datastore->size());
+}
+
 }  // namespace test
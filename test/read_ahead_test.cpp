@@ -0,0 +1,74 @@
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+std::unique_ptr<datastore::client> open(const std::string& name) {
+  auto path = scratch_directory(name);
+  return datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(path));
+}
+
+void fill(datastore::client& datastore, int count) {
+  auto writes = datastore::batch();
+  for (auto i = 0; i < count; ++i) {
+    auto key = std::to_string(1000 + i);
+    writes.put(key, std::string(100 + i % 7, 'v'));
+  }
+  datastore.write(writes);
+}
+
+std::vector<std::pair<std::string, std::string>> scan(
+    datastore::client::iterator it, const datastore::client& datastore) {
+  auto result = std::vector<std::pair<std::string, std::string>>();
+  for (; it != datastore.end(); ++it) {
+    result.emplace_back(it->first, it->second);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(read_ahead, scan) {
+  auto lmdb = open("datastore_read_ahead");
+  fill(*lmdb, 2000);
+  // A window smaller than an element makes the walk wait at every step
+  for (std::size_t window : {1, 4096, 1 << 20}) {
+    EXPECT_EQ(scan(lmdb->lower_bound("1500"), *lmdb),
+              scan(datastore::clients::read_ahead(*lmdb, "1500", window),
+                   *lmdb));
+  }
+  EXPECT_EQ(2000u, scan(datastore::clients::read_ahead(*lmdb), *lmdb).size());
+}
+
+TEST(read_ahead, abandoned) {
+  auto lmdb = open("datastore_read_ahead");
+  fill(*lmdb, 2000);
+  auto it = datastore::clients::read_ahead(*lmdb, "1000", 512);
+  auto copy = it;
+  ++copy;
+  it = datastore::client::iterator();
+  EXPECT_EQ("1001", copy->first);
+}
+
+TEST(read_ahead, end) {
+  auto lmdb = open("datastore_read_ahead");
+  fill(*lmdb, 10);
+  EXPECT_TRUE(lmdb->end() == datastore::clients::read_ahead(*lmdb, "2"));
+}
+
+TEST(read_ahead, invalid) {
+  auto map = datastore::clients::make_map();
+  EXPECT_THROW(static_cast<void>(datastore::clients::read_ahead(*map)),
+               std::invalid_argument);
+}
+
+}  // namespace test
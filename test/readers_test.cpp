@@ -0,0 +1,140 @@
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+datastore::clients::lmdb_configuration configuration(const std::string& name) {
+  auto path = scratch_directory(name);
+  return datastore::clients::lmdb_configuration(path);
+}
+
+void fill(datastore::client& datastore) {
+  auto writes = datastore::batch();
+  for (auto i = 0; i < 100; ++i) {
+    writes.put(std::to_string(1000 + i), "value");
+  }
+  datastore.write(writes);
+}
+
+}  // namespace
+
+TEST(readers, tracked) {
+  auto lmdb = datastore::clients::make_lmdb(configuration("datastore_readers"));
+  fill(*lmdb);
+  EXPECT_TRUE(datastore::clients::open_readers(*lmdb).empty());
+  auto it = lmdb->end();
+  {
+    auto origin = datastore::clients::reader_origin("cache");
+    it = lmdb->begin();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  auto other = lmdb->begin();
+  auto open = datastore::clients::open_readers(*lmdb);
+  ASSERT_EQ(2u, open.size());
+  EXPECT_EQ("cache", open[0].origin);
+  EXPECT_EQ("", open[1].origin);
+  EXPECT_EQ(std::this_thread::get_id(), open[0].thread);
+  EXPECT_GE(open[0].age, std::chrono::milliseconds(5));
+  EXPECT_GT(open[0].age, open[1].age);
+
+  auto stats = datastore::clients::readers(*lmdb);
+  EXPECT_EQ(2u, stats.open);
+  EXPECT_GE(stats.oldest, open[0].age);
+  EXPECT_GE(stats.slots_used, 1u);
+  EXPECT_GT(stats.slots, stats.slots_used);
+  EXPECT_GT(stats.occupancy(), 0.0);
+  EXPECT_EQ(0u, datastore::clients::check_readers(*lmdb));
+
+  it = lmdb->end();
+  other = lmdb->end();
+  EXPECT_TRUE(datastore::clients::open_readers(*lmdb).empty());
+}
+
+TEST(readers, warn) {
+  std::mutex mutex;
+  auto warnings = std::vector<datastore::clients::reader_info>();
+  auto lmdb = datastore::clients::make_lmdb(
+      configuration("datastore_readers")
+          .set_reader_check_interval(std::chrono::milliseconds(1))
+          .set_stale_readers(datastore::clients::reader_policy::warn,
+                             std::chrono::milliseconds(20))
+          .set_stale_reader_callback(
+              [&](const datastore::clients::reader_info& reader) {
+                std::lock_guard lock(mutex);
+                warnings.push_back(reader);
+              }));
+  fill(*lmdb);
+  auto origin = datastore::clients::reader_origin("leak");
+  auto it = lmdb->begin();
+  for (auto i = 0; i < 500 && datastore::clients::readers(*lmdb).warned == 0;
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  {
+    std::lock_guard lock(mutex);
+    ASSERT_EQ(1u, warnings.size());
+    EXPECT_EQ("leak", warnings[0].origin);
+    EXPECT_GT(warnings[0].age, std::chrono::milliseconds(20));
+  }
+  EXPECT_EQ(1u, datastore::clients::readers(*lmdb).warned);
+  // Warnings leave the reader be
+  ++it;
+  EXPECT_EQ("1001", it->first);
+}
+
+TEST(readers, invalidate) {
+  auto invalidated = std::vector<datastore::clients::reader_info>();
+  auto lmdb = datastore::clients::make_lmdb(
+      configuration("datastore_readers")
+          .set_stale_readers(datastore::clients::reader_policy::invalidate,
+                             std::chrono::milliseconds(50))
+          .set_stale_reader_callback(
+              [&](const datastore::clients::reader_info& reader) {
+                invalidated.push_back(reader);
+              }));
+  fill(*lmdb);
+  auto stale = lmdb->begin();
+  auto copy = stale;
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  auto fresh = lmdb->begin();
+  datastore::clients::check_readers(*lmdb);
+  EXPECT_EQ(1u, invalidated.size());
+  EXPECT_EQ(1u, datastore::clients::readers(*lmdb).invalidated);
+  EXPECT_EQ(1u, datastore::clients::open_readers(*lmdb).size());
+  try {
+    ++stale;
+    FAIL() << "invalidated readers throw";
+  } catch (const std::system_error& error) {
+    EXPECT_EQ(std::errc::timed_out, error.code());
+  }
+  EXPECT_THROW(++copy, std::system_error);
+
+  // Other readers and writers carry on
+  ++fresh;
+  EXPECT_EQ("1001", fresh->first);
+  lmdb->insert({"2000", "value"});
+  EXPECT_EQ(101u, lmdb->size());
+  datastore::clients::check_readers(*lmdb);
+  EXPECT_EQ(1u, invalidated.size());
+}
+
+TEST(readers, invalid) {
+  auto map = datastore::clients::make_map();
+  EXPECT_THROW(datastore::clients::readers(*map), std::invalid_argument);
+  EXPECT_THROW(datastore::clients::check_readers(*map), std::invalid_argument);
+}
+
+}  // namespace test
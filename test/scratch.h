@@ -0,0 +1,15 @@
+#pragma once
+#include <filesystem>
+#include <string>
+
+namespace test {
+
+/** Returns an empty directory called name under the temporary directory */
+inline std::filesystem::path scratch_directory(const std::string& name) {
+  auto path = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  return path;
+}
+
+}  // namespace test
@@ -0,0 +1,103 @@
+#include <datastore/clients/concurrent_map.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace test {
+
+TEST(skiplist, map) {
+  auto random = std::mt19937(7);
+  auto expected = datastore::clients::map_client();
+  auto list = datastore::clients::concurrent_map_client();
+  for (auto i = 0; i < 5000; ++i) {
+    auto key = std::to_string(random() % 1000);
+    auto value = std::to_string(i);
+    if (random() % 3 == 0) {
+      EXPECT_EQ(expected.erase(key), list.erase(key));
+    } else {
+      expected.erase(key);
+      list.erase(key);
+      expected.insert(std::pair(std::string_view(key), std::string_view(value)));
+      list.insert(std::pair(std::string_view(key), std::string_view(value)));
+    }
+  }
+  EXPECT_EQ(expected.size(), list.size());
+  EXPECT_TRUE(
+      std::equal(expected.begin(), expected.end(), list.begin(), list.end()));
+  EXPECT_TRUE(std::equal(std::make_reverse_iterator(expected.end()),
+                         std::make_reverse_iterator(expected.begin()),
+                         std::make_reverse_iterator(list.end()),
+                         std::make_reverse_iterator(list.begin())));
+  list.clear();
+  EXPECT_TRUE(list.empty());
+}
+
+TEST(skiplist, erased_cursor) {
+  auto datastore = datastore::clients::make_concurrent_map();
+  datastore->insert(std::pair("a", "1"));
+  datastore->insert(std::pair("b", "2"));
+  datastore->insert(std::pair("c", "3"));
+  auto it = datastore->find("b");
+  datastore->erase("b");
+  datastore->erase("a");
+  // The erased element stays readable and its neighbours reachable
+  EXPECT_EQ("2", (*it).second);
+  auto next = it;
+  EXPECT_EQ("c", (*++next).first);
+  EXPECT_EQ(datastore->end(), --it);
+}
+
+TEST(skiplist, concurrency) {
+  constexpr auto writers = 4;
+  constexpr auto keys = 2000;
+  auto datastore = datastore::clients::make_concurrent_map();
+  auto done = std::atomic<bool>(false);
+  auto failures = std::atomic<int>(0);
+  std::vector<std::thread> readers;
+  for (auto i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!done) {
+        std::string previous;
+        for (const auto& [key, value] : *datastore) {
+          // Values are the key suffixed by the writer's round
+          if ((!previous.empty() && !(previous < key)) ||
+              value.substr(0, key.size()) != key) {
+            ++failures;
+          }
+          previous = key;
+        }
+      }
+    });
+  }
+  std::vector<std::thread> threads;
+  for (auto i = 0; i < writers; ++i) {
+    threads.emplace_back([&datastore, i] {
+      for (auto round = 0; round < 3; ++round) {
+        for (auto j = i; j < keys; j += writers) {
+          auto key = std::to_string(j);
+          auto value = key + "/" + std::to_string(round);
+          datastore->erase(key);
+          if (round < 2 || j % 2 == 0) {
+            datastore->insert(
+                std::pair(std::string_view(key), std::string_view(value)));
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  done = true;
+  for (auto& thread : readers) {
+    thread.join();
+  }
+  EXPECT_EQ(0, failures);
+  EXPECT_EQ(static_cast<std::size_t>(keys / 2), datastore->size());
+  EXPECT_EQ("10/2", datastore->at("10").second);
+}
+
+}  // namespace test
@@ -0,0 +1,124 @@
+#include <datastore/clients/detail/table.h>
+#include <datastore/clients/map.h>
+#include <datastore/clients/table.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <filesystem>
+#include <system_error>
+
+namespace test {
+
+namespace {
+
+std::unique_ptr<datastore::client> source() {
+  auto result = datastore::clients::make_map();
+  for (auto i = 0; i < 1000; ++i) {
+    auto key = "key" + std::to_string(i);
+    auto value = std::to_string(i * i);
+    result->insert(std::pair(std::string_view(key), std::string_view(value)));
+  }
+  return result;
+}
+
+}  // namespace
+
+class table_format : public testing::TestWithParam<unsigned int> {};
+
+TEST_P(table_format, round_trip) {
+  auto configuration = datastore::clients::table_configuration(
+      scratch_directory("datastore_table") / "table");
+  configuration.set_block_size(256).set_restart_interval(GetParam());
+  auto expected = source();
+  datastore::clients::write_table(*expected, configuration);
+  EXPECT_FALSE(std::filesystem::exists(configuration.path().string() + ".tmp"));
+
+  auto datastore = datastore::clients::make_table(configuration);
+  EXPECT_EQ(expected->size(), datastore->size());
+  EXPECT_TRUE(std::equal(expected->begin(), expected->end(),
+                         datastore->begin(), datastore->end()));
+  for (const auto& [key, value] : *expected) {
+    auto it = datastore->find(key);
+    ASSERT_NE(datastore->end(), it);
+    EXPECT_EQ(value, (*it).second);
+  }
+  EXPECT_EQ(datastore->end(), datastore->find("key"));
+  EXPECT_EQ(datastore->end(), datastore->find("key10000"));
+  EXPECT_EQ(datastore->end(), datastore->find("zzz"));
+
+  // Walk backwards across restart points and blocks
+  auto it = datastore->end();
+  auto jt = expected->end();
+  while (jt != expected->begin()) {
+    --it;
+    --jt;
+    EXPECT_EQ(*jt, *it);
+  }
+  EXPECT_EQ(datastore->begin(), it);
+}
+
+INSTANTIATE_TEST_SUITE_P(restart_interval, table_format, testing::Values(1u, 16u));
+
+TEST(table, lower_bound) {
+  auto configuration = datastore::clients::table_configuration(
+      scratch_directory("datastore_table") / "table");
+  configuration.set_block_size(64);
+  datastore::clients::write_table(*source(), configuration);
+  auto backend = datastore::clients::detail::table(configuration);
+  EXPECT_EQ("key0", backend.lower_bound("").key());
+  EXPECT_EQ("key10", backend.lower_bound("key10").key());
+  EXPECT_EQ("key100", backend.lower_bound("key10!").key());
+  EXPECT_EQ("key101", backend.lower_bound("key1000").key());
+  EXPECT_EQ(backend.last(), backend.lower_bound("key9999"));
+}
+
+TEST(table, read_only) {
+  auto configuration = datastore::clients::table_configuration(
+      scratch_directory("datastore_table") / "table");
+  datastore::clients::write_table(*source(), configuration);
+  auto datastore = datastore::clients::make_table(configuration);
+  EXPECT_THROW(datastore->insert(std::pair("a", "b")), std::system_error);
+  EXPECT_THROW(datastore->erase("key1"), std::system_error);
+  EXPECT_THROW(datastore->clear(), std::system_error);
+}
+
+TEST(table, empty) {
+  auto configuration = datastore::clients::table_configuration(
+      scratch_directory("datastore_table") / "table");
+  datastore::clients::table_writer(configuration).finish();
+  auto datastore = datastore::clients::make_table(configuration);
+  EXPECT_TRUE(datastore->empty());
+  EXPECT_EQ(datastore->end(), datastore->find("a"));
+}
+
+TEST(table, writer) {
+  auto path = scratch_directory("datastore_table") / "table";
+  auto configuration = datastore::clients::table_configuration(
+      path, datastore::compare::tuple<std::uint32_t>);
+  {
+    auto writer = datastore::clients::table_writer(configuration);
+    auto key = std::uint32_t{2};
+    writer.add(std::string_view(reinterpret_cast<char*>(&key), sizeof(key)),
+               "two");
+    key = 1;
+    EXPECT_THROW(
+        writer.add(std::string_view(reinterpret_cast<char*>(&key), sizeof(key)),
+                   "one"),
+        std::invalid_argument);
+    key = 256;
+    writer.add(std::string_view(reinterpret_cast<char*>(&key), sizeof(key)),
+               "many");
+  }
+  // An unfinished table is discarded
+  EXPECT_FALSE(std::filesystem::exists(path));
+  EXPECT_TRUE(std::filesystem::is_empty(path.parent_path()));
+}
+
+TEST(table, corrupt) {
+  auto path = scratch_directory("datastore_table") / "table";
+  std::ofstream(path) << "not a table";
+  EXPECT_THROW(datastore::clients::make_table(
+                   datastore::clients::table_configuration(path)),
+               std::filesystem::filesystem_error);
+}
+
+}  // namespace test
@@ -0,0 +1,195 @@
+#include <datastore/clients/compressed.h>
+#include <datastore/clients/detail/tiered.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace test {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+/** Configures a hot tier of capacity bytes, balanced only on request */
+datastore::clients::tiered_configuration configuration(std::size_t capacity) {
+  auto result = datastore::clients::tiered_configuration(capacity);
+  result.set_promotion_threshold(2).set_batch_size(8).set_interval(1h);
+  return result;
+}
+
+}  // namespace
+
+TEST(tiered, map) {
+  auto random = std::mt19937(5);
+  auto expected = datastore::clients::map_client();
+  auto tiered = datastore::clients::tiered_client(
+      datastore::clients::make_map(), configuration(400));
+  for (auto i = 0; i < 3000; ++i) {
+    auto key = std::to_string(random() % 300);
+    auto value = std::to_string(i);
+    auto action = random() % 8;
+    if (action == 0) {
+      EXPECT_EQ(expected.erase(key), tiered.erase(key));
+    } else if (action < 4) {
+      EXPECT_EQ(expected.find(key) == expected.end(),
+                tiered.find(key) == tiered.end());
+    } else {
+      expected.erase(key);
+      expected.insert(std::pair(std::string_view(key), std::string_view(value)));
+      tiered.backend().insert_or_assign(
+          tiered.backend().last(),
+          std::pair(std::string_view(key), std::string_view(value)));
+    }
+    if (i % 100 == 0) {
+      tiered.backend().balance();
+      EXPECT_GE(400u, tiered.backend().hot_bytes());
+    }
+  }
+  EXPECT_EQ(expected.size(), tiered.size());
+  EXPECT_TRUE(
+      std::equal(expected.begin(), expected.end(), tiered.begin(), tiered.end()));
+  EXPECT_TRUE(std::equal(std::make_reverse_iterator(expected.end()),
+                         std::make_reverse_iterator(expected.begin()),
+                         std::make_reverse_iterator(tiered.end()),
+                         std::make_reverse_iterator(tiered.begin())));
+  auto lower = tiered.lower_bound("15");
+  ASSERT_NE(tiered.end(), lower);
+  EXPECT_EQ((*expected.lower_bound("15")).first, (*lower).first);
+}
+
+TEST(tiered, demotion_and_promotion) {
+  auto cold = datastore::clients::make_map();
+  for (auto i = 10; i < 30; ++i) {
+    auto key = "key" + std::to_string(i);
+    cold->insert(std::pair(std::string_view(key), "value"));
+  }
+  auto& cold_tier = *cold;
+  auto tiered = datastore::clients::tiered_client(std::move(cold),
+                                                  configuration(100));
+
+  // Cold keys which are read often are promoted
+  for (auto i = 10; i < 15; ++i) {
+    for (auto j = 0; j < 3; ++j) {
+      EXPECT_NE(tiered.end(), tiered.find("key" + std::to_string(i)));
+    }
+  }
+  tiered.backend().balance();
+  EXPECT_EQ(5u, tiered.backend().hot_size());
+  EXPECT_EQ(20u, cold_tier.size());
+  EXPECT_EQ("value", tiered.at("key10").second);
+
+  // Writes past the capacity demote the least read keys
+  for (auto j = 0; j < 3; ++j) {
+    EXPECT_NE(tiered.end(), tiered.find("key10"));
+  }
+  for (auto i = 30; i < 36; ++i) {
+    auto key = "key" + std::to_string(i);
+    tiered.insert(std::pair(std::string_view(key), "value"));
+  }
+  tiered.backend().balance();
+  EXPECT_GE(100u, tiered.backend().hot_bytes());
+  EXPECT_GT(11u, tiered.backend().hot_size());
+  EXPECT_EQ(26u, tiered.size());
+  tiered.backend().flush();
+  EXPECT_EQ(26u, cold_tier.size());
+}
+
+TEST(tiered, write) {
+  auto cold = datastore::clients::make_map();
+  cold->insert({"a", "cold"});
+  cold->insert({"b", "cold"});
+  auto& cold_tier = *cold;
+  auto tiered = datastore::clients::make_tiered(std::move(cold),
+                                                configuration(1000));
+  tiered->write(datastore::batch().put("a", "hot").erase("b").put("c", "3"));
+  // Erasures reach the cold tier at once, puts when written back
+  EXPECT_EQ(1u, cold_tier.size());
+  EXPECT_EQ("cold", cold_tier.at("a").second);
+  EXPECT_EQ("hot", tiered->at("a").second);
+  EXPECT_EQ(tiered->end(), tiered->find("b"));
+  EXPECT_EQ(2u, tiered->size());
+}
+
+TEST(tiered, background) {
+  auto cold = datastore::clients::make_map();
+  auto& cold_tier = *cold;
+  auto settings = configuration(100);
+  settings.set_interval(10ms);
+  auto tiered = datastore::clients::tiered_client(std::move(cold), settings);
+  for (auto i = 0; i < 50; ++i) {
+    auto key = std::to_string(i);
+    tiered.insert(std::pair(std::string_view(key), "value"));
+  }
+  for (auto i = 0; i < 500 && tiered.backend().hot_bytes() > 100; ++i) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_GE(100u, tiered.backend().hot_bytes());
+  EXPECT_LT(0u, cold_tier.size());
+  EXPECT_EQ(50, std::distance(tiered.begin(), tiered.end()));
+}
+
+TEST(tiered, chunks) {
+  // Values of the cold tier are decompressed into a buffer of its cursor
+  auto cold = datastore::clients::make_compressed(
+      datastore::clients::make_map());
+  for (auto i = 0; i < 100; ++i) {
+    auto key = std::to_string(i);
+    cold->insert(std::pair(std::string_view(key), "value" + key));
+  }
+  auto tiered =
+      datastore::clients::make_tiered(std::move(cold), configuration(1000));
+  tiered->insert({"50", "value50"});
+  auto count = 0;
+  tiered->for_each_chunk(
+      [&count](const auto& chunk) {
+        for (const auto& value : chunk) {
+          EXPECT_EQ("value" + std::string(value.first), value.second);
+          ++count;
+        }
+      },
+      10);
+  EXPECT_EQ(100, count);
+}
+
+TEST(tiered, close) {
+  auto path = scratch_directory("datastore_tiered");
+  auto open = [&path] {
+    return datastore::clients::make_lmdb(
+        datastore::clients::lmdb_configuration(path));
+  };
+  {
+    auto cold = open();
+    cold->insert({"a", "cold"});
+    auto tiered =
+        datastore::clients::make_tiered(std::move(cold), configuration(1000));
+    tiered->write(datastore::batch().put("a", "hot"));
+    tiered->insert({"b", "hot"});
+  }
+  // Destroying the datastore writes back the hot tier
+  auto cold = open();
+  EXPECT_EQ("hot", cold->at("a").second);
+  EXPECT_EQ("hot", cold->at("b").second);
+}
+
+TEST(tiered, close_error) {
+  // The compressed cold tier rejects its reserved key on write-back
+  auto key = std::string("\xff" "datastore.dict");
+  auto errors = 0;
+  {
+    auto tiered = datastore::clients::tiered_client(
+        datastore::clients::make_compressed(datastore::clients::make_map()),
+        configuration(1000).set_close_error_callback(
+            [&errors](const std::exception&) { ++errors; }));
+    tiered.insert(std::pair(std::string_view(key), "hot"));
+    // flush reports the failure, and the destructor tries again
+    EXPECT_THROW(tiered.backend().flush(), std::invalid_argument);
+  }
+  EXPECT_EQ(1, errors);
+}
+
+}  // namespace test
@@ -0,0 +1,189 @@
+#include <datastore/bijective/binary.h>
+#include <datastore/clients/concurrent_map.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <datastore/merge.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+std::string encode(std::int64_t value) {
+  return std::string(datastore::bijective::binary<std::int64_t>().f(value));
+}
+
+std::int64_t decode(std::string_view value) {
+  return datastore::bijective::binary<std::int64_t>().g(value);
+}
+
+std::optional<std::string> value(const datastore::client& datastore,
+                                 std::string_view key) {
+  auto it = datastore.find(key);
+  if (it == datastore.end()) {
+    return std::nullopt;
+  }
+  return std::string(it->second);
+}
+
+/** Checks update, compare_and_swap and merges on any datastore */
+void check(datastore::client& datastore) {
+  auto result = datastore.update("a", [](auto current) {
+    EXPECT_FALSE(current);
+    return std::optional<std::string>("1");
+  });
+  EXPECT_EQ("1", result);
+  EXPECT_EQ("1", value(datastore, "a"));
+  datastore.update("a", [](auto current) {
+    return std::string(*current) + "2";
+  });
+  EXPECT_EQ("12", value(datastore, "a"));
+  datastore.update("a", [](auto) { return std::nullopt; });
+  EXPECT_FALSE(value(datastore, "a"));
+
+  EXPECT_TRUE(datastore.compare_and_swap("b", std::nullopt, "x"));
+  EXPECT_FALSE(datastore.compare_and_swap("b", std::nullopt, "y"));
+  EXPECT_FALSE(datastore.compare_and_swap("b", "y", "z"));
+  EXPECT_EQ("x", value(datastore, "b"));
+  EXPECT_TRUE(datastore.compare_and_swap("b", "x", std::nullopt));
+  EXPECT_FALSE(value(datastore, "b"));
+
+  datastore.write(datastore::batch()
+                      .merge("n", encode(2), datastore::add_int64())
+                      .merge("s", "a", datastore::append())
+                      .merge("n", encode(-5), datastore::add_int64())
+                      .put("s", "b")
+                      .merge("s", "c", datastore::append()));
+  EXPECT_EQ(-3, decode(*value(datastore, "n")));
+  EXPECT_EQ("bc", value(datastore, "s"));
+  datastore.write(datastore::batch()
+                      .merge("n", encode(10), datastore::add_int64())
+                      .erase("s")
+                      .merge("s", "d", datastore::append()));
+  EXPECT_EQ(7, decode(*value(datastore, "n")));
+  EXPECT_EQ("d", value(datastore, "s"));
+  EXPECT_THROW(datastore.write(datastore::batch().merge(
+                   "s", encode(1), datastore::add_int64())),
+               std::invalid_argument);
+  EXPECT_EQ("d", value(datastore, "s"));
+}
+
+/** Adds to one counter from several threads at once */
+void count(datastore::client& datastore) {
+  constexpr auto threads = 4;
+  constexpr auto adds = 200;
+  auto workers = std::vector<std::thread>();
+  for (auto i = 0; i < threads; ++i) {
+    workers.emplace_back([&datastore, i] {
+      for (auto j = 0; j < adds; ++j) {
+        if (j % 2 == 0) {
+          datastore.write(datastore::batch().merge("counter", encode(1),
+                                                   datastore::add_int64()));
+        } else {
+          datastore.update("counter", [](auto current) {
+            return encode((current ? decode(*current) : 0) + 1);
+          });
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(threads * adds, decode(*value(datastore, "counter")));
+}
+
+/** Inserts a key while an update of it runs, which the insert waits for */
+void exclude(datastore::client& datastore) {
+  auto started = std::promise<void>();
+  auto writer = std::thread();
+  datastore.update("k", [&](auto) {
+    writer = std::thread([&] {
+      started.set_value();
+      datastore.insert({"k", "inserted"});
+    });
+    started.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return std::optional<std::string>("updated");
+  });
+  writer.join();
+  EXPECT_EQ("inserted", value(datastore, "k"));
+}
+
+}  // namespace
+
+TEST(update, batch) {
+  auto writes = datastore::batch()
+                    .merge("a", "1", datastore::append())
+                    .put("b", "x")
+                    .merge("a", "2", datastore::append())
+                    .merge("b", "y", datastore::append());
+  EXPECT_TRUE(writes.merges());
+  auto reads = std::vector<std::string>();
+  auto resolved = writes.resolve_merges([&reads](std::string_view key) {
+    reads.emplace_back(key);
+    return key == "a" ? std::optional<std::string>("0") : std::nullopt;
+  });
+  // Each key is read once, unless written before its first merge
+  EXPECT_EQ(std::vector<std::string>{"a"}, reads);
+  EXPECT_FALSE(resolved.merges());
+  auto it = resolved.begin();
+  ASSERT_EQ(3u, resolved.size());
+  EXPECT_EQ("b", it->key);
+  EXPECT_EQ("x", it->value);
+  ++it;
+  EXPECT_EQ(datastore::batch::kind::put, it->type);
+  EXPECT_EQ("a", it->key);
+  EXPECT_EQ("012", it->value);
+  ++it;
+  EXPECT_EQ("b", it->key);
+  EXPECT_EQ("xy", it->value);
+}
+
+TEST(update, map) {
+  auto datastore = datastore::clients::make_map();
+  check(*datastore);
+  exclude(*datastore);
+}
+
+TEST(update, concurrent_map) {
+  auto datastore = datastore::clients::make_concurrent_map();
+  check(*datastore);
+  count(*datastore);
+  exclude(*datastore);
+}
+
+TEST(update, lmdb) {
+  auto lmdb = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(
+          scratch_directory("datastore_update"))
+          .set_change_log(true));
+  check(*lmdb);
+  count(*lmdb);
+
+  // Merges are logged as the values they left
+  auto changes = datastore::clients::read_changes(*lmdb, 1);
+  ASSERT_GE(changes.size(), 6u);
+  const auto& merged = changes[5].writes;
+  ASSERT_EQ(3u, merged.size());
+  EXPECT_EQ(datastore::batch::kind::put, merged.begin()->type);
+  EXPECT_EQ("n", merged.begin()->key);
+  EXPECT_EQ(-3, decode(merged.begin()->value));
+  // Unchanged values are not written
+  auto logged = changes.size();
+  lmdb->update("n", [](auto current) { return std::string(*current); });
+  EXPECT_FALSE(lmdb->compare_and_swap("n", "x", "y"));
+  EXPECT_EQ(logged, datastore::clients::read_changes(*lmdb, 1).size());
+}
+
+}  // namespace test
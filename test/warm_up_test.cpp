@@ -0,0 +1,112 @@
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/map.h>
+#include <gtest/gtest.h>
+#include "scratch.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace test {
+
+namespace {
+
+constexpr auto elements = 100000;
+
+/** Keys of 8 digits, with values of 10 bytes */
+std::string key(int i) {
+  char result[9];
+  std::snprintf(result, sizeof(result), "%08d", i);
+  return result;
+}
+
+std::unique_ptr<datastore::client> make_lmdb() {
+  auto lmdb = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(
+          scratch_directory("datastore_warm_up")));
+  auto writes = datastore::batch();
+  for (auto i = 0; i < elements; ++i) {
+    writes.put(key(i), "0123456789");
+  }
+  lmdb->write(writes);
+  return lmdb;
+}
+
+}  // namespace
+
+TEST(warm_up, branches) {
+  auto lmdb = make_lmdb();
+  auto report = datastore::clients::warm_up(
+      *lmdb, datastore::clients::warm_up_policy().set_threads(3));
+  EXPECT_GT(report.branch_pages, 0u);
+  EXPECT_GT(report.probes, 2u);
+  EXPECT_LE(report.probes, 2 * report.branch_pages);
+  EXPECT_EQ(0u, report.ranges);
+  EXPECT_EQ(0u, report.elements);
+  EXPECT_GT(report.after.size, 0u);
+  EXPECT_LE(report.after.resident, report.after.size);
+}
+
+TEST(warm_up, ranges) {
+  auto lmdb = make_lmdb();
+  auto policy =
+      datastore::clients::warm_up_policy().set_branches(false).set_ranges(
+          {{key(1000), key(2000)}, {key(90000), ""}, {"x", "y"}});
+  auto report = datastore::clients::warm_up(*lmdb, policy);
+  EXPECT_EQ(0u, report.probes);
+  EXPECT_EQ(3u, report.ranges);
+  EXPECT_EQ(11000u, report.elements);
+  EXPECT_EQ(11000u * 18, report.bytes);
+
+  report = datastore::clients::warm_up(*lmdb, policy.set_max_bytes(1800));
+  EXPECT_EQ(100u, report.elements);
+  EXPECT_EQ(1800u, report.bytes);
+
+  // 9000 bytes at 90000 bytes per second take at least 0.1 seconds
+  report = datastore::clients::warm_up(
+      *lmdb, policy.set_max_bytes(0)
+                 .set_ranges({{key(0), key(500)}})
+                 .set_bytes_per_second(90000));
+  EXPECT_EQ(9000u, report.bytes);
+  EXPECT_GE(report.elapsed, std::chrono::milliseconds(100));
+}
+
+TEST(warm_up, empty) {
+  auto lmdb = datastore::clients::make_lmdb(
+      datastore::clients::lmdb_configuration(
+          scratch_directory("datastore_warm_up")));
+  auto report = datastore::clients::warm_up(
+      *lmdb, datastore::clients::warm_up_policy().set_ranges({{"a", ""}}));
+  EXPECT_EQ(0u, report.probes);
+  EXPECT_EQ(1u, report.ranges);
+  EXPECT_EQ(0u, report.elements);
+}
+
+TEST(warm_up, profile) {
+  auto path = scratch_directory("datastore_warm_up") / "profile";
+  auto ranges = std::vector<datastore::clients::key_range>{
+      {"a", "b"}, {std::string("\0\xff", 2), ""}, {"", "z"}};
+  datastore::clients::save_access_profile(path, ranges);
+  EXPECT_EQ(ranges, datastore::clients::load_access_profile(path));
+  datastore::clients::save_access_profile(path, {});
+  EXPECT_TRUE(datastore::clients::load_access_profile(path).empty());
+
+  std::ofstream(path, std::ios::binary) << "corrupt";
+  EXPECT_THROW(datastore::clients::load_access_profile(path),
+               std::runtime_error);
+  EXPECT_THROW(datastore::clients::load_access_profile(path.string() + "x"),
+               std::runtime_error);
+}
+
+TEST(warm_up, invalid) {
+  auto map = datastore::clients::make_map();
+  EXPECT_THROW(datastore::clients::warm_up(*map), std::invalid_argument);
+  EXPECT_THROW(datastore::clients::resident(*map), std::invalid_argument);
+  EXPECT_THROW(datastore::clients::warm_up_policy().set_threads(0),
+               std::invalid_argument);
+}
+
+}  // namespace test
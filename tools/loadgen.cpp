@@ -0,0 +1,575 @@
+/** YCSB-style load generator for datastore clients
+ *
+ * Loads a number of records into a datastore created in a temporary
+ * directory, then runs a mix of operations from several threads, reporting
+ * throughput and latency percentiles for each interval as CSV or JSON lines.
+ * Run with --help for the options.
+ */
+#include <datastore/batch.h>
+#include <datastore/client.h>
+#include <datastore/clients/concurrent_map.h>
+#include <datastore/clients/lmdb.h>
+#include <datastore/clients/lsm.h>
+#include <datastore/clients/map.h>
+#include <datastore/clients/radix_map.h>
+#include <datastore/clients/tiered.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+enum class operation { read, update, insert, scan, read_modify_write };
+
+constexpr std::array<const char*, 5> operation_names = {
+    "read", "update", "insert", "scan", "read_modify_write"};
+
+/** A datastore factory, and whether threads may share its datastores */
+struct backend {
+  std::function<std::unique_ptr<datastore::client>(
+      const std::filesystem::path&)>
+      make;
+  bool shared;
+};
+
+const std::map<std::string, backend>& backends() {
+  using namespace datastore::clients;
+  static const auto result = std::map<std::string, backend>{
+      {"map", {[](const auto&) { return make_map(); }, false}},
+      {"concurrent_map",
+       {[](const auto&) { return make_concurrent_map(); }, true}},
+      {"radix_map", {[](const auto&) { return make_radix_map(); }, false}},
+      {"lmdb",
+       {[](const auto& path) { return make_lmdb(lmdb_configuration(path)); },
+        true}},
+      {"lsm",
+       {[](const auto& path) { return make_lsm(lsm_configuration(path)); },
+        false}},
+      {"tiered",
+       {[](const auto& path) {
+          return make_tiered(make_lmdb(lmdb_configuration(path)),
+                             tiered_configuration(64 << 20));
+        },
+        true}},
+  };
+  return result;
+}
+
+/** Proportions of each operation, and the default key distribution */
+struct workload {
+  std::array<double, 5> mix;
+  const char* distribution;
+};
+
+const std::map<std::string, workload>& workloads() {
+  static const auto result = std::map<std::string, workload>{
+      {"A", {{0.5, 0.5, 0, 0, 0}, "zipfian"}},
+      {"B", {{0.95, 0.05, 0, 0, 0}, "zipfian"}},
+      {"C", {{1, 0, 0, 0, 0}, "zipfian"}},
+      {"D", {{0.95, 0, 0.05, 0, 0}, "latest"}},
+      {"E", {{0, 0, 0.05, 0.95, 0}, "zipfian"}},
+      {"F", {{0.5, 0, 0, 0, 0.5}, "zipfian"}},
+  };
+  return result;
+}
+
+struct options {
+  std::string backend = "map";
+  std::string workload = "A";
+  std::string distribution; /** Defaults to that of the workload */
+  std::uint64_t records = 100000;
+  std::uint64_t operations = 1000000;
+  unsigned int threads = 1;
+  std::size_t min_value_size = 100;
+  std::size_t max_value_size = 100;
+  std::size_t scan_length = 100;
+  std::chrono::milliseconds interval{1000};
+  std::string format = "csv";
+  std::filesystem::path directory = std::filesystem::temp_directory_path();
+  std::uint64_t seed = 1;
+};
+
+void usage(std::ostream& os) {
+  os << "usage: datastore_loadgen [option...]\n"
+        "  --backend NAME         ";
+  for (const auto& [name, _] : backends()) {
+    os << name << ' ';
+  }
+  os << "(map)\n"
+        "  --workload A-F         YCSB core workload (A)\n"
+        "  --distribution NAME    zipfian, uniform or latest\n"
+        "  --records N            records loaded before the run (100000)\n"
+        "  --operations N         operations run, over all threads (1000000)\n"
+        "  --threads N            client threads (1)\n"
+        "  --value-size N[:M]     value size, or uniform range (100)\n"
+        "  --scan-length N        maximum scan length, uniform from 1 (100)\n"
+        "  --interval MS          reporting interval (1000)\n"
+        "  --format csv|json      output format, JSON as one object per line\n"
+        "  --directory PATH       where a scratch directory is made, and\n"
+        "                         removed afterwards (the temporary one)\n"
+        "  --seed N               random seed (1)\n";
+}
+
+options parse(int argc, char** argv) {
+  auto result = options();
+  for (auto i = 1; i < argc; ++i) {
+    auto name = std::string(argv[i]);
+    if (name == "--help") {
+      usage(std::cout);
+      std::exit(0);
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value for " + name);
+    }
+    auto value = std::string(argv[++i]);
+    if (name == "--backend") {
+      result.backend = value;
+    } else if (name == "--workload") {
+      result.workload = value;
+    } else if (name == "--distribution") {
+      result.distribution = value;
+    } else if (name == "--records") {
+      result.records = std::stoull(value);
+    } else if (name == "--operations") {
+      result.operations = std::stoull(value);
+    } else if (name == "--threads") {
+      result.threads = std::max(1ul, std::stoul(value));
+    } else if (name == "--value-size") {
+      auto colon = value.find(':');
+      result.min_value_size = std::stoull(value.substr(0, colon));
+      result.max_value_size = colon == std::string::npos
+                                  ? result.min_value_size
+                                  : std::stoull(value.substr(colon + 1));
+    } else if (name == "--scan-length") {
+      result.scan_length = std::max(1ull, std::stoull(value));
+    } else if (name == "--interval") {
+      result.interval = std::chrono::milliseconds(std::stoull(value));
+    } else if (name == "--format") {
+      result.format = value;
+    } else if (name == "--directory") {
+      result.directory = value;
+    } else if (name == "--seed") {
+      result.seed = std::stoull(value);
+    } else {
+      throw std::invalid_argument("unknown option " + name);
+    }
+  }
+  if (backends().count(result.backend) == 0) {
+    throw std::invalid_argument("unknown backend " + result.backend);
+  }
+  if (workloads().count(result.workload) == 0) {
+    throw std::invalid_argument("unknown workload " + result.workload);
+  }
+  if (result.distribution.empty()) {
+    result.distribution = workloads().at(result.workload).distribution;
+  }
+  if (result.distribution != "zipfian" && result.distribution != "uniform" &&
+      result.distribution != "latest") {
+    throw std::invalid_argument("unknown distribution " + result.distribution);
+  }
+  if (result.format != "csv" && result.format != "json") {
+    throw std::invalid_argument("unknown format " + result.format);
+  }
+  if (result.records == 0 || result.min_value_size > result.max_value_size) {
+    throw std::invalid_argument("invalid record count or value size");
+  }
+  return result;
+}
+
+/** Zipfian ranks in [0, items), rank 0 being the most frequent, after Gray
+ * et al., "Quickly Generating Billion-Record Synthetic Databases" */
+class zipfian {
+ public:
+  explicit zipfian(std::uint64_t items, double theta = 0.99)
+      : items_(items),
+        theta_(theta),
+        alpha_(1 / (1 - theta)),
+        zetan_(zeta(items, theta)),
+        eta_((1 - std::pow(2.0 / items, 1 - theta)) /
+             (1 - zeta(2, theta) / zetan_)) {}
+
+  template <typename Random>
+  std::uint64_t operator()(Random& random) const {
+    auto u = std::uniform_real_distribution<double>()(random);
+    auto uz = u * zetan_;
+    if (uz < 1) {
+      return 0;
+    }
+    if (uz < 1 + std::pow(0.5, theta_)) {
+      return std::min<std::uint64_t>(1, items_ - 1);
+    }
+    auto rank = static_cast<std::uint64_t>(
+        items_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return std::min(rank, items_ - 1);
+  }
+
+ private:
+  static double zeta(std::uint64_t items, double theta) {
+    auto result = 0.0;
+    for (std::uint64_t i = 1; i <= items; ++i) {
+      result += 1 / std::pow(static_cast<double>(i), theta);
+    }
+    return result;
+  }
+
+  std::uint64_t items_;
+  double theta_;
+  double alpha_;
+  double zetan_;
+  double eta_;
+};
+
+std::uint64_t fnv1a(std::uint64_t value) {
+  auto result = 0xcbf29ce484222325ULL;
+  for (auto i = 0; i < 8; ++i, value >>= 8) {
+    result = (result ^ (value & 0xff)) * 0x100000001b3ULL;
+  }
+  return result;
+}
+
+/** Returns the key of a record, hashed so that inserts are not in order */
+std::string key(std::uint64_t record) {
+  return "user" + std::to_string(fnv1a(record));
+}
+
+/** Latencies in nanoseconds, in buckets of 1/16 of a power of two */
+class histogram {
+ public:
+  void add(std::uint64_t nanoseconds) {
+    ++counts_[bucket(nanoseconds)];
+    ++count_;
+  }
+
+  void merge(const histogram& other) {
+    for (std::size_t i = 0; i < buckets; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+  }
+
+  [[nodiscard]] std::uint64_t count() const { return count_; }
+
+  /** Returns the lower bound of the bucket holding quantile q */
+  [[nodiscard]] std::uint64_t quantile(double q) const {
+    auto rank = static_cast<std::uint64_t>(std::ceil(q * count_));
+    auto seen = std::uint64_t{0};
+    for (std::size_t i = 0; i < buckets; ++i) {
+      seen += counts_[i];
+      if (seen >= std::max<std::uint64_t>(rank, 1)) {
+        return lower(i);
+      }
+    }
+    return 0;
+  }
+
+ private:
+  static constexpr std::size_t sub_buckets = 16;
+  static constexpr std::size_t buckets = (64 - 3) * sub_buckets;
+
+  static std::size_t bucket(std::uint64_t value) {
+    if (value < sub_buckets) {
+      return value;
+    }
+    // The highest set bit, found by halving without compiler intrinsics
+    auto exponent = std::size_t{0};
+    for (auto shift = std::size_t{32}; shift != 0; shift /= 2) {
+      if (value >> (exponent + shift) != 0) {
+        exponent += shift;
+      }
+    }
+    auto sub = (value >> (exponent - 4)) & (sub_buckets - 1);
+    return (exponent - 3) * sub_buckets + sub;
+  }
+
+  static std::uint64_t lower(std::size_t index) {
+    if (index < sub_buckets) {
+      return index;
+    }
+    auto exponent = index / sub_buckets + 3;
+    return (sub_buckets + index % sub_buckets) << (exponent - 4);
+  }
+
+  std::array<std::uint64_t, buckets> counts_{};
+  std::uint64_t count_ = 0;
+};
+
+/** Latencies of each operation recorded by one thread */
+struct recorder {
+  std::mutex mutex;
+  std::array<histogram, operation_names.size()> latencies;
+};
+
+class report {
+ public:
+  explicit report(std::string format) : format_(std::move(format)) {
+    if (format_ == "csv") {
+      std::cout << "elapsed_s,operation,count,ops_per_s,p50_us,p99_us,p999_us"
+                << std::endl;
+    }
+  }
+
+  void write(const std::string& elapsed, const std::string& name,
+             const histogram& latencies, double seconds) {
+    if (latencies.count() == 0) {
+      return;
+    }
+    auto micros = [&](double q) { return latencies.quantile(q) / 1000.0; };
+    auto throughput = seconds > 0 ? latencies.count() / seconds : 0;
+    if (format_ == "csv") {
+      std::cout << elapsed << ',' << name << ',' << latencies.count() << ','
+                << throughput << ',' << micros(0.5) << ',' << micros(0.99)
+                << ',' << micros(0.999) << std::endl;
+    } else {
+      auto quote = elapsed == "total" ? "\"" : "";
+      std::cout << "{\"elapsed_s\":" << quote << elapsed << quote
+                << ",\"operation\":\"" << name
+                << "\",\"count\":" << latencies.count()
+                << ",\"ops_per_s\":" << throughput
+                << ",\"p50_us\":" << micros(0.5)
+                << ",\"p99_us\":" << micros(0.99)
+                << ",\"p999_us\":" << micros(0.999) << '}' << std::endl;
+    }
+  }
+
+ private:
+  std::string format_;
+};
+
+/** Writes each histogram of a window, and their total */
+void write_window(report& output, const std::string& elapsed,
+                  const std::array<histogram, operation_names.size()>& window,
+                  double seconds) {
+  auto all = histogram();
+  for (std::size_t i = 0; i < window.size(); ++i) {
+    output.write(elapsed, operation_names[i], window[i], seconds);
+    all.merge(window[i]);
+  }
+  output.write(elapsed, "all", all, seconds);
+}
+
+void load(datastore::client& datastore, const options& settings,
+          const std::string& values) {
+  auto random = std::mt19937_64(settings.seed);
+  auto operations = datastore::batch();
+  for (std::uint64_t i = 0; i < settings.records; ++i) {
+    auto size = std::uniform_int_distribution<std::size_t>(
+        settings.min_value_size, settings.max_value_size)(random);
+    auto offset = std::uniform_int_distribution<std::size_t>(
+        0, values.size() - size)(random);
+    operations.put(key(i), std::string_view(values).substr(offset, size));
+    if (operations.size() == 1000) {
+      datastore.write(operations);
+      operations.clear();
+    }
+  }
+  datastore.write(operations);
+}
+
+/** A directory of its own under parent, removed with everything in it */
+class scratch {
+ public:
+  explicit scratch(const std::filesystem::path& parent) {
+    std::filesystem::create_directories(parent);
+    auto random = std::random_device();
+    // Never one which exists, so that nothing else is removed
+    do {
+      path_ = parent / ("datastore_loadgen." + std::to_string(random()));
+    } while (!std::filesystem::create_directory(path_));
+  }
+
+  ~scratch() {
+    auto error = std::error_code();
+    std::filesystem::remove_all(path_, error);
+  }
+
+  scratch(const scratch&) = delete;
+  scratch& operator=(const scratch&) = delete;
+
+  [[nodiscard]] const std::filesystem::path& path() const { return path_; }
+
+ private:
+  std::filesystem::path path_;
+};
+
+int run(const options& settings) {
+  const auto& chosen = backends().at(settings.backend);
+  auto directory = scratch(settings.directory);
+  auto datastore = chosen.make(directory.path());
+
+  // Values are slices of one random buffer, so generating them costs nothing
+  auto values = std::string(std::max<std::size_t>(settings.max_value_size * 2,
+                                                  1 << 20),
+                            '\0');
+  auto random = std::mt19937_64(settings.seed);
+  std::generate(values.begin(), values.end(),
+                [&] { return static_cast<char>('a' + random() % 26); });
+
+  auto start = clock::now();
+  load(*datastore, settings, values);
+  std::cerr << "loaded " << settings.records << " records in "
+            << std::chrono::duration<double>(clock::now() - start).count()
+            << "s" << std::endl;
+
+  const auto& mix = workloads().at(settings.workload).mix;
+  auto ranks = zipfian(settings.records);
+  auto inserted = std::atomic<std::uint64_t>(settings.records);
+  auto remaining = std::atomic<std::int64_t>(settings.operations);
+  std::mutex exclusive; /** Serialises datastores which are not shared */
+  auto recorders = std::vector<recorder>(settings.threads);
+  auto read_bytes = std::atomic<std::size_t>(0);
+
+  auto worker = [&](unsigned int index) {
+    auto random = std::mt19937_64(settings.seed + index + 1);
+    auto choose = std::discrete_distribution<int>(mix.begin(), mix.end());
+    auto pick = [&] {
+      auto count = inserted.load(std::memory_order_relaxed);
+      if (settings.distribution == "uniform") {
+        return std::uniform_int_distribution<std::uint64_t>(0, count - 1)(
+            random);
+      }
+      auto rank = ranks(random);
+      if (settings.distribution == "latest") {
+        return count - 1 - std::min(rank, count - 1);
+      }
+      // Scatter the popular records over the key space
+      return fnv1a(rank) % settings.records;
+    };
+    auto value = [&] {
+      auto size = std::uniform_int_distribution<std::size_t>(
+          settings.min_value_size, settings.max_value_size)(random);
+      auto offset = std::uniform_int_distribution<std::size_t>(
+          0, values.size() - size)(random);
+      return std::string_view(values).substr(offset, size);
+    };
+    auto bytes = std::size_t{0};
+    while (remaining.fetch_sub(1, std::memory_order_relaxed) > 0) {
+      auto type = static_cast<operation>(choose(random));
+      auto record = type == operation::insert
+                        ? inserted.fetch_add(1, std::memory_order_relaxed)
+                        : pick();
+      auto name = key(record);
+      auto begin = clock::now();
+      {
+        std::unique_lock lock(exclusive, std::defer_lock);
+        if (!chosen.shared) {
+          lock.lock();
+        }
+        switch (type) {
+          case operation::read: {
+            auto it = datastore->find(name);
+            bytes += it != datastore->end() ? it->second.size() : 0;
+            break;
+          }
+          case operation::update:
+          case operation::insert:
+            datastore->write(datastore::batch().put(name, value()));
+            break;
+          case operation::scan: {
+            auto length = std::uniform_int_distribution<std::size_t>(
+                1, settings.scan_length)(random);
+            auto end = datastore->end();
+            auto it = datastore->lower_bound(name);
+            for (std::size_t i = 0; i < length && it != end; ++i, ++it) {
+              bytes += it->second.size();
+            }
+            break;
+          }
+          case operation::read_modify_write: {
+            auto it = datastore->find(name);
+            bytes += it != datastore->end() ? it->second.size() : 0;
+            datastore->write(datastore::batch().put(name, value()));
+            break;
+          }
+        }
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          clock::now() - begin);
+      std::lock_guard lock(recorders[index].mutex);
+      recorders[index].latencies[static_cast<int>(type)].add(elapsed.count());
+    }
+    read_bytes += bytes;
+  };
+
+  auto output = report(settings.format);
+  auto total = std::array<histogram, operation_names.size()>();
+  auto collect = [&] {
+    auto window = std::array<histogram, operation_names.size()>();
+    for (auto& item : recorders) {
+      std::lock_guard lock(item.mutex);
+      for (std::size_t i = 0; i < window.size(); ++i) {
+        window[i].merge(item.latencies[i]);
+        total[i].merge(item.latencies[i]);
+      }
+      item.latencies = {};
+    }
+    return window;
+  };
+
+  start = clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < settings.threads; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  std::mutex mutex;
+  std::condition_variable finished;
+  auto done = false;
+  auto reporter = std::thread([&] {
+    auto last = start;
+    std::unique_lock lock(mutex);
+    while (!finished.wait_for(lock, settings.interval, [&] { return done; })) {
+      auto now = clock::now();
+      auto window = collect();
+      write_window(
+          output,
+          std::to_string(std::chrono::duration<double>(now - start).count()),
+          window, std::chrono::duration<double>(now - last).count());
+      last = now;
+    }
+  });
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+  {
+    std::lock_guard lock(mutex);
+    done = true;
+  }
+  finished.notify_all();
+  reporter.join();
+  collect();
+  write_window(output, "total", total, seconds);
+  std::cerr << "read " << read_bytes << " bytes" << std::endl;
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    return run(parse(argc, argv));
+  } catch (std::exception& e) {
+    std::cerr << "datastore_loadgen: " << e.what() << '\n';
+    usage(std::cerr);
+    return 1;
+  }
+}